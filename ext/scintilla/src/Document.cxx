@@ -24,6 +24,8 @@
 #include <algorithm>
 #include <memory>
 #include <chrono>
+#include <list>
+#include <mutex>
 
 #ifndef NO_CXX11_REGEX
 #include <regex>
@@ -50,6 +52,7 @@
 #include "RESearch.h"
 #include "UniConversion.h"
 #include "ElapsedPeriod.h"
+#include "RegexCache.h"
 
 using namespace Scintilla;
 using namespace Scintilla::Internal;
@@ -3426,15 +3429,14 @@ Sci::Position Cxx11RegexFindText(const Document *doc, Sci::Position minPos, Sci:
 		search.Clear();
 
 		bool matched = false;
+		// Compiling the regex often costs more than the search itself, so reuse
+		// the compiled object from previous searches with the same pattern.
 		if (CpUtf8 == doc->dbcsCodePage) {
-			const std::wstring ws = WStringFromUTF8(s);
-			std::wregex regexp;
-			regexp.assign(ws, flagsRe);
-			matched = MatchOnLines<UTF8Iterator>(doc, regexp, resr, search);
+			const RegexCache::WideRegex regexp = RegexCache::Instance().Wide(s, flagsRe);
+			matched = MatchOnLines<UTF8Iterator>(doc, *regexp, resr, search);
 		} else {
-			std::regex regexp;
-			regexp.assign(s, flagsRe);
-			matched = MatchOnLines<ByteIterator>(doc, regexp, resr, search);
+			const RegexCache::ByteRegex regexp = RegexCache::Instance().Byte(s, flagsRe);
+			matched = MatchOnLines<ByteIterator>(doc, *regexp, resr, search);
 		}
 
 		Sci::Position posMatch = -1;
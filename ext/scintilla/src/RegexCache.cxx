@@ -0,0 +1,77 @@
+// Scintilla source code edit control
+/** @file RegexCache.cxx
+ ** Process wide LRU cache of compiled C++11 regular expressions.
+ **/
+// The License.txt file describes the conditions under which this software may be distributed.
+
+#include <cstddef>
+
+#include <string>
+#include <string_view>
+#include <list>
+#include <memory>
+#include <mutex>
+
+#ifndef NO_CXX11_REGEX
+#include <regex>
+#endif
+
+#include "UniConversion.h"
+#include "RegexCache.h"
+
+using namespace Scintilla::Internal;
+
+#ifndef NO_CXX11_REGEX
+
+RegexCache &RegexCache::Instance() {
+	static RegexCache instance;
+	return instance;
+}
+
+const RegexCache::Entry *RegexCache::Lookup(std::string_view pattern, std::regex::flag_type flags, bool wide) {
+	for (auto it = entries.begin(); it != entries.end(); ++it) {
+		if ((it->wide == wide) && (it->flags == flags) && (it->pattern == pattern)) {
+			// most recently used entries live at the front
+			entries.splice(entries.begin(), entries, it);
+			return &entries.front();
+		}
+	}
+	return nullptr;
+}
+
+void RegexCache::Insert(Entry &&entry) {
+	entries.push_front(std::move(entry));
+	while (entries.size() > capacity) {
+		entries.pop_back();
+	}
+}
+
+RegexCache::ByteRegex RegexCache::Byte(std::string_view pattern, std::regex::flag_type flags) {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (const Entry *entry = Lookup(pattern, flags, false)) {
+			return entry->byteRegex;
+		}
+	}
+	// compile outside the lock: this is the expensive part and may throw
+	auto compiled = std::make_shared<const std::regex>(pattern.data(), pattern.size(), flags);
+	std::lock_guard<std::mutex> lock(mutex);
+	Insert(Entry{std::string(pattern), flags, false, compiled, nullptr});
+	return compiled;
+}
+
+RegexCache::WideRegex RegexCache::Wide(std::string_view pattern, std::regex::flag_type flags) {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (const Entry *entry = Lookup(pattern, flags, true)) {
+			return entry->wideRegex;
+		}
+	}
+	const std::wstring ws = WStringFromUTF8(pattern);
+	auto compiled = std::make_shared<const std::wregex>(ws, flags);
+	std::lock_guard<std::mutex> lock(mutex);
+	Insert(Entry{std::string(pattern), flags, true, nullptr, compiled});
+	return compiled;
+}
+
+#endif
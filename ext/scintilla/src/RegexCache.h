@@ -0,0 +1,69 @@
+// Scintilla source code edit control
+/** @file RegexCache.h
+ ** Process wide LRU cache of compiled C++11 regular expressions.
+ **/
+// The License.txt file describes the conditions under which this software may be distributed.
+
+#ifndef REGEXCACHE_H
+#define REGEXCACHE_H
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <list>
+#include <memory>
+#include <mutex>
+#ifndef NO_CXX11_REGEX
+#include <regex>
+#endif
+
+namespace Scintilla::Internal {
+
+#ifndef NO_CXX11_REGEX
+
+/**
+ * Compiling a std::regex is far more expensive than most searches done with it,
+ * and the same pattern is usually used over and over again: find next, the
+ * highlighting of matches on every UI update, replace all loops.
+ * The cache is shared by all documents and is safe to use from worker threads
+ * since the compiled objects are immutable and handed out as shared pointers.
+ */
+class RegexCache {
+public:
+	using ByteRegex = std::shared_ptr<const std::regex>;
+	using WideRegex = std::shared_ptr<const std::wregex>;
+
+	static RegexCache &Instance();
+
+	/// Returns the compiled regex for the UTF-8 or byte pattern.
+	/// Throws std::regex_error if the pattern is invalid. Invalid patterns are not cached.
+	ByteRegex Byte(std::string_view pattern, std::regex::flag_type flags);
+	/// Returns the compiled regex for the UTF-8 pattern, converted to UTF-16/32 first.
+	WideRegex Wide(std::string_view pattern, std::regex::flag_type flags);
+
+private:
+	RegexCache() = default;
+
+	struct Entry {
+		std::string pattern;
+		std::regex::flag_type flags;
+		bool wide;
+		ByteRegex byteRegex;
+		WideRegex wideRegex;
+	};
+
+	// returns the entry moved to the front of the list, or nullptr if not cached
+	const Entry *Lookup(std::string_view pattern, std::regex::flag_type flags, bool wide);
+	void Insert(Entry &&entry);
+
+	static constexpr size_t capacity = 64;
+
+	std::mutex mutex;
+	std::list<Entry> entries;
+};
+
+#endif
+
+}
+
+#endif
@@ -108,6 +108,7 @@ SRC_OBJS=\
 	$(DIR_O)\MarginView.obj \
 	$(DIR_O)\PerLine.obj \
 	$(DIR_O)\PositionCache.obj \
+	$(DIR_O)\RegexCache.obj \
 	$(DIR_O)\RESearch.obj \
 	$(DIR_O)\RunStyles.obj \
 	$(DIR_O)\Selection.obj \
@@ -19,7 +19,7 @@
 #include "AppUtils.h"
 #include "BowPad.h"
 #include "DarkModeHelper.h"
-#include "DirFileEnum.h"
+#include "DirListCache.h"
 #include "LexStyles.h"
 #include "MainWindow.h"
 #include "OnOutOfScope.h"
@@ -32,10 +32,56 @@
 #include "SciTextReader.h"
 #include "../ext/tinyexpr/tinyexpr.h"
 
+#include <algorithm>
 #include <chrono>
+#include <thread>
 
 constexpr int fullSnippetPosId = 9999;
 
+// ranking of the words offered for autocompletion
+constexpr int scoreSnippet      = 1000;
+constexpr int scoreDocumentWord = 40;
+constexpr int scoreLanguageWord = 20;
+constexpr int bonusMatchCase    = 30;
+// words found close to the caret, decreasing with the distance
+constexpr int bonusProximity    = 60;
+// per time the word was picked from the list before
+constexpr int bonusUse          = 10;
+constexpr int maxUseCount       = 20;
+
+// the least used words are dropped once more than that were picked
+constexpr size_t maxUsedWords           = 2000;
+// longer identifiers are most likely encoded data, not words anyone types
+constexpr size_t maxHarvestedWordLength = 80;
+
+// UTF-8 lead and continuation bytes are treated as word characters,
+// so identifiers with non-ASCII letters are harvested as a whole
+static bool IsIdentifierChar(char ch)
+{
+    auto c = static_cast<unsigned char>(ch);
+    return c >= 0x80 || isalnum(c) || c == '_';
+}
+
+template <typename Callback>
+static void ForEachIdentifier(std::string_view text, Callback&& callback)
+{
+    size_t pos = 0;
+    while (pos < text.size())
+    {
+        if (!IsIdentifierChar(text[pos]))
+        {
+            ++pos;
+            continue;
+        }
+        auto start = pos;
+        while (pos < text.size() && IsIdentifierChar(text[pos]))
+            ++pos;
+        auto word = text.substr(start, pos - start);
+        if (word.size() > 1 && word.size() <= maxHarvestedWordLength && !isdigit(static_cast<unsigned char>(word[0])))
+            callback(word);
+    }
+}
+
 static HICON  LoadIconEx(HINSTANCE hInstance, LPCWSTR lpIconName, int iconWidth, int iconHeight)
 {
     // the docs for LoadIconWithScaleDown don't mention that a size of 0 will
@@ -169,13 +215,22 @@ static bool getPathsForPathCompletion(const std::wstring& input, std::wstring& p
 CAutoComplete::CAutoComplete(CMainWindow* main, CScintillaWnd* scintilla)
     : m_editor(scintilla)
     , m_main(main)
+    , m_stopHarvest(false)
     , m_insertingSnippet(false)
+    , m_pathListPending(false)
     , m_currentSnippetPos(-1)
 {
 }
 
 CAutoComplete::~CAutoComplete()
 {
+    {
+        std::lock_guard<std::recursive_mutex> lockGuard(m_mutex);
+        m_stopHarvest = true;
+    }
+    m_harvestCondition.notify_one();
+    if (m_harvestThread.joinable())
+        m_harvestThread.join();
 }
 
 void CAutoComplete::Init()
@@ -190,6 +245,8 @@ void CAutoComplete::Init()
     m_editor->Scintilla().RGBAImageSetWidth(iconWidth);
     m_editor->Scintilla().RGBAImageSetHeight(iconHeight);
     m_editor->Scintilla().AutoCSetIgnoreCase(TRUE);
+    // the lists are ranked, not sorted alphabetically
+    m_editor->Scintilla().AutoCSetOrder(Scintilla::Ordering::Custom);
     m_editor->Scintilla().AutoCStops("([.");
     int i = 0;
     for (auto icon : {IDI_SCI_CODE, IDI_SCI_FILE, IDI_SCI_SNIPPET, IDI_WORD})
@@ -252,20 +309,21 @@ void CAutoComplete::Init()
     auto autocompleteWords = CLexStyles::Instance().GetAutoCompleteWords();
     for (const auto& [lang, words] : autocompleteWords)
     {
-        std::map<std::string, AutoCompleteType, ci_less> acMap;
-        std::vector<std::string>                         values;
+        CWordStore               store;
+        std::vector<std::string> values;
         stringtok(values, words, true, " ");
         for (const auto& v : values)
-            acMap[v] = AutoCompleteType::Code;
+            store.Add(v, AutoCompleteType::Code);
         std::lock_guard<std::recursive_mutex> lockGuard(m_mutex);
-        m_langWordList[lang] = std::move(acMap);
+        m_langWordList[lang] = std::move(store);
     }
     const auto& langDataMap = CLexStyles::Instance().GetLanguageDataMap();
     for (const auto& [lang, data] : langDataMap)
     {
         if (!data.keywordList.empty())
         {
-            std::map<std::string, AutoCompleteType, ci_less> acMap;
+            std::lock_guard<std::recursive_mutex> lockGuard(m_mutex);
+            auto&                                 store = m_langWordList[lang];
             for (const auto& [id, keywordString] : data.keywordList)
             {
                 std::vector<std::string> values;
@@ -273,11 +331,9 @@ void CAutoComplete::Init()
                 for (const auto& v : values)
                 {
                     if (v.size() > 4 && std::isalpha(v[0]))
-                        acMap[v] = AutoCompleteType::Code;
+                        store.Add(v, AutoCompleteType::Code);
                 }
             }
-            if (!acMap.empty())
-                m_langWordList[lang].insert(acMap.begin(), acMap.end());
         }
     }
 }
@@ -457,12 +513,23 @@ void CAutoComplete::HandleScintillaEvents(const SCNotification* scn)
             }
         }
         break;
-        case SCN_AUTOCCANCELLED:
         case SCN_AUTOCCOMPLETED:
+            if (scn->text && scn->listType == 0)
+            {
+                AddWordUse(scn->text);
+            }
             m_stringToSelect.clear();
             break;
+        case SCN_AUTOCCANCELLED:
+            m_stringToSelect.clear();
+            m_pathListPending = false;
+            break;
         case SCN_MODIFIED:
         {
+            // the tab bar may point to another tab already while the editor
+            // still shows the document the edit belongs to
+            if (scn->modificationType & (SC_MOD_BEFOREINSERT | SC_MOD_BEFOREDELETE | SC_MOD_DELETETEXT | SC_MOD_INSERTTEXT))
+                HarvestEdit(scn, m_main->m_docManager.GetIdForDocument(m_editor->Scintilla().DocPointer()));
             if (scn->modificationType & (SC_MOD_DELETETEXT | SC_MOD_INSERTTEXT))
             {
                 if (m_currentSnippetPos >= 0 && !m_snippetPositions.empty())
@@ -587,25 +654,209 @@ bool CAutoComplete::HandleChar(WPARAM wParam, LPARAM /*lParam*/)
 void CAutoComplete::AddWords(const std::string& lang, std::map<std::string, AutoCompleteType>&& words)
 {
     std::lock_guard<std::recursive_mutex> lockGuard(m_mutex);
-    m_langWordList[lang].insert(words.begin(), words.end());
+    auto&                                 store = m_langWordList[lang];
+    for (const auto& [word, type] : words)
+        store.Add(word, type);
 }
 
 void CAutoComplete::AddWords(const std::string& lang, const std::map<std::string, AutoCompleteType>& words)
 {
     std::lock_guard<std::recursive_mutex> lockGuard(m_mutex);
-    m_langWordList[lang].insert(words.begin(), words.end());
+    auto&                                 store = m_langWordList[lang];
+    for (const auto& [word, type] : words)
+        store.Add(word, type);
 }
 
 void CAutoComplete::AddWords(const DocID& docID, std::map<std::string, AutoCompleteType>&& words)
 {
     std::lock_guard<std::recursive_mutex> lockGuard(m_mutex);
-    m_docWordList[docID].insert(words.begin(), words.end());
+    auto&                                 store = m_docWordList[docID];
+    for (const auto& [word, type] : words)
+        store.Add(word, type);
 }
 
 void CAutoComplete::AddWords(const DocID& docID, const std::map<std::string, AutoCompleteType>& words)
 {
     std::lock_guard<std::recursive_mutex> lockGuard(m_mutex);
-    m_docWordList[docID].insert(words.begin(), words.end());
+    auto&                                 store = m_docWordList[docID];
+    for (const auto& [word, type] : words)
+        store.Add(word, type);
+}
+
+void CAutoComplete::OnDocumentOpen(const DocID& docID)
+{
+    HarvestDocument(docID);
+}
+
+void CAutoComplete::OnDocumentClose(const DocID& docID)
+{
+    std::lock_guard<std::recursive_mutex> lockGuard(m_mutex);
+    m_docWordList.erase(docID);
+    m_documentWords.erase(docID);
+}
+
+void CAutoComplete::OnDocumentTextChanged(const DocID& docID)
+{
+    HarvestDocument(docID);
+}
+
+void CAutoComplete::HarvestDocument(const DocID& docID)
+{
+    if (!m_main->m_docManager.HasDocumentID(docID))
+        return;
+    const auto& doc     = m_main->m_docManager.GetDocumentFromID(docID);
+    auto&       scratch = m_main->m_scratchEditor;
+    scratch.Scintilla().SetDocPointer(doc.m_document);
+    OnOutOfScope(scratch.Scintilla().SetDocPointer(nullptr));
+    const auto length  = scratch.Scintilla().Length();
+    const auto maxSize = CIniSettings::Instance().GetInt64(L"View", L"autocompleteHarvestMaxSize", 32 * 1024 * 1024);
+
+    std::lock_guard<std::recursive_mutex> lockGuard(m_mutex);
+    auto&                                 documentWords = m_documentWords[docID];
+    if (!documentWords)
+        documentWords = std::make_shared<DocumentWords>();
+    // the text is taken now, so edits made before are part of the harvest
+    documentWords->changes.clear();
+    ++documentWords->harvest;
+    if (length > maxSize)
+    {
+        documentWords->words.Clear();
+        documentWords->state = HarvestState::Skipped;
+        return;
+    }
+    documentWords->state = HarvestState::Running;
+    HarvestJob job{documentWords, documentWords->harvest};
+    // an unmodified file is read and decoded again by the harvest thread
+    // instead of copying the text here
+    if (!doc.m_path.empty() && !doc.m_bIsDirty && !doc.m_bNeedsSaving && !documentWords->fileUnreadable)
+    {
+        job.path    = doc.m_path;
+        job.maxSize = static_cast<uint64_t>(maxSize);
+    }
+    else if (doc.m_document == m_editor->Scintilla().DocPointer())
+        job.text = m_editor->GetTextSnapshot();
+    else
+        job.text = std::make_shared<const std::string>(scratch.Scintilla().StringOfRange(Scintilla::Span(0, length)));
+    m_harvestQueue.push_back(std::move(job));
+    // one thread works through the queue: after restoring a session
+    // there's a job for every document
+    if (!m_harvestThread.joinable())
+        m_harvestThread = std::thread(&CAutoComplete::RunHarvestJobs, this);
+    m_harvestCondition.notify_one();
+}
+
+void CAutoComplete::RunHarvestJobs()
+{
+    // the encoding detection uses IMultiLanguage
+    CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+    OnOutOfScope(CoUninitialize());
+    for (;;)
+    {
+        HarvestJob job;
+        {
+            std::unique_lock<std::recursive_mutex> lock(m_mutex);
+            m_harvestCondition.wait(lock, [this] { return m_stopHarvest || !m_harvestQueue.empty(); });
+            if (m_stopHarvest)
+            {
+                m_harvestQueue.clear();
+                return;
+            }
+            job = std::move(m_harvestQueue.front());
+            m_harvestQueue.pop_front();
+        }
+        std::string fileText;
+        const bool  read = job.text || CDocumentManager::ReadFileAsUtf8(job.path, job.maxSize, fileText);
+        std::unordered_map<std::string_view, int> counts;
+        ForEachIdentifier(job.text ? std::string_view(*job.text) : std::string_view(fileText), [&](std::string_view word) { ++counts[word]; });
+
+        std::lock_guard<std::recursive_mutex> lockGuard(m_mutex);
+        auto&                                 target = *job.target;
+        // the document was harvested again in the meantime
+        if (target.harvest != job.harvest)
+            continue;
+        if (!read)
+        {
+            // harvested from the editor once the document is shown
+            target.state          = HarvestState::None;
+            target.fileUnreadable = true;
+            continue;
+        }
+        target.words.Clear();
+        for (const auto& [word, count] : counts)
+            target.words.Add(word, AutoCompleteType::Word, count);
+        for (const auto& [word, delta] : target.changes)
+        {
+            if (delta > 0)
+                target.words.Add(word, AutoCompleteType::Word, delta);
+            else if (delta < 0)
+                target.words.Remove(word, -delta);
+        }
+        target.changes.clear();
+        target.state = HarvestState::Done;
+    }
+}
+
+void CAutoComplete::AddWordUse(const std::string& word)
+{
+    std::lock_guard<std::recursive_mutex> lockGuard(m_mutex);
+    auto&                                 uses = m_wordUses[word];
+    uses                                       = min(uses + 1, maxUseCount);
+    if (m_wordUses.size() <= maxUsedWords)
+        return;
+    // drop a quarter at once so this doesn't happen on every pick,
+    // but never the word that was just picked
+    std::vector<std::pair<std::string, int>> entries(m_wordUses.begin(), m_wordUses.end());
+    const auto                               keep = entries.begin() + maxUsedWords * 3 / 4;
+    std::nth_element(entries.begin(), keep, entries.end(), [](const auto& lhs, const auto& rhs) { return lhs.second > rhs.second; });
+    for (auto it = keep; it != entries.end(); ++it)
+    {
+        if (it->first != word)
+            m_wordUses.erase(it->first);
+    }
+}
+
+void CAutoComplete::HarvestEdit(const SCNotification* scn, const DocID& docID)
+{
+    if (!docID.IsValid())
+        return;
+    // the words touching the changed range are removed before the change
+    // and the words touching it afterwards are added again
+    const bool         before    = (scn->modificationType & (SC_MOD_BEFOREINSERT | SC_MOD_BEFOREDELETE)) != 0;
+    const bool         insert    = (scn->modificationType & (SC_MOD_BEFOREINSERT | SC_MOD_INSERTTEXT)) != 0;
+    auto&              sci       = m_editor->Scintilla();
+    const Sci_Position changeEnd = (before != insert) ? scn->position + scn->length : scn->position;
+    // longer identifiers aren't harvested, so there's no need to look
+    // further for the ends of the words around the change: a word cut
+    // off at the end of the range is too long to count either way
+    constexpr Sci_Position margin     = static_cast<Sci_Position>(maxHarvestedWordLength) + 1;
+    const Sci_Position     rangeStart = max(Sci_Position(0), scn->position - margin);
+    const Sci_Position     rangeEnd   = min(sci.Length(), changeEnd + margin);
+    const std::string_view range(static_cast<const char*>(sci.RangePointer(rangeStart, rangeEnd - rangeStart)), rangeEnd - rangeStart);
+    size_t                 start = static_cast<size_t>(scn->position - rangeStart);
+    size_t                 end   = static_cast<size_t>(changeEnd - rangeStart);
+    while (start > 0 && IsIdentifierChar(range[start - 1]))
+        --start;
+    while (end < range.size() && IsIdentifierChar(range[end]))
+        ++end;
+
+    std::lock_guard<std::recursive_mutex> lockGuard(m_mutex);
+    auto&                                 documentWords = m_documentWords[docID];
+    if (!documentWords)
+        documentWords = std::make_shared<DocumentWords>();
+    if (start < end && documentWords->state != HarvestState::Skipped)
+        CountWords(*documentWords, range.substr(start, end - start), before ? -1 : 1);
+}
+
+void CAutoComplete::CountWords(DocumentWords& documentWords, std::string_view text, int delta)
+{
+    ForEachIdentifier(text, [&](std::string_view word) {
+        if (documentWords.state != HarvestState::Done)
+            documentWords.changes[std::string(word)] += delta;
+        else if (delta > 0)
+            documentWords.words.Add(word, AutoCompleteType::Word, delta);
+        else
+            documentWords.words.Remove(word, -delta);
+    });
 }
 
 void CAutoComplete::HandleAutoComplete(const SCNotification* scn)
@@ -648,55 +899,8 @@ void CAutoComplete::HandleAutoComplete(const SCNotification* scn)
         return; // don't auto complete if we're not at the end of a word
     auto word        = m_editor->GetCurrentWord();
 
-    // path completion: get the current line
-    auto currentLine = CUnicodeUtils::StdGetUnicode(m_editor->GetCurrentLine());
-    CStringUtils::rtrim(currentLine, L"\r\n");
-    std::wstring pathToMatch, rawPath;
-    if (getPathsForPathCompletion(currentLine, rawPath, pathToMatch))
-    {
-        if (m_editor->Scintilla().AutoCActive())
-            return;
-
-        auto lineStartPos = m_editor->Scintilla().PositionFromLine(m_editor->Scintilla().LineFromPosition(pos));
-        if (currentLine.find(rawPath) == (pos - lineStartPos - CUnicodeUtils::StdGetUTF8(rawPath).size()))
-        {
-            std::string pathComplete;
-            if (pathToMatch.ends_with(':'))
-                pathToMatch += '\\';
-            SearchReplace(pathToMatch, L"/", L"\\");
-            CDirFileEnum   fileFinder(pathToMatch);
-            bool           bIsDirectory;
-            std::wstring   filename;
-
-            auto           startTime   = std::chrono::steady_clock::now();
-            constexpr auto maxPathTime = std::chrono::milliseconds(400);
-            auto           rootDir     = rawPath.substr(0, rawPath.find_last_of(L"\\/") + 1);
-            while (fileFinder.NextFile(filename, &bIsDirectory, false))
-            {
-                if (rootDir.size() < filename.size())
-                {
-                    filename = rootDir + filename.substr(rootDir.size());
-                    pathComplete += (CUnicodeUtils::StdGetUTF8(filename) + typeSeparator + std::to_string(static_cast<int>(AutoCompleteType::Path)) + wordSeparator);
-                }
-                auto elapsedPeriod = std::chrono::steady_clock::now() - startTime;
-                if (elapsedPeriod > maxPathTime)
-                    break;
-            }
-            if (!pathComplete.empty())
-            {
-                m_editor->Scintilla().AutoCSetAutoHide(TRUE);
-                m_editor->Scintilla().AutoCSetSeparator(static_cast<uptr_t>(wordSeparator));
-                m_editor->Scintilla().AutoCSetTypeSeparator(static_cast<uptr_t>(typeSeparator));
-                auto option = Scintilla::AutoCompleteOption::SelectFirstItem;
-                if (CTheme::Instance().IsDarkTheme())
-                    option = static_cast<Scintilla::AutoCompleteOption>(static_cast<int>(option) | static_cast<int>(Scintilla::AutoCompleteOption::FixedSize));
-                m_editor->Scintilla().AutoCSetOptions(option);
-                m_editor->Scintilla().AutoCShow(CUnicodeUtils::StdGetUTF8(rawPath).size(), pathComplete.c_str());
-                SetWindowStylesForAutocompletionPopup();
-                return;
-            }
-        }
-    }
+    if (HandlePathCompletion(false))
+        return;
 
     if (scn->ch == '=')
     {
@@ -848,33 +1052,59 @@ void CAutoComplete::HandleAutoComplete(const SCNotification* scn)
     }
     else if (CIniSettings::Instance().GetInt64(L"View", L"autocomplete", 1) && word.size() > 1)
     {
-        std::map<std::string, AutoCompleteType> wordSet;
+        struct Candidate
+        {
+            AutoCompleteType type      = AutoCompleteType::Word;
+            int              score     = 0;
+            int              proximity = 0;
+        };
+        std::unordered_map<std::string, Candidate> candidates;
         {
             std::lock_guard<std::recursive_mutex> lockGuard(m_mutex);
             auto                                  docID        = m_main->m_tabBar.GetCurrentTabId();
-            auto                                  docAutoList  = m_docWordList[docID];
+            auto&                                 docAutoList  = m_docWordList[docID];
             auto                                  lang         = m_main->m_docManager.GetDocumentFromID(docID).GetLanguage();
-            auto                                  langAutoList = m_langWordList[lang];
+            auto&                                 langAutoList = m_langWordList[lang];
             const auto&                           snippetMap   = m_langSnippetList[lang];
-            if (docAutoList.empty() && langAutoList.empty() && snippetMap.empty() && (scn->ch != ' '))
+            auto&                                 harvested    = m_documentWords[docID];
+            // documents never harvested, or whose file
+            // couldn't be read by the harvest thread
+            if (!harvested || harvested->state == HarvestState::None)
+                HarvestDocument(docID);
+            const bool harvestDone = harvested && harvested->state == HarvestState::Done;
+            if (docAutoList.empty() && langAutoList.empty() && snippetMap.empty() && !harvestDone && (scn->ch != ' '))
                 return;
 
-            PrepareWordList(wordSet);
-
-            for (const auto& list : {docAutoList, langAutoList})
+            std::unordered_map<std::string, int> nearWords;
+            PrepareWordList(nearWords);
+            for (const auto& [nearWord, bonus] : nearWords)
+                candidates[nearWord].proximity = bonus;
+
+            auto addWords = [&](CWordStore& list, int score) {
+                list.ForEachWithPrefix(word, [&](std::string_view found, AutoCompleteType type) {
+                    // identifiers found by the function parser that are gone from the document
+                    if (harvestDone && &list == &docAutoList && !harvested->words.Contains(found) &&
+                        std::all_of(found.begin(), found.end(), IsIdentifierChar))
+                        return;
+                    auto [it, inserted] = candidates.try_emplace(std::string(found));
+                    // a word found close to the caret might also be a keyword
+                    if (inserted || it->second.type == AutoCompleteType::Word)
+                        it->second.type = type;
+                    it->second.score = max(it->second.score, score);
+                });
+            };
+            if (harvestDone)
+                addWords(harvested->words, scoreDocumentWord);
+            addWords(docAutoList, scoreDocumentWord);
+            addWords(langAutoList, scoreLanguageWord);
+
+            for (auto& [candidate, info] : candidates)
             {
-                for (auto lowerIt = list.lower_bound(word); lowerIt != list.end(); ++lowerIt)
-                {
-                    int compare = _strnicmp(word.c_str(), lowerIt->first.c_str(), word.size());
-                    if (compare == 0)
-                    {
-                        wordSet.emplace(lowerIt->first, lowerIt->second);
-                    }
-                    else
-                    {
-                        break;
-                    }
-                }
+                info.score += info.proximity;
+                if (candidate.starts_with(word))
+                    info.score += bonusMatchCase;
+                if (auto uses = m_wordUses.find(candidate); uses != m_wordUses.end())
+                    info.score += uses->second * bonusUse;
             }
 
             for (const auto& [name, text] : snippetMap)
@@ -884,18 +1114,32 @@ void CAutoComplete::HandleAutoComplete(const SCNotification* scn)
                 {
                     auto sVal                = SanitizeSnippetText(text);
                     auto sAutoCompleteString = CStringUtils::Format("%s: %s", name.c_str(), sVal.c_str());
-                    wordSet.emplace(sAutoCompleteString, AutoCompleteType::Snippet);
-                    wordSet.erase(name);
+                    candidates[sAutoCompleteString] = Candidate{AutoCompleteType::Snippet, scoreSnippet};
+                    candidates.erase(name);
                 }
             }
         }
-        if (wordSet.empty())
+        if (candidates.empty())
             m_editor->Scintilla().AutoCCancel();
         else
         {
+            // only the best matches are shown: a list of thousands of words
+            // is slow to build and of no use anyway
+            const auto maxItems = static_cast<size_t>(max(1, CIniSettings::Instance().GetInt64(L"View", L"autocompleteMaxItems", 100)));
+            std::vector<std::pair<std::string, Candidate>> ranked(std::make_move_iterator(candidates.begin()), std::make_move_iterator(candidates.end()));
+            auto better = [](const auto& lhs, const auto& rhs) {
+                if (lhs.second.score != rhs.second.score)
+                    return lhs.second.score > rhs.second.score;
+                auto compare = _stricmp(lhs.first.c_str(), rhs.first.c_str());
+                return compare != 0 ? compare < 0 : lhs.first < rhs.first;
+            };
+            const auto itemCount = min(maxItems, ranked.size());
+            std::partial_sort(ranked.begin(), ranked.begin() + itemCount, ranked.end(), better);
+            ranked.resize(itemCount);
+
             std::string sAutoCompleteList;
-            for (const auto& [word2, autoCompleteType] : wordSet)
-                sAutoCompleteList += CStringUtils::Format("%s%c%d%c", word2.c_str(), typeSeparator, static_cast<int>(autoCompleteType), wordSeparator);
+            for (const auto& [word2, candidate] : ranked)
+                sAutoCompleteList += CStringUtils::Format("%s%c%d%c", word2.c_str(), typeSeparator, static_cast<int>(candidate.type), wordSeparator);
             if (sAutoCompleteList.empty())
                 return;
             if (sAutoCompleteList.size() > 1)
@@ -914,6 +1158,69 @@ void CAutoComplete::HandleAutoComplete(const SCNotification* scn)
     }
 }
 
+bool CAutoComplete::HandlePathCompletion(bool refresh)
+{
+    static constexpr auto wordSeparator = '\n';
+    static constexpr auto typeSeparator = '?';
+
+    auto pos         = m_editor->Scintilla().CurrentPos();
+    // path completion: get the current line
+    auto currentLine = CUnicodeUtils::StdGetUnicode(m_editor->GetCurrentLine());
+    CStringUtils::rtrim(currentLine, L"\r\n");
+    std::wstring pathToMatch, rawPath;
+    if (!getPathsForPathCompletion(currentLine, rawPath, pathToMatch))
+        return false;
+    if (m_editor->Scintilla().AutoCActive() && !refresh)
+        return true;
+
+    auto lineStartPos = m_editor->Scintilla().PositionFromLine(m_editor->Scintilla().LineFromPosition(pos));
+    if (currentLine.find(rawPath) != (pos - lineStartPos - CUnicodeUtils::StdGetUTF8(rawPath).size()))
+        return false;
+
+    std::string pathComplete;
+    if (pathToMatch.ends_with(':'))
+        pathToMatch += '\\';
+    SearchReplace(pathToMatch, L"/", L"\\");
+    // listing a folder can take a long time on network drives: show what's
+    // known about it now and the rest when the listing is done
+    std::vector<std::wstring> files;
+    m_pathListPending = !CDirListCache::Instance().Get(pathToMatch, files, *m_main, WM_PATHLISTREADY);
+    auto rootDir      = rawPath.substr(0, rawPath.find_last_of(L"\\/") + 1);
+    for (auto& filename : files)
+    {
+        if (rootDir.size() < filename.size())
+        {
+            filename = rootDir + filename.substr(rootDir.size());
+            pathComplete += (CUnicodeUtils::StdGetUTF8(filename) + typeSeparator + std::to_string(static_cast<int>(AutoCompleteType::Path)) + wordSeparator);
+        }
+    }
+    if (pathComplete.empty())
+        return false;
+
+    m_editor->Scintilla().AutoCSetAutoHide(TRUE);
+    m_editor->Scintilla().AutoCSetSeparator(static_cast<uptr_t>(wordSeparator));
+    m_editor->Scintilla().AutoCSetTypeSeparator(static_cast<uptr_t>(typeSeparator));
+    auto option = Scintilla::AutoCompleteOption::SelectFirstItem;
+    if (CTheme::Instance().IsDarkTheme())
+        option = static_cast<Scintilla::AutoCompleteOption>(static_cast<int>(option) | static_cast<int>(Scintilla::AutoCompleteOption::FixedSize));
+    m_editor->Scintilla().AutoCSetOptions(option);
+    m_editor->Scintilla().AutoCShow(CUnicodeUtils::StdGetUTF8(rawPath).size(), pathComplete.c_str());
+    SetWindowStylesForAutocompletionPopup();
+    return true;
+}
+
+void CAutoComplete::OnPathListReady()
+{
+    // only update a list the user still waits for
+    if (!m_pathListPending || m_insertingSnippet)
+        return;
+    m_pathListPending = false;
+    auto pos          = m_editor->Scintilla().CurrentPos();
+    if (pos != m_editor->Scintilla().WordEndPosition(pos, TRUE))
+        return;
+    HandlePathCompletion(true);
+}
+
 void CAutoComplete::ExitSnippetMode()
 {
     MarkSnippetPositions(true);
@@ -963,10 +1270,15 @@ void CAutoComplete::MarkSnippetPositions(bool clearOnly)
     }
 }
 
-void CAutoComplete::PrepareWordList(std::map<std::string, AutoCompleteType>& wordList) const
+// Finds the words around the caret which start with the word being typed.
+// Words closer to the caret get a higher bonus. Only the lines close to the
+// caret are searched: the words of the whole document are already known
+// from the regex parsing of the document.
+void CAutoComplete::PrepareWordList(std::unordered_map<std::string, int>& nearWords) const
 {
     const bool          autoCompleteIgnoreCase = CIniSettings::Instance().GetInt64(L"View", L"autocompleteIgnorecase", 0) != 0;
     const auto          maxSearchTime          = std::chrono::milliseconds(CIniSettings::Instance().GetInt64(L"View", L"autocompleteMaxSearchTime", 2000));
+    const auto          proximityLines         = max(1, CIniSettings::Instance().GetInt64(L"View", L"autocompleteProximityLines", 2000));
 
     auto                lineLen                = m_editor->Scintilla().GetCurLine(0, nullptr);
     const auto          line                   = m_editor->Scintilla().GetCurLine(lineLen);
@@ -991,21 +1303,21 @@ void CAutoComplete::PrepareWordList(std::map<std::string, AutoCompleteType>& wor
 
     const auto root           = line.substr(startword, current - startword);
     const auto rootLength     = static_cast<Scintilla::Position>(root.length());
-    const auto doclen         = m_editor->Scintilla().Length();
+    const auto searchStart    = m_editor->Scintilla().PositionFromLine(max(0, ln - proximityLines));
+    const auto searchEnd      = m_editor->Scintilla().LineEnd(ln + proximityLines);
     const auto flags          = Scintilla::FindOption::WordStart | (autoCompleteIgnoreCase ? Scintilla::FindOption::None : Scintilla::FindOption::MatchCase);
     const auto posCurrentWord = m_editor->Scintilla().CurrentPos() - rootLength;
 
-    m_editor->Scintilla().SetTarget(Scintilla::Span(0, doclen));
+    m_editor->Scintilla().SetTarget(Scintilla::Span(searchStart, searchEnd));
     m_editor->Scintilla().SetSearchFlags(flags);
     auto          posFind = m_editor->Scintilla().SearchInTarget(root);
     SciTextReader acc(m_editor->Scintilla());
     auto          startTime = std::chrono::steady_clock::now();
-    // search the whole document
-    while (posFind >= 0 && posFind < doclen)
+    while (posFind >= 0 && posFind < searchEnd)
     {
         auto elapsedPeriod = std::chrono::steady_clock::now() - startTime;
         if (elapsedPeriod > maxSearchTime)
-            break; // don't search for too long, some documents can be huge!
+            break; // don't search for too long, lines can be huge!
         Scintilla::Position wordEnd = posFind + rootLength;
         if (posFind != posCurrentWord)
         {
@@ -1014,11 +1326,13 @@ void CAutoComplete::PrepareWordList(std::map<std::string, AutoCompleteType>& wor
             const auto wordLength = wordEnd - posFind;
             if (wordLength > rootLength)
             {
-                const auto word = m_editor->Scintilla().StringOfSpan(Scintilla::Span(posFind, wordEnd));
-                wordList.emplace(word, AutoCompleteType::Word);
+                const auto distance = std::abs(m_editor->Scintilla().LineFromPosition(posFind) - ln);
+                const auto bonus    = static_cast<int>(bonusProximity * (proximityLines - min(distance, proximityLines)) / proximityLines);
+                auto&      best     = nearWords[m_editor->Scintilla().StringOfSpan(Scintilla::Span(posFind, wordEnd))];
+                best                = max(best, bonus);
             }
         }
-        m_editor->Scintilla().SetTarget(Scintilla::Span(wordEnd, doclen));
+        m_editor->Scintilla().SetTarget(Scintilla::Span(wordEnd, searchEnd));
         posFind = m_editor->Scintilla().SearchInTarget(root);
     }
 }
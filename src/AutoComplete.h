@@ -19,22 +19,20 @@
 #include "StringUtils.h"
 #include "DlgResizer.h"
 #include "ScintillaWnd.h"
+#include "WordStore.h"
 #include "../ext/scintilla/include/Sci_Position.h"
+#include <condition_variable>
+#include <deque>
+#include <memory>
 #include <mutex>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
 
 class CMainWindow;
 class DocID;
 struct SCNotification;
 
-enum class AutoCompleteType : int
-{
-    None = -1,
-    Code = 0,
-    Path,
-    Snippet,
-    Word,
-};
-
 class CAutoComplete
 {
     friend class CAutoCompleteConfigDlg;
@@ -50,29 +48,78 @@ public:
     void AddWords(const std::string& lang, const std::map<std::string, AutoCompleteType>& words);
     void AddWords(const DocID& docID, std::map<std::string, AutoCompleteType>&& words);
     void AddWords(const DocID& docID, const std::map<std::string, AutoCompleteType>& words);
+    /// starts harvesting the words of the document in the background
+    void OnDocumentOpen(const DocID& docID);
+    void OnDocumentClose(const DocID& docID);
+    /// the text was replaced without going through the editor, e.g. reloaded from disk
+    void OnDocumentTextChanged(const DocID& docID);
+    /// the folder listing requested by the path completion is ready
+    void OnPathListReady();
 
 private:
+    enum class HarvestState
+    {
+        None,
+        Running,
+        Done,
+        Skipped
+    };
+    // every identifier in a document with the number of times it appears
+    struct DocumentWords
+    {
+        CWordStore                           words;
+        HarvestState                         state   = HarvestState::None;
+        unsigned                             harvest = 0;
+        // edits made while the harvest runs, applied when it's done
+        std::unordered_map<std::string, int> changes;
+        // the file couldn't be read by the harvest thread, use the editor's text
+        bool                                 fileUnreadable = false;
+    };
+    struct HarvestJob
+    {
+        std::shared_ptr<DocumentWords>     target;
+        unsigned                           harvest = 0;
+        std::shared_ptr<const std::string> text;
+        // without text, the file is read by the harvest thread
+        std::wstring                       path;
+        uint64_t                           maxSize = 0;
+    };
+
     void                 HandleAutoComplete(const SCNotification* scn);
+    bool                 HandlePathCompletion(bool refresh);
     void                 ExitSnippetMode();
     void                 MarkSnippetPositions(bool clearOnly);
-    void                 PrepareWordList(std::map<std::string, AutoCompleteType>& wordList) const;
+    void                 PrepareWordList(std::unordered_map<std::string, int>& nearWords) const;
+    void                 HarvestDocument(const DocID& docID);
+    void                 HarvestEdit(const SCNotification* scn, const DocID& docID);
+    void                 RunHarvestJobs();
+    void                 AddWordUse(const std::string& word);
+    static void          CountWords(DocumentWords& documentWords, std::string_view text, int delta);
     std::string          SanitizeSnippetText(const std::string& text) const;
     static bool          IsWordChar(int ch);
     static void          SetWindowStylesForAutocompletionPopup();
     static BOOL CALLBACK AdjustThemeProc(HWND hwnd, LPARAM lParam);
 
 private:
-    CScintillaWnd*                                                          m_editor;
-    CMainWindow*                                                            m_main;
-    // map of [language, [word, AutoCompleteType]]
-    std::map<std::string, std::map<std::string, AutoCompleteType, ci_less>> m_langWordList;
-    std::map<std::string, std::map<std::string, std::string>>               m_langSnippetList;
-    std::map<DocID, std::map<std::string, AutoCompleteType, ci_less>>       m_docWordList;
-    std::recursive_mutex                                                    m_mutex;
-    bool                                                                    m_insertingSnippet;
-    std::string                                                             m_stringToSelect;
-    std::map<int, std::vector<Sci_Position>>                                m_snippetPositions;
-    int                                                                     m_currentSnippetPos;
+    CScintillaWnd*                                            m_editor;
+    CMainWindow*                                              m_main;
+    std::map<std::string, CWordStore>                         m_langWordList;
+    std::map<std::string, std::map<std::string, std::string>> m_langSnippetList;
+    std::map<DocID, CWordStore>                               m_docWordList;
+    // how often a word was picked from the list: those are offered first
+    std::unordered_map<std::string, int>                      m_wordUses;
+    std::map<DocID, std::shared_ptr<DocumentWords>>           m_documentWords;
+    std::deque<HarvestJob>                                    m_harvestQueue;
+    std::thread                                               m_harvestThread;
+    // waits on m_mutex for jobs in m_harvestQueue
+    std::condition_variable_any                               m_harvestCondition;
+    bool                                                      m_stopHarvest;
+    std::recursive_mutex                                      m_mutex;
+    bool                                                      m_insertingSnippet;
+    bool                                                      m_pathListPending;
+    std::string                                               m_stringToSelect;
+    std::map<int, std::vector<Sci_Position>>                  m_snippetPositions;
+    int                                                       m_currentSnippetPos;
 };
 
 class CAutoCompleteConfigDlg : public CDialog
@@ -0,0 +1,123 @@
+﻿// This file is part of BowPad.
+//
+// Copyright (C) 2025 - Stefan Kueng
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// See <http://www.gnu.org/licenses/> for a copy of the full license text
+//
+#pragma once
+#include "UnicodeUtils.h"
+
+#include <cstring>
+#include <string>
+#include <string_view>
+
+// The cache and session files store values in the native byte order
+// and strings as utf8 with their length in front.
+
+template <typename T>
+void Put(std::string& out, T value)
+{
+    out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+inline void PutString(std::string& out, std::string_view s)
+{
+    Put(out, static_cast<uint32_t>(s.size()));
+    out.append(s);
+}
+
+inline void PutString(std::string& out, const std::wstring& s)
+{
+    PutString(out, CUnicodeUtils::StdGetUTF8(s));
+}
+
+template <typename Map>
+void PutStringMap(std::string& out, const Map& map)
+{
+    Put(out, static_cast<uint32_t>(map.size()));
+    for (const auto& [key, value] : map)
+    {
+        PutString(out, key);
+        PutString(out, value);
+    }
+}
+
+/// reads the data written with Put() and PutString(), without ever reading past the end
+class CReader
+{
+public:
+    CReader(std::string_view data)
+        : m_data(data)
+    {
+    }
+
+    template <typename T>
+    bool Get(T& value)
+    {
+        if (m_data.size() - m_pos < sizeof(T))
+            return false;
+        memcpy(&value, m_data.data() + m_pos, sizeof(T));
+        m_pos += sizeof(T);
+        return true;
+    }
+
+    /// the string points into the data given to the constructor
+    bool GetString(std::string_view& s)
+    {
+        uint32_t length = 0;
+        if (!Get(length) || m_data.size() - m_pos < length)
+            return false;
+        s = m_data.substr(m_pos, length);
+        m_pos += length;
+        return true;
+    }
+
+    bool GetString(std::string& s)
+    {
+        std::string_view view;
+        if (!GetString(view))
+            return false;
+        s.assign(view);
+        return true;
+    }
+
+    bool GetString(std::wstring& s)
+    {
+        std::string utf8;
+        if (!GetString(utf8))
+            return false;
+        s = CUnicodeUtils::StdGetUnicode(utf8);
+        return true;
+    }
+
+    template <typename Map>
+    bool GetStringMap(Map& map)
+    {
+        uint32_t count = 0;
+        if (!Get(count))
+            return false;
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            typename Map::key_type    key;
+            typename Map::mapped_type value;
+            if (!GetString(key) || !GetString(value))
+                return false;
+            map.emplace(std::move(key), std::move(value));
+        }
+        return true;
+    }
+
+private:
+    std::string_view m_data;
+    size_t           m_pos = 0;
+};
@@ -28,6 +28,8 @@
 #include "PropertySet.h"
 #include "UICollection.h"
 #include "ResString.h"
+#include "PathIndex.h"
+#include "PathUtils.h"
 #include <string>
 #include <algorithm>
 #include <memory>
@@ -59,6 +61,15 @@ void CCommandPaletteDlg::ClearFilterText()
     SetFocus(m_hFilter);
 }
 
+void CCommandPaletteDlg::SetFileSearch(const std::wstring& root, std::function<void(const std::wstring&)>&& openFile)
+{
+    m_fileRoot = root;
+    m_openFile = std::move(openFile);
+    // start indexing right away so the index is ready when the user starts typing
+    if (!m_fileRoot.empty())
+        CPathIndex::Instance().Prepare(m_fileRoot);
+}
+
 LRESULT CCommandPaletteDlg::DlgFunc(HWND hwndDlg, UINT uMsg, WPARAM wParam, LPARAM lParam)
 {
     UNREFERENCED_PARAMETER(lParam);
@@ -250,7 +261,7 @@ LRESULT CCommandPaletteDlg::DlgFunc(HWND hwndDlg, UINT uMsg, WPARAM wParam, LPAR
                     }
                     ClientToScreen(m_hResults, &pt);
                 }
-                if (selIndex < 0)
+                if (selIndex < 0 || !m_results[selIndex].path.empty())
                     break;
 
                 HMENU hPopup = CreatePopupMenu();
@@ -292,7 +303,12 @@ LRESULT CCommandPaletteDlg::DoCommand(int id, int code)
         case IDOK:
         {
             auto i = ListView_GetSelectionMark(m_hResults);
-            if (i >= 0)
+            if (i >= 0 && !m_results[i].path.empty())
+            {
+                if (m_openFile)
+                    m_openFile(m_results[i].path);
+            }
+            else if (i >= 0)
             {
                 const auto& data    = m_results[i];
                 auto*       cmd     = CCommandHandler::Instance().GetCommand(data.cmdId);
@@ -562,6 +578,12 @@ void CCommandPaletteDlg::FillResults(bool force)
     std::wstring        sFilterText = filterText.get();
     if (force || lastFilterText.empty() || _wcsicmp(sFilterText.c_str(), lastFilterText.c_str()))
     {
+        if (sFilterText.starts_with(L'/') && m_collectionResults.empty() && !m_fileRoot.empty())
+        {
+            FillFileResults(sFilterText.substr(1));
+            lastFilterText = sFilterText;
+            return;
+        }
         m_results.clear();
         int                      col1Width  = 0;
         int                      col2Width  = 0;
@@ -586,6 +608,30 @@ void CCommandPaletteDlg::FillResults(bool force)
     }
 }
 
+void CCommandPaletteDlg::FillFileResults(const std::wstring& query)
+{
+    constexpr size_t maxFileResults = 200;
+    m_results.clear();
+    int col1Width = 0;
+    // while the index is still being built there are no results
+    if (CPathIndex::Instance().Prepare(m_fileRoot))
+    {
+        for (auto& match : CPathIndex::Instance().Query(m_fileRoot, query, maxFileResults))
+        {
+            CmdPalData data;
+            data.command     = CPathUtils::GetFileName(match.path);
+            data.description = match.path;
+            data.path        = std::move(match.path);
+            col1Width        = max(col1Width, ListView_GetStringWidth(m_hResults, data.command.c_str()));
+            m_results.push_back(std::move(data));
+        }
+    }
+    ListView_SetItemCountEx(m_hResults, m_results.size(), 0);
+    ListView_SetColumnWidth(m_hResults, 0, col1Width + 50LL);
+    ListView_SetColumnWidth(m_hResults, 1, 50);
+    ListView_SetColumnWidth(m_hResults, 2, LVSCW_AUTOSIZE);
+}
+
 LRESULT CALLBACK CCommandPaletteDlg::EditSubClassProc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam, UINT_PTR uIdSubclass, DWORD_PTR dwRefData)
 {
     CCommandPaletteDlg* pThis = reinterpret_cast<CCommandPaletteDlg*>(dwRefData);
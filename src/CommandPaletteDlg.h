@@ -19,6 +19,7 @@
 #include "DlgResizer.h"
 #include "ICommand.h"
 #include <vector>
+#include <functional>
 
 class CmdPalData
 {
@@ -28,6 +29,7 @@ public:
     std::wstring command;
     std::wstring description;
     std::wstring shortcut;
+    std::wstring path; ///< set for files found in the path index
 };
 
 /**
@@ -40,6 +42,8 @@ public:
     virtual ~CCommandPaletteDlg();
 
     void ClearFilterText();
+    /// Files below root can be found by starting the filter text with a '/'.
+    void SetFileSearch(const std::wstring& root, std::function<void(const std::wstring&)>&& openFile);
 
 protected:
     LRESULT CALLBACK        DlgFunc(HWND hwndDlg, UINT uMsg, WPARAM wParam, LPARAM lParam) override;
@@ -47,6 +51,7 @@ protected:
 
     void                    InitResultsList() const;
     void                    FillResults(bool force);
+    void                    FillFileResults(const std::wstring& query);
     LRESULT                 DoListNotify(LPNMITEMACTIVATE lpNMItemActivate);
     LRESULT                 GetListItemDispInfo(NMLVDISPINFO* pDispInfo) const;
     LRESULT                 DrawListItem(NMLVCUSTOMDRAW* pLVCD) const;
@@ -63,4 +68,7 @@ private:
     std::vector<CmdPalData> m_allResults;
     std::vector<CmdPalData> m_collectionResults;
     ICommand*               m_pCmd;
+
+    std::wstring                             m_fileRoot;
+    std::function<void(const std::wstring&)> m_openFile;
 };
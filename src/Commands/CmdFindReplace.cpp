@@ -24,6 +24,7 @@
 #include "PathUtils.h"
 #include "DocumentManager.h"
 #include "DirFileEnum.h"
+#include "PathIndex.h"
 #include "BrowseFolder.h"
 #include "LexStyles.h"
 #include "OnOutOfScope.h"
@@ -36,9 +37,12 @@
 #include <algorithm>
 #include <utility>
 #include <memory>
+#include <string_view>
 #include <strsafe.h>
 #include <vssym32.h>
 
+#include "../ext/scintilla/src/RegexCache.h"
+
 #include <dwmapi.h>
 #pragma comment(lib, "dwmapi.lib")
 
@@ -63,6 +67,7 @@ namespace
 {
 constexpr int          TIMER_INFOSTRING                 = 100;
 constexpr int          TIMER_SUGGESTION                 = 101;
+constexpr int          TIMER_INCREMENTALSEARCH          = 102;
 constexpr unsigned int SF_SEARCHSUBFOLDERS              = 1;
 constexpr unsigned int SF_SEARCHFORFUNCTIONS            = 2;
 // Limit the max search results so as not to crash by running out of memory or allowed memory.
@@ -84,6 +89,16 @@ constexpr int          DEFAULT_MAX_SEARCHFILE_STRINGS   = 20;
 // become more of a bottle-neck in performance than time taken to find results.
 constexpr auto         PROGRESS_UPDATE_INTERVAL         = std::chrono::seconds(3);
 constexpr size_t       MAX_DATA_BATCH_SIZE              = 1000;
+// Upper limit of threads used to search the open documents.
+constexpr size_t       MAX_SEARCH_WORKERS               = 8;
+// Incremental search waits for the user to pause typing for this long (ms)
+// before searching, so a fast typist doesn't start a search per keystroke.
+constexpr UINT         INCREMENTAL_SEARCH_DELAY         = 30;
+// Check for a newer query after searching this many bytes.
+constexpr size_t       INCREMENTAL_SEARCH_CHUNK         = 1024 * 1024;
+// Beyond this number of occurrences the positions are not kept (but still counted),
+// the next query then has to scan the whole document again.
+constexpr size_t       MAX_INCREMENTAL_CANDIDATES       = 4 * 1024 * 1024;
 constexpr auto         MATCH_COLOR                      = RGB(0xFF, 0, 0); // Red.
 
 // A couple of functions here are similar to those in CmdFunctions.cpp.
@@ -207,6 +222,151 @@ void moveAppend(T& dst, T& src)
     }
 }
 
+bool IsAscii(const std::string& s)
+{
+    return std::ranges::all_of(s, [](char c) { return static_cast<unsigned char>(c) < 0x80; });
+}
+
+// Plain text matcher for the incremental search, working directly on the UTF-8 text.
+// Follows the rules of Scintilla's own search for the options it supports:
+// case insensitive matching of ASCII strings and whole words.
+class CIncrementalMatcher
+{
+public:
+    CIncrementalMatcher(const CIncrementalSearchState& state)
+        : m_length(state.query.size())
+        , m_wholeWord((state.flags & Scintilla::FindOption::WholeWord) != Scintilla::FindOption::None)
+    {
+        const bool matchCase = (state.flags & Scintilla::FindOption::MatchCase) != Scintilla::FindOption::None;
+        for (int c = 0; c < 256; ++c)
+            m_fold[c] = static_cast<unsigned char>((!matchCase && c >= 'A' && c <= 'Z') ? c - 'A' + 'a' : c);
+        for (char c : state.query)
+            m_query.push_back(static_cast<char>(m_fold[static_cast<unsigned char>(c)]));
+        // The first byte is looked for with memchr, for a letter in case
+        // insensitive mode that's done for the lower and the upper case.
+        for (int c = 0; c < 256; ++c)
+        {
+            if (m_fold[c] == static_cast<unsigned char>(m_query[0]) && m_firstBytes < m_first.size())
+                m_first[m_firstBytes++] = static_cast<char>(c);
+        }
+
+        // Same classification as Scintilla's CharClassify: bytes >= 0x80 are
+        // parts of UTF-8 characters and treated as word characters.
+        for (int c = 0; c < 256; ++c)
+            m_class[c] = (c >= 0x80 || isalnum(c) || c == '_') ? CharClass::Word : (c < 0x20 || c == ' ') ? CharClass::Space : CharClass::Punctuation;
+        if (!state.wordChars.empty() || !state.whitespaceChars.empty())
+        {
+            for (int c = 0; c < 0x80; ++c)
+                m_class[c] = CharClass::Punctuation;
+            for (char c : state.whitespaceChars)
+                m_class[static_cast<unsigned char>(c)] = CharClass::Space;
+            for (char c : state.wordChars)
+                m_class[static_cast<unsigned char>(c)] = CharClass::Word;
+        }
+        m_class[static_cast<unsigned char>('\r')] = CharClass::Newline;
+        m_class[static_cast<unsigned char>('\n')] = CharClass::Newline;
+    }
+
+    bool MatchesAt(std::string_view text, size_t pos) const
+    {
+        if (pos + m_length > text.size())
+            return false;
+        for (size_t i = 0; i < m_length; ++i)
+        {
+            if (m_fold[static_cast<unsigned char>(text[pos + i])] != static_cast<unsigned char>(m_query[i]))
+                return false;
+        }
+        return true;
+    }
+
+    // Returns the start of the first occurrence in [pos, limit), or npos.
+    // Must be called with increasing positions on the same text.
+    size_t Find(std::string_view text, size_t pos, size_t limit)
+    {
+        if (text.size() < m_length)
+            return std::string_view::npos;
+        limit = min(limit, text.size() - m_length + 1);
+        while (pos < limit)
+        {
+            size_t candidate = std::string_view::npos;
+            for (size_t i = 0; i < m_firstBytes; ++i)
+                candidate = min(candidate, NextFirstByte(text, i, pos));
+            if (candidate >= limit)
+                return std::string_view::npos;
+            if (MatchesAt(text, candidate))
+                return candidate;
+            pos = candidate + 1;
+        }
+        return std::string_view::npos;
+    }
+
+    // Records an occurrence. The match count uses the same rules as a
+    // repeated FindText: matches must not overlap and must be whole words if requested.
+    void Add(std::string_view text, size_t pos, CIncrementalSearchState& state)
+    {
+        if (state.candidates.size() < MAX_INCREMENTAL_CANDIDATES)
+            state.candidates.push_back(static_cast<sptr_t>(pos));
+        else
+            state.complete = false;
+
+        if (pos < m_lastMatchEnd)
+            return;
+        if (m_wholeWord && !IsWordAt(text, pos, pos + m_length))
+            return;
+        ++state.matchCount;
+        if (state.matches.size() < MAX_INCREMENTAL_CANDIDATES)
+            state.matches.push_back(static_cast<sptr_t>(pos));
+        m_lastMatchEnd = pos + m_length;
+    }
+
+private:
+    enum class CharClass : unsigned char
+    {
+        Space,
+        Newline,
+        Word,
+        Punctuation
+    };
+
+    static bool IsWordEdge(CharClass cc, CharClass ccNext)
+    {
+        return (cc != ccNext) && (cc == CharClass::Word || cc == CharClass::Punctuation);
+    }
+
+    // The positions found by memchr are remembered: when searching for both
+    // cases, one of them is usually far ahead and must not be searched again.
+    size_t NextFirstByte(std::string_view text, size_t index, size_t pos)
+    {
+        auto& next = m_next[index];
+        if (m_searched[index] && (next == std::string_view::npos || next >= pos))
+            return next;
+        auto found        = static_cast<const char*>(memchr(text.data() + pos, m_first[index], text.size() - pos));
+        next              = found ? static_cast<size_t>(found - text.data()) : std::string_view::npos;
+        m_searched[index] = true;
+        return next;
+    }
+
+    bool IsWordAt(std::string_view text, size_t start, size_t end) const
+    {
+        // Outside of the document is treated as a space, as Scintilla does.
+        const CharClass before = start > 0 ? m_class[static_cast<unsigned char>(text[start - 1])] : CharClass::Space;
+        const CharClass after  = end < text.size() ? m_class[static_cast<unsigned char>(text[end])] : CharClass::Space;
+        return IsWordEdge(m_class[static_cast<unsigned char>(text[start])], before) &&
+               IsWordEdge(m_class[static_cast<unsigned char>(text[end - 1])], after);
+    }
+
+    size_t                         m_length;
+    bool                           m_wholeWord;
+    std::string                    m_query;
+    std::array<char, 2>            m_first{};
+    size_t                         m_firstBytes = 0;
+    std::array<size_t, 2>          m_next{};
+    std::array<bool, 2>            m_searched{};
+    std::array<unsigned char, 256> m_fold{};
+    std::array<CharClass, 256>     m_class{};
+    size_t                         m_lastMatchEnd = 0;
+};
+
 std::wstring GetHomeFolder()
 {
     std::wstring homeFolder;
@@ -219,27 +379,32 @@ std::wstring GetHomeFolder()
 
 }; // unnamed namespace
 
-void adjustFindString(Scintilla::FindOption searchFlags)
+void adjustFindString(std::string& findString, Scintilla::FindOption searchFlags)
 {
     if ((searchFlags & Scintilla::FindOption::RegExp) != Scintilla::FindOption::None)
     {
         // replace all "\n" chars with "(?:\n|\r\n|\n\r)"
-        if ((g_findString.size() > 1) && (g_findString.find("\\r") == std::wstring::npos))
+        if ((findString.size() > 1) && (findString.find("\\r") == std::wstring::npos))
         {
-            SearchReplace(g_findString, "\\n", "(?:\\n|\\r\\n|\\n\\r)");
+            SearchReplace(findString, "\\n", "(?:\\n|\\r\\n|\\n\\r)");
         }
-        if (g_findString.ends_with('$'))
+        if (findString.ends_with('$'))
         {
             // the MSVC regex engine when set to ECMAScript only matches range ends with $
             // so replace it with ($|\n|\r\n|\n\r)
             // note: this can be removed once std::regex_constants::syntax_option_type::multiline
             // is implemented!
-            g_findString = g_findString.substr(0, g_findString.size() - 1);
-            g_findString += "(?=$|\\n|\\r\\n|\\n\\r)";
+            findString = findString.substr(0, findString.size() - 1);
+            findString += "(?=$|\\n|\\r\\n|\\n\\r)";
         }
     }
 }
 
+void adjustFindString(Scintilla::FindOption searchFlags)
+{
+    adjustFindString(g_findString, searchFlags);
+}
+
 CFindReplaceDlg::CFindReplaceDlg(void* obj)
     : CBPBaseDialog()
     , ICommand(obj)
@@ -248,6 +413,11 @@ CFindReplaceDlg::CFindReplaceDlg(void* obj)
     m_maxSearchResults = static_cast<int>(CIniSettings::Instance().GetInt64(L"searchreplace", L"maxsearchresults", MAX_SEARCHRESULTS));
 }
 
+CFindReplaceDlg::~CFindReplaceDlg()
+{
+    StopIncrementalSearchThread();
+}
+
 std::wstring CFindReplaceDlg::GetCurrentDocumentFolder() const
 {
     std::wstring currentDocFolder;
@@ -345,6 +515,10 @@ std::wstring CFindReplaceDlg::OfferFileSuggestion(
     if (currentValue.find_first_of(L";*?") != std::wstring::npos)
         return suggestedFilename; // Should be empty.
 
+    // Once the folder is indexed, the index has all the names without hitting storage.
+    if (IsWorkingFolder(searchFolder) && CPathIndex::Instance().Prepare(searchFolder))
+        return CPathIndex::Instance().SuggestFileName(searchFolder, currentValue, searchSubFolders);
+
     constexpr auto maxSearchTime = std::chrono::milliseconds(200);
     CDirFileEnum   enumerator(searchFolder);
     bool           bIsDir = false;
@@ -443,10 +617,18 @@ LRESULT CFindReplaceDlg::DlgFunc(HWND hwndDlg, UINT uMsg, WPARAM wParam, LPARAM
                 KillTimer(*this, TIMER_INFOSTRING);
                 Clear(IDC_SEARCHINFO);
             }
+            else if (wParam == TIMER_INCREMENTALSEARCH)
+            {
+                KillTimer(*this, TIMER_INCREMENTALSEARCH);
+                DoIncrementalSearch();
+            }
             break;
         case WM_THREADRESULTREADY:
             OnSearchResultsReady(wParam != 0);
             break;
+        case WM_INCSEARCHREADY:
+            OnIncrementalSearchReady();
+            break;
         case WM_NOTIFY:
             switch (wParam)
             {
@@ -527,6 +709,7 @@ void CFindReplaceDlg::InitSizing()
     m_resizer.AddControl(hwndDlg, IDC_REGEXHELP, RESIZER_TOPLEFT);
     m_resizer.AddControl(hwndDlg, IDC_FUNCTIONS, RESIZER_TOPLEFT);
     m_resizer.AddControl(hwndDlg, IDC_HIGHLIGHT, RESIZER_TOPLEFT);
+    m_resizer.AddControl(hwndDlg, IDC_INCREMENTALSEARCH, RESIZER_TOPLEFT);
     m_resizer.AddControl(hwndDlg, IDC_SEARCHSUBFOLDERS, RESIZER_TOPRIGHT);
     m_resizer.AddControl(hwndDlg, IDC_FINDBTN, RESIZER_TOPRIGHT);
     m_resizer.AddControl(hwndDlg, IDC_FINDPREVIOUS, RESIZER_TOPRIGHT);
@@ -555,6 +738,7 @@ void CFindReplaceDlg::DoInitDialog(HWND hwndDlg)
         });
     SetTheme(CTheme::Instance().IsDarkTheme());
     InitDialog(hwndDlg, IDI_BOWPAD, false);
+    CPathIndex::Instance().SetExclusions(m_excludedFolders, m_excludedExtensions);
 
     // Position the find dialog in the top right corner.
     // Make sure we don't obscure the scroll bar though.
@@ -611,6 +795,8 @@ void CFindReplaceDlg::DoInitDialog(HWND hwndDlg)
             ComboBox_SetCurSel(hSearchFolder, 0);
     }
     CheckDlgButton(*this, IDC_HIGHLIGHT, g_highlightMatches ? BST_CHECKED : BST_UNCHECKED);
+    bool incrementalSearch = CIniSettings::Instance().GetInt64(L"searchreplace", L"incrementalsearch", 0LL) != 0LL;
+    CheckDlgButton(*this, IDC_INCREMENTALSEARCH, incrementalSearch ? BST_CHECKED : BST_UNCHECKED);
 
     // These routines can be made somewhat generic and go in a base class eventually.
     // But things need to settle down and it become clear what the final requirements are.
@@ -673,6 +859,8 @@ void CFindReplaceDlg::SaveSettings()
     // CIniSettings::Instance().SetInt64(L"searchreplace", L"searchsubfolders", searchSubFolders ? 1LL : 0LL);
     bool followTab = IsDlgButtonChecked(*this, IDC_SEARCHFOLDERFOLLOWTAB) == BST_CHECKED;
     CIniSettings::Instance().SetInt64(L"searchreplace", L"searchfolderfollowtab", followTab ? 1LL : 0LL);
+    bool incrementalSearch = IsDlgButtonChecked(*this, IDC_INCREMENTALSEARCH) == BST_CHECKED;
+    CIniSettings::Instance().SetInt64(L"searchreplace", L"incrementalsearch", incrementalSearch ? 1LL : 0LL);
     SaveSearchStrings();
     SaveReplaceStrings();
     SaveSearchFolderStrings();
@@ -718,6 +906,8 @@ void CFindReplaceDlg::FindText()
 
     CheckSearchFolder();
     CheckSearchOptions();
+    // Start a new incremental search from the current position.
+    CancelIncrementalSearch();
     FocusOn(IDC_SEARCHCOMBO);
     UpdateWindow(*this);
 }
@@ -1332,6 +1522,7 @@ LRESULT CFindReplaceDlg::DoCommand(int id, int msg)
                 if (IsDlgButtonChecked(*this, IDC_MATCHREGEX) == BST_CHECKED)
                     CheckRegex(true);
                 DialogEnableWindow(IDC_FINDPREVIOUS, IsDlgButtonChecked(*this, IDC_MATCHREGEX) != BST_CHECKED);
+                ScheduleIncrementalSearch();
             }
             break;
         case IDC_SEARCHCOMBO:
@@ -1343,9 +1534,24 @@ LRESULT CFindReplaceDlg::DoCommand(int id, int msg)
                 if (IsDlgButtonChecked(*this, IDC_MATCHREGEX) == BST_CHECKED)
                     CheckRegex(false);
                 CheckSearchOptions();
+                ScheduleIncrementalSearch();
             }
         }
         break;
+        case IDC_MATCHCASE:
+        case IDC_MATCHWORD:
+            if (msg == BN_CLICKED)
+                ScheduleIncrementalSearch();
+            break;
+        case IDC_INCREMENTALSEARCH:
+            if (msg == BN_CLICKED)
+            {
+                if (IsDlgButtonChecked(*this, IDC_INCREMENTALSEARCH) == BST_CHECKED)
+                    ScheduleIncrementalSearch();
+                else
+                    CancelIncrementalSearch();
+            }
+            break;
         case IDC_REPLACECOMBO:
             if (msg == CBN_SETFOCUS)
                 SetDefaultButton(IDC_REPLACEBTN, true);
@@ -1532,6 +1738,327 @@ void CFindReplaceDlg::DoFindPrevious()
         SearchStringNotFound();
 }
 
+void CFindReplaceDlg::ScheduleIncrementalSearch()
+{
+    if (IsDlgButtonChecked(*this, IDC_INCREMENTALSEARCH) != BST_CHECKED)
+        return;
+    // Any search still running is for an outdated query now.
+    ++m_incrementalGeneration;
+    SetTimer(*this, TIMER_INCREMENTALSEARCH, INCREMENTAL_SEARCH_DELAY, nullptr);
+}
+
+void CFindReplaceDlg::CancelIncrementalSearch()
+{
+    KillTimer(*this, TIMER_INCREMENTALSEARCH);
+    ++m_incrementalGeneration;
+    {
+        std::lock_guard<std::mutex> lock(m_incrementalMutex);
+        m_incrementalRequest.reset();
+        m_incrementalRequestPrevious.reset();
+        m_incrementalPending.reset();
+    }
+    m_incrementalLast.reset();
+    m_incrementalText.reset();
+    m_incrementalAnchor = -1;
+}
+
+void CFindReplaceDlg::NotifyOnDocumentModified()
+{
+    // The snapshot and the match positions found in it are invalid now.
+    if (!m_incrementalText)
+        return;
+    m_incrementalText.reset();
+    m_incrementalLast.reset();
+}
+
+void CFindReplaceDlg::DoIncrementalSearch()
+{
+    if (m_threadsRunning || !HasActiveDocument())
+        return;
+
+    std::string searchFor = CUnicodeUtils::StdGetUTF8(GetDlgItemText(IDC_SEARCHCOMBO).get());
+    auto        flags     = GetScintillaOptions();
+    auto        docID     = GetDocIdOfCurrentTab();
+    if (docID != m_incrementalDocID)
+    {
+        m_incrementalText.reset();
+        m_incrementalLast.reset();
+        m_incrementalAnchor = -1;
+        m_incrementalDocID  = docID;
+    }
+    // Every query is searched from where the user started typing, not from
+    // where the previous query moved the selection to.
+    if (m_incrementalAnchor < 0)
+        m_incrementalAnchor = Scintilla().SelectionStart();
+
+    if (searchFor.empty())
+    {
+        m_incrementalLast.reset();
+        g_sHighlightString.clear();
+        g_searchMarkerCount = 0;
+        Scintilla().SetIndicatorCurrent(INDIC_FINDTEXT_MARK);
+        Scintilla().IndicatorClearRange(0, Scintilla().Length());
+        DocScrollClear(DOCSCROLLTYPE_SEARCHTEXT);
+        DocScrollUpdate();
+        Clear(IDC_SEARCHINFO);
+        return;
+    }
+
+    // The editor copies the text only once as long as the document isn't
+    // modified, which usually holds while the user types in this dialog.
+    auto text = GetTextSnapshot();
+    if (text != m_incrementalText)
+    {
+        m_incrementalText = std::move(text);
+        m_incrementalLast.reset();
+    }
+
+    // Regular expressions and case insensitive non-ASCII text need Scintilla's
+    // own search, everything else is searched by the plain text matcher.
+    bool plainText = (flags & Scintilla::FindOption::RegExp) == Scintilla::FindOption::None &&
+                     ((flags & Scintilla::FindOption::MatchCase) != Scintilla::FindOption::None || IsAscii(searchFor));
+
+    auto state             = std::make_shared<CIncrementalSearchState>();
+    state->generation      = ++m_incrementalGeneration;
+    state->query           = searchFor;
+    state->flags           = flags;
+    state->text            = m_incrementalText;
+    state->scintillaSearch = !plainText;
+    state->lineEnd         = Scintilla().EOLMode() == Scintilla::EndOfLine::Cr ? '\r' : '\n';
+    if ((flags & Scintilla::FindOption::WholeWord) != Scintilla::FindOption::None)
+    {
+        state->wordChars       = Scintilla().WordChars();
+        state->whitespaceChars = Scintilla().WhitespaceChars();
+    }
+
+    // When the new query extends the previous one, all its occurrences
+    // start at an occurrence of the previous query.
+    std::shared_ptr<const CIncrementalSearchState> previous;
+    if (plainText && m_incrementalLast && m_incrementalLast->complete &&
+        m_incrementalLast->text == state->text &&
+        (m_incrementalLast->flags & Scintilla::FindOption::MatchCase) == (flags & Scintilla::FindOption::MatchCase) &&
+        searchFor.starts_with(m_incrementalLast->query))
+        previous = m_incrementalLast;
+
+    // Only the newest query is of interest: one that the worker
+    // hasn't started on yet is simply replaced.
+    {
+        std::lock_guard<std::mutex> lock(m_incrementalMutex);
+        m_incrementalRequest         = std::move(state);
+        m_incrementalRequestPrevious = std::move(previous);
+    }
+    if (!m_incrementalThread.joinable())
+        m_incrementalThread = std::thread(&CFindReplaceDlg::IncrementalSearchThread, this);
+    m_incrementalCondition.notify_one();
+}
+
+void CFindReplaceDlg::IncrementalSearchThread()
+{
+    // The Scintilla window for regular expressions is created on this thread
+    // and kept, together with the text loaded into it, for all searches.
+    std::unique_ptr<CScintillaWnd>   searchWnd;
+    std::weak_ptr<const std::string> loadedText;
+    for (;;)
+    {
+        std::shared_ptr<CIncrementalSearchState>       state;
+        std::shared_ptr<const CIncrementalSearchState> previous;
+        {
+            std::unique_lock<std::mutex> lock(m_incrementalMutex);
+            m_incrementalCondition.wait(lock, [this]() { return m_incrementalQuit || m_incrementalRequest; });
+            if (m_incrementalQuit)
+                return;
+            state    = std::move(m_incrementalRequest);
+            previous = std::move(m_incrementalRequestPrevious);
+        }
+        if (!RunIncrementalSearch(*state, previous.get(), searchWnd, loadedText))
+            continue;
+        {
+            std::lock_guard<std::mutex> lock(m_incrementalMutex);
+            if (m_incrementalGeneration != state->generation)
+                continue;
+            m_incrementalPending = std::move(state);
+        }
+        PostMessage(*this, WM_INCSEARCHREADY, 0, 0);
+    }
+}
+
+void CFindReplaceDlg::StopIncrementalSearchThread()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_incrementalMutex);
+        m_incrementalQuit = true;
+    }
+    ++m_incrementalGeneration;
+    m_incrementalCondition.notify_one();
+    if (m_incrementalThread.joinable())
+        m_incrementalThread.join();
+}
+
+// Returns false if the search is outdated.
+bool CFindReplaceDlg::RunIncrementalSearch(CIncrementalSearchState& state, const CIncrementalSearchState* previous,
+                                           std::unique_ptr<CScintillaWnd>& searchWnd, std::weak_ptr<const std::string>& loadedText) const
+{
+    ProfileTimer           profileTimer(previous ? L"IncrementalSearch (refine)" : L"IncrementalSearch");
+
+    const std::string_view text    = *state.text;
+    CIncrementalMatcher    matcher(state);
+    auto                   isStale = [&]() { return m_incrementalGeneration != state.generation; };
+
+    if (state.scintillaSearch)
+    {
+        if (!IncrementalSearchWithScintilla(state, searchWnd, loadedText))
+            return false;
+    }
+    else if (previous)
+    {
+        state.candidates.reserve(previous->candidates.size());
+        state.matches.reserve(previous->matches.size());
+        for (size_t i = 0; i < previous->candidates.size(); ++i)
+        {
+            if ((i % 0x10000) == 0 && isStale())
+                return false;
+            auto pos = static_cast<size_t>(previous->candidates[i]);
+            if (matcher.MatchesAt(text, pos))
+                matcher.Add(text, pos, state);
+        }
+    }
+    else
+    {
+        // Search in chunks so that a newer query doesn't have to wait for
+        // this one to get through the whole document.
+        for (size_t chunkStart = 0; chunkStart < text.size(); chunkStart += INCREMENTAL_SEARCH_CHUNK)
+        {
+            if (isStale())
+                return false;
+            const size_t chunkEnd = chunkStart + INCREMENTAL_SEARCH_CHUNK;
+            for (size_t pos = matcher.Find(text, chunkStart, chunkEnd); pos != std::string_view::npos; pos = matcher.Find(text, pos + 1, chunkEnd))
+                matcher.Add(text, pos, state);
+        }
+    }
+
+    // The lines for the scrollbar markers are counted here, so the UI
+    // thread doesn't have to look up the line of every match.
+    state.lines.reserve(state.matches.size());
+    size_t line    = 0;
+    size_t linePos = 0;
+    for (auto pos : state.matches)
+    {
+        line += std::count(text.begin() + linePos, text.begin() + pos, state.lineEnd);
+        linePos = pos;
+        state.lines.push_back(line);
+    }
+    return !isStale();
+}
+
+// Searches the snapshot with Scintilla's own search, in a private document so
+// the UI thread isn't blocked. Returns false if the search is outdated.
+bool CFindReplaceDlg::IncrementalSearchWithScintilla(CIncrementalSearchState& state, std::unique_ptr<CScintillaWnd>& searchWnd,
+                                                     std::weak_ptr<const std::string>& loadedText) const
+{
+    // We need a Scintilla object created on the same thread as it will be used.
+    if (!searchWnd)
+    {
+        searchWnd = std::make_unique<CScintillaWnd>(g_hRes);
+        searchWnd->InitScratch(g_hRes);
+    }
+
+    // The text is only loaded again once the snapshot changed.
+    const auto& text = *state.text;
+    if (loadedText.lock() != state.text)
+    {
+        auto pLoader = static_cast<Scintilla::ILoader*>(searchWnd->Scintilla().CreateLoader(text.size(),
+                                                                                       Scintilla::DocumentOption::TextLarge | Scintilla::DocumentOption::StylesNone));
+        if (pLoader == nullptr)
+            return false;
+        pLoader->AddData(text.data(), text.size());
+        auto document = static_cast<Document>(pLoader->ConvertToDocument());
+        searchWnd->Scintilla().SetDocPointer(document);
+        searchWnd->Scintilla().ReleaseDocument(document); // the search window holds the only reference now
+        searchWnd->Scintilla().SetCodePage(CP_UTF8);
+        loadedText = state.text;
+    }
+    if (!state.wordChars.empty())
+        searchWnd->Scintilla().SetWordChars(state.wordChars.c_str());
+    else
+        searchWnd->Scintilla().SetCharsDefault();
+    if (!state.whitespaceChars.empty())
+        searchWnd->Scintilla().SetWhitespaceChars(state.whitespaceChars.c_str());
+
+    // No candidates are kept: a longer regular expression
+    // doesn't necessarily match where the shorter one did.
+    state.complete         = false;
+    std::string findString = state.query;
+    adjustFindString(findString, state.flags);
+    Sci_TextToFind ttf = {0};
+    ttf.chrg.cpMin     = 0;
+    ttf.chrg.cpMax     = static_cast<Sci_PositionCR>(text.size());
+    ttf.lpstrText      = findString.c_str();
+    while (searchWnd->Scintilla().FindText(state.flags, &ttf) >= 0)
+    {
+        if (m_incrementalGeneration != state.generation)
+            return false;
+        ++state.matchCount;
+        if (state.matches.size() < MAX_INCREMENTAL_CANDIDATES)
+        {
+            state.matches.push_back(ttf.chrgText.cpMin);
+            state.matchEnds.push_back(ttf.chrgText.cpMax);
+        }
+        if (ttf.chrg.cpMin >= ttf.chrgText.cpMax)
+            break;
+        ttf.chrg.cpMin = ttf.chrgText.cpMax;
+    }
+    return true;
+}
+
+void CFindReplaceDlg::OnIncrementalSearchReady()
+{
+    std::shared_ptr<CIncrementalSearchState> state;
+    {
+        std::lock_guard<std::mutex> lock(m_incrementalMutex);
+        state = std::move(m_incrementalPending);
+    }
+    if (!state || state->generation != m_incrementalGeneration)
+        return;
+    if (state->text != m_incrementalText || GetDocIdOfCurrentTab() != m_incrementalDocID)
+    {
+        // The document changed while searching: start over with a new snapshot.
+        ScheduleIncrementalSearch();
+        return;
+    }
+    m_incrementalLast = state;
+
+    g_findString       = state->query;
+    g_highlightMatches = IsDlgButtonChecked(*this, IDC_HIGHLIGHT) != 0;
+    g_sHighlightString = g_findString;
+    g_searchFlags      = state->flags;
+    // All matches are known already, don't let the SCN_UPDATEUI handler
+    // search the whole document again to set the scrollbar markers.
+    g_lastSelText       = g_sHighlightString;
+    g_lastSearchFlags   = g_searchFlags;
+    g_searchMarkerCount = static_cast<sptr_t>(state->matchCount);
+    DocScrollClear(DOCSCROLLTYPE_SEARCHTEXT);
+    if (g_highlightMatches)
+        DocScrollAddLineColors(DOCSCROLLTYPE_SEARCHTEXT, state->lines, RGB(200, 200, 0));
+    OnOutOfScope(DocScrollUpdate());
+
+    if (state->matches.empty())
+    {
+        SetInfoText(IDS_FINDNOTFOUND, AlertMode::None);
+        return;
+    }
+    auto it = std::ranges::lower_bound(state->matches, m_incrementalAnchor);
+    if (it == state->matches.end())
+        it = state->matches.begin();
+    if (state->scintillaSearch)
+        Center(*it, state->matchEnds[it - state->matches.begin()]);
+    else
+        Center(*it, *it + static_cast<sptr_t>(state->query.size()));
+
+    ResString rInfo(g_hRes, IDS_FINDRESULT_COUNT);
+    auto      sInfo = CStringUtils::Format(rInfo, static_cast<int>(state->matchCount));
+    SetDlgItemText(*this, IDC_SEARCHINFO, sInfo.c_str());
+}
+
 void CFindReplaceDlg::SearchStringNotFound()
 {
     SetInfoText(IDS_FINDNOTFOUND);
@@ -1600,6 +2127,7 @@ void CFindReplaceDlg::DoReplace(int id)
     int replaceCount = 0;
     if (id == IDC_REPLACEALLINTABSBTN)
     {
+        LoadPendingDocuments();
         int tabCount = GetTabCount();
         for (int i = 0; i < tabCount; ++i)
         {
@@ -1610,6 +2138,9 @@ void CFindReplaceDlg::DoReplace(int id)
             {
                 replaceCount += rCount;
                 UpdateTab(i);
+                // the editor only sees the edits of the active tab
+                if (i != GetActiveTabIndex())
+                    NotifyDocumentTextChanged(docID);
             }
         }
     }
@@ -1876,7 +2407,24 @@ void CFindReplaceDlg::DoSearchAll(int id)
             return;
         }
 
-        if (id == IDC_FINDALL && HasActiveDocument())
+        if (id == IDC_FINDALLINTABS)
+        {
+            // Searching hundreds of tabs takes a while: take read-only snapshots
+            // of the documents here and search those in worker threads so the
+            // user can keep on editing while the results arrive.
+            auto snapshots = std::make_shared<const DocumentSnapshots>(TakeDocumentSnapshots());
+            EnableControls(false);
+            SortResults();
+            ShowResults(true);
+
+            UpdateMatchCount(false);
+            FocusOn(IDC_FINDRESULTS);
+            StartSnapshotSearch(snapshots, searchFor, searchFlags, exSearchFlags);
+            // Operation will be completed in OnSearchResultsReady.
+            return;
+        }
+
+        if (HasActiveDocument())
         {
             auto        docId = GetDocIDFromTabIndex(GetActiveTabIndex());
             const auto& doc   = GetActiveDocument();
@@ -1886,58 +2434,20 @@ void CFindReplaceDlg::DoSearchAll(int id)
             SearchDocument(m_searchWnd, docId, doc, searchFor, searchFlags, exSearchFlags,
                            m_searchResults, m_foundPaths);
         }
-        else if (id == IDC_FINDALLINTABS)
-        {
-            ResString rInfo(g_hRes, IDS_SEARCHING_FILE);
-            int       tabCount = GetTabCount();
-            for (int i = 0; i < tabCount; ++i)
-            {
-                auto        docID = GetDocIDFromTabIndex(i);
-                const auto& doc   = GetDocumentFromID(docID);
-                auto        sInfo = CStringUtils::Format(rInfo, CPathUtils::GetFileName(doc.m_path).c_str());
-                SetDlgItemText(*this, IDC_SEARCHINFO, sInfo.c_str());
-                UpdateWindow(*this);
-                SearchDocument(m_searchWnd, docID, doc, searchFor, searchFlags, exSearchFlags,
-                               m_searchResults, m_foundPaths);
-                if (m_foundSize >= m_maxSearchResults)
-                {
-                    ResString rInfoMax(g_hRes, IDS_SEARCHING_FILE_MAX);
-                    auto      sInfoMax = CStringUtils::Format(rInfoMax, m_maxSearchResults);
-                    SetDlgItemText(*this, IDC_SEARCHINFO, sInfoMax.c_str());
-                    break;
-                }
-            }
-        }
         SortResults();
         ListView_SetItemCountEx(hListControl, m_searchResults.size(), 0);
         ShowResults(true);
         UpdateWindow(*this);
         std::wstring sInfo;
-        if (id == IDC_FINDALLINTABS)
+        if (m_searchResults.size() >= m_maxSearchResults)
         {
-            if (m_searchResults.size() >= m_maxSearchResults)
-            {
-                ResString rInfoMax(g_hRes, IDS_SEARCHING_FILE_MAX);
-                sInfo = CStringUtils::Format(rInfoMax, m_maxSearchResults);
-            }
-            else
-            {
-                ResString rInfo(g_hRes, IDS_FINDRESULT_COUNTALL);
-                sInfo = CStringUtils::Format(rInfo, static_cast<int>(m_searchResults.size()), GetTabCount());
-            }
+            ResString rInfoMax(g_hRes, IDS_SEARCHING_FILE_MAX);
+            sInfo = CStringUtils::Format(rInfoMax, m_maxSearchResults);
         }
         else
         {
-            if (m_searchResults.size() >= m_maxSearchResults)
-            {
-                ResString rInfoMax(g_hRes, IDS_SEARCHING_FILE_MAX);
-                sInfo = CStringUtils::Format(rInfoMax, m_maxSearchResults);
-            }
-            else
-            {
-                ResString rInfo(g_hRes, IDS_FINDRESULT_COUNT);
-                sInfo = CStringUtils::Format(rInfo, static_cast<int>(m_searchResults.size()));
-            }
+            ResString rInfo(g_hRes, IDS_FINDRESULT_COUNT);
+            sInfo = CStringUtils::Format(rInfo, static_cast<int>(m_searchResults.size()));
         }
         // We don't action the first result because we can't consistently do that.
         // For multi-tab going to the item might involve opening another
@@ -1973,6 +2483,30 @@ void CFindReplaceDlg::DoSearchAll(int id)
         // Don't save invalid or empty file sets.
         if (filesToFind.size() > 0)
             UpdateSearchFilesStrings(filesString);
+        // Plain file names are looked up in the path index of the folder, which
+        // also finds fuzzy matches and ranks them. Wildcards and lists still
+        // need a walk over the folder, just like folders the user doesn't work in.
+        // The first search starts the indexing.
+        if (id == IDC_FINDFILES && IsWorkingFolder(searchFolder) && CPathIndex::Instance().Prepare(searchFolder) && searchSubFolders &&
+            !filesString.empty() && filesString.find_first_of(L";*?") == std::wstring::npos)
+        {
+            auto matches = CPathIndex::Instance().Query(searchFolder, filesString, m_maxSearchResults);
+            for (auto& match : matches)
+            {
+                CSearchResult result;
+                result.pathIndex = m_foundPaths.size();
+                m_foundPaths.push_back(std::move(match.path));
+                m_searchResults.push_back(std::move(result));
+            }
+            m_foundSize = m_searchResults.size();
+            // The results are already in ranked order, so they're not sorted.
+            ListView_SetItemCountEx(hListControl, m_searchResults.size(), 0);
+            ShowResults(true);
+            UpdateMatchCount(true);
+            FocusOn(IDC_FINDRESULTS);
+            FocusOnFirstListItem(false);
+            return;
+        }
         EnableControls(false);
         SortResults();
         ShowResults(true);
@@ -2046,6 +2580,30 @@ bool CFindReplaceDlg::IsExcludedFolder(const std::wstring& path) const
     return false;
 }
 
+// The path index is only used for the folders the user works in: the folder
+// shown in the file tree and the folders of the open documents. Any other
+// folder, up to a whole drive, is searched by walking it.
+bool CFindReplaceDlg::IsWorkingFolder(const std::wstring& folder) const
+{
+    auto trimmed = [](std::wstring path) {
+        while (!path.empty() && (path.back() == L'\\' || path.back() == L'/'))
+            path.pop_back();
+        return path;
+    };
+    const auto target = trimmed(folder);
+    if (target.empty())
+        return false;
+    if (CPathUtils::PathCompare(trimmed(GetFileTreePath()), target) == 0)
+        return true;
+    for (int i = 0; i < GetTabCount(); ++i)
+    {
+        const auto& doc = GetDocumentFromID(GetDocIDFromTabIndex(i));
+        if (!doc.m_path.empty() && CPathUtils::PathCompare(CPathUtils::GetParentDirectory(doc.m_path), target) == 0)
+            return true;
+    }
+    return false;
+}
+
 void CFindReplaceDlg::SearchThread(int id, const std::wstring& searchPath, const std::string& searchFor,
                                    Scintilla::FindOption flags, unsigned int exSearchFlags,
                                    const std::vector<std::wstring>& filesToFind)
@@ -2141,15 +2699,131 @@ void CFindReplaceDlg::SearchThread(int id, const std::wstring& searchPath, const
     m_threadsRunning = false;
 }
 
+CDocumentSnapshot::CDocumentSnapshot(CDocumentSnapshot&& other) noexcept
+    : docID(other.docID)
+    , language(std::move(other.language))
+    , document(std::exchange(other.document, nullptr))
+{
+}
+
+CDocumentSnapshot::~CDocumentSnapshot()
+{
+    if (document)
+        document->Release();
+}
+
+CFindReplaceDlg::DocumentSnapshots CFindReplaceDlg::TakeDocumentSnapshots() const
+{
+    // The open documents can't be searched in place since the user keeps
+    // on editing them while the workers run, and an edit moves or reallocates
+    // the buffer a view would point into. So every document is copied once,
+    // straight from the Scintilla buffer into a new Scintilla document the
+    // worker then searches without copying it again. That costs one memcpy
+    // and the memory of the text per tab while the search runs, which is
+    // much cheaper than the search itself, especially with regular expressions.
+    // Tabs restored from a session may not have their content loaded yet.
+    LoadPendingDocuments();
+    DocumentSnapshots snapshots;
+    int               tabCount = GetTabCount();
+    snapshots.reserve(tabCount);
+    for (int i = 0; i < tabCount; ++i)
+    {
+        auto        docID = GetDocIDFromTabIndex(i);
+        const auto& doc   = GetDocumentFromID(docID);
+        m_searchWnd.Scintilla().SetDocPointer(doc.m_document);
+        OnOutOfScope(m_searchWnd.Scintilla().SetDocPointer(nullptr));
+        const auto length  = m_searchWnd.Scintilla().Length();
+        auto       pLoader = static_cast<Scintilla::ILoader*>(m_searchWnd.Scintilla().CreateLoader(length,
+                                                                                                  Scintilla::DocumentOption::TextLarge | Scintilla::DocumentOption::StylesNone));
+        if (pLoader == nullptr)
+            continue;
+        pLoader->AddData(static_cast<const char*>(m_searchWnd.Scintilla().RangePointer(0, length)), length);
+        CDocumentSnapshot snapshot;
+        snapshot.docID    = docID;
+        snapshot.language = doc.GetLanguage();
+        snapshot.document = static_cast<Document>(pLoader->ConvertToDocument());
+        snapshots.push_back(std::move(snapshot));
+    }
+    return snapshots;
+}
+
+void CFindReplaceDlg::StartSnapshotSearch(const std::shared_ptr<const DocumentSnapshots>& snapshots, const std::string& searchFor,
+                                          Scintilla::FindOption flags, unsigned int exSearchFlags)
+{
+    m_pendingSearchResults.clear();
+    m_pendingFoundPaths.clear();
+    m_nextSnapshot             = 0;
+    m_timeOfLastProgressUpdate = std::chrono::steady_clock::now();
+    m_threadsRunning           = true;
+    std::thread(&CFindReplaceDlg::SnapshotSearchWorkers, this, snapshots, searchFor, flags, exSearchFlags).detach();
+}
+
+void CFindReplaceDlg::SnapshotSearchWorkers(std::shared_ptr<const DocumentSnapshots> snapshots, const std::string& searchFor,
+                                            Scintilla::FindOption flags, unsigned int exSearchFlags)
+{
+    size_t workerCount = std::clamp<size_t>(std::thread::hardware_concurrency(), 1, MAX_SEARCH_WORKERS);
+    workerCount        = std::clamp<size_t>(snapshots->size(), 1, workerCount);
+    std::vector<std::thread> workers;
+    workers.reserve(workerCount);
+    for (size_t i = 0; i < workerCount; ++i)
+        workers.emplace_back(&CFindReplaceDlg::SnapshotSearchThread, this, snapshots, searchFor, flags, exSearchFlags);
+    // Completion is signaled only once, after every worker ended:
+    // when the result limit is reached, the workers stop on their own.
+    for (auto& worker : workers)
+        worker.join();
+    NewData(m_timeOfLastProgressUpdate, true);
+    m_threadsRunning = false;
+}
+
+void CFindReplaceDlg::SnapshotSearchThread(std::shared_ptr<const DocumentSnapshots> snapshots, const std::string& searchFor,
+                                           Scintilla::FindOption flags, unsigned int exSearchFlags)
+{
+    // We need a Scintilla object created on the same thread as it will be used.
+    auto searchWnd = std::make_unique<CScintillaWnd>(g_hRes);
+    searchWnd->InitScratch(g_hRes);
+
+    SearchResults results;
+    SearchPaths   paths;
+    for (size_t index = m_nextSnapshot++; index < snapshots->size() && !m_bStop; index = m_nextSnapshot++)
+    {
+        if (m_foundSize >= m_maxSearchResults)
+            break;
+        // The snapshot is a private Scintilla document, so the search
+        // behaves exactly like a search in the editor does.
+        // SearchDocument() detaches it from the search window again.
+        const auto& snapshot = (*snapshots)[index];
+        CDocument   doc;
+        doc.m_document = snapshot.document;
+        doc.SetLanguage(snapshot.language);
+
+        SearchDocument(*searchWnd.get(), snapshot.docID, doc, searchFor, flags, exSearchFlags, results, paths);
+        if (!results.empty())
+        {
+            // Only one worker at a time may hand over data to the UI thread.
+            std::lock_guard<std::mutex> lk(m_publishMutex);
+            moveAppend(m_pendingSearchResults, results);
+            NewData(m_timeOfLastProgressUpdate, false);
+        }
+    }
+}
+
 void CFindReplaceDlg::AcceptData()
 {
     std::unique_lock<std::mutex> lk(m_waitingDataMutex);
     auto                         dataReadyPred = [&]() { return m_dataReady; };
     m_dataExchangeCondition.wait(lk, dataReadyPred);
+    // Results from searching snapshots of open documents can refer
+    // to documents that got closed while the search was running.
+    std::erase_if(m_pendingSearchResults, [this](const CSearchResult& item) {
+        return item.docID.IsValid() && !HasDocumentID(item.docID);
+    });
     // Patch up the index so it's makes sense in the list it is
     // appending into rather than the list it moving from.
     for (auto& item : m_pendingSearchResults)
-        item.pathIndex += m_foundPaths.size();
+    {
+        if (item.hasPath())
+            item.pathIndex += m_foundPaths.size();
+    }
     moveAppend(m_searchResults, m_pendingSearchResults);
     // Enable this if something suspect occurs.
     // for (const auto& item : m_pendingSearchResults)
@@ -2322,7 +2996,7 @@ void CFindReplaceDlg::NewData(
     bool                                   finished)
 {
     // Only async functions that should be doing this.
-    assert(m_searchType == IDC_FINDALLINDIR || m_searchType == IDC_FINDFILES);
+    assert(m_searchType == IDC_FINDALLINDIR || m_searchType == IDC_FINDFILES || m_searchType == IDC_FINDALLINTABS);
     std::chrono::steady_clock::time_point timeNow                     = std::chrono::steady_clock::now();
     std::chrono::steady_clock::duration   durationSinceLastDataUpdate = timeNow - timeOfLastProgressUpdate;
     // Exchange data if we are finished or we have batched enough data
@@ -2331,9 +3005,6 @@ void CFindReplaceDlg::NewData(
         m_pendingSearchResults.size() >= MAX_DATA_BATCH_SIZE ||
         (durationSinceLastDataUpdate >= PROGRESS_UPDATE_INTERVAL && (m_pendingFoundPaths.size() > 0 || m_pendingSearchResults.size() > 0)))
     {
-        // Hopefully safe to touch the size field.
-        if (m_searchResults.size() >= m_maxSearchResults)
-            finished = true;
         // NOTE!! It's essential that data isn't sent to the client until
         // it's a full contained unit, i.e. search results must be complete
         // for a given file. Otherwise the file indexes won't match/fixup properly
@@ -2449,9 +3120,14 @@ void CFindReplaceDlg::CheckRegex(bool flash)
 {
     try
     {
-        auto              findText = GetDlgItemText(IDC_SEARCHCOMBO);
-        const std::wregex ignEx(findText.get(),
-                                std::regex_constants::icase | std::regex_constants::ECMAScript);
+        // Compiling through the shared cache with the same flags Scintilla
+        // uses means the search started right after the validation doesn't
+        // have to compile the pattern again.
+        auto                  findText = CUnicodeUtils::StdGetUTF8(GetDlgItemText(IDC_SEARCHCOMBO).get());
+        std::regex::flag_type flags    = std::regex_constants::ECMAScript;
+        if (IsDlgButtonChecked(*this, IDC_MATCHCASE) != BST_CHECKED)
+            flags |= std::regex_constants::icase;
+        Scintilla::Internal::RegexCache::Instance().Wide(findText, flags);
         Clear(IDC_SEARCHINFO);
     }
     catch (const std::exception&)
@@ -2492,6 +3168,7 @@ void CFindReplaceDlg::DoClose()
     // will make it look like they just did a new search or something.
     KillTimer(*this, TIMER_INFOSTRING);
     Clear(IDC_SEARCHINFO);
+    CancelIncrementalSearch();
 
     ShowResults(false);
     ShowWindow(*this, SW_HIDE);
@@ -2527,7 +3204,9 @@ void CFindReplaceDlg::DoClose()
 
 void CFindReplaceDlg::OnClose()
 {
-    m_bStop    = true;
+    m_bStop = true;
+    CancelIncrementalSearch();
+    StopIncrementalSearchThread();
     auto start = GetTickCount64();
     while (m_threadsRunning && (GetTickCount64() - start < 5000))
         Sleep(10);
@@ -2850,7 +3529,27 @@ void CFindReplaceDlg::OnSearchResultsReady(bool finished)
     }
     UpdateMatchCount(finished);
     if (finished)
+    {
         EnableControls(true);
+        if (m_searchType == IDC_FINDALLINTABS)
+        {
+            // Results from the workers arrive in no particular order.
+            SortResults();
+            InvalidateRect(hFindResults, nullptr, FALSE);
+            std::wstring sInfo;
+            if (m_searchResults.size() >= m_maxSearchResults)
+            {
+                ResString rInfoMax(g_hRes, IDS_SEARCHING_FILE_MAX);
+                sInfo = CStringUtils::Format(rInfoMax, m_maxSearchResults);
+            }
+            else
+            {
+                ResString rInfo(g_hRes, IDS_FINDRESULT_COUNTALL);
+                sInfo = CStringUtils::Format(rInfo, static_cast<int>(m_searchResults.size()), GetTabCount());
+            }
+            SetDlgItemText(*this, IDC_SEARCHINFO, sInfo.c_str());
+        }
+    }
     // The first time data arrives focus on the first item.
     // If no results were found make it easy for the user change the search criteria,
     // but don't drag the focus away though from anywhere important to do so.
@@ -2886,7 +3585,12 @@ bool CCmdFindReplace::Execute()
 
 void CCmdFindReplace::ScintillaNotify(SCNotification* pScn)
 {
-    if (pScn->nmhdr.code == SCN_UPDATEUI)
+    if (pScn->nmhdr.code == SCN_MODIFIED)
+    {
+        if ((pScn->modificationType & (SC_MOD_INSERTTEXT | SC_MOD_DELETETEXT)) && g_pFindReplaceDlg != nullptr)
+            g_pFindReplaceDlg->NotifyOnDocumentModified();
+    }
+    else if (pScn->nmhdr.code == SCN_UPDATEUI)
     {
         LRESULT firstLine     = Scintilla().FirstVisibleLine();
         LRESULT lastLine      = firstLine + Scintilla().LinesOnScreen();
@@ -23,12 +23,16 @@
 #include "BPBaseDialog.h"
 #include "InfoRtfDialog.h"
 
+#include <array>
+#include <atomic>
 #include <chrono>
 #include <mutex>
 #include <condition_variable>
 #include <deque>
+#include <memory>
 #include <vector>
 #include <string>
+#include <thread>
 
 class CSearchResult
 {
@@ -48,6 +52,45 @@ public:
     }
 };
 
+// Read-only copy of an open document, taken in the UI thread so the
+// document can be searched in a worker thread while the user edits it.
+// The copy is a Scintilla document of its own which the worker searches
+// directly. Only the worker the snapshot is handed to may use it.
+struct CDocumentSnapshot
+{
+    CDocumentSnapshot() = default;
+    CDocumentSnapshot(CDocumentSnapshot&& other) noexcept;
+    CDocumentSnapshot(const CDocumentSnapshot&)            = delete;
+    CDocumentSnapshot& operator=(const CDocumentSnapshot&) = delete;
+    ~CDocumentSnapshot();
+
+    DocID       docID;
+    std::string language;
+    Document    document = nullptr;
+};
+
+// One run of the incremental search over a snapshot of the current document.
+// The candidates are the start positions of all, possibly overlapping,
+// occurrences of the query: once the user types another character only those
+// positions need to be checked again instead of the whole document.
+struct CIncrementalSearchState
+{
+    unsigned int                       generation = 0;
+    std::string                        query;
+    Scintilla::FindOption              flags = Scintilla::FindOption::None;
+    std::shared_ptr<const std::string> text;
+    std::string                        wordChars;
+    std::string                        whitespaceChars;
+    std::vector<sptr_t>                candidates;
+    std::vector<sptr_t>                matches;
+    std::vector<sptr_t>                matchEnds; // only for searches done by Scintilla, the match lengths vary there
+    std::vector<size_t>                lines;     // the lines of the matches, counted by the worker
+    char                               lineEnd         = '\n';
+    size_t                             matchCount      = 0;
+    bool                               complete        = true;  // false if too many candidates to keep them all
+    bool                               scintillaSearch = false; // regular expressions and case insensitive non-ASCII text
+};
+
 enum class ResultsType
 {
     Unknown,
@@ -74,11 +117,13 @@ class CFindReplaceDlg : public CBPBaseDialog
 {
     // vector or deque should work here. Usage pattern suggests deque
     // might be better but simple tests didn't reveal much difference.
-    using SearchResults = std::deque<CSearchResult>;
-    using SearchPaths   = std::deque<std::wstring>;
+    using SearchResults     = std::deque<CSearchResult>;
+    using SearchPaths       = std::deque<std::wstring>;
+    using DocumentSnapshots = std::vector<CDocumentSnapshot>;
 
 public:
     CFindReplaceDlg(void* obj);
+    ~CFindReplaceDlg() override;
 
     void FindText();
     void FindFunction(const std::wstring& functionToFind);
@@ -87,6 +132,7 @@ public:
     void SetSearchFolder(const std::wstring& folder);
     void NotifyOnDocumentClose(DocID id);
     void NotifyOnDocumentSave(DocID id, bool saveAs);
+    void NotifyOnDocumentModified();
 
 protected: // override
     bool             Execute() override { return true; }
@@ -119,6 +165,24 @@ protected:
 
     void                    SearchThread(int id, const std::wstring& searchPath, const std::string& searchFor,
                                          Scintilla::FindOption flags, unsigned int exSearchFlags, const std::vector<std::wstring>& filesToFind);
+    DocumentSnapshots       TakeDocumentSnapshots() const;
+    void                    StartSnapshotSearch(const std::shared_ptr<const DocumentSnapshots>& snapshots, const std::string& searchFor,
+                                                Scintilla::FindOption flags, unsigned int exSearchFlags);
+    void                    SnapshotSearchWorkers(std::shared_ptr<const DocumentSnapshots> snapshots, const std::string& searchFor,
+                                                  Scintilla::FindOption flags, unsigned int exSearchFlags);
+    void                    SnapshotSearchThread(std::shared_ptr<const DocumentSnapshots> snapshots, const std::string& searchFor,
+                                                 Scintilla::FindOption flags, unsigned int exSearchFlags);
+
+    void                    ScheduleIncrementalSearch();
+    void                    CancelIncrementalSearch();
+    void                    DoIncrementalSearch();
+    void                    IncrementalSearchThread();
+    void                    StopIncrementalSearchThread();
+    bool                    RunIncrementalSearch(CIncrementalSearchState& state, const CIncrementalSearchState* previous,
+                                                 std::unique_ptr<CScintillaWnd>& searchWnd, std::weak_ptr<const std::string>& loadedText) const;
+    bool                    IncrementalSearchWithScintilla(CIncrementalSearchState& state, std::unique_ptr<CScintillaWnd>& searchWnd,
+                                                           std::weak_ptr<const std::string>& loadedText) const;
+    void                    OnIncrementalSearchReady();
 
     void                    SortResults();
     void                    CheckRegex(bool flash);
@@ -139,6 +203,7 @@ protected:
     void                    EnableControls(bool bEnable);
     void                    SearchStringNotFound();
     std::wstring            GetCurrentDocumentFolder() const;
+    bool                    IsWorkingFolder(const std::wstring& folder) const;
 
     void                    FocusOn(int id);
     void                    SetDefaultButton(int id, bool savePrevious = false);
@@ -206,6 +271,21 @@ private:
     std::condition_variable         m_dataExchangeCondition;
     std::atomic_bool                m_bStop                  = false;
     std::atomic_bool                m_threadsRunning         = false;
+    std::mutex                      m_publishMutex;
+    std::atomic_size_t              m_nextSnapshot           = 0;
+    std::chrono::steady_clock::time_point m_timeOfLastProgressUpdate;
+    std::mutex                      m_incrementalMutex;
+    std::condition_variable         m_incrementalCondition;
+    std::thread                     m_incrementalThread;
+    std::atomic_uint                m_incrementalGeneration  = 0;
+    bool                            m_incrementalQuit        = false; // guarded by m_incrementalMutex
+    std::shared_ptr<CIncrementalSearchState>       m_incrementalRequest;         // guarded by m_incrementalMutex
+    std::shared_ptr<const CIncrementalSearchState> m_incrementalRequestPrevious; // guarded by m_incrementalMutex
+    std::shared_ptr<CIncrementalSearchState>       m_incrementalPending;         // guarded by m_incrementalMutex
+    std::shared_ptr<const CIncrementalSearchState> m_incrementalLast;
+    std::shared_ptr<const std::string>             m_incrementalText;
+    DocID                           m_incrementalDocID;
+    sptr_t                          m_incrementalAnchor      = -1;
     int                             m_searchType             = 0;
     ResultsType                     m_resultsType            = ResultsType::Unknown;
     bool                            m_trackingOn             = true;
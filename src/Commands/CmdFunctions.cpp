@@ -114,25 +114,6 @@ static bool ParseSignature(const std::string& sig, std::string& name, std::strin
     return !name.empty();
 }
 
-static bool ParseName(const std::string& sig, std::string& name)
-{
-    // Look for a ( of perhaps void x::f(whatever)
-    auto bracePos = sig.find('(');
-    if (bracePos != std::string::npos)
-    {
-        auto   wPos = sig.find_last_of("\t :,.", bracePos - 1, 5);
-        size_t sPos = (wPos == std::string::npos) ? 0 : wPos + 1;
-
-        // Functions returning pointer or reference will feature these symbols
-        // before the name. Ignore them. This logic is a bit C language based.
-        while (sPos < bracePos && (sig[sPos] == '*' || sig[sPos] == '&' || sig[sPos] == '^'))
-            ++sPos;
-        name.assign(sig, sPos, bracePos - sPos);
-        return !name.empty();
-    }
-    return false;
-}
-
 static bool FindNext(
     const CScintillaWnd& edit,
     Sci_PositionCR searchStart, Sci_PositionCR searchEnd,
@@ -167,6 +148,319 @@ static bool FindNext(
     return true;
 }
 
+// UTF-8 length of a UTF-16 code unit. A surrogate pair takes four bytes, two for each half.
+static sptr_t UTF8Length(wchar_t c)
+{
+    const auto u = static_cast<unsigned>(c);
+    return u < 0x80 ? 1 : (u < 0x800 || (u >= 0xD800 && u < 0xE000)) ? 2 : 3;
+}
+
+static bool IsAscii(const std::string& s)
+{
+    return std::all_of(s.begin(), s.end(), [](char c) { return (c & 0x80) == 0; });
+}
+
+// The function and autocomplete regexes of a language, compiled once.
+// The byte regexes scan the UTF-8 text in place. Since they only see bytes,
+// not characters, they're only used for text that is plain ASCII: '\w', '\b'
+// and icase must see whole characters, so all other text is scanned as UTF-16.
+struct LangRegexes
+{
+    std::string                  functionSource;
+    std::string                  autoCompleteSource;
+    std::unique_ptr<std::regex>  function;
+    std::unique_ptr<std::regex>  autoComplete;
+    std::unique_ptr<std::wregex> wFunction;
+    std::unique_ptr<std::wregex> wAutoComplete;
+};
+
+static void CompileRegex(const std::string& source, std::unique_ptr<std::regex>& byteRegex, std::unique_ptr<std::wregex>& wideRegex)
+{
+    if (source.empty())
+        return;
+    try
+    {
+        constexpr auto flags = std::regex_constants::icase | std::regex_constants::ECMAScript;
+        wideRegex            = std::make_unique<std::wregex>(CUnicodeUtils::StdGetUnicode(source), flags);
+        if (IsAscii(source))
+            byteRegex = std::make_unique<std::regex>(source, flags);
+    }
+    catch (const std::exception&)
+    {
+        byteRegex.reset();
+        wideRegex.reset();
+    }
+}
+
+// Maps iterators into the scanned text to UTF-8 positions in the document.
+// Cheap as long as consecutive calls are close to each other.
+template <typename Char>
+class CDocPosition
+{
+public:
+    using Iterator = typename std::basic_string<Char>::const_iterator;
+
+    CDocPosition(const std::basic_string<Char>& text, sptr_t offset)
+        : m_begin(text.cbegin())
+        , m_end(text.cend())
+        , m_it(text.cbegin())
+        , m_pos(offset)
+    {
+    }
+
+    sptr_t operator()(Iterator it)
+    {
+        if constexpr (sizeof(Char) == 1)
+            return m_pos + (it - m_begin);
+        for (; m_it < it; ++m_it)
+            m_pos += UTF8Length(*m_it);
+        for (; m_it > it;)
+            m_pos -= UTF8Length(*--m_it);
+        return m_pos;
+    }
+
+    // returns the first iterator at or after the document position pos
+    Iterator Find(sptr_t pos)
+    {
+        if constexpr (sizeof(Char) == 1)
+            return m_begin + std::clamp<sptr_t>(pos - m_pos, 0, m_end - m_begin);
+        (*this)(m_begin);
+        while (m_it != m_end && m_pos < pos)
+            m_pos += UTF8Length(*m_it++);
+        return m_it;
+    }
+
+private:
+    Iterator m_begin;
+    Iterator m_end;
+    Iterator m_it;
+    sptr_t   m_pos;
+};
+
+template <typename Char>
+static std::string ToUTF8(typename std::basic_string<Char>::const_iterator first, typename std::basic_string<Char>::const_iterator last)
+{
+    if constexpr (sizeof(Char) == 1)
+        return std::string(first, last);
+    else
+        return CUnicodeUtils::StdGetUTF8(std::wstring(first, last));
+}
+
+// Scans text, which starts at the document position offset, for the functions
+// starting between the document positions start and end and for autocomplete
+// words. The two regexes are still matched separately, std::regex can't
+// combine them into one automaton: the loop just advances whichever of
+// them is behind.
+// The text before start is only used as context for the function regex,
+// so that e.g. '^' doesn't match at start if that's not the start of a line.
+// Words close to the document position currentPos are skipped since they're
+// probably still being typed.
+template <typename Char>
+static void ScanText(const std::basic_string<Char>& text, sptr_t offset, sptr_t start, sptr_t end, sptr_t currentPos,
+                     const std::basic_regex<Char>* functionRegex, const std::basic_regex<Char>* wordRegex,
+                     const std::vector<std::string>& trimTokens, const std::atomic_bool& run,
+                     std::vector<FunctionSymbol>& functions, std::map<std::string, AutoCompleteType>& words)
+{
+    using MatchIterator = std::regex_iterator<typename std::basic_string<Char>::const_iterator>;
+    const MatchIterator noMatch;
+    MatchIterator       functionMatch;
+    MatchIterator       wordMatch;
+    CDocPosition<Char>  functionPos(text, offset);
+    CDocPosition<Char>  wordPos(text, offset);
+    if (functionRegex)
+    {
+        auto       searchStart = functionPos.Find(start);
+        const auto flags       = searchStart == text.cbegin() ? std::regex_constants::match_default : std::regex_constants::match_prev_avail;
+        functionMatch          = MatchIterator(searchStart, text.cend(), *functionRegex, flags);
+    }
+    if (wordRegex)
+        wordMatch = MatchIterator(text.cbegin(), text.cend(), *wordRegex);
+
+    while ((functionMatch != noMatch || wordMatch != noMatch) && run)
+    {
+        // advance whichever of the two is further behind
+        if (functionMatch != noMatch && (wordMatch == noMatch || (*functionMatch)[0].first <= (*wordMatch)[0].first))
+        {
+            auto first = (*functionMatch)[0].first;
+            auto last  = (*functionMatch)[0].second;
+            if (functionPos(first) >= end)
+            {
+                functionMatch = noMatch;
+                continue;
+            }
+            ++functionMatch;
+            // skip the end of the previous statement like FindNext() does
+            while (first != last && (*first == '\r' || *first == '\n' || *first == ';' || *first == '}' || *first == ' ' || *first == '\t'))
+                ++first;
+            if (first == last)
+                continue;
+            auto sig = ToUTF8<Char>(first, last);
+            Normalize(sig, trimTokens);
+            FunctionSymbol function;
+            if (!ParseSignature(sig, function.name, function.displayName))
+                continue;
+            function.start = functionPos(first);
+            function.end   = functionPos(last);
+            functions.push_back(std::move(function));
+        }
+        else
+        {
+            const auto& match = *wordMatch;
+            for (size_t i = 1; i < match.size(); ++i)
+            {
+                if (!match[i].matched)
+                    continue;
+                if (currentPos >= 0)
+                {
+                    auto startPos = wordPos(match[i].first);
+                    auto endPos   = wordPos(match[i].second);
+                    if ((std::abs(startPos - currentPos) < 10) ||
+                        (std::abs(endPos - currentPos) < 10) ||
+                        (startPos < currentPos && endPos > currentPos))
+                    {
+                        continue;
+                    }
+                }
+                auto word = ToUTF8<Char>(match[i].first, match[i].second);
+                if (word.size() > 1)
+                    words[std::move(word)] = AutoCompleteType::Code;
+            }
+            ++wordMatch;
+        }
+    }
+}
+
+// Scans UTF-8 text with ScanText(), in place if the byte regexes can be used.
+static void ScanUTF8(const std::string& text, sptr_t offset, sptr_t start, sptr_t end, sptr_t currentPos,
+                     const LangRegexes& regexes, bool scanFunctions, bool scanWords,
+                     const std::vector<std::string>& trimTokens, const std::atomic_bool& run,
+                     std::vector<FunctionSymbol>& functions, std::map<std::string, AutoCompleteType>& words)
+{
+    const std::wregex* wFunction     = scanFunctions ? regexes.wFunction.get() : nullptr;
+    const std::wregex* wAutoComplete = scanWords ? regexes.wAutoComplete.get() : nullptr;
+    if ((!wFunction || regexes.function) && (!wAutoComplete || regexes.autoComplete) && IsAscii(text))
+    {
+        ScanText(text, offset, start, end, currentPos,
+                 wFunction ? regexes.function.get() : nullptr, wAutoComplete ? regexes.autoComplete.get() : nullptr,
+                 trimTokens, run, functions, words);
+    }
+    else
+    {
+        ScanText(CUnicodeUtils::StdGetUnicode(text), offset, start, end, currentPos,
+                 wFunction, wAutoComplete, trimTokens, run, functions, words);
+    }
+}
+
+// Finds all functions in the UTF-8 text of a file which isn't open, for the
+// symbol index. The function regex of each language is only compiled once.
+void FindFunctionsInText(const std::string& lang, const std::string& functionRegex, const std::vector<std::string>& trimTokens,
+                         const std::string& text, std::vector<FunctionSymbol>& functions)
+{
+    static std::mutex                                          regexesMutex;
+    static std::map<std::string, std::shared_ptr<LangRegexes>> regexes;
+    std::shared_ptr<LangRegexes>                               langRegexes;
+    {
+        std::lock_guard<std::mutex> lock(regexesMutex);
+        auto&                       cached = regexes[lang];
+        if (!cached || cached->functionSource != functionRegex)
+        {
+            cached                 = std::make_shared<LangRegexes>();
+            cached->functionSource = functionRegex;
+            CompileRegex(functionRegex, cached->function, cached->wFunction);
+        }
+        langRegexes = cached;
+    }
+    static const std::atomic_bool           run = true;
+    std::map<std::string, AutoCompleteType> words;
+    try
+    {
+        ScanUTF8(text, 0, 0, static_cast<sptr_t>(text.size()), -1, *langRegexes, true, false, trimTokens, run, functions, words);
+    }
+    catch (const std::exception&)
+    {
+        functions.clear();
+    }
+}
+
+// Replaces the functions starting in the range start - end with the ones found there now.
+static void ReplaceFunctions(std::vector<FunctionSymbol>& functions, sptr_t start, sptr_t end, std::vector<FunctionSymbol>&& found)
+{
+    auto first = std::partition_point(functions.begin(), functions.end(), [start](const FunctionSymbol& f) { return f.start < start; });
+    auto last  = std::partition_point(first, functions.end(), [end](const FunctionSymbol& f) { return f.start < end; });
+    auto pos   = functions.erase(first, last);
+    functions.insert(pos, std::make_move_iterator(found.begin()), std::make_move_iterator(found.end()));
+}
+
+// Moves a position to where it is after an edit at editPos which
+// inserted (positive delta) or deleted (negative delta) text.
+static void MovePosition(sptr_t& pos, sptr_t editPos, sptr_t delta)
+{
+    if (delta > 0)
+    {
+        if (pos >= editPos)
+            pos += delta;
+    }
+    else if (pos >= editPos - delta)
+        pos += delta;
+    else if (pos > editPos)
+        pos = editPos;
+}
+
+// a function signature can span several lines, but not that many
+constexpr sptr_t contextLines = 50;
+
+// Gets the text range needed to parse the range start - end: from the start of the
+// line start is in, and far enough after end for a function starting before end to match.
+static void GetContextRange(const CScintillaWnd& edit, sptr_t start, sptr_t end, sptr_t& contextStart, sptr_t& contextEnd)
+{
+    const sptr_t lastLine = edit.Scintilla().LineFromPosition(end) + contextLines;
+    contextStart          = edit.Scintilla().PositionFromLine(edit.Scintilla().LineFromPosition(start));
+    contextEnd            = lastLine + 1 < edit.Scintilla().LineCount() ? edit.Scintilla().PositionFromLine(lastLine + 1) : edit.Scintilla().Length();
+}
+
+// Returns where a position in the document as it was at fromVersion is now.
+static sptr_t MapPosition(const DocSymbols& state, unsigned fromVersion, sptr_t pos)
+{
+    for (size_t i = fromVersion - state.editsBase; i < state.edits.size(); ++i)
+        MovePosition(pos, state.edits[i].first, state.edits[i].second);
+    return pos;
+}
+
+// Gets the range that has to be parsed again after the document was edited:
+// the edited range, extended to the functions before and after it since an edit can
+// change how the text around it matches. Returns false if nothing was edited.
+static bool GetDirtyRange(const DocSymbols& state, const CScintillaWnd& edit, sptr_t& start, sptr_t& end)
+{
+    if (state.dirtyStart < 0)
+        return false;
+    const sptr_t     length       = edit.Scintilla().Length();
+    const sptr_t     dirtyStart   = std::clamp<sptr_t>(state.dirtyStart, 0, length);
+    const sptr_t     dirtyEnd     = std::clamp<sptr_t>(state.dirtyEnd, dirtyStart, length);
+    const sptr_t     firstLine    = max(0, edit.Scintilla().LineFromPosition(dirtyStart) - contextLines);
+    const sptr_t     lastLine     = edit.Scintilla().LineFromPosition(dirtyEnd) + contextLines;
+    start                         = edit.Scintilla().PositionFromLine(firstLine);
+    end                           = lastLine + 1 < edit.Scintilla().LineCount() ? edit.Scintilla().PositionFromLine(lastLine + 1) : length;
+
+    // start right after the last function before the edit, that's where parsing
+    // the whole document continued as well. A function the edit starts in or
+    // right at the end of is parsed again.
+    const auto& functions = state.functions;
+    auto        affected  = std::partition_point(functions.begin(), functions.end(), [&](const FunctionSymbol& f) { return f.end < dirtyStart; });
+    if (affected != functions.begin())
+        start = max(start, std::prev(affected)->end);
+    if (affected != functions.end())
+        start = min(start, affected->start);
+    // and end with the first function after the edit
+    auto next = std::partition_point(affected, functions.end(), [&](const FunctionSymbol& f) { return f.start < dirtyEnd; });
+    if (next != affected)
+        end = max(end, std::prev(next)->end);
+    if (next != functions.end() && next->start < end)
+        end = next->end;
+    start = std::clamp<sptr_t>(start, 0, dirtyStart);
+    end   = std::clamp<sptr_t>(end, dirtyEnd, length);
+    return true;
+}
+
 CCmdFunctions::CCmdFunctions(void* obj)
     : ICommand(obj)
     , m_autoScanLimit(static_cast<size_t>(-1))
@@ -183,10 +477,13 @@ CCmdFunctions::CCmdFunctions(void* obj)
     m_timerID = GetTimerID();
     m_edit.InitScratch(g_hRes);
 
-    m_bThreadRunning = false;
-    m_bRunThread     = true;
-    m_thread         = std::thread(&CCmdFunctions::ThreadFunc, this);
-    m_thread.detach();
+    // A few threads, so the active document doesn't have to wait until
+    // all others are parsed, e.g. after a big session was restored.
+    const int threadCount = std::clamp(static_cast<int>(std::thread::hardware_concurrency()) / 2, 1, 4);
+    m_threadsRunning      = threadCount;
+    m_bRunThread          = true;
+    for (int i = 0; i < threadCount; ++i)
+        std::thread(&CCmdFunctions::ThreadFunc, this).detach();
 }
 
 HRESULT CCmdFunctions::IUICommandHandlerUpdateProperty(REFPROPERTYKEY key, const PROPVARIANT* pPropVarCurrentValue, PROPVARIANT* pPropVarNewValue)
@@ -223,6 +520,16 @@ HRESULT CCmdFunctions::IUICommandHandlerUpdateProperty(REFPROPERTYKEY key, const
     return E_NOTIMPL;
 }
 
+// Identifies the settings the symbols of a document are parsed with.
+static uint64_t GetSettingsHash(const std::string& lang, const std::string& functionRegex, const std::string& autoCompleteRegex,
+                                const std::vector<std::string>& trimTokens)
+{
+    std::string settings = lang + '\n' + functionRegex + '\n' + autoCompleteRegex + '\n';
+    for (const auto& token : trimTokens)
+        settings += token + '\n';
+    return CSymbolCache::Hash(settings.data(), settings.size());
+}
+
 static bool SortByFunctionNameAndLineNum(const FunctionInfo& lhs, const FunctionInfo& rhs)
 {
     // Sort by name, then by line number.
@@ -284,20 +591,65 @@ void CCmdFunctions::PopulateFunctions(IUICollectionPtr& collection)
 #if defined(_DEBUG) || defined(PROFILING)
         ProfileTimer profileTimer(L"FunctionParse");
 #endif
-        sptr_t         lineNum = 0;
-        std::string    sig;
-        Sci_PositionCR docLength = static_cast<Sci_PositionCR>(edit.Scintilla().Length());
-        for (Sci_PositionCR searchStart = 0, foundStart, foundEnd;
-             FindNext(edit, searchStart, docLength,
-                      langData->functionRegex.c_str(),
-                      foundStart, foundEnd, sig, lineNum);
-             searchStart = foundEnd + 1)
+        // Use the functions found in the background if they're up to date.
+        // What was edited since then is parsed here.
+        std::vector<FunctionSymbol> known;
+        bool                        haveKnown  = false;
+        bool                        hasDirty   = false;
+        sptr_t                      dirtyStart = 0;
+        sptr_t                      dirtyEnd   = 0;
+        Sci_PositionCR              docLength  = static_cast<Sci_PositionCR>(edit.Scintilla().Length());
+        {
+            std::lock_guard<std::mutex> lock(m_symbolsMutex);
+            auto                        found = m_symbols.find(GetDocIdOfCurrentTab());
+            if (found != m_symbols.end() && found->second.complete && found->second.pending == 0 && found->second.length == docLength)
+            {
+                known     = found->second.functions;
+                haveKnown = true;
+                hasDirty  = GetDirtyRange(found->second, edit, dirtyStart, dirtyEnd);
+            }
+        }
+        if (haveKnown && hasDirty)
+        {
+            try
+            {
+                auto   regexes      = GetRegexes(docLang, langData->functionRegex, langData->autoCompleteRegex);
+                sptr_t contextStart = 0;
+                sptr_t contextEnd   = 0;
+                GetContextRange(edit, dirtyStart, dirtyEnd, contextStart, contextEnd);
+                std::vector<FunctionSymbol>             found;
+                std::map<std::string, AutoCompleteType> words;
+                ScanUTF8(edit.Scintilla().StringOfRange(Scintilla::Span(contextStart, contextEnd)), contextStart, dirtyStart, dirtyEnd, -1,
+                         *regexes, true, false, langData->functionRegexTrim, m_bRunThread, found, words);
+                ReplaceFunctions(known, dirtyStart, dirtyEnd, std::move(found));
+            }
+            catch (const std::exception&)
+            {
+                haveKnown = false;
+            }
+        }
+        if (haveKnown)
         {
-            Normalize(sig, langData->functionRegexTrim);
-            std::string name;
-            std::string nameAndArgs;
-            if (ParseSignature(sig, name, nameAndArgs))
-                functions.emplace_back(lineNum, std::move(name), std::move(nameAndArgs));
+            functions.reserve(known.size());
+            for (auto& function : known)
+                functions.emplace_back(edit.Scintilla().LineFromPosition(function.start), std::move(function.name), std::move(function.displayName));
+        }
+        else
+        {
+            sptr_t      lineNum = 0;
+            std::string sig;
+            for (Sci_PositionCR searchStart = 0, foundStart, foundEnd;
+                 FindNext(edit, searchStart, docLength,
+                          langData->functionRegex.c_str(),
+                          foundStart, foundEnd, sig, lineNum);
+                 searchStart = foundEnd + 1)
+            {
+                Normalize(sig, langData->functionRegexTrim);
+                std::string name;
+                std::string nameAndArgs;
+                if (ParseSignature(sig, name, nameAndArgs))
+                    functions.emplace_back(lineNum, std::move(name), std::move(nameAndArgs));
+            }
         }
     }
     if (functions.empty())
@@ -368,25 +720,20 @@ void CCmdFunctions::TabNotify(TBHDR* ptbHdr)
     {
         InvalidateFunctionsSource();
 
-        auto                         docID = GetDocIdOfCurrentTab();
+        auto docID = GetDocIdOfCurrentTab();
+        m_recentDocs.erase(std::remove(m_recentDocs.begin(), m_recentDocs.end(), docID), m_recentDocs.end());
+        m_recentDocs.push_front(docID);
+        if (m_recentDocs.size() > 10)
+            m_recentDocs.pop_back();
+
         std::unique_lock<std::mutex> lock(m_fileDataMutex);
-        auto                         found = std::find_if(m_fileData.begin(), m_fileData.end(), [docID](const WorkItem& wi) {
-            return wi.m_id == docID;
-        });
-        if (found != m_fileData.end())
+        for (auto& workItem : m_fileData)
+            workItem.m_priority = GetPriority(workItem.m_id);
+        auto foundEvent = std::find(m_eventData.begin(), m_eventData.end(), docID);
+        if (foundEvent != m_eventData.end())
         {
-            auto workItem = *found;
-            m_fileData.erase(found);
-            m_fileData.push_back(std::move(workItem));
-        }
-        else
-        {
-            auto foundEvent = std::find(m_eventData.begin(), m_eventData.end(), docID);
-            if (foundEvent != m_eventData.end())
-            {
-                m_eventData.erase(foundEvent);
-                m_eventData.push_front(docID);
-            }
+            m_eventData.erase(foundEvent);
+            m_eventData.push_front(docID);
         }
     }
 }
@@ -398,18 +745,15 @@ void CCmdFunctions::ScintillaNotify(SCNotification* pScn)
         case SCN_MODIFIED:
             if ((pScn->modificationType & (SC_MOD_INSERTTEXT | SC_MOD_DELETETEXT)) != 0)
             {
+                // Every edit is recorded so the positions of the known functions
+                // stay right and only the edited range has to be parsed again.
+                //
                 // We ignore modifications that occur before the document is dirty
                 // on the assumption that the modifications are just the result of
                 // loading the file initially.
-                //
-                // We could process modifications a bit more optimally i.e.
-                // parse within the change area or something but we risk missing
-                // data by only seeing a narrow part of the whole picture then.
-                // Performance issues don't seem to warrant missing data yet
-                // (at least on my machine) during release mode testing but
-                // it is close to warranting it.
-                auto        docID = GetDocIdOfCurrentTab();
-                const auto& doc   = GetDocumentFromID(docID);
+                auto docID = GetDocIdOfCurrentTab();
+                RecordEdit(docID, pScn->position, (pScn->modificationType & SC_MOD_INSERTTEXT) ? pScn->length : -pScn->length);
+                const auto& doc = GetDocumentFromID(docID);
                 if (doc.m_bIsDirty)
                 {
                     m_eventData.push_front(docID);
@@ -455,32 +799,113 @@ void CCmdFunctions::OnTimer(UINT id)
             OnOutOfScope(
                 m_edit.Scintilla().SetDocPointer(nullptr););
             size_t lengthDoc = m_edit.Scintilla().Length();
-            if (limitedScan && lengthDoc > m_autoScanLimit)
+            sptr_t start     = 0;
+            sptr_t end       = 0;
+            bool   full      = GetWorkRange(docId, m_edit, start, end);
+            if (!full && start >= end)
                 continue;
             WorkItem w;
             w.m_lang = lang;
             w.m_id   = docId;
             if (GetDocIdOfCurrentTab() == docId)
                 w.m_currentPos = Scintilla().CurrentPos();
-            w.m_regex       = langData->functionRegex;
-            w.m_trimTokens  = langData->functionRegexTrim;
-            w.m_autoCRegex  = langData->autoCompleteRegex;
-            // get characters directly from Scintilla buffer
-            const char* buf = static_cast<const char*>(m_edit.Scintilla().CharacterPointer());
-            w.m_data        = std::string(buf, lengthDoc);
+            w.m_regex      = langData->functionRegex;
+            w.m_trimTokens = langData->functionRegexTrim;
+            w.m_autoCRegex = langData->autoCompleteRegex;
+            w.m_priority   = GetPriority(docId);
 
             std::unique_lock<std::mutex> lock(m_fileDataMutex);
+            std::lock_guard<std::mutex>  symbolsLock(m_symbolsMutex);
+            auto&                        symbols = m_symbols[docId];
             // if there's already a work item queued up for this document,
-            // remove it and add the new one
-            std::erase_if(m_fileData, [docId](const WorkItem& wi) {
-                return wi.m_id == docId;
-            });
-            m_fileData.push_back(std::move(w));
+            // remove it and parse its range with the new one. The chunks of
+            // a document that is parsed in chunks are left alone.
+            for (auto it = m_fileData.begin(); it != m_fileData.end();)
+            {
+                if (it->m_id != docId || (it->m_chunk && !full))
+                {
+                    ++it;
+                    continue;
+                }
+                if (it->m_full)
+                    full = true;
+                else if (!it->m_chunk)
+                {
+                    start = min(start, MapPosition(symbols, it->m_version, it->m_start));
+                    end   = max(end, MapPosition(symbols, it->m_version, it->m_end));
+                }
+                --symbols.pending;
+                it = m_fileData.erase(it);
+            }
+            auto queueItem = [&](WorkItem&& item, sptr_t itemStart, sptr_t itemEnd) {
+                ++symbols.pending;
+                item.m_start      = itemStart;
+                item.m_end        = itemEnd;
+                item.m_version    = symbols.version;
+                item.m_resets     = symbols.resets;
+                item.m_run        = std::make_shared<std::atomic_bool>(true);
+                sptr_t contextEnd = itemEnd;
+                GetContextRange(m_edit, itemStart, itemEnd, item.m_offset, contextEnd);
+                // get characters directly from Scintilla buffer
+                const char* buf   = static_cast<const char*>(m_edit.Scintilla().CharacterPointer());
+                item.m_data       = std::string(buf + item.m_offset, contextEnd - item.m_offset);
+                m_fileData.push_back(std::move(item));
+            };
+            if (full)
+            {
+                // whatever is running for the document now is parsed again anyway
+                if (auto running = m_runningDocs.find(docId); running != m_runningDocs.end())
+                    *running->second = false;
+                ++symbols.resets;
+                symbols.chunks = 0;
+            }
+            // Documents that are too big to be parsed at once are parsed in chunks.
+            if (full && limitedScan && lengthDoc > m_autoScanLimit)
+            {
+                if (m_autoScan)
+                {
+                    const sptr_t length = static_cast<sptr_t>(lengthDoc);
+                    for (sptr_t chunkStart = 0; chunkStart < length;)
+                    {
+                        const sptr_t chunkLine = m_edit.Scintilla().LineFromPosition(chunkStart + static_cast<sptr_t>(m_autoScanLimit));
+                        sptr_t       chunkEnd  = chunkLine + 1 < m_edit.Scintilla().LineCount() ? m_edit.Scintilla().PositionFromLine(chunkLine + 1) : length;
+                        WorkItem     chunk     = w;
+                        chunk.m_full           = false;
+                        chunk.m_chunk          = true;
+                        queueItem(std::move(chunk), chunkStart, chunkEnd);
+                        ++symbols.chunks;
+                        chunkStart = chunkEnd;
+                    }
+                    bWakeupThread = true;
+                }
+                else if (start < end)
+                {
+                    // only parse the edited range
+                    w.m_full = false;
+                    queueItem(std::move(w), start, end);
+                    bWakeupThread = true;
+                }
+                continue;
+            }
+            w.m_full = full;
+            if (full)
+            {
+                start = 0;
+                end   = static_cast<sptr_t>(lengthDoc);
+                // the results for a file as it is on disk can be cached
+                if (!doc.m_path.empty() && !doc.m_bIsDirty && !doc.m_bNeedsSaving)
+                {
+                    w.m_cacheKey.path      = doc.m_path;
+                    w.m_cacheKey.fileSize  = doc.m_fileSize;
+                    w.m_cacheKey.lastWrite = (static_cast<uint64_t>(doc.m_lastWriteTime.dwHighDateTime) << 32) | doc.m_lastWriteTime.dwLowDateTime;
+                }
+            }
+            queueItem(std::move(w), start, end);
             bWakeupThread = true;
         }
         m_eventData.clear();
         if (bWakeupThread)
-            m_fileDataCv.notify_one();
+            m_fileDataCv.notify_all();
 
         // now go through the lang data and see if we have to update those.
         {
@@ -514,12 +939,84 @@ void CCmdFunctions::OnTimer(UINT id)
 
 void CCmdFunctions::OnDocumentOpen(DocID id)
 {
+    ResetSymbols(id);
     m_eventData.erase(std::remove(m_eventData.begin(), m_eventData.end(), id), m_eventData.end());
+    if (LoadCachedSymbols(id))
+    {
+        // the keywords still have to be handed to the lexer
+        InvalidateFunctionsSource();
+        SetWorkTimer(0);
+        return;
+    }
     m_eventData.push_front(id);
     InvalidateFunctionsSource();
     SetWorkTimer(1000);
 }
 
+// Looks up the cache entry of a file that was just loaded. The content is
+// hashed as it was decoded, since the same file can be decoded differently.
+// Returns true if the symbols of the document were filled from the cache.
+bool CCmdFunctions::LoadCachedSymbols(DocID id)
+{
+    const auto& doc = GetDocumentFromID(id);
+    if (doc.m_path.empty() || doc.m_bIsDirty || doc.m_bNeedsSaving || doc.GetLanguage().empty())
+        return false;
+    auto langData = CLexStyles::Instance().GetLanguageData(doc.GetLanguage());
+    if (!langData ||
+        langData->functionRegex.empty() ||
+        langData->userFunctions <= 0 ||
+        langData->autoCompleteRegex.empty())
+        return false;
+    const bool     scanWords = CIniSettings::Instance().GetInt64(L"View", L"autocomplete", 1) != 0;
+    SymbolCacheKey key;
+    key.path         = doc.m_path;
+    key.fileSize     = doc.m_fileSize;
+    key.lastWrite    = (static_cast<uint64_t>(doc.m_lastWriteTime.dwHighDateTime) << 32) | doc.m_lastWriteTime.dwLowDateTime;
+    key.settingsHash = GetSettingsHash(doc.GetLanguage(), langData->functionRegex, scanWords ? langData->autoCompleteRegex : std::string(),
+                                       langData->functionRegexTrim);
+
+    m_edit.Scintilla().SetDocPointer(doc.m_document);
+    const sptr_t length = m_edit.Scintilla().Length();
+    key.contentHash     = CSymbolCache::Hash(m_edit.Scintilla().RangePointer(0, length), static_cast<size_t>(length));
+    m_edit.Scintilla().SetDocPointer(nullptr);
+
+    std::vector<FunctionSymbol> functions;
+    std::vector<std::string>    cachedWords;
+    if (!CSymbolCache::Instance().Load(key, functions, cachedWords))
+        return false;
+
+    AddFunctionKeywords(doc.GetLanguage(), functions);
+    {
+        std::lock_guard<std::mutex> lock(m_symbolsMutex);
+        auto&                       symbols = m_symbols[id];
+        symbols.functions                   = std::move(functions);
+        symbols.complete                    = true;
+        symbols.length                      = length;
+    }
+    std::map<std::string, AutoCompleteType> words;
+    for (auto& word : cachedWords)
+        words[std::move(word)] = AutoCompleteType::Code;
+    if (!words.empty())
+        AddAutoCompleteWords(id, std::move(words));
+    return true;
+}
+
+// Functions with arguments are used as keywords for the lexer and for autocompletion.
+void CCmdFunctions::AddFunctionKeywords(const std::string& lang, const std::vector<FunctionSymbol>& functions)
+{
+    std::map<std::string, AutoCompleteType> acMap;
+    for (const auto& function : functions)
+    {
+        if (function.displayName.find('(') == std::string::npos)
+            continue;
+        acMap[function.name] = AutoCompleteType::Code;
+        std::lock_guard<std::recursive_mutex> lock(m_langDataMutex);
+        m_langData[lang].insert(function.name);
+    }
+    if (!acMap.empty())
+        AddAutoCompleteWords(lang, std::move(acMap));
+}
+
 void CCmdFunctions::OnDocumentClose(DocID id)
 {
     const auto& closingDoc = GetDocumentFromID(id);
@@ -557,6 +1054,10 @@ void CCmdFunctions::OnDocumentClose(DocID id)
         }
     }
     m_eventData.erase(std::remove(m_eventData.begin(), m_eventData.end(), id), m_eventData.end());
+    m_recentDocs.erase(std::remove(m_recentDocs.begin(), m_recentDocs.end(), id), m_recentDocs.end());
+    CancelWork(id);
+    std::lock_guard<std::mutex> lock(m_symbolsMutex);
+    m_symbols.erase(id);
 }
 
 void CCmdFunctions::OnClose()
@@ -564,8 +1065,9 @@ void CCmdFunctions::OnClose()
     m_bRunThread = false;
     {
         std::unique_lock<std::mutex> lock(m_fileDataMutex);
-        m_fileData.push_back(WorkItem());
-        m_fileDataCv.notify_one();
+        for (const auto& [id, run] : m_runningDocs)
+            *run = false;
+        m_fileDataCv.notify_all();
     }
     // Wait for function processing to finish as exiting while a thread
     // is running can (and has been observed to) cause a crash that can leave
@@ -576,7 +1078,7 @@ void CCmdFunctions::OnClose()
     // due to opening several tabs fairly quickly, such as when cursoring through files
     // in the find/replace dialog's list view (using the find files button).
     constexpr std::chrono::microseconds sleepPeriod(100);
-    while (m_bThreadRunning)
+    while (m_threadsRunning > 0)
         std::this_thread::sleep_for(sleepPeriod);
 }
 
@@ -584,6 +1086,7 @@ void CCmdFunctions::OnDocumentSave(DocID id, bool bSaveAs)
 {
     if (bSaveAs)
     {
+        ResetSymbols(id);
         m_eventData.push_front(id);
         InvalidateFunctionsSource();
         SetWorkTimer(1000);
@@ -592,6 +1095,7 @@ void CCmdFunctions::OnDocumentSave(DocID id, bool bSaveAs)
 
 void CCmdFunctions::OnLangChanged()
 {
+    ResetSymbols(GetDocIdOfCurrentTab());
     m_eventData.push_front(GetDocIdOfCurrentTab());
     InvalidateFunctionsSource();
     SetWorkTimer(1000);
@@ -607,118 +1111,265 @@ void CCmdFunctions::ThreadFunc()
 {
     bool bAutoComplete = CIniSettings::Instance().GetInt64(L"View", L"autocomplete", 1) != 0;
 
-    m_bThreadRunning   = true;
-    do
+    WorkItem work;
+    while (PopWorkItem(work))
     {
-        WorkItem work;
+        std::vector<FunctionSymbol>             functions;
+        std::map<std::string, AutoCompleteType> words;
+        const bool                              scanWords = !work.m_autoCRegex.empty() && bAutoComplete;
+        bool                                    cached    = false;
+        if (!work.m_cacheKey.path.empty())
         {
-            std::unique_lock<std::mutex> lock(m_fileDataMutex);
-            m_fileDataCv.wait(lock, [&] {
-                return !m_fileData.empty();
-            });
-            if (!m_fileData.empty())
-            {
-                work = std::move(m_fileData.back());
-                m_fileData.pop_back();
-            }
+            work.m_cacheKey.contentHash  = CSymbolCache::Hash(work.m_data.data(), work.m_data.size());
+            work.m_cacheKey.settingsHash = GetSettingsHash(work.m_lang, work.m_regex, scanWords ? work.m_autoCRegex : std::string(), work.m_trimTokens);
+            std::vector<std::string> cachedWords;
+            cached = CSymbolCache::Instance().Load(work.m_cacheKey, functions, cachedWords);
+            for (auto& word : cachedWords)
+                words[std::move(word)] = AutoCompleteType::Code;
         }
-        if (!m_bRunThread)
-            break;
-
-        auto sData = CUnicodeUtils::StdGetUnicode(work.m_data);
-        if (!work.m_regex.empty())
+        if (!cached && (!work.m_regex.empty() || scanWords))
         {
-            auto                                    sRegex = CUnicodeUtils::StdGetUnicode(work.m_regex);
-
-            std::map<std::string, AutoCompleteType> acMap;
+            auto regexes = GetRegexes(work.m_lang, work.m_regex, work.m_autoCRegex);
             try
             {
-                std::wregex                       regex(sRegex, std::regex_constants::icase | std::regex_constants::ECMAScript);
-                const std::wsregex_token_iterator end;
                 // Profile
                 //#if defined(_DEBUG) || defined(PROFILING)
-                ProfileTimer                      timer(L"parsing functions");
+                ProfileTimer timer(L"parsing functions and words");
                 //#endif
-                for (std::wsregex_token_iterator match(sData.cbegin(), sData.cend(), regex, 0); match != end; ++match)
-                {
-                    if (!m_bRunThread)
-                        break;
-                    if (!match->matched)
-                        continue;
-                    auto sig = CUnicodeUtils::StdGetUTF8(match->str());
-                    Normalize(sig, work.m_trimTokens);
-                    if (std::string name; ParseName(sig, name))
-                    {
-                        acMap[name] = AutoCompleteType::Code;
-                        std::lock_guard<std::recursive_mutex> lock(m_langDataMutex);
-                        m_langData[work.m_lang].insert(std::move(name));
-                    }
-                    if (work.m_currentPos >= 0)
-                    {
-                        auto startPos = std::distance(sData.cbegin(), match->first);
-                        auto endPos   = std::distance(sData.cbegin(), match->second);
-                        if ((std::abs(startPos - work.m_currentPos) < 10) ||
-                            (std::abs(endPos - work.m_currentPos) < 10) ||
-                            (startPos < work.m_currentPos && endPos > work.m_currentPos))
-                        {
-                            continue;
-                        }
-                    }
-                }
-                if (!acMap.empty())
-                    AddAutoCompleteWords(work.m_lang, std::move(acMap));
+                ScanUTF8(work.m_data, work.m_offset, work.m_start, work.m_end, work.m_currentPos, *regexes,
+                         !work.m_regex.empty(), scanWords, work.m_trimTokens, *work.m_run, functions, words);
             }
             catch (const std::exception&)
             {
+                functions.clear();
             }
         }
-        if (!work.m_autoCRegex.empty() && bAutoComplete)
+        // the results of a cancelled scan are incomplete, and
+        // the document might not even exist anymore
+        if (!*work.m_run)
         {
-            try
-            {
-                auto                                    sRegex = CUnicodeUtils::StdGetUnicode(work.m_autoCRegex);
-                std::wregex                             regex(sRegex, std::regex_constants::icase | std::regex_constants::ECMAScript);
-                const std::wsregex_iterator             end;
-                // Profile
-                //#if defined(_DEBUG) || defined(PROFILING)
-                ProfileTimer                            timer(L"parsing words");
-                //#endif
-                std::map<std::string, AutoCompleteType> acMap;
-                for (std::wsregex_iterator match(sData.begin(), sData.end(), regex); match != end; ++match)
-                {
-                    if (!m_bRunThread)
-                        break;
-
-                    for (size_t i = 1; i < match->size(); ++i)
-                    {
-                        if (work.m_currentPos >= 0)
-                        {
-                            auto startPos = match->position(i);
-                            auto endPos   = startPos + match->length(i);
-                            if ((std::abs(startPos - work.m_currentPos) < 10) ||
-                                (std::abs(endPos - work.m_currentPos) < 10) ||
-                                (startPos < work.m_currentPos && endPos > work.m_currentPos))
-                            {
-                                continue;
-                            }
-                        }
-                        auto word = CUnicodeUtils::StdGetUTF8(match->str(i));
-                        if (word.size() > 1)
-                            acMap[std::move(word)] = AutoCompleteType::Code;
-                    }
-                }
-                if (!acMap.empty())
-                    AddAutoCompleteWords(work.m_id, std::move(acMap));
-            }
-            catch (const std::exception&)
-            {
-            }
+            functions.clear();
+            words.clear();
+        }
+        else if (!cached && !work.m_cacheKey.path.empty())
+        {
+            std::vector<std::string> cacheWords;
+            cacheWords.reserve(words.size());
+            for (const auto& [word, type] : words)
+                cacheWords.push_back(word);
+            CSymbolCache::Instance().Store(work.m_cacheKey, functions, cacheWords);
+        }
+        AddFunctionKeywords(work.m_lang, functions);
+        {
+            std::lock_guard<std::mutex> lock(m_symbolsMutex);
+            ApplyFunctions(work, std::move(functions));
         }
+        if (!words.empty())
+            AddAutoCompleteWords(work.m_id, std::move(words));
 
         SetWorkTimer(0);
+    }
+    --m_threadsRunning;
+}
+
+// Waits for the next work item: the one with the highest priority of the
+// documents no other thread is working on. Work items of one document are
+// never processed at the same time since their results must be applied one
+// after the other. Returns false if the threads have to stop.
+bool CCmdFunctions::PopWorkItem(WorkItem& work)
+{
+    std::unique_lock<std::mutex> lock(m_fileDataMutex);
+    if (work.m_run)
+    {
+        m_runningDocs.erase(work.m_id);
+        // items for the document can be processed now
+        m_fileDataCv.notify_all();
+    }
+    auto next = m_fileData.end();
+    m_fileDataCv.wait(lock, [&] {
+        if (!m_bRunThread)
+            return true;
+        next = m_fileData.end();
+        for (auto it = m_fileData.begin(); it != m_fileData.end(); ++it)
+        {
+            // the newest of the same priority wins
+            if (m_runningDocs.find(it->m_id) == m_runningDocs.end() && (next == m_fileData.end() || it->m_priority <= next->m_priority))
+                next = it;
+        }
+        return next != m_fileData.end();
+    });
+    if (!m_bRunThread)
+        return false;
+    work = std::move(*next);
+    m_fileData.erase(next);
+    m_runningDocs[work.m_id] = work.m_run;
+    return true;
+}
+
+// Lower is processed first: the active document, then the recently active
+// ones, then all others by their distance to the active tab.
+int CCmdFunctions::GetPriority(DocID id) const
+{
+    if (id == GetDocIdOfCurrentTab())
+        return 0;
+    auto recent = std::find(m_recentDocs.begin(), m_recentDocs.end(), id);
+    if (recent != m_recentDocs.end())
+        return 1 + static_cast<int>(recent - m_recentDocs.begin());
+    return 100 + std::abs(GetTabIndexFromDocID(id) - GetActiveTabIndex());
+}
+
+// Removes the queued work items of a document and stops the one that's running.
+void CCmdFunctions::CancelWork(DocID id)
+{
+    std::lock_guard<std::mutex> lock(m_fileDataMutex);
+    std::erase_if(m_fileData, [id](const WorkItem& wi) {
+        return wi.m_id == id;
+    });
+    if (auto running = m_runningDocs.find(id); running != m_runningDocs.end())
+        *running->second = false;
+}
+
+std::shared_ptr<const LangRegexes> CCmdFunctions::GetRegexes(const std::string& lang, const std::string& functionRegex, const std::string& autoCompleteRegex)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_regexesMutex);
+        auto                        found = m_regexes.find(lang);
+        if (found != m_regexes.end() && found->second->functionSource == functionRegex && found->second->autoCompleteSource == autoCompleteRegex)
+            return found->second;
+    }
+    // compiling is the expensive part, do that without holding the lock
+    auto regexes                = std::make_shared<LangRegexes>();
+    regexes->functionSource     = functionRegex;
+    regexes->autoCompleteSource = autoCompleteRegex;
+    CompileRegex(functionRegex, regexes->function, regexes->wFunction);
+    CompileRegex(autoCompleteRegex, regexes->autoComplete, regexes->wAutoComplete);
+    std::lock_guard<std::mutex> lock(m_regexesMutex);
+    m_regexes[lang] = regexes;
+    return regexes;
+}
 
-    } while (m_bRunThread);
-    m_bThreadRunning = false;
+void CCmdFunctions::ResetSymbols(DocID id)
+{
+    std::lock_guard<std::mutex> lock(m_symbolsMutex);
+    auto&                       symbols = m_symbols[id];
+    // work items which are still pending must not change the functions anymore
+    ++symbols.resets;
+    symbols.functions.clear();
+    symbols.complete   = false;
+    symbols.chunks     = 0;
+    symbols.dirtyStart = -1;
+    symbols.dirtyEnd   = -1;
+}
+
+void CCmdFunctions::RecordEdit(DocID id, sptr_t pos, sptr_t delta)
+{
+    std::lock_guard<std::mutex> lock(m_symbolsMutex);
+    auto                        found = m_symbols.find(id);
+    if (found == m_symbols.end())
+        return;
+    auto& symbols = found->second;
+    ++symbols.version;
+    symbols.length += delta;
+    if (symbols.pending > 0)
+        symbols.edits.emplace_back(pos, delta);
+    else
+        symbols.editsBase = symbols.version;
+
+    const sptr_t editEnd = pos + max(delta, 0);
+    if (symbols.dirtyStart < 0)
+    {
+        symbols.dirtyStart = pos;
+        symbols.dirtyEnd   = editEnd;
+    }
+    else
+    {
+        MovePosition(symbols.dirtyStart, pos, delta);
+        MovePosition(symbols.dirtyEnd, pos, delta);
+        symbols.dirtyStart = min(symbols.dirtyStart, pos);
+        symbols.dirtyEnd   = max(symbols.dirtyEnd, editEnd);
+    }
+    // only the functions from the edit on have to move
+    auto first = std::partition_point(symbols.functions.begin(), symbols.functions.end(), [pos](const FunctionSymbol& f) { return f.end < pos; });
+    for (auto it = first; it != symbols.functions.end(); ++it)
+    {
+        MovePosition(it->start, pos, delta);
+        MovePosition(it->end, pos, delta);
+    }
+    // functions that were deleted completely won't be found by parsing the edited range
+    if (delta < 0)
+        symbols.functions.erase(std::remove_if(first, symbols.functions.end(), [](const FunctionSymbol& f) { return f.start >= f.end; }),
+                                symbols.functions.end());
+}
+
+// Returns true if the whole document has to be parsed. Otherwise start and end
+// are set to the range that has to be parsed again, which is empty if nothing was edited.
+bool CCmdFunctions::GetWorkRange(DocID id, const CScintillaWnd& edit, sptr_t& start, sptr_t& end)
+{
+    std::lock_guard<std::mutex> lock(m_symbolsMutex);
+    auto&                       symbols = m_symbols[id];
+    const sptr_t                length  = edit.Scintilla().Length();
+    start                               = 0;
+    end                                 = 0;
+    // If the length doesn't match, the document was changed without us
+    // seeing it, e.g. while it wasn't the active one.
+    // While the document is parsed in chunks it's not complete yet either.
+    const bool full                     = (!symbols.complete && symbols.chunks == 0) || symbols.length != length;
+    GetDirtyRange(symbols, edit, start, end);
+    symbols.dirtyStart = -1;
+    symbols.dirtyEnd   = -1;
+    if (full)
+        symbols.length = length;
+    return full;
+}
+
+// Must be called with m_symbolsMutex locked.
+void CCmdFunctions::ApplyFunctions(const WorkItem& work, std::vector<FunctionSymbol>&& functions)
+{
+    auto found = m_symbols.find(work.m_id);
+    if (found == m_symbols.end())
+        return;
+    auto& symbols = found->second;
+    // cancelled work items are superseded by others
+    if (work.m_resets == symbols.resets && *work.m_run)
+    {
+        // the document might have been edited while the work item was processed
+        for (auto& function : functions)
+        {
+            function.start = MapPosition(symbols, work.m_version, function.start);
+            function.end   = MapPosition(symbols, work.m_version, function.end);
+        }
+        if (work.m_full)
+        {
+            symbols.functions = std::move(functions);
+            symbols.complete  = true;
+        }
+        else
+        {
+            auto start = MapPosition(symbols, work.m_version, work.m_start);
+            auto end   = MapPosition(symbols, work.m_version, work.m_end);
+            ReplaceFunctions(symbols.functions, start, end, std::move(functions));
+            if (work.m_chunk && --symbols.chunks == 0)
+                symbols.complete = true;
+        }
+        // The result doesn't know about the edits made while the work item was
+        // processed. Those might already be queued, but with a range based on the
+        // table before this result was applied: parse them again.
+        for (size_t i = work.m_version - symbols.editsBase; i < symbols.edits.size(); ++i)
+        {
+            const auto [pos, delta] = symbols.edits[i];
+            const auto   version    = static_cast<unsigned>(symbols.editsBase + i + 1);
+            const sptr_t editStart  = MapPosition(symbols, version, pos);
+            const sptr_t editEnd    = MapPosition(symbols, version, pos + max(delta, 0));
+            symbols.dirtyStart      = symbols.dirtyStart < 0 ? editStart : min(symbols.dirtyStart, editStart);
+            symbols.dirtyEnd        = max(symbols.dirtyEnd, editEnd);
+        }
+    }
+    if (--symbols.pending <= 0)
+    {
+        symbols.pending   = 0;
+        symbols.editsBase = symbols.version;
+        symbols.edits.clear();
+    }
 }
 
 void CCmdFunctions::InvalidateFunctionsSource()
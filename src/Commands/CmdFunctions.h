@@ -19,15 +19,19 @@
 #include "ICommand.h"
 #include "BowPadUI.h"
 #include "ScintillaWnd.h"
+#include "SymbolCache.h"
 
 #include <string>
 #include <vector>
 #include <chrono>
 #include <unordered_set>
 #include <unordered_map>
+#include <map>
+#include <memory>
 #include <deque>
 #include <thread>
 #include <mutex>
+#include <atomic>
 
 enum class DocEventType
 {
@@ -53,13 +57,48 @@ enum class DocEventType
 
 struct WorkItem
 {
-    DocID                    m_id;
-    std::string              m_lang;
-    std::string              m_regex;
-    std::string              m_autoCRegex;
-    std::string              m_data;
-    std::vector<std::string> m_trimTokens;
-    sptr_t                   m_currentPos = -1;
+    DocID                             m_id;
+    std::string                       m_lang;
+    std::string                       m_regex;
+    std::string                       m_autoCRegex;
+    std::string                       m_data;
+    std::vector<std::string>          m_trimTokens;
+    sptr_t                            m_currentPos = -1;
+    sptr_t                            m_offset     = 0;     ///< document position m_data starts at
+    sptr_t                            m_start      = 0;     ///< document range to parse, m_data has some context around it
+    sptr_t                            m_end        = 0;
+    bool                              m_full       = true;  ///< m_data is the whole document
+    bool                              m_chunk      = false; ///< part of a document too big to be parsed at once
+    unsigned                          m_version    = 0;     ///< DocSymbols::version when m_data was taken
+    unsigned                          m_resets     = 0;     ///< DocSymbols::resets when m_data was taken
+    int                               m_priority   = 0;     ///< lower is processed first
+    std::shared_ptr<std::atomic_bool> m_run;                ///< cleared to cancel the work item
+    SymbolCacheKey                    m_cacheKey;           ///< the path is set if the results can be cached
+};
+
+struct LangRegexes;
+
+/**
+ * The functions found in a document, kept up to date while the document
+ * is edited: an edit shifts the functions after it and marks the edited range
+ * as dirty. Only the dirty range, extended to the surrounding functions,
+ * is parsed again.
+ */
+struct DocSymbols
+{
+    std::vector<FunctionSymbol>            functions;          ///< sorted by position
+    bool                                   complete   = false; ///< functions holds all functions of the document
+    sptr_t                                 length     = 0;     ///< document length the positions are valid for
+    sptr_t                                 dirtyStart = -1;
+    sptr_t                                 dirtyEnd   = -1;
+    unsigned                               version    = 0; ///< incremented with every edit
+    unsigned                               resets     = 0; ///< incremented when the whole document must be parsed again
+    // edits done while work items are pending, as position and length change,
+    // to move the results of those work items to where they are now
+    unsigned                               editsBase  = 0; ///< version before the first entry in edits
+    std::vector<std::pair<sptr_t, sptr_t>> edits;
+    int                                    pending    = 0; ///< queued or running work items
+    int                                    chunks     = 0; ///< chunks of a chunked parse that are not applied yet
 };
 
 class CCmdFunctions final : public ICommand
@@ -90,6 +129,18 @@ private:
     void    PopulateFunctions(IUICollectionPtr& collection);
     void    SetWorkTimer(int ms) const;
     void    ThreadFunc();
+    bool    PopWorkItem(WorkItem& work);
+    int     GetPriority(DocID id) const;
+    void    CancelWork(DocID id);
+
+    bool    LoadCachedSymbols(DocID id);
+    void    AddFunctionKeywords(const std::string& lang, const std::vector<FunctionSymbol>& functions);
+    void    ResetSymbols(DocID id);
+    void    RecordEdit(DocID id, sptr_t pos, sptr_t delta);
+    bool    GetWorkRange(DocID id, const CScintillaWnd& edit, sptr_t& start, sptr_t& end);
+    void    ApplyFunctions(const WorkItem& work, std::vector<FunctionSymbol>&& functions);
+
+    std::shared_ptr<const LangRegexes> GetRegexes(const std::string& lang, const std::string& functionRegex, const std::string& autoCompleteRegex);
 
 private:
     bool                                                             m_autoScan;
@@ -102,10 +153,15 @@ private:
     std::deque<DocID>                                                m_eventData;
     std::list<WorkItem>                                              m_fileData;
     std::unordered_map<std::string, std::unordered_set<std::string>> m_langData;
-    std::thread                                                      m_thread;
     std::mutex                                                       m_fileDataMutex;
     std::condition_variable                                          m_fileDataCv;
     std::recursive_mutex                                             m_langDataMutex;
+    std::unordered_map<DocID, DocSymbols>                            m_symbols;
+    std::mutex                                                       m_symbolsMutex;
+    std::map<std::string, std::shared_ptr<const LangRegexes>>        m_regexes;
+    std::mutex                                                       m_regexesMutex;
     std::atomic_bool                                                 m_bRunThread;
-    std::atomic_bool                                                 m_bThreadRunning;
+    std::atomic_int                                                  m_threadsRunning;
+    std::unordered_map<DocID, std::shared_ptr<std::atomic_bool>>     m_runningDocs;
+    std::deque<DocID>                                                m_recentDocs;
 };
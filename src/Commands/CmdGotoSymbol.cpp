@@ -17,10 +17,18 @@
 #include "stdafx.h"
 #include "CmdGotoSymbol.h"
 #include "UnicodeUtils.h"
+#include "StringUtils.h"
 #include "LexStyles.h"
+#include "SymbolIndex.h"
+#include "PathUtils.h"
+#include "OnOutOfScope.h"
+
+#include <algorithm>
 
 extern void findReplaceFindFunction(void* mainWnd, const std::wstring& functionName);
 
+constexpr size_t maxSymbolCandidates = 30;
+
 CCmdGotoSymbol::CCmdGotoSymbol(void* obj)
     : ICommand(obj)
 {
@@ -34,10 +42,12 @@ bool CCmdGotoSymbol::Execute()
         const auto& funcRegex = CLexStyles::Instance().GetFunctionRegexForLang(doc.GetLanguage());
         if (!funcRegex.empty())
         {
-            std::wstring symbolName = CUnicodeUtils::StdGetUnicode(GetSelectedText(SelectionHandling::CurrentWordIfSelectionIsEmpty));
+            std::string symbolName = GetSelectedText(SelectionHandling::CurrentWordIfSelectionIsEmpty);
             if (!symbolName.empty())
             {
-                findReplaceFindFunction(m_pMainWindow, symbolName);
+                // only search the folder if the symbol index can't resolve the symbol
+                if (!GotoIndexedSymbol(symbolName))
+                    findReplaceFindFunction(m_pMainWindow, CUnicodeUtils::StdGetUnicode(symbolName));
                 return true;
             }
         }
@@ -45,6 +55,54 @@ bool CCmdGotoSymbol::Execute()
     return false;
 }
 
+bool CCmdGotoSymbol::GotoIndexedSymbol(const std::string& symbolName)
+{
+    const auto& doc  = GetActiveDocument();
+    auto        root = GetFileTreePath();
+    if (root.empty())
+        root = CPathUtils::GetParentDirectory(doc.m_path);
+    if (root.empty() || !CSymbolIndex::Instance().Prepare(root))
+        return false;
+    auto matches = CSymbolIndex::Instance().Query(root, symbolName, doc.GetLanguage(), maxSymbolCandidates);
+    if (matches.empty())
+        return false;
+
+    // a symbol that's defined exactly once needs no choice, anything
+    // else including a single fuzzy match is left to the user
+    const auto exactCount = std::ranges::count_if(matches, [&](const auto& match) { return match.name == symbolName; });
+    size_t     selected   = 0;
+    if (exactCount == 1)
+        selected = std::ranges::find_if(matches, [&](const auto& match) { return match.name == symbolName; }) - matches.begin();
+    else
+    {
+        HMENU hMenu = CreatePopupMenu();
+        if (!hMenu)
+            return false;
+        OnOutOfScope(DestroyMenu(hMenu););
+        int index = 1;
+        for (const auto& match : matches)
+        {
+            auto text = CUnicodeUtils::StdGetUnicode(match.displayName);
+            SearchReplace(text, L"&", L"&&");
+            text += L"\t" + CPathUtils::GetFileName(match.path) + L":" + std::to_wstring(match.line + 1);
+            AppendMenu(hMenu, MF_ENABLED, index++, text.c_str());
+        }
+        auto  pos = Scintilla().CurrentPos();
+        POINT pt{};
+        pt.x = static_cast<LONG>(Scintilla().PointXFromPosition(pos));
+        pt.y = static_cast<LONG>(Scintilla().PointYFromPosition(pos) + Scintilla().TextHeight(Scintilla().LineFromPosition(pos)));
+        ClientToScreen(GetScintillaWnd(), &pt);
+        int selIndex = TrackPopupMenu(hMenu, TPM_LEFTALIGN | TPM_RETURNCMD, pt.x, pt.y, 0, GetHwnd(), nullptr);
+        if (selIndex <= 0)
+            return true;
+        selected = static_cast<size_t>(selIndex) - 1;
+    }
+    const auto& match = matches[selected];
+    if (OpenFile(match.path.c_str(), OpenFlags::AddToMRU) >= 0)
+        GotoLine(static_cast<sptr_t>(match.line));
+    return true;
+}
+
 HRESULT CCmdGotoSymbol::IUICommandHandlerUpdateProperty(REFPROPERTYKEY key, const PROPVARIANT* /*pPropVarCurrentValue*/, PROPVARIANT* pPropVarNewValue)
 {
     if (UI_PKEY_Enabled == key)
@@ -63,7 +121,13 @@ HRESULT CCmdGotoSymbol::IUICommandHandlerUpdateProperty(REFPROPERTYKEY key, cons
 void CCmdGotoSymbol::TabNotify(TBHDR* ptbHdr)
 {
     if (ptbHdr->hdr.code == TCN_SELCHANGE)
+    {
         InvalidateUICommand(UI_INVALIDATIONS_PROPERTY, &UI_PKEY_Enabled);
+        // start indexing the project early so the index is ready when it's needed
+        auto root = GetFileTreePath();
+        if (!root.empty())
+            CSymbolIndex::Instance().Prepare(root);
+    }
 }
 
 void CCmdGotoSymbol::OnLangChanged()
@@ -32,4 +32,10 @@ public:
     HRESULT IUICommandHandlerUpdateProperty(REFPROPERTYKEY key, const PROPVARIANT* pPropVarCurrentValue, PROPVARIANT* pPropVarNewValue) override;
     void    TabNotify(TBHDR* ptbHdr) override;
     void    OnLangChanged() override;
+
+private:
+    // Resolves the symbol with the symbol index of the project. If there's more
+    // than one candidate, the user picks one from a list, best matches first.
+    // Returns false if the index can't be used or doesn't know the symbol.
+    bool    GotoIndexedSymbol(const std::string& symbolName);
 };
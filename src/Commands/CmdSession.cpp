@@ -21,6 +21,7 @@
 #include "BowPad.h"
 
 #include "CmdSession.h"
+#include "SessionFile.h"
 
 #include "StringUtils.h"
 #include "PathUtils.h"
@@ -79,6 +80,74 @@ bool CCmdSessionLoad::Execute()
     return true;
 }
 
+static std::wstring GetSessionFilePath()
+{
+    if (SysInfo::Instance().IsUACEnabled() && SysInfo::Instance().IsElevated())
+        return CAppUtils::GetDataPath() + L"\\sessionelevated.bpsession";
+    return CAppUtils::GetDataPath() + L"\\session.bpsession";
+}
+
+// reads a session which was saved in the ini file by older versions
+static std::vector<SessionTab> ReadIniSession(int sessionSize)
+{
+    auto&                   settings = CIniSettings::Instance();
+    std::vector<SessionTab> tabs;
+    for (int fileNum = 0; fileNum < sessionSize; ++fileNum)
+    {
+        SessionTab tab;
+        tab.path = settings.GetString(sessionSection(), CStringUtils::Format(L"path%d", fileNum).c_str(), L"");
+        if (tab.path.empty())
+            break;
+        if (auto origPath = settings.GetString(sessionSection(), CStringUtils::Format(L"origpath%d", fileNum).c_str(), nullptr))
+        {
+            tab.origPath = origPath;
+            tab.modified = true;
+        }
+        if (auto origTitle = settings.GetString(sessionSection(), CStringUtils::Format(L"origtitle%d", fileNum).c_str(), nullptr))
+            tab.origTitle = origTitle;
+        auto& pos               = tab.position;
+        pos.m_nSelMode          = static_cast<Scintilla::SelectionMode>(settings.GetInt64(sessionSection(), CStringUtils::Format(L"selmode%d", fileNum).c_str(), 0));
+        pos.m_nStartPos         = static_cast<size_t>(settings.GetInt64(sessionSection(), CStringUtils::Format(L"startpos%d", fileNum).c_str(), 0));
+        pos.m_nEndPos           = static_cast<size_t>(settings.GetInt64(sessionSection(), CStringUtils::Format(L"endpos%d", fileNum).c_str(), 0));
+        pos.m_nScrollWidth      = static_cast<size_t>(settings.GetInt64(sessionSection(), CStringUtils::Format(L"scrollwidth%d", fileNum).c_str(), 0));
+        pos.m_xOffset           = static_cast<size_t>(settings.GetInt64(sessionSection(), CStringUtils::Format(L"xoffset%d", fileNum).c_str(), 0));
+        pos.m_nFirstVisibleLine = static_cast<size_t>(settings.GetInt64(sessionSection(), CStringUtils::Format(L"firstvisible%d", fileNum).c_str(), 0));
+        pos.m_nWrapLineOffset   = static_cast<size_t>(settings.GetInt64(sessionSection(), CStringUtils::Format(L"wraplineoffset%d", fileNum).c_str(), 0));
+        pos.m_lastStyleLine     = static_cast<size_t>(settings.GetInt64(sessionSection(), CStringUtils::Format(L"laststyleline%d", fileNum).c_str(), 0));
+        tab.tabSpace            = static_cast<TabSpace>(settings.GetInt64(sessionSection(), CStringUtils::Format(L"tabspace%d", fileNum).c_str(), 0));
+        tab.readDir             = static_cast<Scintilla::Bidirectional>(settings.GetInt64(sessionSection(), CStringUtils::Format(L"readdir%d", fileNum).c_str(), 0));
+        auto wrapMode           = static_cast<int>(settings.GetInt64(sessionSection(), CStringUtils::Format(L"wrapmode%d", fileNum).c_str(), -1));
+        if (wrapMode >= 0)
+            tab.wrapMode = static_cast<Scintilla::Wrap>(wrapMode);
+        auto folds = settings.GetString(sessionSection(), CStringUtils::Format(L"foldlines%d", fileNum).c_str(), nullptr);
+        if (folds)
+        {
+            stringtok(pos.m_lineStateVector, folds, true, L";", false);
+        }
+        auto numUndoActions = static_cast<int>(settings.GetInt64(sessionSection(), CStringUtils::Format(L"undonumactions%d", fileNum).c_str(), 0));
+        if (numUndoActions)
+        {
+            CUndoData undoData;
+            undoData.m_currentAction = static_cast<int>(settings.GetInt64(sessionSection(), CStringUtils::Format(L"undocurrentaction%d", fileNum).c_str(), 0));
+            undoData.m_savePoint     = static_cast<int>(settings.GetInt64(sessionSection(), CStringUtils::Format(L"undosavepoint%d", fileNum).c_str(), 0));
+            undoData.m_tentative     = static_cast<int>(settings.GetInt64(sessionSection(), CStringUtils::Format(L"undotentative%d", fileNum).c_str(), 0));
+            for (int undoIdx = 0; undoIdx < numUndoActions; ++undoIdx)
+            {
+                CUndoAction action;
+                action.m_type     = static_cast<int>(settings.GetInt64(sessionSection(), CStringUtils::Format(L"undoactiontype%d_%d", fileNum, undoIdx).c_str(), 0));
+                action.m_position = static_cast<int>(settings.GetInt64(sessionSection(), CStringUtils::Format(L"undoactionposition%d_%d", fileNum, undoIdx).c_str(), 0));
+                action.m_text     = CStringUtils::base64_decode(CUnicodeUtils::StdGetUTF8(settings.GetString(sessionSection(), CStringUtils::Format(L"undoactiontext%d_%d", fileNum, undoIdx).c_str(), L"")));
+                undoData.m_actions.push_back(action);
+            }
+
+            pos.m_undoData = undoData;
+        }
+        tab.active = settings.GetInt64(sessionSection(), CStringUtils::Format(L"activetab%d", fileNum).c_str(), 0) != 0;
+        tabs.push_back(std::move(tab));
+    }
+    return tabs;
+}
+
 void CCmdSessionLoad::OnClose()
 {
     // BowPad is closing, save the current session
@@ -88,55 +157,23 @@ void CCmdSessionLoad::OnClose()
     auto& settings       = CIniSettings::Instance();
     bool  bAutoLoad      = GetAutoLoad();
     auto  handleModified = CIniSettings::Instance().GetInt64(sessionSection(), L"handlemodified", 1) != 0;
-    // first remove the whole session section
+    // first remove the whole session section, which also removes
+    // a session saved there by older versions
     settings.Delete(sessionSection(), nullptr);
     // now restore the settings of the session section
     SetAutoLoad(bAutoLoad);
     CIniSettings::Instance().SetInt64(sessionSection(), L"handlemodified", handleModified ? 1 : 0);
     // now go through all tabs and save their state
-    int  tabCount        = GetTabCount();
-    int  activeTab       = GetActiveTabIndex();
-    int  saveIndex       = 0;
-
-    auto savePosSettings = [&](int index, const CPosData& pos) {
-        settings.SetInt64(sessionSection(), CStringUtils::Format(L"selmode%d", index).c_str(), static_cast<int>(pos.m_nSelMode));
-        settings.SetInt64(sessionSection(), CStringUtils::Format(L"startpos%d", index).c_str(), pos.m_nStartPos);
-        settings.SetInt64(sessionSection(), CStringUtils::Format(L"endpos%d", index).c_str(), pos.m_nEndPos);
-        settings.SetInt64(sessionSection(), CStringUtils::Format(L"scrollwidth%d", index).c_str(), pos.m_nScrollWidth);
-        settings.SetInt64(sessionSection(), CStringUtils::Format(L"xoffset%d", index).c_str(), pos.m_xOffset);
-        settings.SetInt64(sessionSection(), CStringUtils::Format(L"firstvisible%d", index).c_str(), pos.m_nFirstVisibleLine);
-        settings.SetInt64(sessionSection(), CStringUtils::Format(L"wraplineoffset%d", index).c_str(), pos.m_nWrapLineOffset);
-        settings.SetInt64(sessionSection(), CStringUtils::Format(L"laststyleline%d", index).c_str(), pos.m_lastStyleLine);
-        std::wostringstream out;
-        if (!pos.m_lineStateVector.empty())
-        {
-            std::copy(pos.m_lineStateVector.begin(), pos.m_lineStateVector.end() - 1, std::ostream_iterator<size_t, wchar_t>(out, L";"));
-            out << pos.m_lineStateVector.back();
-        }
-        if (!pos.m_undoData.m_actions.empty())
-        {
-            settings.SetInt64(sessionSection(), CStringUtils::Format(L"undonumactions%d", index).c_str(), static_cast<int>(pos.m_undoData.m_actions.size()));
-            settings.SetInt64(sessionSection(), CStringUtils::Format(L"undocurrentaction%d", index).c_str(), pos.m_undoData.m_currentAction);
-            settings.SetInt64(sessionSection(), CStringUtils::Format(L"undosavepoint%d", index).c_str(), pos.m_undoData.m_savePoint);
-            settings.SetInt64(sessionSection(), CStringUtils::Format(L"undotentative%d", index).c_str(), pos.m_undoData.m_tentative);
-            for (int undoIdx = 0; undoIdx < static_cast<int>(pos.m_undoData.m_actions.size()); ++undoIdx)
-            {
-                auto& action = pos.m_undoData.m_actions[undoIdx];
-                settings.SetInt64(sessionSection(), CStringUtils::Format(L"undoactiontype%d_%d", index, undoIdx).c_str(), action.m_type);
-                settings.SetInt64(sessionSection(), CStringUtils::Format(L"undoactionposition%d_%d", index, undoIdx).c_str(), action.m_position);
-                settings.SetString(sessionSection(), CStringUtils::Format(L"undoactiontext%d_%d", index, undoIdx).c_str(), CUnicodeUtils::StdGetUnicode(CStringUtils::base64_encode(action.m_text)).c_str());
-            }
-        }
-
-        std::wstring result(out.str());
-        settings.SetString(sessionSection(), CStringUtils::Format(L"foldlines%d", index).c_str(), result.c_str());
-    };
+    int                     tabCount    = GetTabCount();
+    int                     activeTab   = GetActiveTabIndex();
 
-    auto sessionPath = GetBackupPath();
+    auto                    sessionPath = GetBackupPath();
 
-    int  sessionSize = static_cast<int>(settings.GetInt64(sessionSection(), L"session_size", BP_DEFAULT_SESSION_SIZE));
+    int                     sessionSize = static_cast<int>(settings.GetInt64(sessionSection(), L"session_size", BP_DEFAULT_SESSION_SIZE));
     // No point saving more than we are prepared to load.
-    int  saveCount   = min(tabCount, sessionSize);
+    int                     saveCount   = min(tabCount, sessionSize);
+    std::vector<SessionTab> tabs;
+    tabs.reserve(saveCount);
     for (int i = 0; i < saveCount; ++i)
     {
         auto  docId = GetDocIDFromTabIndex(i);
@@ -146,20 +183,19 @@ void CCmdSessionLoad::OnClose()
             if (sessionPath.empty())
                 continue;
         }
-        auto docOrigPath = doc.m_path;
+        int        saveIndex = static_cast<int>(tabs.size());
+        SessionTab tab;
+        tab.path = doc.m_path;
         if (i == activeTab)
         {
-            CPosData pos;
-            SaveCurrentPos(pos);
-
-            settings.SetInt64(sessionSection(), CStringUtils::Format(L"activetab%d", saveIndex).c_str(), 1);
-            savePosSettings(saveIndex, pos);
+            SaveCurrentPos(tab.position);
+            tab.active = true;
         }
         else
         {
-            savePosSettings(saveIndex, doc.m_position);
-            settings.SetInt64(sessionSection(), CStringUtils::Format(L"activetab%d", saveIndex).c_str(), 0);
+            tab.position = doc.m_position;
         }
+        tab.position.m_undoData = GetUndoData(docId);
 
         if (!sessionPath.empty() && (doc.m_bIsDirty || doc.m_bNeedsSaving))
         {
@@ -185,41 +221,39 @@ void CCmdSessionLoad::OnClose()
                     }
                 }
             }
-            auto backupPath = CStringUtils::Format(L"%s\\%d%s", sessionPath.c_str(), saveIndex, filename.c_str());
-            settings.SetString(sessionSection(), CStringUtils::Format(L"origpath%d", saveIndex).c_str(), doc.m_path.c_str());
-            settings.SetString(sessionSection(), CStringUtils::Format(L"origtitle%d", saveIndex).c_str(), title.c_str());
+            auto backupPath    = CStringUtils::Format(L"%s\\%d%s", sessionPath.c_str(), saveIndex, filename.c_str());
+            tab.origPath       = doc.m_path;
+            tab.origTitle      = title;
+            tab.modified       = true;
             doc.m_path         = backupPath;
             doc.m_bIsDirty     = false;
             doc.m_bNeedsSaving = false;
             SaveDoc(docId, backupPath);
-            doc.m_path = CStringUtils::Format(L"%d%s", saveIndex, filename.c_str());
+            doc.m_path        = tab.origPath;
             doc.m_tmpSavePath = backupPath;
+            // the backup is stored relative to the backup folder
+            tab.path          = CStringUtils::Format(L"%d%s", saveIndex, filename.c_str());
         }
-        settings.SetString(sessionSection(), CStringUtils::Format(L"path%d", saveIndex).c_str(), doc.m_path.c_str());
-        settings.SetInt64(sessionSection(), CStringUtils::Format(L"tabspace%d", saveIndex).c_str(), static_cast<int>(doc.m_tabSpace));
-        settings.SetInt64(sessionSection(), CStringUtils::Format(L"readdir%d", saveIndex).c_str(), static_cast<int>(doc.m_readDir));
-        if (doc.m_wrapMode)
-            settings.SetInt64(sessionSection(), CStringUtils::Format(L"wrapmode%d", saveIndex).c_str(), static_cast<int>(*doc.m_wrapMode));
-        doc.m_path = docOrigPath;
-        ++saveIndex;
+        tab.tabSpace = doc.m_tabSpace;
+        tab.readDir  = doc.m_readDir;
+        tab.wrapMode = doc.m_wrapMode;
+        tabs.push_back(std::move(tab));
     }
+    CSessionFile::Write(GetSessionFilePath(), tabs);
 }
 
 void CCmdSessionLoad::RestoreSavedSession() const
 {
-    ProfileTimer profile(L"RestoreSavedSession");
-    auto&        settings          = CIniSettings::Instance();
-    int          numFilesToRestore = 0;
-
-    int          sessionSize       = static_cast<int>(settings.GetInt64(sessionSection(), L"session_size", BP_DEFAULT_SESSION_SIZE));
-    for (int fileNum = 0; fileNum < sessionSize; ++fileNum)
-    {
-        std::wstring key  = CStringUtils::Format(L"path%d", fileNum);
-        std::wstring path = settings.GetString(sessionSection(), key.c_str(), L"");
-        if (path.empty())
-            break;
-        ++numFilesToRestore;
-    }
+    ProfileTimer            profile(L"RestoreSavedSession");
+    auto&                   settings    = CIniSettings::Instance();
+
+    int                     sessionSize = static_cast<int>(settings.GetInt64(sessionSection(), L"session_size", BP_DEFAULT_SESSION_SIZE));
+    std::vector<SessionTab> tabs;
+    if (!CSessionFile::Read(GetSessionFilePath(), tabs))
+        tabs = ReadIniSession(sessionSize);
+    if (static_cast<int>(tabs.size()) > sessionSize)
+        tabs.resize(max(0, sessionSize));
+    int numFilesToRestore = static_cast<int>(tabs.size());
     if (numFilesToRestore == 0)
         return;
 
@@ -238,41 +272,46 @@ void CCmdSessionLoad::RestoreSavedSession() const
     }
 
     DocID                     activeDoc;
-    constexpr unsigned int    openFlags   = OpenFlags::IgnoreIfMissing | OpenFlags::NoActivate;
-    int                       fileCount   = 0;
-    auto                      sessionPath = GetBackupPath();
+    DocID                     lastDoc;
+    constexpr unsigned int    openFlags = OpenFlags::IgnoreIfMissing | OpenFlags::NoActivate;
+    int                       fileCount = 0;
     std::vector<std::wstring> filesToDelete;
-    for (int fileNum = 0; fileNum < sessionSize; ++fileNum)
+    for (auto& tab : tabs)
     {
-        std::wstring key  = CStringUtils::Format(L"path%d", fileNum);
-        std::wstring path = settings.GetString(sessionSection(), key.c_str(), L"");
-        if (path.empty())
-            break;
         ++fileCount;
         SetProgress(fileCount, numFilesToRestore);
 
-        auto origPath = settings.GetString(sessionSection(), CStringUtils::Format(L"origpath%d", fileNum).c_str(), nullptr);
-        if (origPath)
+        auto path     = tab.path;
+        bool modified = tab.modified;
+        if (modified)
         {
             if (PathIsRelative(path.c_str()))
             {
                 // the saved path is only the filename in the backup dir
                 path = GetBackupPath() + L"\\" + path;
             }
+            // If the backup is gone, e.g. because BowPad was killed after restoring
+            // the session the last time, its file time is zero and the original
+            // file is used.
             WIN32_FILE_ATTRIBUTE_DATA savedFileData = {};
             GetFileAttributesEx(path.c_str(), GetFileExInfoStandard, &savedFileData);
             WIN32_FILE_ATTRIBUTE_DATA origFileData = {};
-            GetFileAttributesEx(origPath, GetFileExInfoStandard, &origFileData);
+            GetFileAttributesEx(tab.origPath.c_str(), GetFileExInfoStandard, &origFileData);
             if (CompareFileTime(&savedFileData.ftLastWriteTime, &origFileData.ftLastWriteTime) < 0)
             {
                 // the original file was modified after we saved the modifications
                 // --> use the original file
                 filesToDelete.push_back(path);
-                path     = origPath;
-                origPath = nullptr;
+                path     = tab.origPath;
+                modified = false;
             }
         }
-        int tabIndex = OpenFile(path.c_str(), openFlags);
+        // Only create placeholder tabs, so the time until BowPad is usable
+        // doesn't depend on the size of the session: the files get loaded
+        // when their tab is activated or in the background while idle.
+        // Files with modifications are loaded right away since their backup
+        // gets deleted afterwards.
+        int tabIndex = OpenFile(path.c_str(), modified ? openFlags : openFlags | OpenFlags::LoadLater);
         if (tabIndex < 0)
             continue;
         // Don't use the index to track the active tab, as it's probably
@@ -281,64 +320,34 @@ void CCmdSessionLoad::RestoreSavedSession() const
         auto docId = GetDocIDFromTabIndex(tabIndex);
         if (!docId.IsValid())
             continue;
-        auto& doc               = GetModDocumentFromID(docId);
-        auto& pos               = doc.m_position;
-        pos.m_nSelMode          = static_cast<Scintilla::SelectionMode>(settings.GetInt64(sessionSection(), CStringUtils::Format(L"selmode%d", fileNum).c_str(), 0));
-        pos.m_nStartPos         = static_cast<size_t>(settings.GetInt64(sessionSection(), CStringUtils::Format(L"startpos%d", fileNum).c_str(), 0));
-        pos.m_nEndPos           = static_cast<size_t>(settings.GetInt64(sessionSection(), CStringUtils::Format(L"endpos%d", fileNum).c_str(), 0));
-        pos.m_nScrollWidth      = static_cast<size_t>(settings.GetInt64(sessionSection(), CStringUtils::Format(L"scrollwidth%d", fileNum).c_str(), 0));
-        pos.m_xOffset           = static_cast<size_t>(settings.GetInt64(sessionSection(), CStringUtils::Format(L"xoffset%d", fileNum).c_str(), 0));
-        pos.m_nFirstVisibleLine = static_cast<size_t>(settings.GetInt64(sessionSection(), CStringUtils::Format(L"firstvisible%d", fileNum).c_str(), 0));
-        pos.m_nWrapLineOffset   = static_cast<size_t>(settings.GetInt64(sessionSection(), CStringUtils::Format(L"wraplineoffset%d", fileNum).c_str(), 0));
-        pos.m_lastStyleLine     = static_cast<size_t>(settings.GetInt64(sessionSection(), CStringUtils::Format(L"laststyleline%d", fileNum).c_str(), 0));
-        doc.m_tabSpace          = static_cast<TabSpace>(settings.GetInt64(sessionSection(), CStringUtils::Format(L"tabspace%d", fileNum).c_str(), 0));
-        doc.m_readDir           = static_cast<Scintilla::Bidirectional>(settings.GetInt64(sessionSection(), CStringUtils::Format(L"readdir%d", fileNum).c_str(), 0));
-        doc.m_wrapMode          = static_cast<Scintilla::Wrap>(settings.GetInt64(sessionSection(), CStringUtils::Format(L"wrapmode%d", fileNum).c_str(), -1));
-        if (static_cast<int>(*doc.m_wrapMode) < 0)
-            doc.m_wrapMode = std::nullopt;
-        auto folds = settings.GetString(sessionSection(), CStringUtils::Format(L"foldlines%d", fileNum).c_str(), nullptr);
-        pos.m_lineStateVector.clear();
-        if (folds)
-        {
-            stringtok(pos.m_lineStateVector, folds, true, L";", false);
-        }
-        auto numUndoActions = static_cast<int>(settings.GetInt64(sessionSection(), CStringUtils::Format(L"undonumactions%d", fileNum).c_str(), 0));
-        if (numUndoActions)
-        {
-            CUndoData undoData;
-            undoData.m_currentAction = static_cast<int>(settings.GetInt64(sessionSection(), CStringUtils::Format(L"undocurrentaction%d", fileNum).c_str(), 0));
-            undoData.m_savePoint     = static_cast<int>(settings.GetInt64(sessionSection(), CStringUtils::Format(L"undosavepoint%d", fileNum).c_str(), 0));
-            undoData.m_tentative     = static_cast<int>(settings.GetInt64(sessionSection(), CStringUtils::Format(L"undotentative%d", fileNum).c_str(), 0));
-            for (int undoIdx = 0; undoIdx < numUndoActions; ++undoIdx)
-            {
-                CUndoAction action;
-                action.m_type     = static_cast<int>(settings.GetInt64(sessionSection(), CStringUtils::Format(L"undoactiontype%d_%d", fileNum, undoIdx).c_str(), 0));
-                action.m_position = static_cast<int>(settings.GetInt64(sessionSection(), CStringUtils::Format(L"undoactionposition%d_%d", fileNum, undoIdx).c_str(), 0));
-                action.m_text     = CStringUtils::base64_decode(CUnicodeUtils::StdGetUTF8(settings.GetString(sessionSection(), CStringUtils::Format(L"undoactiontext%d_%d", fileNum, undoIdx).c_str(), L"")));
-                undoData.m_actions.push_back(action);
-            }
-
-            pos.m_undoData = undoData;
-        }
-        if (origPath)
+        auto& doc      = GetModDocumentFromID(docId);
+        doc.m_position = std::move(tab.position);
+        doc.m_tabSpace = tab.tabSpace;
+        doc.m_readDir  = tab.readDir;
+        doc.m_wrapMode = tab.wrapMode;
+        if (modified)
         {
             filesToDelete.push_back(doc.m_path);
-            doc.m_path         = origPath;
+            doc.m_path         = tab.origPath;
             doc.m_bIsDirty     = true;
             doc.m_bNeedsSaving = true;
-            auto origTitle     = settings.GetString(sessionSection(), CStringUtils::Format(L"origtitle%d", fileNum).c_str(), nullptr);
-            SetTitleForDocID(docId, origTitle);
+            SetTitleForDocID(docId, tab.origTitle.c_str());
             UpdateFileTime(doc, true);
             UpdateTab(GetTabIndexFromDocID(docId));
-            settings.Delete(sessionSection(), CStringUtils::Format(L"origpath%d", fileNum).c_str());
-            settings.SetString(sessionSection(), CStringUtils::Format(L"path%d", fileNum).c_str(), doc.m_path.c_str());
         }
 
-        if (static_cast<int>(settings.GetInt64(sessionSection(), CStringUtils::Format(L"activetab%d", fileNum).c_str(), 0)))
+        if (tab.active)
             activeDoc = docId;
-        RestoreCurrentPos(doc.m_position);
-        doc.m_position.m_undoData = {};
+        lastDoc = docId;
+        // placeholders restore the position when they're activated
+        if (!doc.m_bLoadPending)
+        {
+            RestoreCurrentPos(doc.m_position);
+            doc.m_position.m_undoData = {};
+        }
     }
+    if (!activeDoc.IsValid())
+        activeDoc = lastDoc;
     if (activeDoc.IsValid())
     {
         int activeTabIndex = GetTabIndexFromDocID(activeDoc);
@@ -350,10 +359,6 @@ void CCmdSessionLoad::RestoreSavedSession() const
         if (!path.empty())
             DeleteFile(path.c_str());
     }
-    if (!filesToDelete.empty())
-    {
-        settings.Save();
-    }
 }
 
 CCmdSessionAutoLoad::CCmdSessionAutoLoad(void* obj)
@@ -446,14 +451,11 @@ void CCmdSessionRestoreLast::OnDocumentClose(DocID id)
 
     auto activeTabIndex = GetActiveTabIndex();
     auto index          = GetTabIndexFromDocID(id);
+    CPosData pos;
     if (index == activeTabIndex)
-    {
-        CPosData pos;
         SaveCurrentPos(pos);
-        m_docStates.emplace_back(doc.m_path, pos);
-    }
     else
-    {
-        m_docStates.emplace_back(doc.m_path, doc.m_position);
-    }
+        pos = doc.m_position;
+    pos.m_undoData = GetUndoData(id);
+    m_docStates.emplace_back(doc.m_path, pos);
 }
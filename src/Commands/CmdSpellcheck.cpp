@@ -26,11 +26,15 @@
 #include "SciLexer.h"
 #include "ScintillaWnd.h"
 #include "StringUtils.h"
+#include "Theme.h"
 #include "UnicodeUtils.h"
 #include "../ext/scintilla/include/ScintillaStructures.h"
 
 #include <Richedit.h>
 #include <spellcheck.h>
+#include <list>
+#include <unordered_map>
+#include <string_view>
 
 extern IUIFramework* g_pFramework;
 extern UINT32        g_contextID;
@@ -40,23 +44,341 @@ namespace
 ISpellCheckerFactoryPtr   g_spellCheckerFactory = nullptr;
 ISpellCheckerPtr          g_spellChecker        = nullptr;
 std::vector<std::wstring> g_languages;
-UINT                      g_checkTimer = 0;
+std::vector<std::wstring> g_ignoredWords;
+UINT                      g_checkTimer  = 0;
+UINT                      g_resultTimer = 0;
+UINT                      g_markerTimer = 0;
 std::string               g_wordChars;
-std::string               g_sentenceChars;
+
+// the text is passed to the worker in chunks of about this size,
+// so taking a snapshot never blocks the UI noticeably
+constexpr sptr_t          CHECK_CHUNK_SIZE       = 32 * 1024;
+constexpr size_t          MAX_CACHED_WORD_LENGTH = 256;
+// in milliseconds
+constexpr ULONGLONG       CHECK_DELAY            = 500;  ///< after an edit before the visible lines are checked
+constexpr ULONGLONG       BACKGROUND_PAUSE       = 2000; ///< after an edit before the background pass continues
+constexpr UINT            BACKGROUND_DELAY       = 50;   ///< between two chunks of the background pass
+constexpr UINT            MARKER_DELAY           = 500;
+
+bool IsWordChar(char c)
+{
+    auto ch = static_cast<unsigned char>(c);
+    return ch >= 0x80 || isalnum(ch) || ch == '_' || ch == '\'';
+}
+
+bool IsSentenceChar(char c)
+{
+    if (IsWordChar(c))
+        return true;
+    switch (c)
+    {
+        case ' ':
+        case ',':
+        case ';':
+        case '"':
+        case '%':
+        case '&':
+        case '/':
+        case '(':
+        case ')':
+        case '\r':
+        case '\n':
+            return true;
+        default:
+            return false;
+    }
+}
+
+// The dictionary results of the recently checked words. Most words appear
+// many times in a document, and a dictionary lookup is a lot slower than
+// a hash lookup. The positions of the errors are relative to the word.
+class CWordCache
+{
+public:
+    const std::vector<SpellCheckError>* Find(std::string_view word)
+    {
+        auto found = m_index.find(word);
+        if (found == m_index.end())
+            return nullptr;
+        m_entries.splice(m_entries.begin(), m_entries, found->second);
+        return &found->second->second;
+    }
+
+    const std::vector<SpellCheckError>& Insert(std::string_view word, std::vector<SpellCheckError>&& errors)
+    {
+        m_entries.emplace_front(std::string(word), std::move(errors));
+        m_index[m_entries.front().first] = m_entries.begin();
+        if (m_entries.size() > maxEntries)
+        {
+            m_index.erase(m_entries.back().first);
+            m_entries.pop_back();
+        }
+        return m_entries.front().second;
+    }
+
+    void Clear()
+    {
+        m_index.clear();
+        m_entries.clear();
+    }
+
+private:
+    static constexpr size_t                                             maxEntries = 20000;
+    std::list<std::pair<std::string, std::vector<SpellCheckError>>>     m_entries; ///< most recently used first
+    std::unordered_map<std::string_view, decltype(m_entries)::iterator> m_index;
+};
+
+std::vector<SpellCheckError> CheckWord(ISpellChecker* checker, std::string_view word, bool comprehensive)
+{
+    std::vector<SpellCheckError> errors;
+    auto                         sWord             = CUnicodeUtils::StdGetUnicode(std::string(word));
+    IEnumSpellingErrorPtr        enumSpellingError = nullptr;
+    HRESULT                      hr                = S_FALSE;
+    if (comprehensive)
+        hr = checker->ComprehensiveCheck(sWord.c_str(), &enumSpellingError);
+    else
+        hr = checker->Check(sWord.c_str(), &enumSpellingError);
+    if (FAILED(hr))
+        return errors;
+
+    ISpellingErrorPtr spellingError = nullptr;
+    while (enumSpellingError->Next(&spellingError) == S_OK)
+    {
+        CORRECTIVE_ACTION action = CORRECTIVE_ACTION_NONE;
+        spellingError->get_CorrectiveAction(&action);
+        if (action == CORRECTIVE_ACTION_NONE)
+            continue;
+        ULONG errStart = 0;
+        ULONG errLen   = 0;
+        spellingError->get_StartIndex(&errStart);
+        spellingError->get_Length(&errLen);
+        if (errStart > sWord.size())
+            continue;
+        // the checker reports utf16 positions, the document is utf8
+        auto start  = CUnicodeUtils::StdGetUTF8(sWord.substr(0, errStart)).size();
+        auto length = CUnicodeUtils::StdGetUTF8(sWord.substr(errStart, errLen)).size();
+        errors.push_back({static_cast<sptr_t>(start), static_cast<sptr_t>(length), action == CORRECTIVE_ACTION_DELETE});
+    }
+    return errors;
+}
+
+// Splits the text of the job into words, or into sentences for plain text,
+// and adds the misspellings to errors. Returns false if the job was cancelled.
+bool CheckText(const SpellCheckJob& job, ISpellChecker* checker, CWordCache& cache, const std::atomic<unsigned>& generation, std::vector<SpellCheckError>& errors)
+{
+    const auto&                  text = job.text;
+    std::vector<SpellCheckError> uncached;
+    size_t                       url = 0;
+    size_t                       pos = 0;
+    while (pos < text.size())
+    {
+        if (generation != job.generation)
+            return false;
+        if (!IsWordChar(text[pos]))
+        {
+            ++pos;
+            continue;
+        }
+        // urls are not checked
+        while (url < job.urls.size() && job.urls[url].second <= pos)
+            ++url;
+        if (url < job.urls.size() && job.urls[url].first <= pos)
+        {
+            pos = job.urls[url].second;
+            continue;
+        }
+
+        size_t start = pos;
+        if (job.comprehensive)
+        {
+            while (pos < text.size() && IsSentenceChar(text[pos]))
+                ++pos;
+        }
+        else
+        {
+            while (pos < text.size() && IsWordChar(text[pos]))
+                ++pos;
+        }
+        size_t end = pos;
+        while (end > start && !IsWordChar(text[end - 1]))
+            --end;
+
+        // only check text, doc and comment styles unless all text is checked
+        if (!job.styles.empty() && !job.textStyles[static_cast<unsigned char>(job.styles[start])])
+            continue;
+
+        std::string_view word(text.data() + start, end - start);
+        const auto*      wordErrors = cache.Find(word);
+        if (!wordErrors)
+        {
+            auto checked = CheckWord(checker, word, job.comprehensive);
+            if (word.size() <= MAX_CACHED_WORD_LENGTH)
+                wordErrors = &cache.Insert(word, std::move(checked));
+            else
+            {
+                uncached   = std::move(checked);
+                wordErrors = &uncached;
+            }
+        }
+
+        for (const auto& error : *wordErrors)
+        {
+            if (error.pos > static_cast<sptr_t>(word.size()))
+                continue;
+            auto errorText = std::string(word.substr(error.pos, error.length));
+            auto sWord     = CUnicodeUtils::StdGetUnicode(errorText);
+            // ignore words that contain numbers/digits
+            if (sWord.empty() || std::ranges::any_of(sWord, ::iswdigit))
+                continue;
+            // ignore words that contain uppercase letters in the middle
+            if (!job.checkUppercase && std::any_of(sWord.begin() + 1, sWord.end(), ::iswupper))
+                continue;
+            // ignore keywords of the currently selected lexer
+            if (job.keywords && job.keywords->contains(errorText))
+                continue;
+            errors.push_back({job.offset + static_cast<sptr_t>(start) + error.pos, error.length, error.del});
+        }
+    }
+    return true;
+}
+
+// Finds the first misspelling which starts at or after pos.
+bool NextMisspelling(Scintilla::ScintillaCall& sci, sptr_t pos, sptr_t& start, sptr_t& end)
+{
+    bool found  = false;
+    auto length = sci.Length();
+    for (int indicator : {INDIC_MISSPELLED, INDIC_MISSPELLED_DEL})
+    {
+        for (auto p = pos; p < length;)
+        {
+            auto runEnd = sci.IndicatorEnd(indicator, p);
+            if (sci.IndicatorValueAt(indicator, p) && sci.IndicatorStart(indicator, p) >= pos)
+            {
+                if (!found || p < start)
+                {
+                    start = p;
+                    end   = runEnd;
+                    found = true;
+                }
+                break;
+            }
+            if (runEnd <= p)
+                break;
+            p = runEnd;
+        }
+    }
+    return found;
+}
+
+// Finds the last misspelling which starts before pos.
+bool PrevMisspelling(Scintilla::ScintillaCall& sci, sptr_t pos, sptr_t& start, sptr_t& end)
+{
+    bool found = false;
+    for (int indicator : {INDIC_MISSPELLED, INDIC_MISSPELLED_DEL})
+    {
+        for (auto p = pos; p > 0;)
+        {
+            auto runStart = sci.IndicatorStart(indicator, p - 1);
+            if (sci.IndicatorValueAt(indicator, p - 1))
+            {
+                if (!found || runStart > start)
+                {
+                    start = runStart;
+                    end   = sci.IndicatorEnd(indicator, p - 1);
+                    found = true;
+                }
+                break;
+            }
+            if (runStart >= p)
+                break;
+            p = runStart;
+        }
+    }
+    return found;
+}
 } // namespace
 
+void CCheckedLines::Add(sptr_t firstLine, sptr_t endLine)
+{
+    if (firstLine >= endLine)
+        return;
+    // the ranges which overlap or touch the new one are merged into it
+    auto first = std::ranges::lower_bound(m_ranges, firstLine, {}, [](const auto& range) { return range.second; });
+    auto last  = first;
+    while (last != m_ranges.end() && last->first <= endLine)
+    {
+        firstLine = min(firstLine, last->first);
+        endLine   = max(endLine, last->second);
+        ++last;
+    }
+    first = m_ranges.erase(first, last);
+    m_ranges.emplace(first, firstLine, endLine);
+}
+
+void CCheckedLines::Modified(sptr_t line, sptr_t linesAdded)
+{
+    // the old lines from line up to removedEnd are the edited line now,
+    // or the edited line and the inserted lines
+    auto                                   removedEnd = linesAdded < 0 ? line - linesAdded + 1 : line + 1;
+    std::vector<std::pair<sptr_t, sptr_t>> ranges;
+    ranges.reserve(m_ranges.size() + 1);
+    for (const auto& [first, end] : m_ranges)
+    {
+        if (first < line)
+            ranges.emplace_back(first, min(end, line));
+        if (end > removedEnd)
+        {
+            auto shiftedFirst = max(first, removedEnd) + linesAdded;
+            if (!ranges.empty() && ranges.back().second >= shiftedFirst)
+                ranges.back().second = end + linesAdded;
+            else
+                ranges.emplace_back(shiftedFirst, end + linesAdded);
+        }
+    }
+    m_ranges = std::move(ranges);
+}
+
+bool CCheckedLines::NextUnchecked(sptr_t firstLine, sptr_t endLine, sptr_t& uncheckedFirst, sptr_t& uncheckedEnd) const
+{
+    for (const auto& [first, end] : m_ranges)
+    {
+        if (end <= firstLine)
+            continue;
+        if (first > firstLine)
+        {
+            endLine = min(first, endLine);
+            break;
+        }
+        firstLine = end;
+    }
+    uncheckedFirst = firstLine;
+    uncheckedEnd   = endLine;
+    return firstLine < endLine;
+}
+
 CCmdSpellCheck::CCmdSpellCheck(void* obj)
     : ICommand(obj)
     , m_enabled(true)
     , m_activeLexer(-1)
     , m_useComprehensiveCheck(false)
-    , m_textBufLen(0)
-    , m_lastCheckedPos(0)
+    , m_checkAll(true)
+    , m_checkUppercase(true)
+    , m_ignoredSent(0)
+    , m_lastEdit(0)
+    , m_markersPending(false)
+    , m_jobInFlight(false)
+    , m_jobFirstLine(0)
+    , m_jobEndLine(0)
+    , m_jobVisible(false)
+    , m_generation(0)
+    , m_runThread(true)
 {
-    m_enabled    = CIniSettings::Instance().GetInt64(L"spellcheck", L"enabled", 1) != 0;
-    g_checkTimer = GetTimerID();
+    m_enabled     = CIniSettings::Instance().GetInt64(L"spellcheck", L"enabled", 1) != 0;
+    g_checkTimer  = GetTimerID();
+    g_resultTimer = GetTimerID();
+    g_markerTimer = GetTimerID();
     // try to create the spell checker factory
-    HRESULT hr   = CoCreateInstance(__uuidof(SpellCheckerFactory), nullptr, CLSCTX_INPROC_SERVER, IID_PPV_ARGS(&g_spellCheckerFactory));
+    HRESULT hr    = CoCreateInstance(__uuidof(SpellCheckerFactory), nullptr, CLSCTX_INPROC_SERVER, IID_PPV_ARGS(&g_spellCheckerFactory));
     if (SUCCEEDED(hr))
     {
         // get all available languages
@@ -91,8 +413,7 @@ CCmdSpellCheck::CCmdSpellCheck(void* obj)
             g_spellChecker = nullptr;
             hr             = g_spellCheckerFactory->CreateSpellChecker(m_lang.c_str(), &g_spellChecker);
         }
-        m_textBufLen = 1024;
-        m_textBuffer = std::make_unique<char[]>(m_textBufLen);
+        m_thread = std::thread(&CCmdSpellCheck::ThreadFunc, this);
     }
     else
     {
@@ -101,25 +422,11 @@ CCmdSpellCheck::CCmdSpellCheck(void* obj)
 
     // create a string with all the word chars
     g_wordChars.clear();
-    g_sentenceChars.clear();
-    for (int ch = 0; ch < 256; ++ch)
+    for (int ch = 1; ch < 256; ++ch)
     {
-        if (ch >= 0x80 || isalnum(ch) || ch == '_' || ch == '\'')
+        if (IsWordChar(static_cast<char>(ch)))
             g_wordChars += static_cast<char>(ch);
     }
-    g_sentenceChars = g_wordChars;
-    g_sentenceChars += ' ';
-    g_sentenceChars += ',';
-    g_sentenceChars += ';';
-    g_sentenceChars += '"';
-    g_sentenceChars += '\'';
-    g_sentenceChars += '%';
-    g_sentenceChars += '&';
-    g_sentenceChars += '/';
-    g_sentenceChars += '(';
-    g_sentenceChars += ')';
-    g_sentenceChars += '\r';
-    g_sentenceChars += '\n';
 
     g_contextID = m_enabled && g_spellChecker ? cmdContextSpellMap : cmdContextMap;
 
@@ -128,6 +435,7 @@ CCmdSpellCheck::CCmdSpellCheck(void* obj)
 
 inline CCmdSpellCheck::~CCmdSpellCheck()
 {
+    OnClose();
     g_spellChecker        = nullptr;
     g_spellCheckerFactory = nullptr;
 }
@@ -138,270 +446,355 @@ void CCmdSpellCheck::ScintillaNotify(SCNotification* pScn)
     {
         case SCN_UPDATEUI:
             if (m_enabled && (pScn->updated & (SC_UPDATE_V_SCROLL | SC_UPDATE_H_SCROLL)) != 0)
-            {
-                m_lastCheckedPos = 0;
                 SetTimer(GetHwnd(), g_checkTimer, 500, nullptr);
-            }
             break;
         case SCN_MODIFIED:
             if (m_enabled && (pScn->modificationType & (SC_MOD_DELETETEXT | SC_MOD_INSERTTEXT)) != 0)
             {
-                m_lastCheckedPos = 0;
-                SetTimer(GetHwnd(), g_checkTimer, 500, nullptr);
+                // the positions of a running job are wrong now, and
+                // the edited lines have to be checked again
+                ++m_generation;
+                m_lastEdit = GetTickCount64();
+                m_checkedLines[GetDocIdOfCurrentTab()].Modified(Scintilla().LineFromPosition(pScn->position), pScn->linesAdded);
+                SetTimer(GetHwnd(), g_checkTimer, static_cast<UINT>(CHECK_DELAY), nullptr);
+                if (pScn->linesAdded && !m_markersPending)
+                {
+                    m_markersPending = true;
+                    SetTimer(GetHwnd(), g_markerTimer, MARKER_DELAY, nullptr);
+                }
             }
             break;
     }
 }
 
+void CCmdSpellCheck::TabNotify(TBHDR* ptbHdr)
+{
+    if (ptbHdr->hdr.code == TCN_RELOAD)
+        OnDocumentTextChanged(GetDocIDFromTabIndex(ptbHdr->tabOrigin));
+    else if (m_enabled && ptbHdr->hdr.code == TCN_SELCHANGE)
+    {
+        ++m_generation;
+        SetTimer(GetHwnd(), g_checkTimer, 500, nullptr);
+        UpdateScrollMarkers();
+    }
+}
+
+void CCmdSpellCheck::OnDocumentTextChanged(DocID id)
+{
+    // the text changed without going through the editor
+    ++m_generation;
+    m_checkedLines.erase(id);
+    if (m_enabled)
+        SetTimer(GetHwnd(), g_checkTimer, 500, nullptr);
+}
+
+void CCmdSpellCheck::OnLangChanged()
+{
+    // the lines were checked for the styles of the previous lexer
+    ++m_generation;
+    m_checkedLines.erase(GetDocIdOfCurrentTab());
+    SetTimer(GetHwnd(), g_checkTimer, 500, nullptr);
+}
+
+void CCmdSpellCheck::OnDocumentOpen(DocID id)
+{
+    m_checkedLines.erase(id);
+}
+
+void CCmdSpellCheck::OnDocumentClose(DocID id)
+{
+    m_checkedLines.erase(id);
+}
+
+// Checks the lines which are not checked yet: see SendNextJob and ApplyResults.
 void CCmdSpellCheck::Check()
 {
-    if (m_enabled && g_spellChecker)
+    if (!m_enabled || !g_spellChecker)
+        return;
+
+    // determine the spelling options for the current lexer and settings
+    bool checkAll       = CIniSettings::Instance().GetInt64(L"spellcheck", L"checkall", 1) != 0;
+    bool checkUppercase = CIniSettings::Instance().GetInt64(L"spellcheck", L"uppercase", 1) != 0;
+    auto lang           = CIniSettings::Instance().GetString(L"spellcheck", L"language", L"en-US");
+    if (checkAll != m_checkAll || checkUppercase != m_checkUppercase || lang != m_lang)
     {
-#ifdef _DEBUG
-        ProfileTimer timer(L"SpellCheck");
-#endif
-        // determine the spelling options for the current lexer and settings
-        bool checkAll       = CIniSettings::Instance().GetInt64(L"spellcheck", L"checkall", 1) != 0;
-        bool checkUppercase = CIniSettings::Instance().GetInt64(L"spellcheck", L"uppercase", 1) != 0;
-        if (m_activeLexer != static_cast<int>(Scintilla().Lexer()))
-        {
-            m_activeLexer = static_cast<int>(Scintilla().Lexer());
-            m_lexerData   = CLexStyles::Instance().GetLexerDataForLexer(m_activeLexer);
-            m_keywords.clear();
-            const auto& keywords = CLexStyles::Instance().GetKeywordsForLexer(m_activeLexer);
-            for (const auto& [type, words] : keywords)
-            {
-                stringtokset(m_keywords, words, true, " ", true);
-            }
-            m_lastCheckedPos        = 0;
-            m_useComprehensiveCheck = (m_activeLexer == SCLEX_NULL || m_activeLexer == SCLEX_INDENT);
+        m_checkAll       = checkAll;
+        m_checkUppercase = checkUppercase;
+        m_lang           = lang;
+        InvalidateAll();
+    }
+    if (m_activeLexer != static_cast<int>(Scintilla().Lexer()))
+    {
+        m_activeLexer          = static_cast<int>(Scintilla().Lexer());
+        auto        keywords   = std::make_shared<std::set<std::string>>();
+        const auto& lexerWords = CLexStyles::Instance().GetKeywordsForLexer(m_activeLexer);
+        for (const auto& [type, words] : lexerWords)
+        {
+            stringtokset(*keywords, words, true, " ", true);
         }
+        m_keywords = std::move(keywords);
 
-        auto wordCharsBuffer = GetWordChars();
-        OnOutOfScope(Scintilla().SetWordChars(wordCharsBuffer.c_str()));
-
-        if (m_useComprehensiveCheck)
-            Scintilla().SetWordChars(g_sentenceChars.c_str());
-        else
-            Scintilla().SetWordChars(g_wordChars.c_str());
-        // start at the first visible line and check all visible lines
-        Scintilla::TextRangeFull textRange{};
-        auto                     firstLine = Scintilla().FirstVisibleLine();
-        auto                     lastLine  = firstLine + Scintilla().LinesOnScreen();
-        auto                     firstPos  = static_cast<Sci_Position>(Scintilla().PositionFromLine(firstLine));
-        textRange.chrg.cpMin               = firstPos;
-        textRange.chrg.cpMax               = textRange.chrg.cpMin;
-        auto lastPos                       = Scintilla().PositionFromLine(lastLine) + Scintilla().LineLength(lastLine);
-        auto textLength                    = Scintilla().Length();
-        if (lastPos < 0)
-            lastPos = textLength - textRange.chrg.cpMin;
-        // if we already checked some text of the visible lines, start from there
-        if (m_lastCheckedPos)
-            textRange.chrg.cpMax = static_cast<Sci_Position>(m_lastCheckedPos);
-        auto start = GetTickCount64();
-        while (textRange.chrg.cpMax < lastPos)
-        {
-            if (GetTickCount64() - start > 100)
-            {
-                // to avoid a blocked UI, only check for 100ms and then continue later
-                m_lastCheckedPos = textRange.chrg.cpMax;
-                if (g_checkTimer)
-                    SetTimer(GetHwnd(), g_checkTimer, 10, nullptr);
+        // the styles which contain text, doc or comments
+        m_textStyles.set();
+        switch (m_activeLexer)
+        {
+            case SCLEX_NULL:   // text
+            case SCLEX_INDENT: // text
                 break;
-            }
-            // split the whole text either into words or if m_useComprehensiveCheck is true into sentences
-            Scintilla().SetWordChars(g_wordChars.c_str());
-            // skip over whitespace
-            while (textRange.chrg.cpMax < lastPos)
-            {
-                auto c = Scintilla().CharacterAt(textRange.chrg.cpMax);
-                if (c > 0x20)
-                    break;
-                textRange.chrg.cpMax++;
-            }
-            // don't start in the middle of a word but at the beginning
-            textRange.chrg.cpMin = static_cast<Sci_Position>(Scintilla().WordStartPosition(textRange.chrg.cpMax + 1, TRUE));
-            if (textRange.chrg.cpMin < textRange.chrg.cpMax && textRange.chrg.cpMin >= firstPos)
-            {
-                // word start is before the visible text, so we skip it
-                auto wordEnd = static_cast<Sci_Position>(Scintilla().WordEndPosition(textRange.chrg.cpMax, TRUE));
-                if (wordEnd <= textRange.chrg.cpMax)
-                {
-                    DebugBreak();
-                    break;
-                }
-                textRange.chrg.cpMax = wordEnd;
-                continue;
-            }
-            if (m_useComprehensiveCheck)
-                Scintilla().SetWordChars(g_sentenceChars.c_str());
-            textRange.chrg.cpMax = static_cast<Sci_Position>(Scintilla().WordEndPosition(textRange.chrg.cpMin, TRUE));
-            if (textRange.chrg.cpMax > lastPos)
-            {
-                Scintilla().SetWordChars(g_wordChars.c_str());
-                textRange.chrg.cpMax = static_cast<Sci_Position>(Scintilla().WordEndPosition(textRange.chrg.cpMin, TRUE));
-            }
-            if (textRange.chrg.cpMin == textRange.chrg.cpMax)
-            {
-                textRange.chrg.cpMax++;
-                // since Scintilla squiggles to the end of the text even if told to stop one char before it,
-                // we have to clear here the squiggly lines to the end.
-                if (textRange.chrg.cpMin)
-                {
-                    Scintilla().SetIndicatorCurrent(INDIC_MISSPELLED);
-                    Scintilla().IndicatorClearRange(textRange.chrg.cpMin - 1, textRange.chrg.cpMax - textRange.chrg.cpMin + 1);
-                }
-                continue;
-            }
-            while (textRange.chrg.cpMin < lastPos &&
-                   textRange.chrg.cpMax > textRange.chrg.cpMin &&
-                   Scintilla().IndicatorValueAt(INDIC_URLHOTSPOT, textRange.chrg.cpMin))
-                ++textRange.chrg.cpMin;
-
-            int style = Scintilla().StyleAt(textRange.chrg.cpMin);
-            // check if the word is text, doc or comment
-            if (!checkAll)
-            {
-                bool isText = true;
-                switch (m_activeLexer)
+            case SCLEX_MARKDOWN:
+                m_textStyles.reset(SCE_MARKDOWN_LINK);
+                m_textStyles.reset(SCE_MARKDOWN_CODE);
+                m_textStyles.reset(SCE_MARKDOWN_CODE2);
+                m_textStyles.reset(SCE_MARKDOWN_CODEBK);
+                break;
+            default:
+                for (const auto& [style, styleData] : CLexStyles::Instance().GetLexerDataForLexer(m_activeLexer).styles)
                 {
-                    case SCLEX_NULL:   // text
-                    case SCLEX_INDENT: // text
-                        break;
-                    case SCLEX_MARKDOWN:
-                        switch (style)
-                        {
-                            case SCE_MARKDOWN_LINK:
-                            case SCE_MARKDOWN_CODE:
-                            case SCE_MARKDOWN_CODE2:
-                            case SCE_MARKDOWN_CODEBK:
-                                // mark word as correct (remove the squiggle line)
-                                Scintilla().SetIndicatorCurrent(INDIC_MISSPELLED);
-                                Scintilla().IndicatorClearRange(textRange.chrg.cpMin, textRange.chrg.cpMax - textRange.chrg.cpMin);
-                                Scintilla().IndicatorClearRange(textRange.chrg.cpMin, textRange.chrg.cpMax - textRange.chrg.cpMin + 1);
-                                Scintilla().SetIndicatorCurrent(INDIC_MISSPELLED_DEL);
-                                Scintilla().IndicatorClearRange(textRange.chrg.cpMin, textRange.chrg.cpMax - textRange.chrg.cpMin);
-                                Scintilla().IndicatorClearRange(textRange.chrg.cpMin, textRange.chrg.cpMax - textRange.chrg.cpMin + 1);
-                                continue;
-                        }
-                        break;
-                    default:
-                        if (style < static_cast<int>(m_lexerData.styles.size()))
-                        {
-                            const auto& sStyle = m_lexerData.styles[style].name;
-                            if ((sStyle.find(L"DOC") == std::wstring::npos) &&
-                                (sStyle.find(L"COMMENT") == std::wstring::npos) &&
-                                (sStyle.find(L"STRING") == std::wstring::npos) &&
-                                (sStyle.find(L"TEXT") == std::wstring::npos))
-                                isText = false;
-                        }
-                        if (!isText)
-                        {
-                            // mark word as correct (remove the squiggle line)
-                            Scintilla().SetIndicatorCurrent(INDIC_MISSPELLED);
-                            Scintilla().IndicatorClearRange(textRange.chrg.cpMin, textRange.chrg.cpMax - textRange.chrg.cpMin);
-                            Scintilla().IndicatorClearRange(textRange.chrg.cpMin, textRange.chrg.cpMax - textRange.chrg.cpMin + 1);
-                            Scintilla().SetIndicatorCurrent(INDIC_MISSPELLED_DEL);
-                            Scintilla().IndicatorClearRange(textRange.chrg.cpMin, textRange.chrg.cpMax - textRange.chrg.cpMin);
-                            Scintilla().IndicatorClearRange(textRange.chrg.cpMin, textRange.chrg.cpMax - textRange.chrg.cpMin + 1);
-                            continue;
-                        }
+                    const auto& sStyle = styleData.name;
+                    if (style >= 0 && style < static_cast<int>(m_textStyles.size()) &&
+                        (sStyle.find(L"DOC") == std::wstring::npos) &&
+                        (sStyle.find(L"COMMENT") == std::wstring::npos) &&
+                        (sStyle.find(L"STRING") == std::wstring::npos) &&
+                        (sStyle.find(L"TEXT") == std::wstring::npos))
+                        m_textStyles.reset(style);
                 }
-            }
-            assert(textRange.chrg.cpMax >= textRange.chrg.cpMin);
-            if (m_textBufLen < (textRange.chrg.cpMax - textRange.chrg.cpMin + 2))
-            {
-                m_textBufLen = textRange.chrg.cpMax - textRange.chrg.cpMin + 1024;
-                m_textBuffer = std::make_unique<char[]>(m_textBufLen);
-            }
-            textRange.lpstrText = m_textBuffer.get();
-            if (textRange.chrg.cpMax < textLength)
-            {
-                textRange.chrg.cpMax++;
-                Scintilla().GetTextRangeFull(&textRange);
-            }
-            else
-            {
-                Scintilla().GetTextRangeFull(&textRange);
-                textRange.chrg.cpMax++;
-            }
-            auto len = strlen(textRange.lpstrText);
-            if (len == 0)
+                break;
+        }
+        m_useComprehensiveCheck = (m_activeLexer == SCLEX_NULL || m_activeLexer == SCLEX_INDENT);
+    }
+    SendNextJob();
+}
+
+// Takes a snapshot of the next lines to check and passes it to the worker:
+// the visible lines first, then the rest of the document in the background.
+void CCmdSpellCheck::SendNextJob()
+{
+    if (m_jobInFlight || !m_enabled || !g_spellChecker)
+        return;
+
+    auto        docID        = GetDocIdOfCurrentTab();
+    const auto& checkedLines = m_checkedLines[docID];
+    auto        lineCount    = Scintilla().LineCount();
+    auto        firstVisible = Scintilla().DocLineFromVisible(Scintilla().FirstVisibleLine());
+    auto        lastVisible  = Scintilla().DocLineFromVisible(Scintilla().FirstVisibleLine() + Scintilla().LinesOnScreen());
+    auto        endVisible   = min(lastVisible + 1, lineCount);
+    sptr_t      firstLine    = 0;
+    sptr_t      endLine      = 0;
+    bool        visible      = checkedLines.NextUnchecked(firstVisible, endVisible, firstLine, endLine);
+    if (!visible &&
+        !checkedLines.NextUnchecked(endVisible, lineCount, firstLine, endLine) &&
+        !checkedLines.NextUnchecked(0, firstVisible, firstLine, endLine))
+        return; // the whole document is checked
+
+    // don't check the words the user is still typing, and
+    // pause the background pass while the user is typing
+    auto idle  = GetTickCount64() - m_lastEdit;
+    auto pause = visible ? CHECK_DELAY : BACKGROUND_PAUSE;
+    if (idle < pause)
+    {
+        SetTimer(GetHwnd(), g_checkTimer, static_cast<UINT>(pause - idle), nullptr);
+        return;
+    }
+
+    // whole lines of about CHECK_CHUNK_SIZE, so no word is split
+    auto start     = Scintilla().PositionFromLine(firstLine);
+    auto chunkLine = Scintilla().LineFromPosition(start + CHECK_CHUNK_SIZE);
+    endLine        = max(firstLine + 1, min(endLine, chunkLine));
+    auto chunkEnd  = endLine < lineCount ? Scintilla().PositionFromLine(endLine) : Scintilla().Length();
+
+    auto          length = chunkEnd - start;
+    SpellCheckJob job;
+    job.generation     = m_generation;
+    job.document       = Scintilla().DocPointer();
+    job.offset         = start;
+    job.text.assign(static_cast<const char*>(Scintilla().RangePointer(start, length)), length);
+    job.textStyles     = m_textStyles;
+    job.keywords       = m_keywords;
+    job.language       = m_lang;
+    job.comprehensive  = m_useComprehensiveCheck;
+    job.checkUppercase = m_checkUppercase;
+    if (!m_checkAll && !m_textStyles.all())
+    {
+        // the styles are needed to only check text, doc and comments
+        Scintilla().Colourise(start, chunkEnd);
+        std::string              styledText(2 * length + 2, '\0');
+        Scintilla::TextRangeFull textRange{};
+        textRange.chrg.cpMin = start;
+        textRange.chrg.cpMax = chunkEnd;
+        textRange.lpstrText  = styledText.data();
+        Scintilla().GetStyledTextFull(&textRange);
+        job.styles.resize(length);
+        for (sptr_t i = 0; i < length; ++i)
+            job.styles[i] = styledText[2 * i + 1];
+    }
+    for (auto pos = start; pos < chunkEnd;)
+    {
+        auto runEnd = Scintilla().IndicatorEnd(INDIC_URLHOTSPOT, pos);
+        if (runEnd <= pos)
+            break;
+        if (Scintilla().IndicatorValueAt(INDIC_URLHOTSPOT, pos))
+            job.urls.emplace_back(pos - start, min(runEnd, chunkEnd) - start);
+        pos = runEnd;
+    }
+    job.ignoredWords.assign(g_ignoredWords.begin() + m_ignoredSent, g_ignoredWords.end());
+    m_ignoredSent = g_ignoredWords.size();
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_job = std::move(job);
+    }
+    m_cv.notify_one();
+    m_jobInFlight  = true;
+    m_jobDoc       = docID;
+    m_jobFirstLine = firstLine;
+    m_jobEndLine   = endLine;
+    m_jobVisible   = visible;
+}
+
+// Marks the misspellings the worker found, then passes it the next lines.
+void CCmdSpellCheck::ApplyResults()
+{
+    std::vector<SpellCheckBatch> results;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        results.swap(m_results);
+    }
+    bool background = false;
+    for (const auto& batch : results)
+    {
+        m_jobInFlight = false;
+        if (batch.cancelled || batch.generation != m_generation || batch.document != Scintilla().DocPointer())
+            continue;
+        Scintilla().SetIndicatorCurrent(INDIC_MISSPELLED);
+        Scintilla().IndicatorClearRange(batch.start, batch.end - batch.start);
+        Scintilla().SetIndicatorCurrent(INDIC_MISSPELLED_DEL);
+        Scintilla().IndicatorClearRange(batch.start, batch.end - batch.start);
+        for (const auto& error : batch.errors)
+        {
+            Scintilla().SetIndicatorCurrent(error.del ? INDIC_MISSPELLED_DEL : INDIC_MISSPELLED);
+            Scintilla().IndicatorFillRange(error.pos, error.length);
+        }
+        m_checkedLines[m_jobDoc].Add(m_jobFirstLine, m_jobEndLine);
+        background = !m_jobVisible;
+        if (!m_markersPending)
+        {
+            m_markersPending = true;
+            SetTimer(GetHwnd(), g_markerTimer, MARKER_DELAY, nullptr);
+        }
+    }
+    // the background pass has low priority: give the UI some time between the chunks
+    if (background)
+        SetTimer(GetHwnd(), g_checkTimer, BACKGROUND_DELAY, nullptr);
+    else
+        SendNextJob();
+}
+
+// Shows the lines with misspellings in the scrollbar.
+void CCmdSpellCheck::UpdateScrollMarkers()
+{
+    m_markersPending = false;
+    DocScrollClear(DOCSCROLLTYPE_SPELLING);
+    if (m_enabled)
+    {
+        std::vector<size_t> lines;
+        auto                length = Scintilla().Length();
+        for (int indicator : {INDIC_MISSPELLED, INDIC_MISSPELLED_DEL})
+        {
+            for (sptr_t pos = 0; pos < length;)
             {
-                textRange.chrg.cpMax--;
-                Scintilla().GetTextRangeFull(&textRange);
-                len = strlen(textRange.lpstrText);
-                textRange.chrg.cpMax++;
-                len++;
+                if (Scintilla().IndicatorValueAt(indicator, pos))
+                    lines.push_back(Scintilla().LineFromPosition(pos));
+                auto runEnd = Scintilla().IndicatorEnd(indicator, pos);
+                if (runEnd <= pos)
+                    break;
+                pos = runEnd;
             }
-            if (len && textRange.lpstrText[len])
-                textRange.lpstrText[len - 1] = 0;
-            textRange.chrg.cpMax--;
-            if (textRange.lpstrText[0])
-            {
-                auto                  sWord             = CUnicodeUtils::StdGetUnicode(textRange.lpstrText);
+        }
+        DocScrollAddLineColors(DOCSCROLLTYPE_SPELLING, lines, CTheme::Instance().GetThemeColor(RGB(255, 0, 0), true));
+    }
+    DocScrollUpdate();
+}
 
-                IEnumSpellingErrorPtr enumSpellingError = nullptr;
-                HRESULT               hr                = S_FALSE;
-                if (m_useComprehensiveCheck)
-                    hr = g_spellChecker->ComprehensiveCheck(sWord.c_str(), &enumSpellingError);
-                else
-                    hr = g_spellChecker->Check(sWord.c_str(), &enumSpellingError);
+// The results of all documents are outdated, e.g. after a setting changed.
+void CCmdSpellCheck::InvalidateAll()
+{
+    ++m_generation;
+    m_checkedLines.clear();
+}
 
-                // first mark all text as correct (remove the squiggle lines)
-                Scintilla().SetIndicatorCurrent(INDIC_MISSPELLED);
-                Scintilla().IndicatorClearRange(textRange.chrg.cpMin, textRange.chrg.cpMax - textRange.chrg.cpMin);
-                Scintilla().IndicatorClearRange(textRange.chrg.cpMin, textRange.chrg.cpMax - textRange.chrg.cpMin + 1);
-                Scintilla().SetIndicatorCurrent(INDIC_MISSPELLED_DEL);
-                Scintilla().IndicatorClearRange(textRange.chrg.cpMin, textRange.chrg.cpMax - textRange.chrg.cpMin);
-                Scintilla().IndicatorClearRange(textRange.chrg.cpMin, textRange.chrg.cpMax - textRange.chrg.cpMin + 1);
+void CCmdSpellCheck::ClearIndicators()
+{
+    Scintilla().SetIndicatorCurrent(INDIC_MISSPELLED);
+    Scintilla().IndicatorClearRange(0, Scintilla().Length());
+    Scintilla().SetIndicatorCurrent(INDIC_MISSPELLED_DEL);
+    Scintilla().IndicatorClearRange(0, Scintilla().Length());
+}
 
-                if (SUCCEEDED(hr))
-                {
-                    ISpellingErrorPtr spellingError = nullptr;
-                    hr                              = enumSpellingError->Next(&spellingError);
-                    while (hr == S_OK)
-                    {
-                        CORRECTIVE_ACTION action = CORRECTIVE_ACTION_NONE;
-                        spellingError->get_CorrectiveAction(&action);
-                        if (action != CORRECTIVE_ACTION_NONE)
-                        {
-                            // mark text as misspelled
-                            ULONG errLen = 0;
-                            spellingError->get_Length(&errLen);
-                            ULONG errStart = 0;
-                            spellingError->get_StartIndex(&errStart);
-
-                            Scintilla::TextRangeFull wordRange{};
-                            wordRange.chrg.cpMin = textRange.chrg.cpMin + errStart;
-                            wordRange.chrg.cpMax = wordRange.chrg.cpMin + errLen;
-                            wordRange.lpstrText  = m_textBuffer.get();
-                            Scintilla().GetTextRangeFull(&wordRange);
-                            sWord       = CUnicodeUtils::StdGetUnicode(wordRange.lpstrText);
-
-                            bool ignore = false;
-                            // ignore words that contain numbers/digits
-                            if (std::ranges::any_of(sWord, ::iswdigit))
-                                ignore = true;
-                            // ignore words that contain uppercase letters in the middle
-                            if (!ignore && !checkUppercase && (std::any_of(sWord.begin() + 1, sWord.end(), ::iswupper)))
-                                ignore = true;
-
-                            // ignore keywords of the currently selected lexer
-                            if (!ignore && m_keywords.contains(textRange.lpstrText))
-                                ignore = true;
-
-                            if (!ignore)
-                            {
-                                Scintilla().SetIndicatorCurrent(action == CORRECTIVE_ACTION_DELETE ? INDIC_MISSPELLED_DEL : INDIC_MISSPELLED);
-                                Scintilla().IndicatorFillRange(textRange.chrg.cpMin + errStart, errLen);
-                            }
-                        }
-                        hr = enumSpellingError->Next(&spellingError);
-                    }
-                }
+// Checks the jobs with its own spell checker: the one of the UI
+// thread can't be used here.
+void CCmdSpellCheck::ThreadFunc()
+{
+    CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+    OnOutOfScope(CoUninitialize());
+    // most of the work is the background pass, which must not slow down the UI
+    SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_BELOW_NORMAL);
+
+    ISpellCheckerFactoryPtr   factory = nullptr;
+    ISpellCheckerPtr          checker = nullptr;
+    std::wstring              language;
+    std::vector<std::wstring> ignoredWords;
+    CWordCache                cache;
+    if (FAILED(CoCreateInstance(__uuidof(SpellCheckerFactory), nullptr, CLSCTX_INPROC_SERVER, IID_PPV_ARGS(&factory))))
+        factory = nullptr;
+
+    for (;;)
+    {
+        SpellCheckJob job;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_cv.wait(lock, [this] { return !m_runThread || m_job.has_value(); });
+            if (!m_runThread)
+                break;
+            job = std::move(*m_job);
+            m_job.reset();
+        }
+#ifdef _DEBUG
+        ProfileTimer timer(L"SpellCheck");
+#endif
+        ignoredWords.insert(ignoredWords.end(), job.ignoredWords.begin(), job.ignoredWords.end());
+        if (factory && job.language != language)
+        {
+            language = job.language;
+            checker  = nullptr;
+            cache.Clear();
+            BOOL supported = FALSE;
+            factory->IsSupported(language.c_str(), &supported);
+            if (supported && SUCCEEDED(factory->CreateSpellChecker(language.c_str(), &checker)))
+            {
+                for (const auto& word : ignoredWords)
+                    checker->Ignore(word.c_str());
             }
         }
+        else if (checker && !job.ignoredWords.empty())
+        {
+            for (const auto& word : job.ignoredWords)
+                checker->Ignore(word.c_str());
+            cache.Clear();
+        }
+
+        SpellCheckBatch batch;
+        batch.generation = job.generation;
+        batch.document   = job.document;
+        batch.start      = job.offset;
+        batch.end        = job.offset + static_cast<sptr_t>(job.text.size());
+        if (checker)
+            batch.cancelled = !CheckText(job, checker, cache, m_generation, batch.errors);
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_results.push_back(std::move(batch));
+        }
+        // the results are handled on the UI thread like all other work of the commands
+        PostMessage(GetHwnd(), WM_TIMER, g_resultTimer, 0);
     }
 }
 
@@ -412,14 +805,38 @@ void CCmdSpellCheck::OnTimer(UINT id)
         KillTimer(GetHwnd(), g_checkTimer);
         Check();
     }
+    else if (id == g_resultTimer)
+    {
+        ApplyResults();
+    }
+    else if (id == g_markerTimer)
+    {
+        KillTimer(GetHwnd(), g_markerTimer);
+        UpdateScrollMarkers();
+    }
 }
 
 void CCmdSpellCheck::OnPluginNotify(UINT /*cmdId*/, const std::wstring& /*pluginName*/, LPARAM /*data*/)
 {
-    m_lastCheckedPos = 0;
+    // a word was ignored or added to the dictionary
+    InvalidateAll();
     SetTimer(GetHwnd(), g_checkTimer, 500, nullptr);
 }
 
+void CCmdSpellCheck::OnClose()
+{
+    if (m_thread.joinable())
+    {
+        ++m_generation;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_runThread = false;
+        }
+        m_cv.notify_all();
+        m_thread.join();
+    }
+}
+
 HRESULT CCmdSpellCheck::IUICommandHandlerUpdateProperty(REFPROPERTYKEY key, const PROPVARIANT* /*pPropVarCurrentValue*/, PROPVARIANT* pPropVarNewValue)
 {
     if (UI_PKEY_BooleanValue == key)
@@ -440,17 +857,13 @@ bool CCmdSpellCheck::Execute()
     m_enabled = !m_enabled;
     CIniSettings::Instance().SetInt64(L"spellcheck", L"enabled", m_enabled);
     InvalidateUICommand(UI_INVALIDATIONS_PROPERTY, &UI_PKEY_BooleanValue);
+    InvalidateAll();
     if (m_enabled)
-    {
-        m_lastCheckedPos = 0;
         Check();
-    }
     else
     {
-        Scintilla().SetIndicatorCurrent(INDIC_MISSPELLED);
-        Scintilla().IndicatorClearRange(0, Scintilla().Length());
-        Scintilla().SetIndicatorCurrent(INDIC_MISSPELLED_DEL);
-        Scintilla().IndicatorClearRange(0, Scintilla().Length());
+        ClearIndicators();
+        UpdateScrollMarkers();
     }
     g_contextID = m_enabled && g_spellChecker ? cmdContextSpellMap : cmdContextMap;
     return true;
@@ -709,11 +1122,13 @@ HRESULT CCmdSpellCheckCorrect::IUICommandHandlerExecute(UI_EXECUTIONVERB verb, c
                         {
                             // ignore for this session
                             g_spellChecker->Ignore(sWord.c_str());
+                            g_ignoredWords.push_back(sWord);
                         }
                         if (selected == (m_suggestions.size() + 1))
                         {
                             // add to Dictionary
                             g_spellChecker->Add(sWord.c_str());
+                            g_ignoredWords.push_back(sWord);
                         }
                         NotifyPlugins(L"cmdSpellCheck", 1);
                     }
@@ -734,6 +1149,30 @@ void CCmdSpellCheckCorrect::ScintillaNotify(SCNotification* pScn)
     }
 }
 
+bool CCmdSpellCheckNext::Execute()
+{
+    sptr_t start = 0;
+    sptr_t end   = 0;
+    // retry from the start of the document
+    if (!NextMisspelling(Scintilla(), Scintilla().SelectionEnd(), start, end) &&
+        !NextMisspelling(Scintilla(), 0, start, end))
+        return false;
+    Center(start, end);
+    return true;
+}
+
+bool CCmdSpellCheckPrev::Execute()
+{
+    sptr_t start = 0;
+    sptr_t end   = 0;
+    // retry from the end of the document
+    if (!PrevMisspelling(Scintilla(), Scintilla().SelectionStart(), start, end) &&
+        !PrevMisspelling(Scintilla(), Scintilla().Length(), start, end))
+        return false;
+    Center(start, end);
+    return true;
+}
+
 CCmdSpellCheckAll::CCmdSpellCheckAll(void* obj)
     : ICommand(obj)
 {
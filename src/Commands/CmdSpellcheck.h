@@ -19,9 +19,68 @@
 #include "ICommand.h"
 #include "BowPadUI.h"
 #include "LexStyles.h"
+#include "DocumentManager.h"
 
 #include <vector>
 #include <set>
+#include <unordered_map>
+#include <bitset>
+#include <memory>
+#include <optional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+struct SpellCheckError
+{
+    sptr_t pos    = 0;
+    sptr_t length = 0;
+    bool   del    = false; ///< the corrective action is to delete the text
+};
+
+/// a range of the document to check, taken on the UI thread
+struct SpellCheckJob
+{
+    unsigned                                     generation = 0;
+    const void*                                  document   = nullptr;
+    sptr_t                                       offset     = 0; ///< document position of text
+    std::string                                  text;
+    std::string                                  styles;     ///< style of every char of text, empty to check all text
+    std::bitset<256>                             textStyles; ///< the styles which are checked
+    std::vector<std::pair<size_t, size_t>>       urls;       ///< url ranges in text, those are not checked
+    std::shared_ptr<const std::set<std::string>> keywords;
+    std::wstring                                 language;
+    std::vector<std::wstring>                    ignoredWords; ///< words to ignore from now on
+    bool                                         comprehensive  = false;
+    bool                                         checkUppercase = true;
+};
+
+/// the misspellings the worker found in the text of a job
+struct SpellCheckBatch
+{
+    unsigned                     generation = 0;
+    const void*                  document   = nullptr;
+    sptr_t                       start      = 0;
+    sptr_t                       end        = 0;
+    bool                         cancelled  = false;
+    std::vector<SpellCheckError> errors;
+};
+
+/// the lines of a document which are checked already, kept up to date
+/// while lines are inserted and removed
+class CCheckedLines
+{
+public:
+    void Add(sptr_t firstLine, sptr_t endLine);
+    /// the line was edited, and linesAdded lines were inserted after it or removed if negative
+    void Modified(sptr_t line, sptr_t linesAdded);
+    /// finds the first lines in [firstLine, endLine) which are not checked yet
+    bool NextUnchecked(sptr_t firstLine, sptr_t endLine, sptr_t& uncheckedFirst, sptr_t& uncheckedEnd) const;
+
+private:
+    std::vector<std::pair<sptr_t, sptr_t>> m_ranges; ///< sorted, neither overlapping nor adjacent
+};
 
 class CCmdSpellCheck : public ICommand
 {
@@ -39,20 +98,49 @@ public:
 
     void    OnTimer(UINT id) override;
     void    OnPluginNotify(UINT cmdId, const std::wstring& pluginName, LPARAM data) override;
+    void    TabNotify(TBHDR* ptbHdr) override;
+    void    OnClose() override;
+    void    OnLangChanged() override;
+    void    OnDocumentClose(DocID id) override;
+    void    OnDocumentOpen(DocID id) override;
+    void    OnDocumentTextChanged(DocID id) override;
 
 protected:
     void Check();
 
 private:
-    bool                    m_enabled;
-    std::wstring            m_lang;
-    std::set<std::string>   m_keywords;
-    int                     m_activeLexer;
-    bool                    m_useComprehensiveCheck;
-    LexerData               m_lexerData;
-    std::unique_ptr<char[]> m_textBuffer;
-    Sci_Position            m_textBufLen;
-    sptr_t                  m_lastCheckedPos;
+    void SendNextJob();
+    void ApplyResults();
+    void ClearIndicators();
+    void UpdateScrollMarkers();
+    void InvalidateAll();
+    void ThreadFunc();
+
+    bool                                         m_enabled;
+    std::wstring                                 m_lang;
+    std::shared_ptr<const std::set<std::string>> m_keywords;
+    int                                          m_activeLexer;
+    bool                                         m_useComprehensiveCheck;
+    bool                                         m_checkAll;
+    bool                                         m_checkUppercase;
+    std::bitset<256>                             m_textStyles;
+    std::unordered_map<DocID, CCheckedLines>     m_checkedLines;
+    size_t                                       m_ignoredSent; ///< ignored words already passed to the worker
+    ULONGLONG                                    m_lastEdit;    ///< tick count of the last edit
+    bool                                         m_markersPending;
+    bool                                         m_jobInFlight;
+    DocID                                        m_jobDoc;
+    sptr_t                                       m_jobFirstLine;
+    sptr_t                                       m_jobEndLine;
+    bool                                         m_jobVisible; ///< the job checks visible lines, not the background pass
+
+    std::thread                                  m_thread;
+    std::mutex                                   m_mutex;
+    std::condition_variable                      m_cv;
+    std::optional<SpellCheckJob>                 m_job;
+    std::vector<SpellCheckBatch>                 m_results;
+    std::atomic<unsigned>                        m_generation; ///< bumped to cancel the running job
+    std::atomic_bool                             m_runThread;
 };
 
 class CCmdSpellCheckLang : public ICommand
@@ -90,6 +178,36 @@ private:
     std::vector<std::wstring> m_suggestions;
 };
 
+class CCmdSpellCheckNext : public ICommand
+{
+public:
+    CCmdSpellCheckNext(void* obj)
+        : ICommand(obj)
+    {
+    }
+
+    ~CCmdSpellCheckNext() override = default;
+
+    bool Execute() override;
+
+    UINT GetCmdId() override { return cmdSpellCheckNext; }
+};
+
+class CCmdSpellCheckPrev : public ICommand
+{
+public:
+    CCmdSpellCheckPrev(void* obj)
+        : ICommand(obj)
+    {
+    }
+
+    ~CCmdSpellCheckPrev() override = default;
+
+    bool Execute() override;
+
+    UINT GetCmdId() override { return cmdSpellCheckPrev; }
+};
+
 class CCmdSpellCheckAll : public ICommand
 {
 public:
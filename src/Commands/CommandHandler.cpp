@@ -234,6 +234,8 @@ void CCommandHandler::Init(void* obj)
     Add<CCmdSpellCheckCorrect>(obj);
     Add<CCmdSpellCheckAll>(obj);
     Add<CCmdSpellCheckUpper>(obj);
+    Add<CCmdSpellCheckNext>(obj);
+    Add<CCmdSpellCheckPrev>(obj);
 
     Add<CCmdLaunchEdge>(obj);
     Add<CCmdLaunchIe>(obj);
@@ -353,6 +355,19 @@ void CCommandHandler::OnDocumentSave(DocID docId, bool bSaveAs)
     }
 }
 
+void CCommandHandler::OnDocumentTextChanged(DocID docId)
+{
+    for (auto& [id, cmd] : m_commands)
+    {
+        cmd->OnDocumentTextChanged(docId);
+    }
+    for (auto& [id, cmd] : m_noDeleteCommands)
+    {
+        if (cmd)
+            cmd->OnDocumentTextChanged(docId);
+    }
+}
+
 void CCommandHandler::OnClipboardChanged()
 {
     for (auto& [id, cmd] : m_commands)
@@ -41,6 +41,7 @@ public:
     void                                             OnDocumentOpen(DocID docId);
     void                                             OnBeforeDocumentSave(DocID docId);
     void                                             OnDocumentSave(DocID docId, bool bSaveAs);
+    void                                             OnDocumentTextChanged(DocID docId);
     void                                             OnClipboardChanged();
     void                                             BeforeLoad();
     void                                             AfterInit();
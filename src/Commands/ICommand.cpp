@@ -75,6 +75,10 @@ void ICommand::OnDocumentSave(DocID /*id*/, bool /*bSaveAs*/)
 {
 }
 
+void ICommand::OnDocumentTextChanged(DocID /*id*/)
+{
+}
+
 void ICommand::OnClipboardChanged()
 {
 }
@@ -171,6 +175,11 @@ Scintilla::ScintillaCall& ICommand::Scintilla() const
     return m_pMainWindow->m_editor.Scintilla();
 }
 
+std::shared_ptr<const std::string> ICommand::GetTextSnapshot() const
+{
+    return m_pMainWindow->m_editor.GetTextSnapshot();
+}
+
 HWND ICommand::GetHwnd() const
 {
     return *m_pMainWindow;
@@ -191,6 +200,11 @@ void ICommand::OpenFiles(const std::vector<std::wstring>& paths) const
     return m_pMainWindow->OpenFiles(paths);
 }
 
+void ICommand::LoadPendingDocuments() const
+{
+    m_pMainWindow->LoadPendingDocuments();
+}
+
 bool ICommand::ReloadTab(int tab, int encoding) const
 {
     return m_pMainWindow->ReloadTab(tab, encoding);
@@ -277,6 +291,11 @@ void ICommand::SaveCurrentPos(CPosData& pos) const
     return m_pMainWindow->m_editor.SaveCurrentPos(pos);
 }
 
+CUndoData ICommand::GetUndoData(DocID id) const
+{
+    return m_pMainWindow->GetUndoData(id);
+}
+
 bool ICommand::UpdateFileTime(CDocument& doc, bool bIncludeReadonly) const
 {
     return m_pMainWindow->m_docManager.UpdateFileTime(doc, bIncludeReadonly);
@@ -317,6 +336,11 @@ void ICommand::DocScrollAddLineColor(int type, size_t line, COLORREF clr) const
     m_pMainWindow->m_editor.DocScrollAddLineColor(type, line, clr);
 }
 
+void ICommand::DocScrollAddLineColors(int type, const std::vector<size_t>& lines, COLORREF clr) const
+{
+    m_pMainWindow->m_editor.DocScrollAddLineColors(type, lines, clr);
+}
+
 void ICommand::DocScrollRemoveLine(int type, size_t line) const
 {
     m_pMainWindow->m_editor.DocScrollRemoveLine(type, line);
@@ -447,6 +471,12 @@ void ICommand::AddAutoCompleteWords(const std::string& lang, const std::map<std:
     m_pMainWindow->AddAutoCompleteWords(lang, words);
 }
 
+void ICommand::NotifyDocumentTextChanged(DocID id) const
+{
+    m_pMainWindow->m_autoCompleter.OnDocumentTextChanged(id);
+    CCommandHandler::Instance().OnDocumentTextChanged(id);
+}
+
 void ICommand::AddAutoCompleteWords(const DocID& docID, std::map<std::string, AutoCompleteType>&& words) const
 {
     m_pMainWindow->AddAutoCompleteWords(docID, std::move(words));
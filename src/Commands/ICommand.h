@@ -20,6 +20,7 @@
 #include "Document.h"
 #include "../AutoComplete.h"
 
+#include <memory>
 #include <vector>
 #include <string>
 #include <UIRibbon.h>
@@ -37,6 +38,7 @@ constexpr unsigned int NoActivate           = 16;
 constexpr unsigned int CreateTabOnly        = 32;
 constexpr unsigned int CreateIfMissing      = 64;
 constexpr unsigned int NewIfMissing         = 128;
+constexpr unsigned int LoadLater            = 256; ///< only create a placeholder tab, the file is loaded when the tab is activated
 }; // namespace OpenFlags
 
 class ICommand
@@ -63,6 +65,8 @@ public:
     virtual void    OnDocumentOpen(DocID id);
     virtual void    OnBeforeDocumentSave(DocID id);
     virtual void    OnDocumentSave(DocID id, bool bSaveAs);
+    // the text of a document not shown in the editor was changed, e.g. by a replace in all tabs
+    virtual void    OnDocumentTextChanged(DocID id);
     virtual void    OnClipboardChanged();
     virtual HRESULT IUICommandHandlerUpdateProperty(REFPROPERTYKEY key, const PROPVARIANT* pPropVarCurrentValue, PROPVARIANT* pPropVarNewValue);
     virtual HRESULT IUICommandHandlerExecute(UI_EXECUTIONVERB verb, const PROPERTYKEY* key, const PROPVARIANT* pPropVarValue, IUISimplePropertySet* pCommandExecutionProperties);
@@ -98,16 +102,19 @@ protected:
     CDocument&                GetModDocumentFromID(DocID id) const;
     void                      RestoreCurrentPos(const CPosData& pos) const;
     void                      SaveCurrentPos(CPosData& pos) const;
+    CUndoData                 GetUndoData(DocID id) const;
     bool                      UpdateFileTime(CDocument& doc, bool bIncludeReadonly) const;
     std::vector<char>         ReadNewData(CDocument& doc) const;
 
     Scintilla::ScintillaCall& Scintilla() const;
+    std::shared_ptr<const std::string> GetTextSnapshot() const;
     LRESULT                   SendMessageToMainWnd(UINT msg, WPARAM wParam, LPARAM lParam) const;
     void                      UpdateStatusBar(bool bEverything) const;
     void                      SetupLexerForLang(const std::string& lang) const;
     std::string               GetCurrentLanguage() const;
     void                      DocScrollClear(int type) const;
     void                      DocScrollAddLineColor(int type, size_t line, COLORREF clr) const;
+    void                      DocScrollAddLineColors(int type, const std::vector<size_t>& lines, COLORREF clr) const;
     void                      DocScrollUpdate() const;
     void                      DocScrollRemoveLine(int type, size_t line) const;
     void                      UpdateLineNumberWidth() const;
@@ -127,6 +134,8 @@ protected:
     std::wstring              GetFileTreePath() const;
     void                      FileTreeBlockRefresh(bool bBlock) const;
 
+    // for text changed without going through the editor, e.g. a replace in all tabs
+    void                      NotifyDocumentTextChanged(DocID id) const;
     void                      AddAutoCompleteWords(const std::string& lang, std::map<std::string, AutoCompleteType>&& words) const;
     void                      AddAutoCompleteWords(const std::string& lang, const std::map<std::string, AutoCompleteType>& words) const;
     void                      AddAutoCompleteWords(const DocID& docID, std::map<std::string, AutoCompleteType>&& words) const;
@@ -137,6 +146,7 @@ protected:
     static UINT               GetTimerID() { return m_nextTimerID++; }
     int                       OpenFile(LPCWSTR file, unsigned int openFlags) const;
     void                      OpenFiles(const std::vector<std::wstring>& paths) const;
+    void                      LoadPendingDocuments() const;
     void                      OpenHDROP(HDROP hDrop) const;
     bool                      ReloadTab(int tab, int encoding = -1) const; // By default reload encoding
     bool                      SaveCurrentTab(bool bSaveAs = false) const;
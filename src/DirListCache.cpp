@@ -0,0 +1,157 @@
+﻿// This file is part of BowPad.
+//
+// Copyright (C) 2025 - Stefan Kueng
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// See <http://www.gnu.org/licenses/> for a copy of the full license text
+//
+#include "stdafx.h"
+#include "DirListCache.h"
+#include "PathWatcher.h"
+#include "PathUtils.h"
+#include "StringUtils.h"
+#include "DirFileEnum.h"
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+namespace
+{
+// a list with thousands of paths is of no use for the autocompletion
+constexpr size_t MAX_ENTRIES  = 5000;
+constexpr size_t MAX_LISTINGS = 64;
+
+std::wstring ListingKey(const std::wstring& dir)
+{
+    auto key = CStringUtils::to_lower(dir);
+    while (!key.empty() && key.back() == L'\\')
+        key.pop_back();
+    return key;
+}
+} // namespace
+
+struct CDirListCache::Listing
+{
+    std::mutex                            mutex;
+    std::wstring                          dir;
+    std::vector<std::wstring>             entries;
+    std::chrono::steady_clock::time_point listed;
+    std::chrono::steady_clock::time_point used;
+    bool                                  valid   = false; ///< entries holds a complete listing
+    bool                                  watched = false;
+    std::shared_ptr<std::atomic_bool>     run;             ///< true while the directory is listed
+};
+
+CDirListCache& CDirListCache::Instance()
+{
+    static CDirListCache instance;
+    return instance;
+}
+
+CDirListCache::CDirListCache()
+    : m_watcher(std::make_unique<CPathWatcher>())
+{
+}
+
+CDirListCache::~CDirListCache()
+{
+    if (m_running)
+        *m_running = false;
+}
+
+bool CDirListCache::Get(const std::wstring& dir, std::vector<std::wstring>& entries, HWND notifyWnd, UINT notifyMsg)
+{
+    const auto ttl = std::chrono::seconds(CIniSettings::Instance().GetInt64(L"View", L"autocompletePathTTL", 30));
+    const auto now = std::chrono::steady_clock::now();
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    InvalidateChangedPaths();
+    auto& slot = m_listings[ListingKey(dir)];
+    if (!slot)
+    {
+        slot      = std::make_shared<Listing>();
+        slot->dir = dir;
+    }
+    auto listing  = slot;
+    listing->used = now;
+    {
+        std::lock_guard<std::mutex> listingLock(listing->mutex);
+        entries = listing->entries;
+        if (listing->valid && !listing->watched)
+        {
+            m_watcher->AddPath(listing->dir, false);
+            listing->watched = true;
+        }
+        if (listing->valid && now - listing->listed < ttl)
+            return true;
+        if (listing->run && *listing->run)
+            return false;
+        // the user typed on to another folder: stop listing the previous one
+        if (m_running)
+            *m_running = false;
+        m_running    = std::make_shared<std::atomic_bool>(true);
+        listing->run = m_running;
+    }
+    // the thread only works with the listing so it doesn't depend on the cache
+    std::thread([listing, run = m_running, notifyWnd, notifyMsg]() {
+        std::vector<std::wstring> found;
+        CDirFileEnum              enumerator(listing->dir);
+        std::wstring              path;
+        bool                      isDir = false;
+        while (*run && found.size() < MAX_ENTRIES && enumerator.NextFile(path, &isDir, false))
+            found.push_back(path);
+        if (!*run)
+            return;
+        {
+            std::lock_guard<std::mutex> listingLock(listing->mutex);
+            listing->entries = std::move(found);
+            listing->listed  = std::chrono::steady_clock::now();
+            listing->valid   = true;
+            *run             = false;
+        }
+        PostMessage(notifyWnd, notifyMsg, 0, 0);
+    }).detach();
+    RemoveOldListings();
+    return false;
+}
+
+void CDirListCache::InvalidateChangedPaths()
+{
+    auto expire = [this](const std::wstring& key) {
+        if (auto it = m_listings.find(key); it != m_listings.end())
+        {
+            std::lock_guard<std::mutex> listingLock(it->second->mutex);
+            it->second->listed = {};
+        }
+    };
+    // the old entries are still shown until the directory is listed again
+    for (const auto& [action, path] : m_watcher->GetChangedPaths())
+    {
+        auto key = ListingKey(path);
+        expire(key);
+        expire(ListingKey(CPathUtils::GetParentDirectory(key)));
+    }
+}
+
+void CDirListCache::RemoveOldListings()
+{
+    while (m_listings.size() > MAX_LISTINGS)
+    {
+        auto oldest = std::min_element(m_listings.begin(), m_listings.end(), [](const auto& lhs, const auto& rhs) {
+            return lhs.second->used < rhs.second->used;
+        });
+        if (oldest->second->watched)
+            m_watcher->RemovePath(oldest->second->dir);
+        m_listings.erase(oldest);
+    }
+}
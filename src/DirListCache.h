@@ -0,0 +1,62 @@
+﻿// This file is part of BowPad.
+//
+// Copyright (C) 2025 - Stefan Kueng
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// See <http://www.gnu.org/licenses/> for a copy of the full license text
+//
+#pragma once
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <atomic>
+
+class CPathWatcher;
+
+/**
+ * Cache of directory listings for the path autocompletion.
+ *
+ * Listing a directory on a slow or network drive can take seconds, so
+ * directories are listed in a background thread and the cached listing is
+ * used until the new one is ready. Listings expire after a while and when
+ * a CPathWatcher reports changes in the directory.
+ */
+class CDirListCache
+{
+public:
+    static CDirListCache& Instance();
+
+    /**
+     * Fills entries with the full paths of the files and folders in dir,
+     * as far as they're known already. Returns true if the listing is up to date.
+     * Otherwise the directory is listed in the background and notifyMsg is
+     * posted to notifyWnd once that is done. Listing another directory cancels
+     * the one running before.
+     */
+    bool Get(const std::wstring& dir, std::vector<std::wstring>& entries, HWND notifyWnd, UINT notifyMsg);
+
+private:
+    CDirListCache();
+    ~CDirListCache();
+
+    struct Listing;
+    void InvalidateChangedPaths();
+    void RemoveOldListings();
+
+    std::mutex                                       m_mutex;
+    std::map<std::wstring, std::shared_ptr<Listing>> m_listings;
+    std::unique_ptr<CPathWatcher>                    m_watcher;
+    // cancels the listing running in the background
+    std::shared_ptr<std::atomic_bool>                m_running;
+};
@@ -21,6 +21,8 @@
 #include "GDIHelpers.h"
 #include "DPIAware.h"
 
+#include <algorithm>
+
 #pragma warning(push)
 #pragma warning(disable : 4458) // declaration of 'xxx' hides class member
 #include <gdiplus.h>
@@ -111,7 +113,8 @@ CDocScroll::~CDocScroll()
 }
 
 CDocScroll::CDocScroll()
-    : m_visibleLines(0)
+    : m_rows(0)
+    , m_visibleLines(0)
     , m_lines(0)
     , m_curPosVisLine(0)
     , m_curPosColor(0)
@@ -272,28 +275,31 @@ LRESULT CALLBACK CDocScroll::HandleCustomDraw(WPARAM /*wParam*/, NMCSBCUSTOMDRAW
                                            static_cast<INT>(pCustDraw->rect.right - pCustDraw->rect.left),
                                            static_cast<INT>(pCustDraw->rect.bottom - pCustDraw->rect.top));
 
-                    if (m_bDirty)
-                        CalcLines();
+                    CalcLines(static_cast<size_t>(max(0L, pCustDraw->rect.bottom - pCustDraw->rect.top)));
 
-                    LONG     lastLinePos = -1;
-                    COLORREF lastColor   = static_cast<COLORREF>(-1);
-                    int      colCount    = DOCSCROLLTYPE_END;
-                    int      width       = pCustDraw->rect.right - pCustDraw->rect.left;
-                    int      colWidth    = width / (colCount - 1);
+                    int colCount     = DOCSCROLLTYPE_END;
+                    int width        = pCustDraw->rect.right - pCustDraw->rect.left;
+                    int colWidth     = width / (colCount - 1);
+                    int markerHeight = CDPIAware::Instance().Scale(pCustDraw->hdr.hwndFrom, 2);
                     for (int c = 1; c < colCount; ++c)
                     {
-                        int drawX = pCustDraw->rect.left + (c - 1) * colWidth;
-                        for (const auto& line : m_visibleLineColors[c])
+                        LONG        lastLinePos = -1;
+                        COLORREF    lastColor   = static_cast<COLORREF>(-1);
+                        int         drawX       = pCustDraw->rect.left + (c - 1) * colWidth;
+                        const auto& buckets     = m_markers[c].buckets;
+                        for (size_t row = 0; row < buckets.size(); ++row)
                         {
-                            LONG linePos = static_cast<LONG>(pCustDraw->rect.top + (pCustDraw->rect.bottom - pCustDraw->rect.top) * line.first / m_visibleLines);
-                            if ((linePos > (lastLinePos + 1)) || (lastColor != line.second))
+                            if (buckets[row].count == 0)
+                                continue;
+                            LONG linePos = static_cast<LONG>(pCustDraw->rect.top + row);
+                            if ((linePos > (lastLinePos + 1)) || (lastColor != buckets[row].color))
                             {
                                 Gdiplus::Color c2;
-                                c2.SetFromCOLORREF(line.second);
+                                c2.SetFromCOLORREF(buckets[row].color);
                                 Gdiplus::SolidBrush brushLine(c2);
-                                graphics.FillRectangle(&brushLine, drawX, linePos, colWidth, CDPIAware::Instance().Scale(pCustDraw->hdr.hwndFrom, 2));
+                                graphics.FillRectangle(&brushLine, drawX, linePos, colWidth, markerHeight);
                                 lastLinePos = linePos;
-                                lastColor   = line.second;
+                                lastColor   = buckets[row].color;
                             }
                         }
                     }
@@ -320,19 +326,67 @@ LRESULT CALLBACK CDocScroll::HandleCustomDraw(WPARAM /*wParam*/, NMCSBCUSTOMDRAW
     return CDRF_SKIPDEFAULT;
 }
 
-void CDocScroll::CalcLines()
+void CDocScroll::CalcLines(size_t rows)
 {
-    if (m_bDirty)
+    if (m_bDirty || rows != m_rows)
     {
-        for (int i = 0; i < DOCSCROLLTYPE_END; ++i)
-            m_visibleLineColors[i].clear();
-        for (const auto& lc : m_lineColors)
-        {
-            m_visibleLineColors[lc.first.type][m_pScintilla->Scintilla().VisibleFromDocLine(lc.first.line)] = lc.second;
-        }
         m_visibleLines = m_pScintilla->Scintilla().VisibleFromDocLine(m_lines);
+        m_rows         = rows;
         m_bDirty       = false;
+        for (auto& markerType : m_markers)
+            markerType.dirty = true;
+    }
+    for (auto& markerType : m_markers)
+    {
+        if (!markerType.dirty)
+            continue;
+        SortMarkers(markerType);
+        markerType.buckets.assign(m_rows, Bucket());
+        for (const auto& marker : markerType.markers)
+            AddToBuckets(markerType, marker.line, marker.color);
+        markerType.dirty = false;
+    }
+}
+
+void CDocScroll::SortMarkers(MarkerType& markerType)
+{
+    if (!markerType.sorted)
+    {
+        // a line has only one marker of a type, the one added last
+        auto& markers = markerType.markers;
+        std::stable_sort(markers.begin(), markers.end(), [](const Marker& lhs, const Marker& rhs) { return lhs.line < rhs.line; });
+        size_t count = 0;
+        for (const auto& marker : markers)
+        {
+            if (count > 0 && markers[count - 1].line == marker.line)
+                markers[count - 1].color = marker.color;
+            else
+                markers[count++] = marker;
+        }
+        markers.resize(count);
+        markerType.sorted = true;
+    }
+    markerType.sortedCount = markerType.markers.size();
+}
+
+void CDocScroll::AddToBuckets(MarkerType& markerType, size_t line, COLORREF clr) const
+{
+    if (markerType.buckets.empty() || m_visibleLines == 0)
+        return;
+    const uint64_t visibleLine = m_pScintilla->Scintilla().VisibleFromDocLine(line);
+    const auto     row         = min(static_cast<size_t>(visibleLine * markerType.buckets.size() / m_visibleLines), markerType.buckets.size() - 1);
+    auto&          bucket      = markerType.buckets[row];
+    ++bucket.count;
+    // majority vote: if most markers in the row have the same color, that's the one shown
+    if (bucket.votes == 0)
+    {
+        bucket.color = clr;
+        bucket.votes = 1;
     }
+    else if (bucket.color == clr)
+        ++bucket.votes;
+    else
+        --bucket.votes;
 }
 
 void CDocScroll::AnimateFraction(AnimationVariable& animVar, double endVal)
@@ -354,23 +408,55 @@ void CDocScroll::AnimateFraction(AnimationVariable& animVar, double endVal)
 
 void CDocScroll::AddLineColor(int type, size_t line, COLORREF clr)
 {
-    auto foundIt = m_lineColors.emplace(LineColor(type, line), clr);
-    if (foundIt.second)
-        m_bDirty = true;
-    else
+    if (type <= 0 || type >= DOCSCROLLTYPE_END)
+        return;
+    auto& markerType = m_markers[type];
+    // markers are usually added line by line, so several markers
+    // on the same line follow each other
+    if (!markerType.markers.empty() && markerType.markers.back().line == line)
     {
-        if (foundIt.first->second != clr)
+        if (markerType.markers.back().color != clr)
         {
-            foundIt.first->second = clr;
-            m_bDirty              = true;
+            markerType.markers.back().color = clr;
+            markerType.dirty                = true;
         }
+        return;
+    }
+    if (!markerType.markers.empty() && markerType.markers.back().line > line)
+    {
+        // the line might already have a marker: the buckets are filled
+        // again once the markers are sorted and the duplicates dropped
+        markerType.sorted = false;
+        markerType.dirty  = true;
     }
+    markerType.markers.push_back(Marker{static_cast<uint32_t>(line), clr});
+    if (!markerType.dirty && !m_bDirty)
+        AddToBuckets(markerType, line, clr);
+    // don't let the duplicates pile up until the scrollbar is drawn again
+    else if (!markerType.sorted && markerType.markers.size() >= 2 * markerType.sortedCount + 1024)
+        SortMarkers(markerType);
+}
+
+void CDocScroll::AddLineColors(int type, const std::vector<size_t>& lines, COLORREF clr)
+{
+    if (type <= 0 || type >= DOCSCROLLTYPE_END)
+        return;
+    m_markers[type].markers.reserve(m_markers[type].markers.size() + lines.size());
+    for (auto line : lines)
+        AddLineColor(type, line, clr);
 }
 
 void CDocScroll::RemoveLine(int type, size_t line)
 {
-    if (m_lineColors.erase(LineColor(type, line)) > 0)
-        m_bDirty = true;
+    if (type <= 0 || type >= DOCSCROLLTYPE_END)
+        return;
+    auto& markerType = m_markers[type];
+    auto  it         = std::remove_if(markerType.markers.begin(), markerType.markers.end(), [line](const Marker& marker) { return marker.line == line; });
+    if (it != markerType.markers.end())
+    {
+        markerType.markers.erase(it, markerType.markers.end());
+        markerType.dirty = true;
+    }
 }
 
 void CDocScroll::VisibleLinesChanged()
@@ -393,28 +479,16 @@ void CDocScroll::SetTotalLines(size_t lines)
 
 void CDocScroll::Clear(int type)
 {
-    if (type == 0)
-    {
-        if (!m_lineColors.empty())
-            m_bDirty = true;
-        m_lineColors.clear();
-    }
-    else
-    {
-        for (auto it = m_lineColors.begin(); it != m_lineColors.end();)
-        {
-            if (it->first.type == type)
-            {
-                it       = m_lineColors.erase(it);
-                m_bDirty = true;
-            }
-            else
-                ++it;
-        }
-    }
-    if (m_bDirty)
+    for (int i = 0; i < DOCSCROLLTYPE_END; ++i)
     {
-        for (int i = 0; i < DOCSCROLLTYPE_END; ++i)
-            m_visibleLineColors[i].clear();
+        if (type != 0 && type != i)
+            continue;
+        auto& markerType = m_markers[i];
+        // release the memory: there might have been millions of markers
+        std::vector<Marker>().swap(markerType.markers);
+        markerType.buckets.assign(markerType.buckets.size(), Bucket());
+        markerType.dirty       = false;
+        markerType.sorted      = true;
+        markerType.sortedCount = 0;
     }
 }
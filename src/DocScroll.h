@@ -18,7 +18,8 @@
 #include "coolscroll.h"
 #include "AnimationManager.h"
 
-#include <map>
+#include <array>
+#include <vector>
 
 constexpr int DOCSCROLLTYPE_SELTEXT = 1;
 constexpr int DOCSCROLLTYPE_BOOKMARK = 2;
@@ -27,23 +28,8 @@ constexpr int DOCSCROLLTYPE_CUSTOMMARK_1 = 4;
 constexpr int DOCSCROLLTYPE_CUSTOMMARK_2 = 5;
 constexpr int DOCSCROLLTYPE_CUSTOMMARK_3 = 6;
 constexpr int DOCSCROLLTYPE_CUSTOMMARK_4 = 7;
-constexpr int DOCSCROLLTYPE_END = 8;
-
-struct LineColor
-{
-    inline LineColor(int type, size_t line) : type(type), line(line) {}
-    // Sort by type then line.
-    inline bool operator<(const LineColor& rhs) const
-    {
-        if (type != rhs.type)
-            return type < rhs.type;
-        else
-            return line < rhs.line;
-    }
-
-    int type;
-    size_t line;
-};
+constexpr int DOCSCROLLTYPE_SPELLING = 8;
+constexpr int DOCSCROLLTYPE_END = 9;
 
 class CScintillaWnd;
 
@@ -58,17 +44,43 @@ public:
     void                        SetTotalLines(size_t lines);
     void                        Clear(int type);
     void                        AddLineColor(int type, size_t line, COLORREF clr);
+    void                        AddLineColors(int type, const std::vector<size_t>& lines, COLORREF clr);
     void                        RemoveLine(int type, size_t line);
     void                        SetCurrentPos(size_t visibleLine, COLORREF clr) { m_curPosVisLine = visibleLine; m_curPosColor = clr; }
     void                        VisibleLinesChanged();
     bool                        IsDirty() const { return m_bDirty; }
 private:
-    void                        CalcLines();
+    // the markers of one type in one pixel row of the scrollbar
+    struct Bucket
+    {
+        uint32_t    count = 0;
+        uint32_t    votes = 0;
+        COLORREF    color = 0;      ///< the color of most of the markers
+    };
+    struct Marker
+    {
+        uint32_t    line;
+        COLORREF    color;
+    };
+    struct MarkerType
+    {
+        // needed to fill the buckets again when lines are folded or wrapped
+        // or the scrollbar is resized
+        std::vector<Marker> markers;
+        std::vector<Bucket> buckets;
+        bool                dirty       = false;
+        bool                sorted      = true; ///< ordered by line, with one marker per line
+        size_t              sortedCount = 0;    ///< number of markers after they were last sorted
+    };
+
+    void                        CalcLines(size_t rows);
+    static void                 SortMarkers(MarkerType& markerType);
+    void                        AddToBuckets(MarkerType& markerType, size_t line, COLORREF clr) const;
     void                        AnimateFraction(AnimationVariable& animVar, double endVal);
 
 
-    std::map<size_t, COLORREF>                  m_visibleLineColors[DOCSCROLLTYPE_END];
-    std::map<LineColor,COLORREF>                m_lineColors;
+    std::array<MarkerType, DOCSCROLLTYPE_END>   m_markers;
+    size_t                                      m_rows;
     size_t                                      m_visibleLines;
     size_t                                      m_lines;
     size_t                                      m_curPosVisLine;
@@ -84,7 +84,7 @@ public:
     sptr_t                   m_nScrollWidth;
     std::vector<sptr_t>      m_lineStateVector;
     sptr_t                   m_lastStyleLine;
-    CUndoData                m_undoData;
+    CUndoData                m_undoData; ///< only filled when the undo history has to leave the document, e.g. for the session
 };
 
 class CDocument
@@ -106,6 +106,7 @@ public:
         , m_bTailing(false)
         , m_bIsWriteProtected(false)
         , m_bDoSaveAs(false)
+        , m_bLoadPending(false)
         , m_tabSpace(TabSpace::Default)
         , m_readDir(Scintilla::Bidirectional::Disabled)
         , m_wrapMode(std::nullopt)
@@ -146,7 +147,8 @@ public:
     bool                           m_bIsReadonly;
     bool                           m_bTailing;
     bool                           m_bIsWriteProtected;
-    bool                           m_bDoSaveAs; ///< even if m_path is set, always ask where to save
+    bool                           m_bDoSaveAs;    ///< even if m_path is set, always ask where to save
+    bool                           m_bLoadPending; ///< placeholder only, the file content is not loaded yet
     FILETIME                       m_lastWriteTime;
     CPosData                       m_position;
     TabSpace                       m_tabSpace;
@@ -32,13 +32,18 @@
 #include "util/encodings/encodings.pb.h"
 #include "util/languages/languages.pb.h"
 
+#include <set>
 #include <stdexcept>
+#include <thread>
+#include <atomic>
 #include <Shobjidl.h>
 #include <mlang.h>
 #include <wrl/client.h>
 
 namespace
 {
+constexpr size_t MAX_LOAD_THREADS = 8;
+
 struct ICaseComp
 {
     bool operator()(const std::string& lhs, const std::string& rhs) const
@@ -493,6 +498,132 @@ void SetEOLType(const CScintillaWnd& edit, const CDocument& doc)
             break;
     }
 }
+
+struct LoadSettings
+{
+    bool preferUtf8       = false;
+    bool useCed           = true;
+    bool ignoreUnreliable = false;
+};
+
+LoadSettings GetLoadSettings()
+{
+    LoadSettings settings;
+    settings.preferUtf8       = CIniSettings::Instance().GetInt64(L"Defaults", L"encodingutf8overansi", 0) != 0;
+    settings.useCed           = CIniSettings::Instance().GetInt64(L"Defaults", L"useCED", 1) != 0;
+    settings.ignoreUnreliable = CIniSettings::Instance().GetInt64(L"Defaults", L"ignoreUnreliableEncDetection", 0) != 0;
+    return settings;
+}
+
+void SetFileInformation(CDocument& doc, const BY_HANDLE_FILE_INFORMATION& fi, const std::wstring& path)
+{
+    doc.m_bIsReadonly   = (fi.dwFileAttributes & (FILE_ATTRIBUTE_HIDDEN | FILE_ATTRIBUTE_READONLY | FILE_ATTRIBUTE_SYSTEM)) != 0;
+    doc.m_lastWriteTime = fi.ftLastWriteTime;
+    doc.m_path          = path;
+}
+
+// reads the whole file, detects the encoding if it's -1 and passes the content
+// converted to utf8 to the loader. Only the passed buffers are used, so this can
+// run in several threads at once as long as every thread has its own buffers.
+void DecodeFile(HANDLE hFile, Scintilla::ILoader& edit, int encoding, const LoadSettings& settings,
+                char* data, char* charBuf, int charBufSize, wchar_t* wideBuf, CDocument& doc)
+{
+    DWORD lenFile                 = 0;
+    int   incompleteMultiByteChar = 0;
+    bool  bFirst                  = true;
+    bool  inconclusive            = false;
+    bool  encodingSet             = encoding != -1;
+    int   skip                    = 0;
+    do
+    {
+        if (!ReadFile(hFile, data + incompleteMultiByteChar, ReadBlockSize - incompleteMultiByteChar, &lenFile, nullptr))
+            lenFile = 0;
+        else
+            lenFile += incompleteMultiByteChar;
+        incompleteMultiByteChar = 0;
+
+        if ((!encodingSet) || (inconclusive && encoding == CP_ACP))
+        {
+            encoding = GetCodepageFromBuf(data + skip, lenFile - skip, doc.m_bHasBOM, inconclusive, skip);
+            if (inconclusive || encoding == CP_ACP)
+            {
+                if (inconclusive && encoding == CP_ACP)
+                    encoding = CP_UTF8;
+                if (settings.useCed)
+                {
+                    int  bytesConsumed = 0;
+                    bool isReliable    = false;
+                    auto enc           = CompactEncDet::DetectEncoding(data + incompleteMultiByteChar,
+                                                                       lenFile - incompleteMultiByteChar,
+                                                                       nullptr, nullptr, nullptr,
+                                                                       Encoding::UNKNOWN_ENCODING,
+                                                                       Language::UNKNOWN_LANGUAGE,
+                                                                       CompactEncDet::WEB_CORPUS,
+                                                                       true,
+                                                                       &bytesConsumed,
+                                                                       &isReliable);
+                    auto charset       = MimeEncodingName(enc);
+                    if (isReliable || !settings.ignoreUnreliable)
+                    {
+                        Microsoft::WRL::ComPtr<IMultiLanguage> ml;
+                        if (SUCCEEDED(CoCreateInstance(CLSID_CMultiLanguage, nullptr,
+                                                       CLSCTX_ALL,
+                                                       IID_IMultiLanguage, (void**)&ml)))
+                        {
+                            MIMECSETINFO charsetInfo{};
+                            _bstr_t      wCs = CUnicodeUtils::StdGetUnicode(charset).c_str();
+                            if (SUCCEEDED(ml->GetCharsetInfo(wCs, &charsetInfo)))
+                            {
+                                encoding = charsetInfo.uiInternetEncoding;
+                            }
+                            else if (encodings.contains(charset))
+                            {
+                                encoding = encodings.at(charset);
+                            }
+                        }
+                    }
+                }
+            }
+        }
+        encodingSet    = true;
+
+        doc.m_encoding = encoding;
+
+        switch (encoding)
+        {
+            case -1:
+            case CP_UTF8:
+                LoadSomeUtf8(edit, doc.m_bHasBOM, bFirst, lenFile, data, doc.m_format, doc.m_tabSpace);
+                break;
+            case 1200: // UTF16_LE
+                loadSomeUtf16Le(edit, doc.m_bHasBOM, bFirst, lenFile, data, charBuf, charBufSize, wideBuf, doc.m_format, doc.m_tabSpace);
+                break;
+            case 1201: // UTF16_BE
+                loadSomeUtf16Be(edit, doc.m_bHasBOM, bFirst, lenFile, data, charBuf, charBufSize, wideBuf, doc.m_format, doc.m_tabSpace);
+                break;
+            case 12001:                         // UTF32_BE
+                loadSomeUtf32Be(lenFile, data); // Doesn't load, falls through to load.
+                [[fallthrough]];
+            case 12000: // UTF32_LE
+                loadSomeUtf32Le(edit, doc.m_bHasBOM, bFirst, lenFile, data, charBuf, charBufSize, wideBuf, doc.m_format, doc.m_tabSpace);
+                break;
+            default:
+                LoadSomeOther(edit, encoding, lenFile, incompleteMultiByteChar, data, charBuf, charBufSize, wideBuf, doc.m_format, doc.m_tabSpace);
+                break;
+        }
+
+        if (incompleteMultiByteChar != 0) // copy bytes to next buffer
+            memcpy(data, data + ReadBlockSize - incompleteMultiByteChar, incompleteMultiByteChar);
+
+        bFirst = false;
+    } while (lenFile == ReadBlockSize);
+
+    if (settings.preferUtf8 && inconclusive && doc.m_encoding == CP_ACP)
+        doc.m_encoding = CP_UTF8;
+
+    if (doc.m_format == EOLFormat::Unknown_Format)
+        doc.m_format = EOLFormat::Win_Format;
+}
 } // namespace
 
 CDocumentManager::CDocumentManager()
@@ -553,6 +684,17 @@ void CDocumentManager::AddDocumentAtEnd(const CDocument& doc, DocID id)
 
 CDocument CDocumentManager::LoadFile(HWND hWnd, const std::wstring& path, int encoding, bool createIfMissing)
 {
+    if (encoding == -1 && !m_preloaded.empty())
+    {
+        auto found = m_preloaded.find(CStringUtils::to_lower(path));
+        if (found != m_preloaded.end())
+        {
+            CDocument preloaded = found->second;
+            m_preloaded.erase(found);
+            return preloaded;
+        }
+    }
+
     CDocument doc;
     doc.m_format    = EOLFormat::Unknown_Format;
 
@@ -601,21 +743,38 @@ CDocument CDocumentManager::LoadFile(HWND hWnd, const std::wstring& path, int en
         ShowFileLoadError(hWnd, path, errMsg);
         return doc;
     }
-    doc.m_bIsReadonly                    = (fi.dwFileAttributes & (FILE_ATTRIBUTE_HIDDEN | FILE_ATTRIBUTE_READONLY | FILE_ATTRIBUTE_SYSTEM)) != 0;
-    doc.m_lastWriteTime                  = fi.ftLastWriteTime;
-    doc.m_path                           = path;
-    unsigned __int64 fileSize            = static_cast<__int64>(fi.nFileSizeHigh) << 32 | fi.nFileSizeLow;
-    // add more room for Scintilla (usually 1/6 more for editing)
-    unsigned __int64 bufferSizeRequested = fileSize + min(1 << 20, fileSize / 6);
+    SetFileInformation(doc, fi, path);
+    unsigned __int64 fileSize = static_cast<__int64>(fi.nFileSizeHigh) << 32 | fi.nFileSizeLow;
 
 #ifdef _DEBUG
     ProfileTimer timer(L"LoadFile");
 #endif
 
+    bool                ro       = false;
+    Scintilla::ILoader* pdocLoad = CreateLoader(fileSize, ro);
+    if (pdocLoad == nullptr)
+    {
+        ShowFileLoadError(hWnd, path,
+                          CLanguage::Instance().GetTranslatedString(ResString(g_hRes, IDS_ERR_FILETOOBIG)).c_str());
+        return doc;
+    }
+    DecodeFile(hFile, *pdocLoad, encoding, GetLoadSettings(), m_data, m_charBuf.get(), m_charBufSize, m_wideBuf.get(), doc);
+    FinishLoad(pdocLoad, ro, doc);
+
+    doc.m_fileSize = fileSize;
+
+    return doc;
+}
+
+Scintilla::ILoader* CDocumentManager::CreateLoader(unsigned __int64 fileSize, bool& ro)
+{
+    // add more room for Scintilla (usually 1/6 more for editing)
+    unsigned __int64 bufferSizeRequested = fileSize + min(1 << 20, fileSize / 6);
+
     // Setup our scratch scintilla control to load the data
     m_scratchScintilla.Scintilla().SetStatus(Scintilla::Status::Ok); // reset error status
     m_scratchScintilla.Scintilla().SetDocPointer(nullptr);
-    bool ro = m_scratchScintilla.Scintilla().ReadOnly() != 0;
+    ro = m_scratchScintilla.Scintilla().ReadOnly() != 0;
     if (ro)
         m_scratchScintilla.Scintilla().SetReadOnly(false); // we need write access
     m_scratchScintilla.Scintilla().SetUndoCollection(false);
@@ -624,114 +783,11 @@ CDocument CDocumentManager::LoadFile(HWND hWnd, const std::wstring& path, int en
     Scintilla::DocumentOption docOptions = Scintilla::DocumentOption::TextLarge;
     if (bufferSizeRequested > INT_MAX)
         docOptions = docOptions | Scintilla::DocumentOption::StylesNone;
-    Scintilla::ILoader* pdocLoad = static_cast<Scintilla::ILoader*>(m_scratchScintilla.Scintilla().CreateLoader(static_cast<uptr_t>(bufferSizeRequested), docOptions));
-    if (pdocLoad == nullptr)
-    {
-        ShowFileLoadError(hWnd, path,
-                          CLanguage::Instance().GetTranslatedString(ResString(g_hRes, IDS_ERR_FILETOOBIG)).c_str());
-        return doc;
-    }
-    auto& edit                    = *pdocLoad;
-
-    DWORD lenFile                 = 0;
-    int   incompleteMultiByteChar = 0;
-    bool  bFirst                  = true;
-    bool  preferUtf8              = CIniSettings::Instance().GetInt64(L"Defaults", L"encodingutf8overansi", 0) != 0;
-    bool  useCed                  = CIniSettings::Instance().GetInt64(L"Defaults", L"useCED", 1) != 0;
-    bool  ignoreUnreliable        = CIniSettings::Instance().GetInt64(L"Defaults", L"ignoreUnreliableEncDetection", 0) != 0;
-    bool  inconclusive            = false;
-    bool  encodingSet             = encoding != -1;
-    int   skip                    = 0;
-    do
-    {
-        if (!ReadFile(hFile, m_data + incompleteMultiByteChar, ReadBlockSize - incompleteMultiByteChar, &lenFile, nullptr))
-            lenFile = 0;
-        else
-            lenFile += incompleteMultiByteChar;
-        incompleteMultiByteChar = 0;
-
-        if ((!encodingSet) || (inconclusive && encoding == CP_ACP))
-        {
-            encoding = GetCodepageFromBuf(m_data + skip, lenFile - skip, doc.m_bHasBOM, inconclusive, skip);
-            if (inconclusive || encoding == CP_ACP)
-            {
-                if (inconclusive && encoding == CP_ACP)
-                    encoding = CP_UTF8;
-                if (useCed)
-                {
-                    int  bytesConsumed = 0;
-                    bool isReliable    = false;
-                    auto enc           = CompactEncDet::DetectEncoding(m_data + incompleteMultiByteChar,
-                                                                       lenFile - incompleteMultiByteChar,
-                                                                       nullptr, nullptr, nullptr,
-                                                                       Encoding::UNKNOWN_ENCODING,
-                                                                       Language::UNKNOWN_LANGUAGE,
-                                                                       CompactEncDet::WEB_CORPUS,
-                                                                       true,
-                                                                       &bytesConsumed,
-                                                                       &isReliable);
-                    auto charset       = MimeEncodingName(enc);
-                    if (isReliable || !ignoreUnreliable)
-                    {
-                        Microsoft::WRL::ComPtr<IMultiLanguage> ml;
-                        if (SUCCEEDED(CoCreateInstance(CLSID_CMultiLanguage, nullptr,
-                                                       CLSCTX_ALL,
-                                                       IID_IMultiLanguage, (void**)&ml)))
-                        {
-                            MIMECSETINFO charsetInfo{};
-                            _bstr_t      wCs = CUnicodeUtils::StdGetUnicode(charset).c_str();
-                            if (SUCCEEDED(ml->GetCharsetInfo(wCs, &charsetInfo)))
-                            {
-                                encoding = charsetInfo.uiInternetEncoding;
-                            }
-                            else if (encodings.contains(charset))
-                            {
-                                encoding = encodings.at(charset);
-                            }
-                        }
-                    }
-                }
-            }
-        }
-        encodingSet    = true;
-
-        doc.m_encoding = encoding;
-
-        switch (encoding)
-        {
-            case -1:
-            case CP_UTF8:
-                LoadSomeUtf8(edit, doc.m_bHasBOM, bFirst, lenFile, m_data, doc.m_format, doc.m_tabSpace);
-                break;
-            case 1200: // UTF16_LE
-                loadSomeUtf16Le(edit, doc.m_bHasBOM, bFirst, lenFile, m_data, m_charBuf.get(), m_charBufSize, m_wideBuf.get(), doc.m_format, doc.m_tabSpace);
-                break;
-            case 1201: // UTF16_BE
-                loadSomeUtf16Be(edit, doc.m_bHasBOM, bFirst, lenFile, m_data, m_charBuf.get(), m_charBufSize, m_wideBuf.get(), doc.m_format, doc.m_tabSpace);
-                break;
-            case 12001:                           // UTF32_BE
-                loadSomeUtf32Be(lenFile, m_data); // Doesn't load, falls through to load.
-                [[fallthrough]];
-            case 12000: // UTF32_LE
-                loadSomeUtf32Le(edit, doc.m_bHasBOM, bFirst, lenFile, m_data, m_charBuf.get(), m_charBufSize, m_wideBuf.get(), doc.m_format, doc.m_tabSpace);
-                break;
-            default:
-                LoadSomeOther(edit, encoding, lenFile, incompleteMultiByteChar, m_data, m_charBuf.get(), m_charBufSize, m_wideBuf.get(), doc.m_format, doc.m_tabSpace);
-                break;
-        }
-
-        if (incompleteMultiByteChar != 0) // copy bytes to next buffer
-            memcpy(m_data, m_data + ReadBlockSize - incompleteMultiByteChar, incompleteMultiByteChar);
-
-        bFirst = false;
-    } while (lenFile == ReadBlockSize);
-
-    if (preferUtf8 && inconclusive && doc.m_encoding == CP_ACP)
-        doc.m_encoding = CP_UTF8;
-
-    if (doc.m_format == EOLFormat::Unknown_Format)
-        doc.m_format = EOLFormat::Win_Format;
+    return static_cast<Scintilla::ILoader*>(m_scratchScintilla.Scintilla().CreateLoader(static_cast<uptr_t>(bufferSizeRequested), docOptions));
+}
 
+void CDocumentManager::FinishLoad(Scintilla::ILoader* pdocLoad, bool ro, CDocument& doc)
+{
     auto loadedDoc = pdocLoad->ConvertToDocument();                                                      // loadedDoc has reference count 1
     m_scratchScintilla.Scintilla().SetDocPointer(static_cast<Scintilla::IDocumentEditable*>(loadedDoc)); // doc in scratch has reference count 2 (loadedDoc 1, added one)
     m_scratchScintilla.Scintilla().SetUndoCollection(true);
@@ -743,10 +799,122 @@ CDocument CDocumentManager::LoadFile(HWND hWnd, const std::wstring& path, int en
         m_scratchScintilla.Scintilla().SetReadOnly(true);
     doc.m_document = m_scratchScintilla.Scintilla().DocPointer(); // doc.m_document has reference count of 2
     m_scratchScintilla.Scintilla().SetDocPointer(nullptr);        // now doc.m_document has reference count of 1, and the scratch does not hold any doc anymore
+}
 
-    doc.m_fileSize = fileSize;
+size_t CDocumentManager::GetLoadThreadCount()
+{
+    return std::clamp<size_t>(std::thread::hardware_concurrency(), 1, MAX_LOAD_THREADS);
+}
 
-    return doc;
+bool CDocumentManager::ReadFileAsUtf8(const std::wstring& path, uint64_t maxSize, std::string& text)
+{
+    CAutoFile hFile = CreateFile(path.c_str(), GENERIC_READ, FILE_SHARE_DELETE | FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (!hFile.IsValid())
+        return false;
+    LARGE_INTEGER fileSize{};
+    if (!GetFileSizeEx(hFile, &fileSize) || static_cast<uint64_t>(fileSize.QuadPart) > maxSize)
+        return false;
+
+    constexpr int     wideBufSize = ReadBlockSize * 2;
+    constexpr int     charBufSize = ReadBlockSize * 4;
+    auto              data        = std::make_unique<char[]>(ReadBlockSize + 8);
+    auto              wideBuf     = std::make_unique<wchar_t[]>(wideBufSize);
+    auto              charBuf     = std::make_unique<char[]>(charBufSize);
+    std::vector<char> utf8;
+    utf8.reserve(static_cast<size_t>(fileSize.QuadPart));
+    VectorLoader loader(utf8);
+    CDocument    doc;
+    DecodeFile(hFile, loader, -1, GetLoadSettings(), data.get(), charBuf.get(), charBufSize, wideBuf.get(), doc);
+    text.assign(utf8.begin(), utf8.end());
+    return true;
+}
+
+void CDocumentManager::PreloadFiles(const std::vector<std::wstring>& paths)
+{
+    struct PreloadJob
+    {
+        explicit PreloadJob(HANDLE h)
+            : hFile(h)
+        {
+        }
+        CAutoFile           hFile;
+        Scintilla::ILoader* loader   = nullptr;
+        bool                ro       = false;
+        unsigned __int64    fileSize = 0;
+        CDocument           doc;
+    };
+    // the loaders are created here in the UI thread. Files which can't be
+    // opened are skipped, LoadFile() shows the error for those later.
+    std::vector<std::unique_ptr<PreloadJob>> jobs;
+    std::set<std::wstring>                   queued; ///< a path given twice is only loaded once
+    for (const auto& path : paths)
+    {
+        auto lowerPath = CStringUtils::to_lower(path);
+        if (m_preloaded.contains(lowerPath) || !queued.insert(std::move(lowerPath)).second)
+            continue;
+        auto job = std::make_unique<PreloadJob>(CreateFile(path.c_str(), GENERIC_READ, FILE_SHARE_DELETE | FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr));
+        if (!job->hFile.IsValid())
+            continue;
+        BY_HANDLE_FILE_INFORMATION fi;
+        if (!GetFileInformationByHandle(job->hFile, &fi))
+            continue;
+        job->doc.m_format = EOLFormat::Unknown_Format;
+        SetFileInformation(job->doc, fi, path);
+        job->fileSize = static_cast<__int64>(fi.nFileSizeHigh) << 32 | fi.nFileSizeLow;
+        job->loader   = CreateLoader(job->fileSize, job->ro);
+        if (job->loader == nullptr)
+            continue;
+        jobs.push_back(std::move(job));
+    }
+    if (jobs.empty())
+        return;
+
+#ifdef _DEBUG
+    ProfileTimer timer(L"PreloadFiles");
+#endif
+
+    // reading and decoding the files is what takes the time, and that only
+    // touches the file and the loader of a job: do that in parallel
+    const auto          settings    = GetLoadSettings();
+    std::atomic<size_t> nextJob     = 0;
+    size_t              threadCount = std::clamp<size_t>(GetLoadThreadCount(), 1, jobs.size());
+    auto                decodeJobs  = [&]() {
+        auto data    = std::make_unique<char[]>(ReadBlockSize + 8);
+        auto wideBuf = std::make_unique<wchar_t[]>(m_wideBufSize);
+        auto charBuf = std::make_unique<char[]>(m_charBufSize);
+        for (size_t i = nextJob++; i < jobs.size(); i = nextJob++)
+        {
+            auto& job = *jobs[i];
+            DecodeFile(job.hFile, *job.loader, -1, settings, data.get(), charBuf.get(), m_charBufSize, wideBuf.get(), job.doc);
+        }
+    };
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < threadCount; ++i)
+    {
+        threads.emplace_back([&]() {
+            // the encoding detection uses IMultiLanguage
+            CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+            OnOutOfScope(CoUninitialize());
+            decodeJobs();
+        });
+    }
+    decodeJobs();
+    for (auto& thread : threads)
+        thread.join();
+
+    for (auto& job : jobs)
+    {
+        FinishLoad(job->loader, job->ro, job->doc);
+        job->doc.m_fileSize                                  = job->fileSize;
+        m_preloaded[CStringUtils::to_lower(job->doc.m_path)] = job->doc;
+    }
+}
+
+void CDocumentManager::ClearPreloaded()
+{
+    for (const auto& [path, doc] : m_preloaded)
+        m_scratchScintilla.Scintilla().ReleaseDocument(doc.m_document);
+    m_preloaded.clear();
 }
 
 static bool SaveAsUtf16(const CDocument& doc, char* buf, size_t lengthDoc, CAutoFile& hFile, std::wstring& err)
@@ -1090,6 +1258,18 @@ bool CDocumentManager::SaveFile(HWND hWnd, CDocument& doc, const std::wstring& p
     return SaveDoc(hWnd, path, doc);
 }
 
+CDocument CDocumentManager::CreatePlaceholder(const std::wstring& path)
+{
+    // an empty document which stands in for the file until it is loaded:
+    // the file time stays zero so the placeholder is never reported as
+    // modified from outside.
+    CDocument doc;
+    doc.m_document     = m_scratchScintilla.Scintilla().CreateDocument(0, Scintilla::DocumentOption::Default);
+    doc.m_path         = path;
+    doc.m_bLoadPending = true;
+    return doc;
+}
+
 bool CDocumentManager::UpdateFileTime(CDocument& doc, bool bIncludeReadonly)
 {
     if (doc.m_path.empty())
@@ -1212,6 +1392,16 @@ DocID CDocumentManager::GetIdForPath(const std::wstring& path) const
     return {};
 }
 
+DocID CDocumentManager::GetIdForDocument(Document document) const
+{
+    for (const auto& [docId, doc] : m_documents)
+    {
+        if (doc.m_document == document)
+            return docId;
+    }
+    return {};
+}
+
 void CDocumentManager::RemoveDocument(DocID id)
 {
     const auto& doc = GetDocumentFromID(id);
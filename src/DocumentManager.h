@@ -19,6 +19,11 @@
 
 #include "Document.h"
 
+namespace Scintilla
+{
+class ILoader;
+}
+
 enum class DocModifiedState
 {
     Unmodified,
@@ -87,11 +92,22 @@ public:
     void              RemoveDocument(DocID id);
     int               GetCount() const { return static_cast<int>(m_documents.size()); }
     DocID             GetIdForPath(const std::wstring& path) const;
+    DocID             GetIdForDocument(Document document) const;
     bool              HasDocumentID(DocID id) const;
     const CDocument&  GetDocumentFromID(DocID id) const;
     CDocument&        GetModDocumentFromID(DocID id);
 
     CDocument         LoadFile(HWND hWnd, const std::wstring& path, int encoding, bool createIfMissing);
+    /// reads and decodes the files in several threads at once. LoadFile() then
+    /// returns the preloaded documents instead of reading the files again.
+    /// Files which can't be opened are skipped.
+    void              PreloadFiles(const std::vector<std::wstring>& paths);
+    /// releases the preloaded documents which were not used by LoadFile()
+    void              ClearPreloaded();
+    /// reads a file converted to utf8, with the same encoding detection as when
+    /// opening a file. Can be called from any thread that initialized COM.
+    static bool       ReadFileAsUtf8(const std::wstring& path, uint64_t maxSize, std::string& text);
+    CDocument         CreatePlaceholder(const std::wstring& path);
     bool              SaveFile(HWND hWnd, CDocument& doc, bool& bTabMoved) const;
     bool              SaveFile(HWND hWnd, CDocument& doc, const std::wstring& path) const;
     static bool       UpdateFileTime(CDocument& doc, bool bIncludeReadonly);
@@ -99,15 +115,19 @@ public:
     std::vector<char> ReadNewData(CDocument& doc);
 
 private:
-    bool SaveDoc(HWND hWnd, const std::wstring& path, const CDocument& doc) const;
+    bool                SaveDoc(HWND hWnd, const std::wstring& path, const CDocument& doc) const;
+    Scintilla::ILoader* CreateLoader(unsigned __int64 fileSize, bool& ro);
+    void                FinishLoad(Scintilla::ILoader* pdocLoad, bool ro, CDocument& doc);
+    static size_t       GetLoadThreadCount();
 
 private:
-    std::map<DocID, CDocument> m_documents;
-    CScintillaWnd              m_scratchScintilla;
+    std::map<DocID, CDocument>        m_documents;
+    CScintillaWnd                     m_scratchScintilla;
+    std::map<std::wstring, CDocument> m_preloaded; ///< by lower case path
 
-    char                       m_data[ReadBlockSize + 8];
-    const int                  m_wideBufSize = ReadBlockSize * 2;
-    std::unique_ptr<wchar_t[]> m_wideBuf;
-    const int                  m_charBufSize = ReadBlockSize * 4;
-    std::unique_ptr<char[]>    m_charBuf;
+    char                              m_data[ReadBlockSize + 8];
+    const int                         m_wideBufSize = ReadBlockSize * 2;
+    std::unique_ptr<wchar_t[]>        m_wideBuf;
+    const int                         m_charBufSize = ReadBlockSize * 4;
+    std::unique_ptr<char[]>           m_charBuf;
 };
@@ -25,6 +25,11 @@
 #include "OnOutOfScope.h"
 #include "GDIHelpers.h"
 #include "DirFileEnum.h"
+#include "SmartHandle.h"
+#include "BinaryData.h"
+
+#include <fstream>
+#include <string_view>
 
 namespace
 {
@@ -35,6 +40,188 @@ const std::vector<std::string>             emptyStringVector;
 
 constexpr COLORREF                         fgColor = RGB(0, 0, 0);
 constexpr COLORREF                         bgColor = RGB(255, 255, 255);
+
+constexpr uint32_t                         cacheMagic   = 0x43534C42; // "BLSC"
+// must be increased whenever the cache format or the parsing changes
+constexpr uint32_t                         cacheVersion = 1;
+
+void PutStyle(std::string& out, const StyleData& style)
+{
+    PutString(out, style.name);
+    Put(out, static_cast<uint32_t>(style.foregroundColor));
+    Put(out, static_cast<uint32_t>(style.backgroundColor));
+    PutString(out, style.fontName);
+    Put(out, static_cast<int32_t>(style.fontStyle));
+    Put(out, static_cast<int32_t>(style.fontSize));
+    Put(out, static_cast<uint8_t>(style.eolFilled ? 1 : 0));
+}
+
+bool GetStyle(CReader& reader, StyleData& style)
+{
+    uint32_t fg        = 0;
+    uint32_t bg        = 0;
+    int32_t  fontStyle = 0;
+    int32_t  fontSize  = 0;
+    uint8_t  eolFilled = 0;
+    if (!reader.GetString(style.name) || !reader.Get(fg) || !reader.Get(bg) || !reader.GetString(style.fontName) ||
+        !reader.Get(fontStyle) || !reader.Get(fontSize) || !reader.Get(eolFilled))
+        return false;
+    style.foregroundColor = fg;
+    style.backgroundColor = bg;
+    style.fontStyle       = static_cast<FontStyle>(fontStyle);
+    style.fontSize        = fontSize;
+    style.eolFilled       = eolFilled != 0;
+    return true;
+}
+
+void PutLexer(std::string& out, const LexerData& lexer)
+{
+    Put(out, static_cast<int32_t>(lexer.id));
+    PutString(out, lexer.name);
+    Put(out, static_cast<uint32_t>(lexer.styles.size()));
+    for (const auto& [id, style] : lexer.styles)
+    {
+        Put(out, static_cast<int32_t>(id));
+        PutStyle(out, style);
+    }
+    PutStringMap(out, lexer.properties);
+    Put(out, static_cast<uint32_t>(lexer.annotations.size()));
+    for (const auto& rule : lexer.annotations)
+    {
+        PutString(out, rule.pattern);
+        PutString(out, rule.text);
+    }
+}
+
+bool GetLexer(CReader& reader, LexerData& lexer)
+{
+    int32_t  id    = 0;
+    uint32_t count = 0;
+    if (!reader.Get(id) || !reader.GetString(lexer.name) || !reader.Get(count))
+        return false;
+    lexer.id = id;
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        int32_t   styleId = 0;
+        StyleData style;
+        if (!reader.Get(styleId) || !GetStyle(reader, style))
+            return false;
+        lexer.styles[styleId] = std::move(style);
+    }
+    if (!reader.GetStringMap(lexer.properties) || !reader.Get(count))
+        return false;
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        AnnotationRule rule;
+        if (!reader.GetString(rule.pattern) || !reader.GetString(rule.text))
+            return false;
+        // the patterns were valid when the cache was written
+        try
+        {
+            rule.regex = std::make_shared<const std::regex>(rule.pattern, std::regex_constants::icase);
+            lexer.annotations.push_back(std::move(rule));
+        }
+        catch (const std::exception&)
+        {
+        }
+    }
+    return true;
+}
+
+void PutLanguage(std::string& out, const LanguageData& lang)
+{
+    Put(out, static_cast<int32_t>(lang.lexer));
+    Put(out, static_cast<uint32_t>(lang.keywordList.size()));
+    for (const auto& [id, keywords] : lang.keywordList)
+    {
+        Put(out, static_cast<int32_t>(id));
+        PutString(out, keywords);
+    }
+    PutString(out, lang.commentLine);
+    Put(out, static_cast<uint8_t>(lang.commentLineAtStart ? 1 : 0));
+    PutString(out, lang.commentStreamStart);
+    PutString(out, lang.commentStreamEnd);
+    PutString(out, lang.functionRegex);
+    Put(out, static_cast<uint32_t>(lang.functionRegexTrim.size()));
+    for (const auto& trim : lang.functionRegexTrim)
+        PutString(out, trim);
+    Put(out, static_cast<int32_t>(lang.functionRegexSort));
+    PutString(out, lang.autoCompleteRegex);
+    Put(out, static_cast<int32_t>(lang.userFunctions));
+    PutString(out, lang.autocompletionWords);
+}
+
+bool GetLanguage(CReader& reader, LanguageData& lang)
+{
+    int32_t  lexer = 0;
+    uint32_t count = 0;
+    if (!reader.Get(lexer) || !reader.Get(count))
+        return false;
+    lang.lexer = lexer;
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        int32_t id = 0;
+        if (!reader.Get(id) || !reader.GetString(lang.keywordList[id]))
+            return false;
+    }
+    uint8_t commentLineAtStart = 0;
+    if (!reader.GetString(lang.commentLine) || !reader.Get(commentLineAtStart) || !reader.GetString(lang.commentStreamStart) ||
+        !reader.GetString(lang.commentStreamEnd) || !reader.GetString(lang.functionRegex) || !reader.Get(count))
+        return false;
+    lang.commentLineAtStart = commentLineAtStart != 0;
+    lang.functionRegexTrim.resize(count);
+    for (auto& trim : lang.functionRegexTrim)
+    {
+        if (!reader.GetString(trim))
+            return false;
+    }
+    int32_t functionRegexSort = 0;
+    int32_t userFunctions     = 0;
+    if (!reader.Get(functionRegexSort) || !reader.GetString(lang.autoCompleteRegex) || !reader.Get(userFunctions) ||
+        !reader.GetString(lang.autocompletionWords))
+        return false;
+    lang.functionRegexSort = functionRegexSort;
+    lang.userFunctions     = userFunctions;
+    return true;
+}
+
+// the same case folding _stricmp() does for the extensions and file names
+std::string LowerAscii(std::string s)
+{
+    std::transform(s.begin(), s.end(), s.begin(), [](char c) { return static_cast<char>(::tolower(static_cast<unsigned char>(c))); });
+    return s;
+}
+
+// FNV-1a
+uint64_t HashData(uint64_t hash, const void* data, size_t size)
+{
+    const auto* bytes = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < size; ++i)
+    {
+        hash ^= bytes[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+// identifies the content the cache was built from: the embedded
+// styles and the path, size and modification time of the user files
+uint64_t GetCacheStamp(const char* resData, DWORD resLen, const std::vector<std::wstring>& userFiles)
+{
+    uint64_t hash = HashData(14695981039346656037ULL, &cacheVersion, sizeof(cacheVersion));
+    if (resData)
+        hash = HashData(hash, resData, resLen);
+    for (const auto& file : userFiles)
+    {
+        WIN32_FILE_ATTRIBUTE_DATA fad{};
+        GetFileAttributesEx(file.c_str(), GetFileExInfoStandard, &fad);
+        hash = HashData(hash, file.c_str(), file.size() * sizeof(wchar_t));
+        hash = HashData(hash, &fad.ftLastWriteTime, sizeof(fad.ftLastWriteTime));
+        hash = HashData(hash, &fad.nFileSizeLow, sizeof(fad.nFileSizeLow));
+        hash = HashData(hash, &fad.nFileSizeHigh, sizeof(fad.nFileSizeHigh));
+    }
+    return hash;
+}
 }; // namespace
 
 struct LexDetectStrings
@@ -66,6 +253,8 @@ static std::vector<LexDetectStrings> lexDetectStrings = {
     {"-Java", "#!groovy"},
     {"-Java", "#!/usr/bin/env groovy"},
     {"-JavaScript", "#!/usr/bin/env zx"}};
+// the detection strings added by the config files follow these
+static const size_t builtinDetectStrings = lexDetectStrings.size();
 
 StyleData::StyleData()
     : foregroundColor(fgColor)
@@ -78,6 +267,7 @@ StyleData::StyleData()
 
 CLexStyles::CLexStyles()
     : m_bLoaded(false)
+    , m_generation(0)
 {
 }
 
@@ -164,35 +354,54 @@ void CLexStyles::ParseStyle(
 
 void CLexStyles::Load()
 {
-    std::vector<std::tuple<std::unique_ptr<CSimpleIni>, bool>> inis;
-    DWORD                                                      resLen  = 0;
-    const char*                                                resData = CAppUtils::GetResourceData(L"config", IDR_LEXSTYLES, resLen);
-    if (resData != nullptr)
-    {
-        inis.push_back(std::make_tuple(std::make_unique<CSimpleIni>(), false));
-        std::get<0>(inis.back())->SetUnicode();
-        std::get<0>(inis.back())->LoadFile(resData, resLen);
-    }
+    DWORD                     resLen  = 0;
+    const char*               resData = CAppUtils::GetResourceData(L"config", IDR_LEXSTYLES, resLen);
 
-    CDirFileEnum enumerator(CAppUtils::GetDataPath());
-    bool         bIsDir = false;
-    std::wstring path;
+    std::vector<std::wstring> userFiles;
+    CDirFileEnum              enumerator(CAppUtils::GetDataPath());
+    bool                      bIsDir = false;
+    std::wstring              path;
     while (enumerator.NextFile(path, &bIsDir, false))
     {
         if (CPathUtils::GetFileExtension(path) == L"bplex")
-        {
-            inis.push_back(std::make_tuple(std::make_unique<CSimpleIni>(), true));
-            std::get<0>(inis.back())->SetUnicode();
-            std::get<0>(inis.back())->LoadFile(path.c_str());
-        }
+            userFiles.push_back(path);
     }
-
     std::wstring userStyleFile = CAppUtils::GetDataPath() + L"\\userconfig";
     if (PathFileExists(userStyleFile.c_str()))
+        userFiles.push_back(std::move(userStyleFile));
+
+    // parsing the ini files takes a while, so the result is cached
+    // until the embedded styles or one of the user files change
+    const auto cachePath = CAppUtils::GetDataPath() + L"\\lexstyles.bpcache";
+    const auto stamp     = GetCacheStamp(resData, resLen, userFiles);
+    if (!LoadCache(cachePath, stamp))
+    {
+        Clear();
+        Parse(resData, resLen, userFiles);
+        SaveCache(cachePath, stamp);
+    }
+    for (auto& [name, mask] : m_fileTypes)
+        m_filterSpec.push_back({name.c_str(), mask.c_str()});
+
+    BuildLanguageIndex();
+    ++m_generation;
+    m_bLoaded = true;
+}
+
+void CLexStyles::Parse(const char* resData, DWORD resLen, const std::vector<std::wstring>& userFiles)
+{
+    std::vector<std::tuple<std::unique_ptr<CSimpleIni>, bool>> inis;
+    if (resData != nullptr)
+    {
+        inis.push_back(std::make_tuple(std::make_unique<CSimpleIni>(), false));
+        std::get<0>(inis.back())->SetUnicode();
+        std::get<0>(inis.back())->LoadFile(resData, resLen);
+    }
+    for (const auto& userFile : userFiles)
     {
         inis.push_back(std::make_tuple(std::make_unique<CSimpleIni>(), true));
         std::get<0>(inis.back())->SetUnicode();
-        std::get<0>(inis.back())->LoadFile(userStyleFile.c_str());
+        std::get<0>(inis.back())->LoadFile(userFile.c_str());
     }
 
     std::unordered_map<std::wstring, std::wstring> variables;
@@ -300,9 +509,24 @@ void CLexStyles::Load()
             }
             if (!annotations.empty())
             {
+                // rules are ordered by their regex, a later rule with the same regex wins
+                std::map<std::string, std::string> rules;
                 for (const auto& data : annotations)
                 {
-                    lexerData.annotations[data.second.sRegex] = data.second.sText;
+                    rules[data.second.sRegex] = data.second.sText;
+                }
+                lexerData.annotations.clear();
+                for (auto& [sRegex, sText] : rules)
+                {
+                    try
+                    {
+                        auto rx = std::make_shared<const std::regex>(sRegex, std::regex_constants::icase);
+                        lexerData.annotations.push_back({std::move(rx), std::move(sText), sRegex});
+                    }
+                    catch (const std::exception&)
+                    {
+                        // invalid regex: the rule is ignored
+                    }
                 }
             }
             m_lexerData[lexerData.id] = std::move(lexerData);
@@ -498,10 +722,178 @@ void CLexStyles::Load()
         return _wcsicmp(first.first.c_str(), second.first.c_str()) < 0;
     });
     m_fileTypes.push_front(std::make_pair(TEXT("All files"), TEXT("*.*")));
-    for (auto& [name, mask] : m_fileTypes)
-        m_filterSpec.push_back({name.c_str(), mask.c_str()});
+}
 
-    m_bLoaded = true;
+bool CLexStyles::LoadCache(const std::wstring& cachePath, uint64_t stamp)
+{
+    CAutoFile hFile = CreateFile(cachePath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (!hFile.IsValid())
+        return false;
+    LARGE_INTEGER fileSize{};
+    if (!GetFileSizeEx(hFile, &fileSize) || fileSize.QuadPart == 0 || static_cast<uint64_t>(fileSize.QuadPart) > SIZE_MAX)
+        return false;
+    CAutoFile hFileMapping = CreateFileMapping(hFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!hFileMapping)
+        return false;
+    auto view = MapViewOfFile(hFileMapping, FILE_MAP_READ, 0, 0, 0);
+    if (!view)
+        return false;
+    OnOutOfScope(UnmapViewOfFile(view););
+
+    CReader  reader(std::string_view(static_cast<const char*>(view), static_cast<size_t>(fileSize.QuadPart)));
+    uint32_t magic      = 0;
+    uint32_t version    = 0;
+    uint64_t cacheStamp = 0;
+    if (!reader.Get(magic) || magic != cacheMagic || !reader.Get(version) || version != cacheVersion ||
+        !reader.Get(cacheStamp) || cacheStamp != stamp)
+        return false;
+
+    uint32_t count = 0;
+    if (!reader.Get(count))
+        return false;
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        std::string language;
+        if (!reader.GetString(language) || !GetLanguage(reader, m_langData[language]))
+            return false;
+    }
+    for (auto* lexers : {&m_lexerData, &m_userLexerData})
+    {
+        if (!reader.Get(count))
+            return false;
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            LexerData lexer;
+            if (!GetLexer(reader, lexer))
+                return false;
+            (*lexers)[lexer.id] = std::move(lexer);
+        }
+    }
+    if (!reader.Get(count))
+        return false;
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        int32_t lexer = 0;
+        if (!reader.Get(lexer) || !reader.GetString(m_lexerSection[lexer]))
+            return false;
+    }
+    if (!reader.GetStringMap(m_extLang) || !reader.GetStringMap(m_fileLang) || !reader.GetStringMap(m_userExtLang) ||
+        !reader.GetStringMap(m_autoExtLang) || !reader.GetStringMap(m_pathsLang))
+        return false;
+    if (!reader.Get(count))
+        return false;
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        std::wstring p;
+        if (!reader.GetString(p))
+            return false;
+        m_pathsForLang.push_back(std::move(p));
+    }
+    if (!reader.Get(count))
+        return false;
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        std::wstring hidden;
+        if (!reader.GetString(hidden))
+            return false;
+        m_hiddenLangs.insert(std::move(hidden));
+    }
+    if (!reader.Get(count))
+        return false;
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        std::wstring name;
+        std::wstring mask;
+        if (!reader.GetString(name) || !reader.GetString(mask))
+            return false;
+        m_fileTypes.emplace_back(std::move(name), std::move(mask));
+    }
+    if (!reader.Get(count))
+        return false;
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        LexDetectStrings lds;
+        uint32_t         numExts = 0;
+        if (!reader.GetString(lds.lang) || !reader.GetString(lds.firstLine) || !reader.Get(numExts))
+            return false;
+        lds.extensions.resize(numExts);
+        for (auto& ext : lds.extensions)
+        {
+            if (!reader.GetString(ext))
+                return false;
+        }
+        lexDetectStrings.push_back(std::move(lds));
+    }
+    return true;
+}
+
+bool CLexStyles::SaveCache(const std::wstring& cachePath, uint64_t stamp) const
+{
+    std::string data;
+    Put(data, cacheMagic);
+    Put(data, cacheVersion);
+    Put(data, stamp);
+    Put(data, static_cast<uint32_t>(m_langData.size()));
+    for (const auto& [language, langData] : m_langData)
+    {
+        PutString(data, language);
+        PutLanguage(data, langData);
+    }
+    for (const auto* lexers : {&m_lexerData, &m_userLexerData})
+    {
+        Put(data, static_cast<uint32_t>(lexers->size()));
+        for (const auto& [id, lexer] : *lexers)
+            PutLexer(data, lexer);
+    }
+    Put(data, static_cast<uint32_t>(m_lexerSection.size()));
+    for (const auto& [lexer, section] : m_lexerSection)
+    {
+        Put(data, static_cast<int32_t>(lexer));
+        PutString(data, section);
+    }
+    PutStringMap(data, m_extLang);
+    PutStringMap(data, m_fileLang);
+    PutStringMap(data, m_userExtLang);
+    PutStringMap(data, m_autoExtLang);
+    PutStringMap(data, m_pathsLang);
+    Put(data, static_cast<uint32_t>(m_pathsForLang.size()));
+    for (const auto& p : m_pathsForLang)
+        PutString(data, p);
+    Put(data, static_cast<uint32_t>(m_hiddenLangs.size()));
+    for (const auto& hidden : m_hiddenLangs)
+        PutString(data, hidden);
+    PutStringMap(data, m_fileTypes);
+    Put(data, static_cast<uint32_t>(lexDetectStrings.size() - builtinDetectStrings));
+    for (size_t i = builtinDetectStrings; i < lexDetectStrings.size(); ++i)
+    {
+        const auto& lds = lexDetectStrings[i];
+        PutString(data, lds.lang);
+        PutString(data, lds.firstLine);
+        Put(data, static_cast<uint32_t>(lds.extensions.size()));
+        for (const auto& ext : lds.extensions)
+            PutString(data, ext);
+    }
+
+    // write a temp file first so a crash can't leave a half written cache
+    const auto tempPath = cachePath + L".tmp";
+    {
+        std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+        if (!file.good())
+            return false;
+        file.write(data.data(), static_cast<std::streamsize>(data.size()));
+        if (!file.good())
+        {
+            file.close();
+            DeleteFile(tempPath.c_str());
+            return false;
+        }
+    }
+    if (!MoveFileEx(tempPath.c_str(), cachePath.c_str(), MOVEFILE_REPLACE_EXISTING))
+    {
+        DeleteFile(tempPath.c_str());
+        return false;
+    }
+    return true;
 }
 
 const std::unordered_map<int, std::string>& CLexStyles::GetKeywordsForLang(const std::string& lang)
@@ -574,6 +966,12 @@ void CLexStyles::GenerateUserKeywords(LanguageData& ld)
 }
 
 void CLexStyles::Reload()
+{
+    Clear();
+    Load();
+}
+
+void CLexStyles::Clear()
 {
     m_extLang.clear();
     m_fileLang.clear();
@@ -588,8 +986,37 @@ void CLexStyles::Reload()
     m_fileTypes.clear();
     m_filterSpec.clear();
     m_hiddenLangs.clear();
+    lexDetectStrings.resize(builtinDetectStrings);
+    BuildLanguageIndex();
+}
 
-    Load();
+void CLexStyles::BuildLanguageIndex()
+{
+    // the first of several entries that only differ in case wins,
+    // just like it did when searching through the sorted maps
+    m_pathsLangIndex.clear();
+    m_fileLangIndex.clear();
+    m_extLangIndex.clear();
+    for (const auto& [path, lang] : m_pathsLang)
+        m_pathsLangIndex.try_emplace(CStringUtils::to_lower(path), lang);
+    for (const auto& [file, lang] : m_fileLang)
+        m_fileLangIndex.try_emplace(LowerAscii(file), lang);
+    for (const auto& [ext, lang] : m_extLang)
+        m_extLangIndex.try_emplace(LowerAscii(ext), lang);
+    for (const auto& [ext, lang] : m_autoExtLang)
+        m_extLangIndex.try_emplace(LowerAscii(ext), lang);
+
+    m_detectExts.clear();
+    for (auto& candidates : m_detectByFirstChar)
+        candidates.clear();
+    for (uint32_t i = 0; i < static_cast<uint32_t>(lexDetectStrings.size()); ++i)
+    {
+        const auto& m = lexDetectStrings[i];
+        for (const auto& e : m.extensions)
+            m_detectExts.insert(LowerAscii(e));
+        if (!m.firstLine.empty())
+            m_detectByFirstChar[static_cast<unsigned char>(m.firstLine[0])].push_back(i);
+    }
 }
 
 const LexerData& CLexStyles::GetLexerDataForLang(const std::string& lang) const
@@ -624,72 +1051,58 @@ const std::string& CLexStyles::GetLanguageForLexer(int lexer) const
 
 std::string CLexStyles::GetLanguageForPath(const std::wstring& path)
 {
-    auto it = std::ranges::find_if(m_pathsLang, [&](const auto& toFind) {
-        return _wcsicmp(toFind.first.c_str(), path.c_str()) == 0;
-    });
-    if (it != m_pathsLang.end())
+    // move the path to the top of the list, if it's not there already
+    if (m_pathsLangIndex.contains(CStringUtils::to_lower(path)) &&
+        (m_pathsForLang.empty() || _wcsicmp(m_pathsForLang.front().c_str(), path.c_str()) != 0))
     {
-        // move the path to the top of the list
-        for (auto li = m_pathsForLang.begin(); li != m_pathsForLang.end(); ++li)
-        {
-            if (_wcsicmp(it->first.c_str(), li->c_str()) == 0)
-            {
-                m_pathsForLang.erase(li);
-                m_pathsForLang.push_front(it->first);
-                break;
-            }
-        }
-        return it->second;
+        auto li = std::ranges::find_if(m_pathsForLang, [&](const auto& toFind) {
+            return _wcsicmp(toFind.c_str(), path.c_str()) == 0;
+        });
+        if (li != m_pathsForLang.end())
+            m_pathsForLang.splice(m_pathsForLang.begin(), m_pathsForLang, li);
     }
+    return FindLanguageForPath(path);
+}
 
-    auto pathA = CUnicodeUtils::StdGetUTF8(CPathUtils::GetFileName(path));
-    auto fit   = std::ranges::find_if(m_fileLang, [&](const auto& toFind) {
-        return _stricmp(toFind.first.c_str(), pathA.c_str()) == 0;
-    });
-
-    if (fit != m_fileLang.end())
+std::string CLexStyles::FindLanguageForPath(const std::wstring& path) const
+{
+    if (!m_pathsLangIndex.empty())
     {
-        return fit->second;
+        auto it = m_pathsLangIndex.find(CStringUtils::to_lower(path));
+        if (it != m_pathsLangIndex.end())
+            return it->second;
     }
-    auto ext = CUnicodeUtils::StdGetUTF8(CPathUtils::GetFileExtension(path));
 
-    auto eit = std::ranges::find_if(m_extLang, [&](const auto& toFind) {
-        return _stricmp(toFind.first.c_str(), ext.c_str()) == 0;
-    });
-    if (eit != m_extLang.end())
-    {
-        return eit->second;
-    }
+    auto fit = m_fileLangIndex.find(LowerAscii(CUnicodeUtils::StdGetUTF8(CPathUtils::GetFileName(path))));
+    if (fit != m_fileLangIndex.end())
+        return fit->second;
 
-    auto ait = std::ranges::find_if(m_autoExtLang, [&](const auto& toFind) {
-        return _stricmp(toFind.first.c_str(), ext.c_str()) == 0;
-    });
-    if (ait != m_autoExtLang.end())
-    {
-        return ait->second;
-    }
+    auto eit = m_extLangIndex.find(LowerAscii(CUnicodeUtils::StdGetUTF8(CPathUtils::GetFileExtension(path))));
+    if (eit != m_extLangIndex.end())
+        return eit->second;
     return "";
 }
 
-std::string CLexStyles::GetLanguageForDocument(const CDocument& doc, const CScintillaWnd& edit)
+// Returns the language of every known file extension as GetLanguageForPath()
+// resolves it from the extension alone. The extensions are lower case.
+std::map<std::string, std::string> CLexStyles::GetLanguagesForExtensions() const
+{
+    std::map<std::string, std::string> languages;
+    for (const auto& [ext, lang] : m_extLang)
+        languages.try_emplace(LowerAscii(ext), lang);
+    for (const auto& [ext, lang] : m_autoExtLang)
+        languages.try_emplace(LowerAscii(ext), lang);
+    return languages;
+}
+
+std::string CLexStyles::GetLanguageForDocument(const CDocument& doc, const CScintillaWnd& edit) const
 {
     if (doc.m_path.empty())
         return "Text";
-    auto sExt           = CUnicodeUtils::StdGetUTF8(CPathUtils::GetFileExtension(doc.m_path));
-    bool hasExtOverride = false;
-    for (const auto& m : lexDetectStrings)
-    {
-        for (const auto& e : m.extensions)
-        {
-            if (_stricmp(sExt.c_str(), e.c_str()) == 0)
-            {
-                hasExtOverride = true;
-                break;
-            }
-        }
-    }
+    auto sExt           = LowerAscii(CUnicodeUtils::StdGetUTF8(CPathUtils::GetFileExtension(doc.m_path)));
+    bool hasExtOverride = m_detectExts.contains(sExt);
 
-    auto lang = GetLanguageForPath(doc.m_path);
+    auto lang = FindLanguageForPath(doc.m_path);
     if (!lang.empty() && !hasExtOverride)
         return lang;
 
@@ -701,17 +1114,30 @@ std::string CLexStyles::GetLanguageForDocument(const CDocument& doc, const CScin
     OnOutOfScope(
         edit.Scintilla().SetDocPointer(nullptr););
 
-    std::string line = edit.GetLine(0);
-    for (const auto& m : lexDetectStrings)
+    // all detection strings are checked in one pass over the line: at every
+    // position only the strings starting with that character are compared.
+    // If several strings match, the first one in the list wins.
+    std::string line  = edit.GetLine(0);
+    size_t      found = lexDetectStrings.size();
+    for (size_t pos = 0; pos < line.size() && found > 0; ++pos)
     {
-        auto foundPos = line.find(m.firstLine);
-        if (((m.lang[0] == '-') && (foundPos == 0)) ||
-            ((m.lang[0] == '+') && (foundPos != std::string::npos)))
+        for (const auto i : m_detectByFirstChar[static_cast<unsigned char>(line[pos])])
         {
-            lang = &m.lang[1];
-            break;
+            if (i >= found)
+                break;
+            const auto& m = lexDetectStrings[i];
+            if (((m.lang[0] == '-') && (pos == 0)) || (m.lang[0] == '+'))
+            {
+                if (line.compare(pos, m.firstLine.size(), m.firstLine) == 0)
+                {
+                    found = i;
+                    break;
+                }
+            }
         }
     }
+    if (found < lexDetectStrings.size())
+        lang = &lexDetectStrings[found].lang[1];
     // Unknown language,use "Text" as default
     if (lang.empty())
         lang = "Text";
@@ -896,15 +1322,8 @@ void CLexStyles::SetUserFontStyle(int id, int style, FontStyle fontstyle)
 
 void CLexStyles::ResetUserData()
 {
-    m_userLexerData.clear();
-    m_userExtLang.clear();
-    m_extLang.clear();
-    m_langData.clear();
-    m_lexerData.clear();
-    m_fileTypes.clear();
-    m_filterSpec.clear();
-    m_hiddenLangs.clear();
-    Load();
+    // drop the unsaved changes by loading everything again
+    Reload();
 }
 
 void CLexStyles::ResetUserData(const std::string& language)
@@ -1170,6 +1589,7 @@ void CLexStyles::SetLangForPath(const std::wstring& path, const std::string& lan
                 // set user selected language as the default for this extension
                 m_autoExtLang.erase(e);
                 m_autoExtLang[e] = language;
+                BuildLanguageIndex();
                 SaveUserData();
                 return;
             }
@@ -1178,6 +1598,7 @@ void CLexStyles::SetLangForPath(const std::wstring& path, const std::string& lan
         }
         // store the full path and the language
         m_pathsLang[path] = language;
+        BuildLanguageIndex();
         m_pathsForLang.push_front(path);
         while (m_pathsForLang.size() > 100)
             m_pathsForLang.pop_back();
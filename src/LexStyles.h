@@ -18,12 +18,15 @@
 #include "Document.h"
 #include "ScintillaWnd.h"
 
+#include <array>
 #include <string>
 #include <map>
 #include <set>
 #include <unordered_set>
 #include <unordered_map>
 #include <vector>
+#include <memory>
+#include <regex>
 
 class LanguageData
 {
@@ -76,6 +79,14 @@ public:
     bool         eolFilled;
 };
 
+class AnnotationRule
+{
+public:
+    std::shared_ptr<const std::regex> regex;
+    std::string                       text;
+    std::string                       pattern; // the regex source, for the cache
+};
+
 class LexerData
 {
 public:
@@ -87,17 +98,21 @@ public:
     std::string                        name;
     std::unordered_map<int, StyleData> styles;
     std::map<std::string, std::string> properties;
-    std::map<std::string, std::string> annotations;
+    // compiled once when the styles are loaded, evaluated in order
+    std::vector<AnnotationRule>        annotations;
 };
 
 class CLexStyles
 {
 public:
     static CLexStyles&                           Instance();
+    /// changes every time the styles are loaded again
+    unsigned                                     GetGeneration() const { return m_generation; }
 
     std::vector<std::wstring>                    GetLanguages() const;
     std::map<std::string, LanguageData>&         GetLanguageDataMap();
-    std::string                                  GetLanguageForDocument(const CDocument& doc, const CScintillaWnd& edit);
+    /// only reads the styles, so it can be called from the search threads
+    std::string                                  GetLanguageForDocument(const CDocument& doc, const CScintillaWnd& edit) const;
     std::wstring                                 GetUserExtensionsForLanguage(const std::wstring& lang) const;
     bool                                         GetDefaultExtensionForLanguage(const std::string& lang, std::wstring& ext, UINT& index) const;
     bool                                         IsLanguageHidden(const std::wstring& lang) const;
@@ -134,7 +149,9 @@ public:
     void                                         ResetUserData(const std::string& language);
     void                                         SaveUserData();
     bool                                         AddUserFunctionForLang(const std::string& lang, const std::string& fnc);
+    /// also moves a path with a language set by the user to the top of the recent paths
     std::string                                  GetLanguageForPath(const std::wstring& path);
+    std::map<std::string, std::string>           GetLanguagesForExtensions() const;
     static void                                  GenerateUserKeywords(LanguageData& ld);
     void                                         Reload();
 
@@ -143,6 +160,12 @@ private:
     ~CLexStyles();
 
     void        Load();
+    void        Parse(const char* resData, DWORD resLen, const std::vector<std::wstring>& userFiles);
+    void        Clear();
+    bool        LoadCache(const std::wstring& cachePath, uint64_t stamp);
+    bool        SaveCache(const std::wstring& cachePath, uint64_t stamp) const;
+    void        BuildLanguageIndex();
+    std::string FindLanguageForPath(const std::wstring& path) const;
     static void ReplaceVariables(std::wstring& s, const std::unordered_map<std::wstring, std::wstring>& vars);
     static void ParseStyle(LPCWSTR                                               styleName,
                            LPCWSTR                                               styleString,
@@ -151,6 +174,7 @@ private:
 
 private:
     bool                                             m_bLoaded;
+    unsigned                                         m_generation;
 
     // Different languages may have the same file extension
     std::multimap<std::string, std::string>          m_extLang;
@@ -168,4 +192,13 @@ private:
     // Used by the Save File Dialog filter.
     std::list<std::pair<std::wstring, std::wstring>> m_fileTypes;
     std::vector<COMDLG_FILTERSPEC>                   m_filterSpec;
+
+    // case folded indexes for GetLanguageForPath() and GetLanguageForDocument(),
+    // rebuilt in the UI thread whenever the maps above change
+    std::unordered_map<std::wstring, std::string>    m_pathsLangIndex;
+    std::unordered_map<std::string, std::string>     m_fileLangIndex;
+    std::unordered_map<std::string, std::string>     m_extLangIndex; // m_extLang, then m_autoExtLang
+    std::unordered_set<std::string>                  m_detectExts;
+    // indexes into the detection strings, by the first character of the string
+    std::array<std::vector<uint32_t>, 256>           m_detectByFirstChar;
 };
@@ -366,3 +366,15 @@ void CMRU::PinPath(const std::wstring& path, bool bPin)
         }
     }
 }
+
+std::vector<std::wstring> CMRU::GetRecentPaths()
+{
+    if (!m_bLoaded)
+        Load();
+
+    std::vector<std::wstring> paths;
+    paths.reserve(m_mruVec.size());
+    for (auto it = m_mruVec.crbegin(); it != m_mruVec.crend(); ++it)
+        paths.push_back(it->path);
+    return paths;
+}
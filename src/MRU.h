@@ -39,6 +39,8 @@ public:
     void                            AddPath(const std::wstring& path);
     void                            RemovePath(const std::wstring& path, bool removeEvenIfPinned);
     void                            PinPath(const std::wstring& path, bool bPin);
+    /// returns the paths of the MRU list, the most recently used path first
+    std::vector<std::wstring>       GetRecentPaths();
 
 private:
     static std::wstring GetMRUFilename();
@@ -46,6 +46,7 @@
 #include "Monitor.h"
 #include "ResString.h"
 #include "AutoCloakWindow.h"
+#include "SymbolIndex.h"
 #include "../ext/tinyexpr/tinyexpr.h"
 
 #include <memory>
@@ -97,6 +98,8 @@ constexpr int                 TIMER_UPDATECHECK                  = 101;
 constexpr int                 TIMER_SELCHANGE                    = 102;
 constexpr int                 TIMER_CHECKLINES                   = 103;
 constexpr int                 TIMER_DWELLEND                     = 104;
+constexpr int                 TIMER_LOADPENDING                  = 105;
+constexpr UINT                LOADPENDING_DELAY                  = 200; // ms between loading placeholder tabs in the background
 
 ResponseToOutsideModifiedFile responseToOutsideModifiedFile      = ResponseToOutsideModifiedFile::Reload;
 BOOL                          responseToOutsideModifiedFileDoAll = FALSE;
@@ -231,8 +234,6 @@ CMainWindow::CMainWindow(HINSTANCE hInst, const WNDCLASSEX* wcx /* = nullptr*/)
     , m_autoCompleter(this, &m_editor)
     , m_dwellStartPos(-1)
     , m_bBlockAutoIndent(false)
-    , m_annotationsLastEndLine(0)
-    , m_annotationsLastStartLine(0)
     , m_hShieldIcon(nullptr)
     , m_hCapsLockIcon(nullptr)
     , m_hLexerIcon(nullptr)
@@ -571,6 +572,13 @@ void CMainWindow::ShowCommandPalette()
     SetWindowPos(*m_commandPaletteDlg, nullptr,
                  pos.left, pos.top, pos.right - pos.left, pos.bottom - pos.top,
                  flags);
+    auto fileRoot = GetFileTreePath();
+    auto docID    = m_tabBar.GetCurrentTabId();
+    if (fileRoot.empty() && m_docManager.HasDocumentID(docID))
+        fileRoot = CPathUtils::GetParentDirectory(m_docManager.GetDocumentFromID(docID).m_path);
+    m_commandPaletteDlg->SetFileSearch(fileRoot, [this](const std::wstring& path) {
+        OpenFile(path, OpenFlags::AddToMRU);
+    });
     m_commandPaletteDlg->ClearFilterText();
 }
 
@@ -799,71 +807,51 @@ LRESULT CALLBACK CMainWindow::WinMsgHandler(HWND hwnd, UINT uMsg, WPARAM wParam,
                     KillTimer(*this, TIMER_SELCHANGE);
                     m_editor.MarkSelectedWord(false, false);
                     break;
+                case TIMER_LOADPENDING:
+                    LoadNextPendingDocument();
+                    break;
                 case TIMER_CHECKLINES:
                 {
                     KillTimer(*this, TIMER_CHECKLINES);
 
-                    auto activeLexer = static_cast<int>(m_editor.Scintilla().Lexer());
-                    auto lexerData   = CLexStyles::Instance().GetLexerDataForLexer(activeLexer);
+                    auto        activeLexer = static_cast<int>(m_editor.Scintilla().Lexer());
+                    const auto& lexerData   = CLexStyles::Instance().GetLexerDataForLexer(activeLexer);
                     if (!lexerData.annotations.empty())
                     {
-                        sptr_t lineSize = 1024;
-                        auto   pLine    = std::make_unique<char[]>(lineSize);
-
-                        auto   eolBytes = 1;
-                        switch (m_editor.Scintilla().EOLMode())
-                        {
-                            case Scintilla::EndOfLine::CrLf:
-                                eolBytes = 2;
-                                break;
-                            default:
-                                eolBytes = 1;
-                                break;
-                        }
                         auto firstVisibleDocLine = m_editor.Scintilla().DocLineFromVisible(m_editor.Scintilla().FirstVisibleLine());
                         auto lastVisibleDocLine  = m_editor.Scintilla().DocLineFromVisible(m_editor.Scintilla().FirstVisibleLine() + m_editor.Scintilla().LinesOnScreen());
-                        auto startLine           = firstVisibleDocLine;
-                        auto endLine             = lastVisibleDocLine;
-                        // adjust startLine and endLine to exclude the range m_annotationsLastStartLine to m_annotationsLastEndLine
-                        if (m_annotationsLastEndLine > startLine && m_annotationsLastEndLine < endLine)
-                            startLine = m_annotationsLastEndLine;
-                        if (m_annotationsLastStartLine > startLine && m_annotationsLastStartLine < endLine)
-                            endLine = m_annotationsLastStartLine;
-                        for (sptr_t line = startLine; line <= endLine; ++line)
+                        lastVisibleDocLine       = min(lastVisibleDocLine, m_editor.Scintilla().LineCount() - 1);
+                        // lines keep the MARK_ANNOTATIONCHECKED marker until they're modified
+                        // or the annotations are refreshed, so scrolling only checks new lines
+                        for (sptr_t line = firstVisibleDocLine; line <= lastVisibleDocLine; ++line)
                         {
-                            auto curLineSize = m_editor.Scintilla().GetLine(line, nullptr);
-                            if (curLineSize <= eolBytes)
+                            if (m_editor.Scintilla().MarkerGet(line) & (1 << MARK_ANNOTATIONCHECKED))
                                 continue;
-                            if (curLineSize > lineSize)
-                            {
-                                lineSize = curLineSize + 1024;
-                                pLine    = std::make_unique<char[]>(lineSize);
-                            }
-                            m_editor.Scintilla().GetLine(line, pLine.get());
-                            pLine[curLineSize - eolBytes] = 0;
-                            if ( curLineSize - eolBytes - 1 > 0 && (pLine[curLineSize - eolBytes - 1] == '\r' || pLine[curLineSize - eolBytes - 1] == '\n'))
-                            {
-                                pLine[curLineSize - eolBytes - 1] = 0;
-                                --curLineSize;
-                            }
-                            std::string_view sLine(pLine.get(), curLineSize - eolBytes);
-                            bool             textSet = false;
-                            for (const auto& [sRegex, annotation] : lexerData.annotations)
+                            m_editor.Scintilla().MarkerAdd(line, MARK_ANNOTATIONCHECKED);
+                            auto lineStart = m_editor.Scintilla().PositionFromLine(line);
+                            auto lineEnd   = m_editor.Scintilla().LineEndPosition(line);
+                            auto sLine     = m_editor.Scintilla().StringOfRange(Scintilla::Span(lineStart, lineEnd));
+
+                            const AnnotationRule* match = nullptr;
+                            if (!sLine.empty())
                             {
-                                std::regex rx(sRegex, std::regex_constants::icase);
-                                if (std::regex_match(sLine.begin(), sLine.end(), rx))
+                                for (const auto& rule : lexerData.annotations)
                                 {
-                                    m_editor.Scintilla().EOLAnnotationSetText(line, annotation.c_str());
-                                    m_editor.Scintilla().EOLAnnotationSetStyle(line, STYLE_FOLDDISPLAYTEXT);
-                                    textSet = true;
-                                    break;
+                                    if (std::regex_match(sLine, *rule.regex))
+                                    {
+                                        match = &rule;
+                                        break;
+                                    }
                                 }
                             }
-                            if (!textSet)
+                            if (match)
+                            {
+                                m_editor.Scintilla().EOLAnnotationSetText(line, match->text.c_str());
+                                m_editor.Scintilla().EOLAnnotationSetStyle(line, STYLE_FOLDDISPLAYTEXT);
+                            }
+                            else
                                 m_editor.Scintilla().EOLAnnotationSetText(line, nullptr);
                         }
-                        m_annotationsLastStartLine = startLine;
-                        m_annotationsLastEndLine = endLine;
                     }
                 }
                 break;
@@ -916,6 +904,7 @@ LRESULT CALLBACK CMainWindow::WinMsgHandler(HWND hwnd, UINT uMsg, WPARAM wParam,
         case WM_DESTROY:
             findReplaceFinish();
             regexCaptureFinish();
+            CSymbolIndex::Instance().Shutdown();
             g_pFramework->Destroy();
             PostQuitMessage(0);
             break;
@@ -967,6 +956,13 @@ LRESULT CALLBACK CMainWindow::WinMsgHandler(HWND hwnd, UINT uMsg, WPARAM wParam,
             *result      = m_inMenuLoop ? FALSE : TRUE;
         }
         break;
+        case WM_PATHLISTREADY:
+            m_autoCompleter.OnPathListReady();
+            break;
+        case WM_SELTEXTMARKERS:
+            m_editor.AddSelTextMarkers(static_cast<unsigned>(wParam));
+            UpdateStatusBar(false);
+            break;
         case WM_MOUSEWHEEL:
         case WM_MOUSEHWHEEL:
         {
@@ -1245,7 +1241,16 @@ LRESULT CMainWindow::HandleEditorEvents(const NMHDR& nmHdr, WPARAM wParam, LPARA
         {
             if (pScn->modificationType & (SC_MOD_INSERTTEXT | SC_MOD_DELETETEXT))
             {
-                RefreshAnnotations();
+                // inserted lines have no marker and deleted lines are merged
+                // into the start line, so only that one has to be scanned again.
+                // The merge keeps the markers of every deleted line, but
+                // MarkerDelete only removes one of them.
+                auto line = m_editor.Scintilla().LineFromPosition(pScn->position);
+                while (m_editor.Scintilla().MarkerGet(line) & (1 << MARK_HOTSPOTSCANNED))
+                    m_editor.Scintilla().MarkerDelete(line, MARK_HOTSPOTSCANNED);
+                while (m_editor.Scintilla().MarkerGet(line) & (1 << MARK_ANNOTATIONCHECKED))
+                    m_editor.Scintilla().MarkerDelete(line, MARK_ANNOTATIONCHECKED);
+                SetTimer(*this, TIMER_CHECKLINES, 300, nullptr);
             }
         }
         break;
@@ -2494,7 +2499,13 @@ bool CMainWindow::CloseTab(int closingTabIndex, bool force /* = false */, bool q
         }
         // If the save successful or closed without saveing, the tab will be closed.
     }
-    CCommandHandler::Instance().OnDocumentClose(closingTabId);
+    m_annotationsChecked.erase(closingTabId);
+    // tabs which were never activated were never reported as opened either
+    if (m_openPending.erase(closingTabId) == 0)
+    {
+        CCommandHandler::Instance().OnDocumentClose(closingTabId);
+        m_autoCompleter.OnDocumentClose(closingTabId);
+    }
     // Prefer to remove the document after the tab has gone as it supports it
     // and deletion causes events that may expect it to be there.
     m_tabBar.DeleteItemAt(closingTabIndex);
@@ -3432,57 +3443,85 @@ void CMainWindow::HandleWriteProtectedEdit()
     }
 }
 
+static bool IsUrlWordChar(char c)
+{
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+}
+
+static bool IsUrlSchemeChar(char c)
+{
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '+';
+}
+
+static bool IsUrlChar(char c)
+{
+    return IsUrlWordChar(c) || (c != 0 && strchr("-+~.:?&@=/%#,;{}()[]|*!\\", c) != nullptr);
+}
+
+// calls callback(start, length) for every url in text: the same ones
+// URL_REG_EXPR matches, but found without the regex engine
+template <typename Callback>
+static void FindUrls(std::string_view text, Callback&& callback)
+{
+    // urls longer than 2048 are not handled by browsers
+    constexpr size_t maxUrlLength = 2048;
+    auto             isBoundary   = [&](size_t pos) {
+        bool before = pos > 0 && IsUrlWordChar(text[pos - 1]);
+        bool after  = pos < text.size() && IsUrlWordChar(text[pos]);
+        return before != after;
+    };
+    size_t searchPos = 0;
+    for (auto colon = text.find("://"); colon != std::string_view::npos; colon = text.find("://", max(colon + 1, searchPos)))
+    {
+        // the scheme: 3 to 9 characters starting at a word boundary
+        size_t schemeStart = colon;
+        while (schemeStart > searchPos && colon - schemeStart < 9 && IsUrlSchemeChar(text[schemeStart - 1]))
+            --schemeStart;
+        while (schemeStart + 3 <= colon && !isBoundary(schemeStart))
+            ++schemeStart;
+        if (schemeStart + 3 > colon || colon - schemeStart > 9)
+            continue;
+        size_t bodyStart = colon + 3;
+        size_t end       = bodyStart;
+        while (end < text.size() && end - bodyStart < maxUrlLength && IsUrlChar(text[end]))
+            ++end;
+        // the url ends at a word boundary
+        while (end > bodyStart && !isBoundary(end))
+            --end;
+        if (end == bodyStart)
+            continue;
+        callback(schemeStart, end - schemeStart);
+        searchPos = end;
+    }
+}
+
 void CMainWindow::AddHotSpots() const
 {
     auto firstVisibleLine = m_editor.Scintilla().FirstVisibleLine();
-    auto startPos         = m_editor.Scintilla().PositionFromLine(m_editor.Scintilla().DocLineFromVisible(firstVisibleLine));
     auto linesOnScreen    = m_editor.Scintilla().LinesOnScreen();
     auto lineCount        = m_editor.Scintilla().LineCount();
-    auto endPos           = m_editor.Scintilla().PositionFromLine(m_editor.Scintilla().DocLineFromVisible(firstVisibleLine + min(linesOnScreen, lineCount)));
+    auto startLine        = m_editor.Scintilla().DocLineFromVisible(firstVisibleLine);
+    auto endLine          = min(m_editor.Scintilla().DocLineFromVisible(firstVisibleLine + min(linesOnScreen, lineCount)), lineCount - 1);
 
-    if (startPos < 0 || endPos < 0)
+    if (startLine < 0 || endLine < 0)
         return;
-    // to speed up the search, first search for "://" without using the regex engine
-    auto fStartPos        = startPos;
-    auto fEndPos          = endPos;
-    m_editor.Scintilla().SetSearchFlags(Scintilla::FindOption::None);
-    m_editor.Scintilla().SetTargetStart(fStartPos);
-    m_editor.Scintilla().SetTargetEnd(fEndPos);
-    LRESULT posFoundColonSlash = m_editor.Scintilla().SearchInTarget(3, "://");
-    while (posFoundColonSlash != -1)
-    {
-        // found a "://"
-        auto lineFoundColonSlash = m_editor.Scintilla().LineFromPosition(posFoundColonSlash);
-        startPos                 = m_editor.Scintilla().PositionFromLine(lineFoundColonSlash);
-        endPos                   = m_editor.Scintilla().LineEndPosition(lineFoundColonSlash);
-        fStartPos                = posFoundColonSlash + 1LL;
-
-        m_editor.Scintilla().SetSearchFlags(Scintilla::FindOption::RegExp | Scintilla::FindOption::Cxx11RegEx);
-
-        // 20 chars for the url protocol should be enough
-        m_editor.Scintilla().SetTargetStart(max(startPos, posFoundColonSlash - 20));
-        // urls longer than 2048 are not handled by browsers
-        m_editor.Scintilla().SetTargetEnd(min(endPos, posFoundColonSlash + 2048));
-
-        LRESULT posFound = m_editor.Scintilla().SearchInTarget(URL_REG_EXPR_LENGTH, URL_REG_EXPR);
-
-        if (posFound != -1)
-        {
-            auto start        = m_editor.Scintilla().TargetStart();
-            auto end          = m_editor.Scintilla().TargetEnd();
-            auto foundTextLen = end - start;
-
-            // reset indicators
-            m_editor.Scintilla().SetIndicatorCurrent(INDIC_URLHOTSPOT);
-            m_editor.Scintilla().IndicatorClearRange(start, foundTextLen);
-            m_editor.Scintilla().IndicatorClearRange(start, foundTextLen - 1LL);
-
-            m_editor.Scintilla().IndicatorFillRange(start, foundTextLen);
-        }
-        m_editor.Scintilla().SetTargetStart(fStartPos);
-        m_editor.Scintilla().SetTargetEnd(fEndPos);
-        m_editor.Scintilla().SetSearchFlags(Scintilla::FindOption::None);
-        posFoundColonSlash = static_cast<int>(m_editor.Scintilla().SearchInTarget(3, "://"));
+    m_editor.Scintilla().SetIndicatorCurrent(INDIC_URLHOTSPOT);
+    // lines keep the MARK_HOTSPOTSCANNED marker until they're modified, so
+    // scrolling back and forth only scans lines that haven't been seen yet
+    for (auto line = startLine; line <= endLine; ++line)
+    {
+        if (m_editor.Scintilla().MarkerGet(line) & (1 << MARK_HOTSPOTSCANNED))
+            continue;
+        auto lineStart = m_editor.Scintilla().PositionFromLine(line);
+        auto lineEnd   = m_editor.Scintilla().LineEndPosition(line);
+        auto lineText  = m_editor.Scintilla().StringOfRange(Scintilla::Span(lineStart, lineEnd));
+
+        // reset indicators
+        m_editor.Scintilla().IndicatorClearRange(lineStart, lineEnd - lineStart);
+        FindUrls(lineText, [&](size_t start, size_t length) {
+            m_editor.Scintilla().IndicatorFillRange(lineStart + start, length);
+        });
+        m_editor.Scintilla().MarkerAdd(line, MARK_HOTSPOTSCANNED);
     }
 }
 
@@ -3600,6 +3639,7 @@ void CMainWindow::OpenNewTab()
     auto docID = m_tabBar.GetIDFromIndex(index);
     m_docManager.AddDocumentAtEnd(doc, docID);
     CCommandHandler::Instance().OnDocumentOpen(docID);
+    m_autoCompleter.OnDocumentOpen(docID);
 
     m_tabBar.SelectChange(index);
     // m_editor.GotoLine(0);
@@ -3626,6 +3666,19 @@ void CMainWindow::HandleTabChange(const NMHDR& /*nmhdr*/)
     if (!m_docManager.HasDocumentID(docID))
         return;
 
+    // tabs opened with OpenFlags::LoadLater get their file content now
+    // if that hasn't happened in the background already.
+    bool firstActivation = m_openPending.contains(docID);
+    if (firstActivation)
+    {
+        if (!LoadPendingDocument(docID))
+        {
+            CloseTab(curTab, true);
+            return;
+        }
+        m_openPending.erase(docID);
+    }
+
     auto& doc = m_docManager.GetModDocumentFromID(docID);
     m_editor.Scintilla().SetDocPointer(doc.m_document);
     m_editor.SetEOLType(toEolMode(doc.m_format));
@@ -3634,8 +3687,13 @@ void CMainWindow::HandleTabChange(const NMHDR& /*nmhdr*/)
     doc.m_position.m_undoData = {};
     m_editor.SetTabSettings(doc.m_tabSpace);
     m_editor.SetReadDirection(doc.m_readDir);
-    RefreshAnnotations();
-    CEditorConfigHandler::Instance().ApplySettingsForPath(doc.m_path, &m_editor, doc, true);
+    // the annotations and the markers of the checked lines are stored in the
+    // document: they only have to be refreshed if the rules were loaded again
+    if (auto checked = m_annotationsChecked.find(docID); checked == m_annotationsChecked.end() || checked->second != CLexStyles::Instance().GetGeneration())
+        RefreshAnnotations();
+    else
+        SetTimer(*this, TIMER_CHECKLINES, 300, nullptr);
+    CEditorConfigHandler::Instance().ApplySettingsForPath(doc.m_path, &m_editor, doc, !firstActivation);
     CCommandHandler::Instance().OnStylesSet();
     g_pFramework->InvalidateUICommand(cmdUseTabs, UI_INVALIDATIONS_PROPERTY, &UI_PKEY_BooleanValue);
     m_editor.MarkSelectedWord(true, false);
@@ -3660,6 +3718,12 @@ void CMainWindow::HandleTabChange(const NMHDR& /*nmhdr*/)
         }
     }
 
+    if (firstActivation)
+    {
+        CCommandHandler::Instance().OnDocumentOpen(docID);
+        m_autoCompleter.OnDocumentOpen(docID);
+    }
+
     if (!m_bIgnoreFileChanges && !doc.m_bTailing)
     {
         auto ds = m_docManager.HasFileChanged(docID);
@@ -3693,6 +3757,7 @@ int CMainWindow::OpenFile(const std::wstring& file, unsigned int openFlags)
     // Ignore no activate flag for now. It causes too many issues.
     bool bActivate             = true; //(openFlags & OpenFlags::NoActivate) == 0;
     bool bCreateTabOnly        = (openFlags & OpenFlags::CreateTabOnly) != 0;
+    bool bLoadLater            = (openFlags & OpenFlags::LoadLater) != 0;
 
     auto createTab             = [&]() {
         auto      fileName = CPathUtils::GetFileName(file);
@@ -3714,6 +3779,7 @@ int CMainWindow::OpenFile(const std::wstring& file, unsigned int openFlags)
         UpdateStatusBar(true);
         m_tabBar.ActivateAt(index);
         CCommandHandler::Instance().OnDocumentOpen(docID);
+        m_autoCompleter.OnDocumentOpen(docID);
 
         return index;
     };
@@ -3767,7 +3833,7 @@ int CMainWindow::OpenFile(const std::wstring& file, unsigned int openFlags)
                 return createTab();
         }
 
-        CDocument doc = m_docManager.LoadFile(*this, filepath, encoding, createIfMissing);
+        CDocument doc = bLoadLater ? m_docManager.CreatePlaceholder(filepath) : m_docManager.LoadFile(*this, filepath, encoding, createIfMissing);
         if (doc.m_document)
         {
             DocID activeTabId;
@@ -3791,6 +3857,7 @@ int CMainWindow::OpenFile(const std::wstring& file, unsigned int openFlags)
                     {
                         auto curTabIndex = m_tabBar.GetCurrentTabIndex();
                         CCommandHandler::Instance().OnDocumentClose(docID);
+                        m_autoCompleter.OnDocumentClose(docID);
                         m_insertionIndex = curTabIndex;
                         m_tabBar.DeleteItemAt(m_insertionIndex);
                         if (m_insertionIndex)
@@ -3847,11 +3914,19 @@ int CMainWindow::OpenFile(const std::wstring& file, unsigned int openFlags)
             m_docManager.AddDocumentAtEnd(doc, id);
             doc = m_docManager.GetDocumentFromID(id);
 
+            if (bLoadLater)
+            {
+                // the file is loaded when the tab gets activated,
+                // or in the background while BowPad is idle.
+                m_openPending.insert(id);
+                m_pendingLoads.push_back(id);
+                SetTimer(*this, TIMER_LOADPENDING, LOADPENDING_DELAY, nullptr);
+            }
             // only activate the new doc tab if the main window is enabled:
             // if it's disabled, a modal dialog is shown
             // (e.g., the handle-outside-modifications confirmation dialog)
             // and we then must not change the active tab.
-            if (IsWindowEnabled(*this))
+            else if (IsWindowEnabled(*this))
             {
                 bool bResize = m_fileTree.GetPath().empty() && !doc.m_path.empty();
                 if (bActivate)
@@ -3868,7 +3943,8 @@ int CMainWindow::OpenFile(const std::wstring& file, unsigned int openFlags)
             else
                 m_editor.Scintilla().SetDocPointer(doc.m_document);
 
-            CEditorConfigHandler::Instance().ApplySettingsForPath(doc.m_path, &m_editor, doc, false);
+            if (!bLoadLater)
+                CEditorConfigHandler::Instance().ApplySettingsForPath(doc.m_path, &m_editor, doc, false);
             InvalidateRect(m_tabBar, nullptr, FALSE);
 
             if (bAddToMRU)
@@ -3879,7 +3955,11 @@ int CMainWindow::OpenFile(const std::wstring& file, unsigned int openFlags)
                 ResizeChildWindows();
             }
             UpdateTab(id);
-            CCommandHandler::Instance().OnDocumentOpen(id);
+            if (!bLoadLater)
+            {
+                CCommandHandler::Instance().OnDocumentOpen(id);
+                m_autoCompleter.OnDocumentOpen(id);
+            }
         }
         else
         {
@@ -4329,6 +4409,7 @@ void CMainWindow::HandleTabDroppedOutside(int tab, POINT pt)
     auto         getPosString = [&]() {
         CPosData pos;
         m_editor.SaveCurrentPos(pos);
+        pos.m_undoData = GetUndoData(docID);
         std::wstring posString;
 
         posString += std::to_wstring(pos.m_nFirstVisibleLine) + L"*";
@@ -4549,6 +4630,7 @@ bool CMainWindow::ReloadTab(int tab, int encoding, bool dueToOutsideChanges)
     if (bReloadCurrentTab)
     {
         editor->SaveCurrentPos(doc.m_position);
+        doc.m_position.m_undoData = editor->GetUndoData();
 
         auto maxLenForUndo = CIniSettings::Instance().GetInt64(L"View", L"maxLenForUndo", 2 * 1024 * 1024);
         if (editor->Scintilla().Length() < maxLenForUndo)
@@ -4586,8 +4668,8 @@ bool CMainWindow::ReloadTab(int tab, int encoding, bool dueToOutsideChanges)
     doc                           = docReload;
     editor->SetupLexerForLang(lang);
     doc.SetLanguage(lang);
-    editor->RestoreCurrentPos(docReload.m_position);
-    docReload.m_position.m_undoData = {};
+    editor->RestoreCurrentPos(doc.m_position);
+    doc.m_position.m_undoData = {};
     editor->Scintilla().SetReadOnly(docReload.m_bIsWriteProtected);
     editor->EnableChangeHistory();
     CEditorConfigHandler::Instance().ApplySettingsForPath(doc.m_path, editor, doc, false);
@@ -4600,6 +4682,7 @@ bool CMainWindow::ReloadTab(int tab, int encoding, bool dueToOutsideChanges)
     tbHdr.tabOrigin    = tab;
     CCommandHandler::Instance().TabNotify(&tbHdr);
     CCommandHandler::Instance().OnStylesSet();
+    m_autoCompleter.OnDocumentTextChanged(docID);
 
     if (bReloadCurrentTab)
         UpdateStatusBar(true);
@@ -4785,6 +4868,20 @@ void CMainWindow::OpenFiles(const std::vector<std::wstring>& paths)
         ShowProgressCtrl(static_cast<UINT>(CIniSettings::Instance().GetInt64(L"View", L"progressdelay", 1000)));
         OnOutOfScope(HideProgressCtrl());
 
+        // read and decode the files in parallel first, OpenFile() then
+        // only has to set up the tabs for the already loaded documents.
+        // The ini file is skipped since OpenFile() saves it before loading it.
+        std::vector<std::wstring> preloadPaths;
+        for (const auto& file : paths)
+        {
+            auto filepath = CPathUtils::GetLongPathname(file);
+            if (!m_docManager.GetIdForPath(filepath).IsValid() &&
+                _wcsicmp(CIniSettings::Instance().GetIniPath().c_str(), filepath.c_str()) != 0)
+                preloadPaths.push_back(std::move(filepath));
+        }
+        m_docManager.PreloadFiles(preloadPaths);
+        OnOutOfScope(m_docManager.ClearPreloaded());
+
         // Open all that was selected or at least returned.
         DocID docToActivate;
         int   fileCounter = 0;
@@ -4805,6 +4902,82 @@ void CMainWindow::OpenFiles(const std::vector<std::wstring>& paths)
     }
 }
 
+bool CMainWindow::LoadPendingDocument(DocID docID)
+{
+    if (!m_docManager.HasDocumentID(docID))
+        return false;
+    auto& placeholder = m_docManager.GetModDocumentFromID(docID);
+    if (!placeholder.m_bLoadPending)
+        return true;
+    // files that got removed since the placeholder was created are
+    // dropped silently, just like OpenFlags::IgnoreIfMissing does.
+    if (!PathFileExists(placeholder.m_path.c_str()))
+        return false;
+
+    CDocument doc = m_docManager.LoadFile(*this, placeholder.m_path, -1, false);
+    if (!doc.m_document)
+        return false;
+    // keep what the placeholder was set up with, e.g. the restored session state
+    doc.m_position     = std::move(placeholder.m_position);
+    doc.m_tabSpace     = placeholder.m_tabSpace;
+    doc.m_readDir      = placeholder.m_readDir;
+    doc.m_wrapMode     = placeholder.m_wrapMode;
+    doc.m_saveCallback = std::move(placeholder.m_saveCallback);
+    doc.SetLanguage(CLexStyles::Instance().GetLanguageForDocument(doc, m_scratchEditor));
+
+    m_docManager.RemoveDocument(docID);
+    m_docManager.AddDocumentAtEnd(doc, docID);
+    UpdateTab(docID);
+    return true;
+}
+
+void CMainWindow::LoadPendingDocuments()
+{
+    for (int i = 0; i < m_tabBar.GetItemCount(); ++i)
+    {
+        auto docID = m_tabBar.GetIDFromIndex(i);
+        if (m_docManager.HasDocumentID(docID) && m_docManager.GetDocumentFromID(docID).m_bLoadPending)
+            LoadPendingDocument(docID);
+    }
+}
+
+CUndoData CMainWindow::GetUndoData(DocID docID)
+{
+    const auto& doc = m_docManager.GetDocumentFromID(docID);
+    // a restored document that wasn't activated yet still has the
+    // undo history from the session, the document itself has none
+    if (m_openPending.contains(docID))
+        return doc.m_position.m_undoData;
+    if (docID == m_tabBar.GetCurrentTabId())
+        return m_editor.GetUndoData();
+    m_scratchEditor.Scintilla().SetDocPointer(doc.m_document);
+    OnOutOfScope(m_scratchEditor.Scintilla().SetDocPointer(nullptr));
+    return m_scratchEditor.GetUndoData();
+}
+
+void CMainWindow::LoadNextPendingDocument()
+{
+    // only use the time the user doesn't need: the timer just tries
+    // again later if there's input waiting or a dialog is shown.
+    if (!IsWindowEnabled(*this) || HIWORD(GetQueueStatus(QS_INPUT)) != 0)
+        return;
+    // load only one document per tick: a batch would block
+    // the UI for as long as it takes to load all its files
+    while (!m_pendingLoads.empty())
+    {
+        auto docID = m_pendingLoads.front();
+        m_pendingLoads.pop_front();
+        if (m_docManager.HasDocumentID(docID) && m_docManager.GetDocumentFromID(docID).m_bLoadPending)
+        {
+            // a failed load is tried again when the tab gets activated,
+            // which then also closes the tab.
+            LoadPendingDocument(docID);
+            return;
+        }
+    }
+    KillTimer(*this, TIMER_LOADPENDING);
+}
+
 void CMainWindow::BlockAllUIUpdates(bool block)
 {
     std::vector<HWND> windows = {m_fileTree, m_statusBar};
@@ -5149,7 +5322,9 @@ void CMainWindow::SetTheme(bool dark)
 
 void CMainWindow::RefreshAnnotations()
 {
-    m_annotationsLastEndLine = 0;
+    if (auto activeTabId = m_tabBar.GetCurrentTabId(); activeTabId.IsValid())
+        m_annotationsChecked[activeTabId] = CLexStyles::Instance().GetGeneration();
+    m_editor.Scintilla().MarkerDeleteAll(MARK_ANNOTATIONCHECKED);
     m_editor.Scintilla().AnnotationClearAll();
     SetTimer(*this, TIMER_CHECKLINES, 300, nullptr);
 }
@@ -30,6 +30,9 @@
 #include <UIRibbon.h>
 #include <UIRibbonPropertyHelpers.h>
 #include <list>
+#include <deque>
+#include <unordered_map>
+#include <unordered_set>
 
 constexpr int COMMAND_TIMER_ID_START = 1000;
 
@@ -79,6 +82,8 @@ public:
     int          OpenFile(const std::wstring& file, unsigned int openFlags);
     bool         OpenFileAs(const std::wstring& tempPath, const std::wstring& realpath, bool bModified);
     bool         ReloadTab(int tab, int encoding, bool dueToOutsideChanges = false);
+    void         LoadPendingDocuments();
+    CUndoData    GetUndoData(DocID docID);
 
     bool         SaveCurrentTab(bool bSaveAs = false);
     bool         SaveDoc(DocID docID, bool bSaveAs = false);
@@ -196,6 +201,8 @@ private:
     void                             SetZoomPC(int zoomPC) const;
     COLORREF                         GetColorForDocument(DocID id);
     void                             OpenFiles(const std::vector<std::wstring>& paths);
+    bool                             LoadPendingDocument(DocID docID);
+    void                             LoadNextPendingDocument();
     void                             BlockAllUIUpdates(bool block);
     int                              UnblockUI();
     void                             ReBlockUI(int blockCount);
@@ -251,8 +258,9 @@ private:
     CAutoComplete                                  m_autoCompleter;
     Sci_Position                                   m_dwellStartPos;
     bool                                           m_bBlockAutoIndent;
-    sptr_t                                         m_annotationsLastEndLine;
-    sptr_t                                         m_annotationsLastStartLine;
+    std::deque<DocID>                              m_pendingLoads;       ///< placeholder tabs to load in the background
+    std::unordered_set<DocID>                      m_openPending;        ///< tabs not activated yet since they were opened with OpenFlags::LoadLater
+    std::unordered_map<DocID, unsigned>            m_annotationsChecked; ///< CLexStyles generation the annotation markers of a tab were set with
 
     // status bar icons
     HICON                                          m_hShieldIcon;
@@ -0,0 +1,703 @@
+﻿// This file is part of BowPad.
+//
+// Copyright (C) 2025 - Stefan Kueng
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// See <http://www.gnu.org/licenses/> for a copy of the full license text
+//
+#include "stdafx.h"
+#include "PathIndex.h"
+#include "PathWatcher.h"
+#include "PathUtils.h"
+#include "StringUtils.h"
+#include "DirFileEnum.h"
+#include "MRU.h"
+
+#include <algorithm>
+#include <atomic>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+
+namespace
+{
+// scoring of fuzzy matches, modeled after fzf
+constexpr int      SCORE_MATCH             = 16;
+constexpr int      SCORE_GAP_START         = -3;
+constexpr int      SCORE_GAP_EXTENSION     = -1;
+constexpr int      BONUS_BOUNDARY          = 8;
+constexpr int      BONUS_CONSECUTIVE       = 4;
+constexpr int      BONUS_FIRST_CHAR_FACTOR = 2;
+constexpr int      BONUS_FILENAME          = 24;
+// bonus for the most recently used file, decreasing for older ones
+constexpr int      BONUS_MRU               = 64;
+constexpr int      BONUS_MRU_STEP          = 2;
+
+// more changes than that at once and the index is rebuilt instead of updated
+constexpr size_t   MAX_CHANGES_TO_APPLY    = 500;
+constexpr size_t   MIN_FILES_PER_THREAD    = 32768;
+constexpr size_t   MAX_QUERY_THREADS       = 8;
+// indexes kept at once, each one has a folder watcher running
+constexpr size_t   MAX_INDEXED_ROOTS       = 4;
+constexpr uint32_t NO_INDEX                = UINT32_MAX;
+
+using PathChanges = std::vector<std::tuple<DWORD, std::wstring>>;
+
+bool IsBoundary(wchar_t c)
+{
+    return c == '\\' || c == '/' || c == '_' || c == '-' || c == '.' || c == ' ';
+}
+
+// Returns the score of the shortest match of query in text, or -1 if the
+// characters of query don't appear in text in that order.
+// Matches that lie completely in the file name part, starting at nameOffset, score higher.
+int FuzzyScore(std::wstring_view query, std::wstring_view text, size_t nameOffset)
+{
+    if (query.empty())
+        return 0;
+    // forward pass: find where the leftmost match ends
+    size_t qi  = 0;
+    size_t end = 0;
+    for (size_t i = 0; i < text.size(); ++i)
+    {
+        if (text[i] == query[qi] && ++qi == query.size())
+        {
+            end = i + 1;
+            break;
+        }
+    }
+    if (qi < query.size())
+        return -1;
+    // backward pass: find the shortest window that still matches
+    size_t start = end;
+    qi           = query.size();
+    while (start > 0)
+    {
+        --start;
+        if (text[start] == query[qi - 1] && --qi == 0)
+            break;
+    }
+
+    int     score       = 0;
+    int     consecutive = 0;
+    int     firstBonus  = 0;
+    bool    inGap       = false;
+    wchar_t prev        = start > 0 ? text[start - 1] : L'\\';
+    qi                  = 0;
+    for (size_t i = start; i < end; ++i)
+    {
+        const wchar_t c = text[i];
+        if (qi < query.size() && c == query[qi])
+        {
+            score += SCORE_MATCH;
+            int bonus = IsBoundary(prev) ? BONUS_BOUNDARY : 0;
+            if (consecutive == 0)
+                firstBonus = bonus;
+            else
+            {
+                // a run of consecutive matches keeps the bonus of its first character
+                if (bonus > firstBonus)
+                    firstBonus = bonus;
+                bonus = max(bonus, max(firstBonus, BONUS_CONSECUTIVE));
+            }
+            score += qi == 0 ? bonus * BONUS_FIRST_CHAR_FACTOR : bonus;
+            inGap = false;
+            ++consecutive;
+            ++qi;
+        }
+        else
+        {
+            score += inGap ? SCORE_GAP_EXTENSION : SCORE_GAP_START;
+            inGap       = true;
+            consecutive = 0;
+            firstBonus  = 0;
+        }
+        prev = c;
+    }
+    if (start >= nameOffset)
+        score += BONUS_FILENAME;
+    return score;
+}
+
+// Returns how many characters of query are found in text, in order.
+size_t MatchedPrefix(std::wstring_view query, std::wstring_view text)
+{
+    size_t qi = 0;
+    for (size_t i = 0; i < text.size() && qi < query.size(); ++i)
+    {
+        if (text[i] == query[qi])
+            ++qi;
+    }
+    return qi;
+}
+
+std::wstring NormalizeRoot(const std::wstring& root)
+{
+    auto path = CStringUtils::to_lower(root);
+    std::replace(path.begin(), path.end(), L'/', L'\\');
+    while (!path.empty() && path.back() == L'\\')
+        path.pop_back();
+    return path;
+}
+
+// Returns true for drive roots like "c:" and share roots like "\\server\share".
+bool IsVolumeRoot(const std::wstring& normalizedRoot)
+{
+    if (normalizedRoot.size() <= 2)
+        return true;
+    if (!normalizedRoot.starts_with(L"\\\\"))
+        return false;
+    return std::count(normalizedRoot.begin() + 2, normalizedRoot.end(), L'\\') <= 1;
+}
+
+/**
+ * The files below a root folder. Folder and file names are interned, and each
+ * folder only stores its parent, its name and its lower case path relative to
+ * the root which is what queries are matched against.
+ */
+class CPathTree
+{
+public:
+    struct Dir
+    {
+        uint32_t              parent = NO_INDEX;
+        uint32_t              name   = NO_INDEX;
+        std::wstring          lowerPath; ///< relative to the root, with a trailing backslash
+        std::vector<uint32_t> files;
+    };
+    struct File
+    {
+        uint32_t dir     = 0;
+        uint32_t name    = 0;
+        bool     removed = false;
+    };
+
+    CPathTree(const std::wstring& root, const std::vector<std::wstring>& excludedFolders)
+        : m_root(root)
+        , m_excludedFolders(excludedFolders)
+    {
+        while (!m_root.empty() && m_root.back() == L'\\')
+            m_root.pop_back();
+        dirs.emplace_back();
+        m_dirIds[L""] = 0;
+    }
+
+    void Scan(uint32_t startDir, const std::wstring& startPath)
+    {
+        CDirFileEnum enumerator(startPath);
+        bool         bIsDir  = false;
+        bool         recurse = true;
+        std::wstring path;
+        std::wstring lastParent   = startPath;
+        uint32_t     lastParentId = startDir;
+        while (enumerator.NextFile(path, &bIsDir, recurse))
+        {
+            recurse     = true;
+            auto parent = CPathUtils::GetParentDirectory(path);
+            if (parent != lastParent)
+            {
+                lastParentId = FindDir(RelativePath(parent));
+                lastParent   = parent;
+            }
+            if (lastParentId == NO_INDEX)
+                continue;
+            auto name = CPathUtils::GetFileName(path);
+            if (bIsDir)
+            {
+                if (IsExcludedFolder(name))
+                    recurse = false;
+                else
+                    AddDir(lastParentId, name);
+                continue;
+            }
+            AddFile(lastParentId, name);
+        }
+    }
+
+    void ApplyChanges(const PathChanges& changes)
+    {
+        for (const auto& [action, path] : changes)
+        {
+            if (path.size() <= m_root.size() + 1 || _wcsnicmp(path.c_str(), m_root.c_str(), m_root.size()) != 0 || path[m_root.size()] != L'\\')
+                continue;
+            auto relPath = RelativePath(path);
+            switch (action)
+            {
+                case FILE_ACTION_ADDED:
+                case FILE_ACTION_RENAMED_NEW_NAME:
+                {
+                    auto attributes = GetFileAttributes(path.c_str());
+                    if (attributes == INVALID_FILE_ATTRIBUTES)
+                        break;
+                    auto parentId = EnsureDir(CPathUtils::GetParentDirectory(relPath));
+                    if (parentId == NO_INDEX)
+                        break;
+                    auto name = CPathUtils::GetFileName(path);
+                    if (attributes & FILE_ATTRIBUTE_DIRECTORY)
+                    {
+                        if (IsExcludedFolder(name))
+                            break;
+                        // folders that are moved in come with content
+                        Scan(AddDir(parentId, name), path);
+                    }
+                    else
+                        AddFile(parentId, name);
+                }
+                break;
+                case FILE_ACTION_REMOVED:
+                case FILE_ACTION_RENAMED_OLD_NAME:
+                {
+                    auto lowerRelPath = CStringUtils::to_lower(relPath);
+                    if (m_dirIds.contains(lowerRelPath))
+                    {
+                        auto prefix = lowerRelPath + L"\\";
+                        for (auto& dir : dirs)
+                        {
+                            if (dir.lowerPath.starts_with(prefix))
+                            {
+                                for (auto file : dir.files)
+                                    files[file].removed = true;
+                            }
+                        }
+                    }
+                    else
+                    {
+                        auto fileId = FindFile(lowerRelPath);
+                        if (fileId != NO_INDEX)
+                            files[fileId].removed = true;
+                    }
+                }
+                break;
+                default:
+                    break;
+            }
+        }
+    }
+
+    /// Returns the index of the file with the lower case relative path, or NO_INDEX.
+    uint32_t FindFile(const std::wstring& lowerRelPath) const
+    {
+        auto slashPos = lowerRelPath.find_last_of(L'\\');
+        auto parent   = slashPos == std::wstring::npos ? std::wstring() : lowerRelPath.substr(0, slashPos);
+        auto name     = slashPos == std::wstring::npos ? lowerRelPath : lowerRelPath.substr(slashPos + 1);
+        auto foundDir = m_dirIds.find(parent);
+        if (foundDir == m_dirIds.end())
+            return NO_INDEX;
+        for (auto file : dirs[foundDir->second].files)
+        {
+            if (lowerNames[files[file].name] == name)
+                return file;
+        }
+        return NO_INDEX;
+    }
+
+    std::wstring GetPath(uint32_t fileId) const
+    {
+        const auto&                      file = files[fileId];
+        std::vector<const std::wstring*> segments;
+        segments.push_back(&names[file.name]);
+        for (auto dir = file.dir; dirs[dir].parent != NO_INDEX; dir = dirs[dir].parent)
+            segments.push_back(&names[dirs[dir].name]);
+        std::wstring path = m_root;
+        for (auto it = segments.crbegin(); it != segments.crend(); ++it)
+        {
+            path += L'\\';
+            path += **it;
+        }
+        return path;
+    }
+
+    std::vector<std::wstring> names;
+    std::vector<std::wstring> lowerNames;
+    std::vector<Dir>          dirs;
+    std::vector<File>         files;
+
+private:
+    std::wstring RelativePath(const std::wstring& path) const
+    {
+        if (path.size() <= m_root.size() + 1)
+            return {};
+        return path.substr(m_root.size() + 1);
+    }
+
+    bool IsExcludedFolder(const std::wstring& name) const
+    {
+        return std::ranges::any_of(m_excludedFolders, [&](const std::wstring& e) { return _wcsicmp(name.c_str(), e.c_str()) == 0; });
+    }
+
+    uint32_t Intern(const std::wstring& name)
+    {
+        auto [it, inserted] = m_nameIds.try_emplace(name, static_cast<uint32_t>(names.size()));
+        if (inserted)
+        {
+            names.push_back(name);
+            lowerNames.push_back(CStringUtils::to_lower(name));
+        }
+        return it->second;
+    }
+
+    uint32_t FindDir(const std::wstring& relPath) const
+    {
+        auto foundDir = m_dirIds.find(CStringUtils::to_lower(relPath));
+        return foundDir == m_dirIds.end() ? NO_INDEX : foundDir->second;
+    }
+
+    uint32_t AddDir(uint32_t parent, const std::wstring& name)
+    {
+        Dir dir;
+        dir.parent      = parent;
+        dir.name        = Intern(name);
+        dir.lowerPath   = dirs[parent].lowerPath + lowerNames[dir.name] + L"\\";
+        auto key        = dir.lowerPath.substr(0, dir.lowerPath.size() - 1);
+        auto [it, isNew] = m_dirIds.try_emplace(key, static_cast<uint32_t>(dirs.size()));
+        if (isNew)
+            dirs.push_back(std::move(dir));
+        return it->second;
+    }
+
+    // returns the folder for the relative path, adding it and its parents if necessary
+    uint32_t EnsureDir(const std::wstring& relPath)
+    {
+        if (relPath.empty())
+            return 0;
+        auto dirId = FindDir(relPath);
+        if (dirId != NO_INDEX)
+            return dirId;
+        auto name = CPathUtils::GetFileName(relPath);
+        if (IsExcludedFolder(name))
+            return NO_INDEX;
+        auto slashPos = relPath.find_last_of(L'\\');
+        auto parentId = EnsureDir(slashPos == std::wstring::npos ? std::wstring() : relPath.substr(0, slashPos));
+        if (parentId == NO_INDEX)
+            return NO_INDEX;
+        return AddDir(parentId, name);
+    }
+
+    void AddFile(uint32_t dirId, const std::wstring& name)
+    {
+        auto  nameId = Intern(name);
+        auto& dir    = dirs[dirId];
+        // a file that's added while the index is built might already be there
+        for (auto file : dir.files)
+        {
+            if (lowerNames[files[file].name] == lowerNames[nameId])
+            {
+                files[file].removed = false;
+                return;
+            }
+        }
+        dir.files.push_back(static_cast<uint32_t>(files.size()));
+        files.push_back(File{dirId, nameId, false});
+    }
+
+    std::wstring                               m_root;
+    std::vector<std::wstring>                  m_excludedFolders;
+    std::unordered_map<std::wstring, uint32_t> m_nameIds;
+    std::unordered_map<std::wstring, uint32_t> m_dirIds; ///< lower case relative path without trailing backslash
+};
+} // namespace
+
+class CPathIndex::CRoot
+{
+public:
+    CRoot(const std::wstring& path, const std::vector<std::wstring>& excludedFolders, const std::vector<std::wstring>& excludedExtensions)
+        : path(path)
+        , excludedFolders(excludedFolders)
+        , excludedExtensions(excludedExtensions)
+    {
+        watcher.AddPath(path, true);
+    }
+
+    void StartBuild(const std::shared_ptr<CRoot>& self)
+    {
+        if (building.exchange(true))
+            return;
+        std::thread([self]() {
+            ProfileTimer profileTimer(L"building path index");
+            auto         tree = std::make_shared<CPathTree>(self->path, self->excludedFolders);
+            tree->Scan(0, self->path);
+            // replay the changes reported while scanning, the scan
+            // might have passed those paths already
+            for (;;)
+            {
+                PathChanges changes;
+                {
+                    std::lock_guard lock(self->mutex);
+                    if (self->pendingChanges.empty())
+                    {
+                        self->tree = std::move(tree);
+                        ++self->generation;
+                        self->building = false;
+                        return;
+                    }
+                    changes.swap(self->pendingChanges);
+                }
+                tree->ApplyChanges(changes);
+            }
+        }).detach();
+    }
+
+    // must be called with the mutex locked
+    void Update(const std::shared_ptr<CRoot>& self)
+    {
+        auto changes = watcher.GetChangedPaths();
+        if (changes.empty())
+            return;
+        if (building)
+            pendingChanges.insert(pendingChanges.end(), changes.begin(), changes.end());
+        if (!tree)
+            return;
+        if (changes.size() > MAX_CHANGES_TO_APPLY)
+        {
+            // keep using the old index until the new one is ready
+            StartBuild(self);
+            return;
+        }
+        tree->ApplyChanges(changes);
+        ++generation;
+    }
+
+    bool IsExcludedFile(const std::wstring& lowerName) const
+    {
+        auto dotPos = lowerName.find_last_of(L'.');
+        if (dotPos == std::wstring::npos)
+            return false;
+        std::wstring_view ext(lowerName.c_str() + dotPos + 1);
+        return std::ranges::any_of(excludedExtensions, [&](const std::wstring& e) { return ext == e; });
+    }
+
+    const std::wstring              path;
+    const std::vector<std::wstring> excludedFolders;
+    std::vector<std::wstring>       excludedExtensions;
+    std::mutex                      mutex;
+    std::shared_ptr<CPathTree>      tree; ///< null until the first build finished
+    std::atomic_bool                building   = false;
+    unsigned                        generation = 0;
+    CPathWatcher                    watcher;
+    PathChanges                     pendingChanges; ///< changes to apply once the build finished
+    uint64_t                        lastUsed = 0;   ///< guarded by the mutex of CPathIndex
+
+    // the files matching the last query: a query that just adds characters
+    // to the last one only has to look at those again
+    std::wstring                    lastQuery;
+    unsigned                        lastGeneration = 0;
+    std::vector<uint32_t>           lastMatches;
+};
+
+CPathIndex& CPathIndex::Instance()
+{
+    static CPathIndex instance;
+    return instance;
+}
+
+void CPathIndex::SetExclusions(const std::vector<std::wstring>& folders, const std::vector<std::wstring>& extensions)
+{
+    std::lock_guard lock(m_mutex);
+    m_excludedFolders    = folders;
+    m_excludedExtensions = extensions;
+    // excluded files are filtered out when querying, so that also works for roots already indexed
+    for (const auto& [key, pRoot] : m_roots)
+    {
+        std::lock_guard rootLock(pRoot->mutex);
+        pRoot->excludedExtensions = extensions;
+    }
+}
+
+std::shared_ptr<CPathIndex::CRoot> CPathIndex::GetRoot(const std::wstring& root, bool create)
+{
+    auto            key = NormalizeRoot(root);
+    std::lock_guard lock(m_mutex);
+    if (auto found = m_roots.find(key); found != m_roots.end())
+    {
+        found->second->lastUsed = ++m_useCount;
+        return found->second;
+    }
+    if (!create || IsVolumeRoot(key))
+        return nullptr;
+    if (m_roots.size() >= MAX_INDEXED_ROOTS)
+    {
+        auto oldest = std::ranges::min_element(m_roots, {}, [](const auto& entry) { return entry.second->lastUsed; });
+        oldest->second->watcher.Stop();
+        m_roots.erase(oldest);
+    }
+    auto path = root;
+    while (!path.empty() && (path.back() == L'\\' || path.back() == L'/'))
+        path.pop_back();
+    auto pRoot      = std::make_shared<CRoot>(path, m_excludedFolders, m_excludedExtensions);
+    pRoot->lastUsed = ++m_useCount;
+    pRoot->StartBuild(pRoot);
+    m_roots[key] = pRoot;
+    return pRoot;
+}
+
+bool CPathIndex::Prepare(const std::wstring& root)
+{
+    auto pRoot = GetRoot(root, true);
+    if (!pRoot)
+        return false;
+    std::lock_guard lock(pRoot->mutex);
+    return pRoot->tree != nullptr;
+}
+
+std::vector<PathIndexMatch> CPathIndex::Query(const std::wstring& root, const std::wstring& query, size_t maxResults)
+{
+    std::vector<PathIndexMatch> results;
+    auto                        pRoot = GetRoot(root, false);
+    if (!pRoot || maxResults == 0)
+        return results;
+    std::lock_guard lock(pRoot->mutex);
+    pRoot->Update(pRoot);
+    if (!pRoot->tree)
+        return results;
+    const auto& tree       = *pRoot->tree;
+    auto        lowerQuery = CStringUtils::to_lower(query);
+    std::replace(lowerQuery.begin(), lowerQuery.end(), L'/', L'\\');
+
+    // recently used files rank higher
+    const auto                        rootPrefix = NormalizeRoot(pRoot->path) + L"\\";
+    std::unordered_map<uint32_t, int> mruBonus;
+    int                               bonus      = BONUS_MRU;
+    for (const auto& mruPath : CMRU::Instance().GetRecentPaths())
+    {
+        if (bonus <= 0)
+            break;
+        auto lowerPath = CStringUtils::to_lower(mruPath);
+        if (!lowerPath.starts_with(rootPrefix))
+            continue;
+        auto fileId = tree.FindFile(lowerPath.substr(rootPrefix.size()));
+        if (fileId != NO_INDEX && !tree.files[fileId].removed)
+        {
+            mruBonus.try_emplace(fileId, bonus);
+            if (lowerQuery.empty() && results.size() < maxResults)
+                results.push_back(PathIndexMatch{tree.GetPath(fileId), bonus});
+            bonus -= BONUS_MRU_STEP;
+        }
+    }
+    if (lowerQuery.empty())
+        return results;
+
+    const bool refine  = !pRoot->lastQuery.empty() && lowerQuery.starts_with(pRoot->lastQuery) &&
+                        pRoot->lastGeneration == pRoot->generation;
+    const auto count   = refine ? pRoot->lastMatches.size() : tree.files.size();
+
+    // how much of the query the folder path matches already: a file only
+    // has to be scored if its name matches the rest
+    std::vector<uint32_t> dirMatched(tree.dirs.size());
+    for (size_t i = 0; i < tree.dirs.size(); ++i)
+        dirMatched[i] = static_cast<uint32_t>(MatchedPrefix(lowerQuery, tree.dirs[i].lowerPath));
+
+    struct Scored
+    {
+        uint32_t file;
+        int      score;
+    };
+    size_t threadCount = std::clamp<size_t>(std::thread::hardware_concurrency(), 1, MAX_QUERY_THREADS);
+    threadCount        = std::clamp<size_t>(count / MIN_FILES_PER_THREAD, 1, threadCount);
+    std::vector<std::vector<Scored>> partialResults(threadCount);
+    auto                             scoreRange = [&](size_t part) {
+        const size_t      begin = count * part / threadCount;
+        const size_t      end   = count * (part + 1) / threadCount;
+        std::wstring      text;
+        auto&             scored = partialResults[part];
+        std::wstring_view q(lowerQuery);
+        for (size_t i = begin; i < end; ++i)
+        {
+            const uint32_t fileId = refine ? pRoot->lastMatches[i] : static_cast<uint32_t>(i);
+            const auto&    file   = tree.files[fileId];
+            if (file.removed)
+                continue;
+            const auto& name = tree.lowerNames[file.name];
+            if (MatchedPrefix(q.substr(dirMatched[file.dir]), name) + dirMatched[file.dir] < q.size())
+                continue;
+            if (pRoot->IsExcludedFile(name))
+                continue;
+            const auto& dirPath = tree.dirs[file.dir].lowerPath;
+            text.assign(dirPath).append(name);
+            scored.push_back(Scored{fileId, FuzzyScore(q, text, dirPath.size())});
+        }
+    };
+    std::vector<std::thread> threads;
+    for (size_t part = 1; part < threadCount; ++part)
+        threads.emplace_back(scoreRange, part);
+    scoreRange(0);
+    for (auto& thread : threads)
+        thread.join();
+
+    std::vector<Scored> matches;
+    for (auto& part : partialResults)
+        matches.insert(matches.end(), part.begin(), part.end());
+    pRoot->lastQuery      = lowerQuery;
+    pRoot->lastGeneration = pRoot->generation;
+    pRoot->lastMatches.clear();
+    pRoot->lastMatches.reserve(matches.size());
+    for (const auto& match : matches)
+        pRoot->lastMatches.push_back(match.file);
+
+    for (auto& match : matches)
+    {
+        if (auto found = mruBonus.find(match.file); found != mruBonus.end())
+            match.score += found->second;
+    }
+    auto pathLength = [&](uint32_t fileId) {
+        const auto& file = tree.files[fileId];
+        return tree.dirs[file.dir].lowerPath.size() + tree.lowerNames[file.name].size();
+    };
+    auto better = [&](const Scored& lhs, const Scored& rhs) {
+        if (lhs.score != rhs.score)
+            return lhs.score > rhs.score;
+        auto lhsLength = pathLength(lhs.file);
+        auto rhsLength = pathLength(rhs.file);
+        if (lhsLength != rhsLength)
+            return lhsLength < rhsLength;
+        return lhs.file < rhs.file;
+    };
+    const auto resultCount = min(maxResults, matches.size());
+    std::partial_sort(matches.begin(), matches.begin() + resultCount, matches.end(), better);
+    results.clear();
+    results.reserve(resultCount);
+    for (size_t i = 0; i < resultCount; ++i)
+        results.push_back(PathIndexMatch{tree.GetPath(matches[i].file), matches[i].score});
+    return results;
+}
+
+std::wstring CPathIndex::SuggestFileName(const std::wstring& root, const std::wstring& prefix, bool recursive)
+{
+    auto pRoot = GetRoot(root, false);
+    if (!pRoot || prefix.empty())
+        return {};
+    std::lock_guard lock(pRoot->mutex);
+    pRoot->Update(pRoot);
+    if (!pRoot->tree)
+        return {};
+    const auto& tree        = *pRoot->tree;
+    auto        lowerPrefix = CStringUtils::to_lower(prefix);
+    uint32_t    bestName    = NO_INDEX;
+    auto        check       = [&](uint32_t fileId) {
+        const auto& file = tree.files[fileId];
+        const auto& name = tree.lowerNames[file.name];
+        if (file.removed || !name.starts_with(lowerPrefix) || pRoot->IsExcludedFile(name))
+            return;
+        if (bestName == NO_INDEX || name.size() < tree.lowerNames[bestName].size())
+            bestName = file.name;
+    };
+    if (recursive)
+    {
+        for (uint32_t fileId = 0; fileId < tree.files.size(); ++fileId)
+            check(fileId);
+    }
+    else
+    {
+        for (auto fileId : tree.dirs[0].files)
+            check(fileId);
+    }
+    return bestName == NO_INDEX ? std::wstring() : tree.names[bestName];
+}
@@ -0,0 +1,88 @@
+﻿// This file is part of BowPad.
+//
+// Copyright (C) 2025 - Stefan Kueng
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// See <http://www.gnu.org/licenses/> for a copy of the full license text
+//
+#pragma once
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <mutex>
+
+struct PathIndexMatch
+{
+    std::wstring path;
+    int          score = 0;
+};
+
+/**
+ * In-memory index of all files below a root folder, used to find files by
+ * fuzzy matching their path instead of walking the file system for every query.
+ *
+ * The index of a root is built in a background thread the first time the root
+ * is used and kept up to date with a CPathWatcher afterwards. Paths are stored
+ * as interned segments: every folder and file name is only stored once, no
+ * matter how often it appears in the tree.
+ * Only a few roots are kept, the least recently used one is dropped and its
+ * watcher stopped when another root is indexed.
+ */
+class CPathIndex
+{
+public:
+    static CPathIndex& Instance();
+
+    /**
+     * Starts indexing the root folder if that's not done already.
+     * Returns true if the index for the root is ready to be queried.
+     * The root should be a folder the user works in, like the folder shown
+     * in the file tree or the folder of an open document. Drive and share
+     * roots are never indexed.
+     */
+    bool                        Prepare(const std::wstring& root);
+
+    /**
+     * Returns the files below root that match the query, best matches first.
+     * The query characters must appear in the path in the same order, but
+     * not necessarily next to each other. Recently used files rank higher.
+     * Returns an empty list if the index isn't ready yet.
+     */
+    std::vector<PathIndexMatch> Query(const std::wstring& root, const std::wstring& query, size_t maxResults);
+
+    /**
+     * Returns the shortest file name starting with prefix, or an empty string.
+     * If recursive is false only files directly in root are considered.
+     */
+    std::wstring                SuggestFileName(const std::wstring& root, const std::wstring& prefix, bool recursive);
+
+    /**
+     * Sets the folders which are not indexed and the file extensions which are
+     * never returned. Excluded folders only affect roots that are indexed afterwards.
+     * Both lists must be lower case.
+     */
+    void                        SetExclusions(const std::vector<std::wstring>& folders, const std::vector<std::wstring>& extensions);
+
+private:
+    CPathIndex()  = default;
+    ~CPathIndex() = default;
+
+    class CRoot;
+    std::shared_ptr<CRoot> GetRoot(const std::wstring& root, bool create);
+
+    std::mutex                                     m_mutex;
+    std::map<std::wstring, std::shared_ptr<CRoot>> m_roots;
+    uint64_t                                       m_useCount = 0;
+    std::vector<std::wstring>                      m_excludedFolders = {L".svn", L".git"};
+    std::vector<std::wstring>                      m_excludedExtensions;
+};
@@ -32,7 +32,13 @@
 #include "../ext/scintilla/include/ILexer.h"
 #include "../ext/scintilla/include/ScintillaStructures.h"
 
+#include <algorithm>
 #include <chrono>
+#include <thread>
+#if defined(_M_X64) || defined(_M_IX86)
+#    include <emmintrin.h>
+#    include <intrin.h>
+#endif
 #include <UIRibbon.h>
 #include <UIRibbonPropertyHelpers.h>
 #include <uxtheme.h>
@@ -65,6 +71,7 @@ UINT32                      g_contextID                    = cmdContextMap;
 constexpr int               TIM_HIDECURSOR                 = 101;
 constexpr int               TIM_BRACEHIGHLIGHTTEXT         = 102;
 constexpr int               TIM_BRACEHIGHLIGHTTEXTCLEAR    = 103;
+constexpr int               TIM_SELTEXTCOUNT               = 104;
 
 static bool                 g_scintillaInitialized         = false;
 
@@ -87,6 +94,12 @@ CScintillaWnd::CScintillaWnd(HINSTANCE hInst)
     : CWindow(hInst)
     , m_scrollTool(hInst)
     , m_selTextMarkerCount(0)
+    , m_selTextCounting(false)
+    , m_selTextWholeWord(false)
+    , m_textSnapshotDoc(nullptr)
+    , m_selTextGeneration(0)
+    , m_selTextDone(false)
+    , m_selTextPosted(false)
     , m_bCursorShown(true)
     , m_bScratch(false)
     , m_eraseBkgnd(true)
@@ -115,6 +128,9 @@ CScintillaWnd::CScintillaWnd(HINSTANCE hInst)
 
 CScintillaWnd::~CScintillaWnd()
 {
+    ++m_selTextGeneration;
+    if (m_selTextThread.joinable())
+        m_selTextThread.join();
     if (m_bScratch)
     {
         DestroyWindow(*this);
@@ -182,6 +198,8 @@ bool CScintillaWnd::Init(HINSTANCE hInst, HWND hParent, HWND hWndAttachTo)
     m_scintilla.SetMarginCursorN(SC_MARGE_SYMBOL, Scintilla::CursorShape::Arrow);
     m_scintilla.MarkerSetAlpha(MARK_BOOKMARK, static_cast<Scintilla::Alpha>(70));
     m_scintilla.MarkerDefine(MARK_BOOKMARK, Scintilla::MarkerSymbol::VerticalBookmark);
+    m_scintilla.MarkerDefine(MARK_HOTSPOTSCANNED, Scintilla::MarkerSymbol::Empty);
+    m_scintilla.MarkerDefine(MARK_ANNOTATIONCHECKED, Scintilla::MarkerSymbol::Empty);
 
     m_scintilla.SetMarginSensitiveN(SC_MARGE_FOLDER, true);
     m_scintilla.SetMarginSensitiveN(SC_MARGE_SYMBOL, true);
@@ -720,6 +738,12 @@ LRESULT CALLBACK CScintillaWnd::WinMsgHandler(HWND hwnd, UINT uMsg, WPARAM wPara
                 case TIM_BRACEHIGHLIGHTTEXTCLEAR:
                     MatchBraces(BraceMatch::Clear);
                     break;
+                case TIM_SELTEXTCOUNT:
+                    // count again once the document stopped changing
+                    KillTimer(*this, TIM_SELTEXTCOUNT);
+                    if (!m_selTextLast.empty())
+                        StartSelTextCount(m_selTextLast, m_selTextWholeWord);
+                    break;
                 default:
                     break;
             }
@@ -923,7 +947,10 @@ void CScintillaWnd::SaveCurrentPos(CPosData& pos)
     {
         m_lineToScrollToAfterPaint = -1;
     }
+}
 
+CUndoData CScintillaWnd::GetUndoData() const
+{
     CUndoData undoData;
     undoData.m_savePoint     = m_scintilla.UndoSavePoint();
     undoData.m_currentAction = m_scintilla.UndoCurrent();
@@ -942,7 +969,7 @@ void CScintillaWnd::SaveCurrentPos(CPosData& pos)
             undoData.m_actions.push_back(undoAction);
         }
     }
-    pos.m_undoData = undoData;
+    return undoData;
 }
 
 void CScintillaWnd::RestoreCurrentPos(const CPosData& pos)
@@ -1477,13 +1504,11 @@ void CScintillaWnd::SelectionUpdated() const
 
 void CScintillaWnd::MarkSelectedWord(bool clear, bool edit)
 {
-    static std::string    lastSelText;
-    static Sci_PositionCR lastStopPosition = 0;
-    auto                  firstLine        = m_scintilla.FirstVisibleLine();
-    auto                  lastLine         = firstLine + m_scintilla.LinesOnScreen();
-    auto                  startStylePos    = m_scintilla.PositionFromLine(firstLine);
-    startStylePos                          = max(startStylePos, 0);
-    auto endStylePos                       = m_scintilla.PositionFromLine(lastLine) + m_scintilla.LineLength(lastLine);
+    auto firstLine     = m_scintilla.FirstVisibleLine();
+    auto lastLine      = firstLine + m_scintilla.LinesOnScreen();
+    auto startStylePos = m_scintilla.PositionFromLine(firstLine);
+    startStylePos      = max(startStylePos, 0);
+    auto endStylePos   = m_scintilla.PositionFromLine(lastLine) + m_scintilla.LineLength(lastLine);
     if (endStylePos < 0)
         endStylePos = m_scintilla.Length();
 
@@ -1498,10 +1523,10 @@ void CScintillaWnd::MarkSelectedWord(bool clear, bool edit)
     auto selSpan = m_scintilla.SelectionSpan();
     if (clear || selSpan.Length() == 0 )
     {
-        lastSelText.clear();
-        m_docScroll.Clear(DOCSCROLLTYPE_SELTEXT);
-        m_selTextMarkerCount = 0;
-        SendMessage(*this, WM_NCPAINT, static_cast<WPARAM>(1), 0);
+        // the snapshot might be of a document that changed while it wasn't shown
+        if (clear)
+            m_textSnapshot.reset();
+        ClearSelTextMarkers();
         return;
     }
     auto sSelText     = m_scintilla.GetSelText();
@@ -1512,10 +1537,7 @@ void CScintillaWnd::MarkSelectedWord(bool clear, bool edit)
     auto selEndLine   = m_scintilla.LineFromPosition(origSelEnd);
     if (selStartLine != selEndLine)
     {
-        lastSelText.clear();
-        m_docScroll.Clear(DOCSCROLLTYPE_SELTEXT);
-        m_selTextMarkerCount = 0;
-        SendMessage(*this, WM_NCPAINT, static_cast<WPARAM>(1), 0);
+        ClearSelTextMarkers();
         return;
     }
 
@@ -1527,25 +1549,20 @@ void CScintillaWnd::MarkSelectedWord(bool clear, bool edit)
     auto origSelText = sSelText;
     if (origSelText.empty())
     {
-        lastSelText.clear();
-        m_docScroll.Clear(DOCSCROLLTYPE_SELTEXT);
-        m_selTextMarkerCount = 0;
-        SendMessage(*this, WM_NCPAINT, static_cast<WPARAM>(1), 0);
+        ClearSelTextMarkers();
         return;
     }
     if (!edit)
         CStringUtils::trim(sSelText);
     if (sSelText.empty())
     {
-        lastSelText.clear();
-        m_docScroll.Clear(DOCSCROLLTYPE_SELTEXT);
-        m_selTextMarkerCount = 0;
-        SendMessage(*this, WM_NCPAINT, static_cast<WPARAM>(1), 0);
+        ClearSelTextMarkers();
         return;
     }
     // don't mark the text again if it's already marked by the search feature
     if (_stricmp(g_sHighlightString.c_str(), origSelText.c_str()) == 0)
     {
+        StopSelTextCount();
         m_selTextMarkerCount = g_searchMarkerCount;
         return;
     }
@@ -1566,64 +1583,212 @@ void CScintillaWnd::MarkSelectedWord(bool clear, bool edit)
         startPos = strstr(startPos + 1, origSelText.c_str());
     }
 
-    auto lineCount = m_scintilla.LineCount();
-    if ((selTextLen > 1) || (lineCount < 100000))
+    if (edit)
     {
-        auto selTextDifferent = lastSelText.compare(origSelText.c_str());
-        if (selTextDifferent || (lastStopPosition != 0) || edit)
+        // the selections are added right away, so count in one go
+        StopSelTextCount();
+        m_docScroll.Clear(DOCSCROLLTYPE_SELTEXT);
+        m_selTextMarkerCount = 0;
+        int                       addSelCount = 0;
+        Scintilla::TextToFindFull findText{};
+        findText.chrg.cpMin     = 0;
+        findText.chrg.cpMax     = m_scintilla.Length();
+        findText.lpstrText      = origSelText.c_str();
+        const auto selTextColor = CTheme::Instance().GetThemeColor(RGB(0, 255, 0), true);
+        auto       findOptions  = Scintilla::FindOption::MatchCase;
+        if (wholeWord)
+            findOptions |= Scintilla::FindOption::WholeWord;
+        while (m_scintilla.FindTextFull(findOptions, &findText) >= 0)
         {
-            int  addSelCount = 0;
-            auto start       = std::chrono::steady_clock::now();
-            if (selTextDifferent)
+            if ((origSelStart != findText.chrgText.cpMin) || (origSelEnd != findText.chrgText.cpMax))
             {
-                m_docScroll.Clear(DOCSCROLLTYPE_SELTEXT);
-                m_selTextMarkerCount = 0;
+                m_scintilla.AddSelection(findText.chrgText.cpMax, findText.chrgText.cpMin);
+                ++addSelCount;
             }
-            Scintilla::TextToFindFull findText{};
-            findText.chrg.cpMin     = lastStopPosition;
-            findText.chrg.cpMax     = m_scintilla.Length();
-            findText.lpstrText      = origSelText.c_str();
-            lastStopPosition        = 0;
-            const auto selTextColor = CTheme::Instance().GetThemeColor(RGB(0, 255, 0), true);
-            auto       findOptions  = Scintilla::FindOption::MatchCase;
-            if (wholeWord)
-                findOptions |= Scintilla::FindOption::WholeWord;
-            while (m_scintilla.FindTextFull(findOptions, &findText) >= 0)
+            auto line = m_scintilla.LineFromPosition(findText.chrgText.cpMin);
+            m_docScroll.AddLineColor(DOCSCROLLTYPE_SELTEXT, line, selTextColor);
+            ++m_selTextMarkerCount;
+            if (findText.chrg.cpMin >= findText.chrgText.cpMax)
+                break;
+            findText.chrg.cpMin = findText.chrgText.cpMax;
+        }
+        if (addSelCount > 0)
+            m_scintilla.AddSelection(origSelEnd, origSelStart);
+        SendMessage(*this, WM_NCPAINT, static_cast<WPARAM>(1), 0);
+    }
+    else if (m_selTextLast != origSelText)
+        StartSelTextCount(origSelText, wholeWord);
+    m_selTextLast = origSelText;
+}
+
+void CScintillaWnd::ClearSelTextMarkers()
+{
+    StopSelTextCount();
+    m_selTextLast.clear();
+    m_docScroll.Clear(DOCSCROLLTYPE_SELTEXT);
+    m_selTextMarkerCount = 0;
+    SendMessage(*this, WM_NCPAINT, static_cast<WPARAM>(1), 0);
+}
+
+// Returns the position of the first occurrence of needle in text at or after pos, or npos.
+// Checks 16 positions at once by comparing their first and last byte with
+// the needle before comparing the bytes in between.
+static size_t FindInText(std::string_view text, std::string_view needle, size_t pos)
+{
+#if defined(_M_X64) || defined(_M_IX86)
+    const size_t length = needle.size();
+    if (length > 1)
+    {
+        const __m128i first = _mm_set1_epi8(needle.front());
+        const __m128i last  = _mm_set1_epi8(needle.back());
+        const char*   data  = text.data();
+        for (; pos + length + 15 <= text.size(); pos += 16)
+        {
+            const __m128i blockFirst = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + pos));
+            const __m128i blockLast  = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + pos + length - 1));
+            unsigned      mask       = static_cast<unsigned>(_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(first, blockFirst), _mm_cmpeq_epi8(last, blockLast))));
+            while (mask)
             {
-                if (edit)
-                {
-                    if ((origSelStart != findText.chrgText.cpMin) || (origSelEnd != findText.chrgText.cpMax))
-                    {
-                        m_scintilla.AddSelection(findText.chrgText.cpMax, findText.chrgText.cpMin);
-                        ++addSelCount;
-                    }
-                }
-                auto line = m_scintilla.LineFromPosition(findText.chrgText.cpMin);
-                m_docScroll.AddLineColor(DOCSCROLLTYPE_SELTEXT, line, selTextColor);
-                ++m_selTextMarkerCount;
-                if (findText.chrg.cpMin >= findText.chrgText.cpMax)
-                    break;
-                findText.chrg.cpMin = findText.chrgText.cpMax;
+                unsigned long bit = 0;
+                _BitScanForward(&bit, mask);
+                if (memcmp(data + pos + bit + 1, needle.data() + 1, length - 2) == 0)
+                    return pos + bit;
+                mask &= mask - 1;
+            }
+        }
+    }
+#endif
+    return text.find(needle, pos);
+}
 
-                if (!edit)
-                {
-                    // stop after 1.5 seconds - users don't want to wait for too long
-                    auto end = std::chrono::steady_clock::now();
-                    if (std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() > 1500)
-                    {
-                        lastStopPosition = findText.chrg.cpMin;
-                        break;
-                    }
-                }
+std::shared_ptr<const std::string> CScintillaWnd::GetTextSnapshot()
+{
+    if (!m_textSnapshot || m_textSnapshotDoc != m_scintilla.DocPointer())
+    {
+        m_textSnapshot    = std::make_shared<const std::string>(m_scintilla.StringOfRange(Scintilla::Span(0, m_scintilla.Length())));
+        m_textSnapshotDoc = m_scintilla.DocPointer();
+    }
+    return m_textSnapshot;
+}
+
+void CScintillaWnd::StartSelTextCount(const std::string& selText, bool wholeWord)
+{
+    StopSelTextCount();
+    m_docScroll.Clear(DOCSCROLLTYPE_SELTEXT);
+    m_selTextMarkerCount = 0;
+    m_selTextCounting    = true;
+    m_selTextLast        = selText;
+    m_selTextWholeWord   = wholeWord;
+    {
+        std::lock_guard<std::mutex> lock(m_selTextMutex);
+        m_selTextLines.clear();
+        m_selTextDone   = false;
+        m_selTextPosted = false;
+    }
+    // the thread works on a snapshot since the document may change while it runs
+    std::array<bool, 256> isWordChar{};
+    if (wholeWord)
+    {
+        for (int c = 0x80; c < 256; ++c)
+            isWordChar[c] = true;
+        for (char c : GetWordChars())
+            isWordChar[static_cast<unsigned char>(c)] = true;
+    }
+    const char lineEnd = m_scintilla.EOLMode() == Scintilla::EndOfLine::Cr ? '\r' : '\n';
+    m_selTextThread    = std::thread(&CScintillaWnd::SelTextCountThread, this, GetTextSnapshot(), selText, isWordChar, wholeWord, lineEnd,
+                                     m_selTextGeneration.load(), GetParent(*this));
+    SendMessage(*this, WM_NCPAINT, static_cast<WPARAM>(1), 0);
+}
+
+void CScintillaWnd::StopSelTextCount()
+{
+    KillTimer(*this, TIM_SELTEXTCOUNT);
+    ++m_selTextGeneration;
+    m_selTextCounting = false;
+    // the thread checks the generation after every chunk, so it ends soon
+    if (m_selTextThread.joinable())
+        m_selTextThread.join();
+}
+
+void CScintillaWnd::SelTextCountThread(std::shared_ptr<const std::string> snapshot, std::string selText, std::array<bool, 256> isWordChar, bool wholeWord,
+                                       char lineEnd, unsigned generation, HWND notifyWnd)
+{
+    // the lines are handed over in batches, so the markers show up while
+    // the rest of a huge document is still searched
+    constexpr size_t chunkSize = 4 * 1024 * 1024;
+
+    // same rules as a FindText loop with FindOption::WholeWord: matches
+    // don't overlap and must not have word characters around them
+    const std::string_view text(*snapshot);
+    auto                   isWord = [&](size_t pos) {
+        if (!wholeWord)
+            return true;
+        if (pos > 0 && isWordChar[static_cast<unsigned char>(text[pos - 1])])
+            return false;
+        auto end = pos + selText.size();
+        return end >= text.size() || !isWordChar[static_cast<unsigned char>(text[end])];
+    };
+
+    // the lines of the matches are counted along the way, so the UI thread
+    // doesn't have to look up the line of every match
+    std::vector<size_t> lines;
+    size_t              line    = 0;
+    size_t              linePos = 0;
+    size_t              pos     = 0;
+    for (size_t chunkEnd = chunkSize;; chunkEnd += chunkSize)
+    {
+        if (m_selTextGeneration != generation)
+            return;
+        while ((pos = FindInText(text, selText, pos)) != std::string::npos && pos < chunkEnd)
+        {
+            if (isWord(pos))
+            {
+                line += std::count(text.begin() + linePos, text.begin() + pos, lineEnd);
+                linePos = pos;
+                lines.push_back(line);
+                pos += selText.size();
             }
-            if (edit && addSelCount > 0)
-                m_scintilla.AddSelection(origSelEnd, origSelStart);
-            SendMessage(*this, WM_NCPAINT, static_cast<WPARAM>(1), 0);
+            else
+                ++pos;
         }
-        lastSelText = origSelText.c_str();
+        const bool done = pos == std::string::npos;
+        {
+            std::lock_guard<std::mutex> lock(m_selTextMutex);
+            if (m_selTextGeneration != generation)
+                return;
+            m_selTextLines.insert(m_selTextLines.end(), lines.begin(), lines.end());
+            m_selTextDone = done;
+            if (!m_selTextPosted)
+            {
+                m_selTextPosted = true;
+                PostMessage(notifyWnd, WM_SELTEXTMARKERS, static_cast<WPARAM>(generation), 0);
+            }
+        }
+        lines.clear();
+        if (done)
+            return;
     }
 }
 
+void CScintillaWnd::AddSelTextMarkers(unsigned generation)
+{
+    std::vector<size_t> lines;
+    bool                done = false;
+    {
+        std::lock_guard<std::mutex> lock(m_selTextMutex);
+        if (generation != m_selTextGeneration)
+            return;
+        lines.swap(m_selTextLines);
+        done            = m_selTextDone;
+        m_selTextPosted = false;
+    }
+    m_docScroll.AddLineColors(DOCSCROLLTYPE_SELTEXT, lines, CTheme::Instance().GetThemeColor(RGB(0, 255, 0), true));
+    m_selTextMarkerCount += static_cast<sptr_t>(lines.size());
+    if (done)
+        m_selTextCounting = false;
+    SendMessage(*this, WM_NCPAINT, static_cast<WPARAM>(1), 0);
+}
+
 void CScintillaWnd::MatchBraces(BraceMatch what)
 {
     static sptr_t lastIndicatorStart  = 0;
@@ -1751,6 +1916,20 @@ void CScintillaWnd::GotoBrace() const
         if (charAfter && wcschr(brackets, charAfter))
             braceAtCaret = caretPos;
     }
+    if (braceAtCaret < 0)
+    {
+        // not at a brace: go to the matching xml/html tag instead
+        XmlMatchedTagsPos xmlTags = {0};
+        if (GetXmlMatchedTagsPos(xmlTags) && xmlTags.tagCloseStart != -1)
+        {
+            bool inOpenTag = caretPos < xmlTags.tagOpenEnd;
+            if (shift)
+                m_scintilla.SetSel(xmlTags.tagOpenStart, xmlTags.tagCloseEnd);
+            else
+                m_scintilla.GotoPos((inOpenTag ? xmlTags.tagCloseStart : xmlTags.tagOpenStart) + 1);
+            return;
+        }
+    }
     if (braceAtCaret >= 0)
     {
         braceOpposite = m_scintilla.BraceMatch(braceAtCaret, 0);
@@ -1792,7 +1971,10 @@ void CScintillaWnd::MatchTags() const
     if ((lexer != SCLEX_HTML) &&
         (lexer != SCLEX_XML) &&
         (lexer != SCLEX_PHPSCRIPT))
+    {
+        m_tagIndex.Clear();
         return;
+    }
 
     // Get the original targets and search options to restore after tag matching operation
     auto              originalStartPos    = m_scintilla.TargetStart();
@@ -1879,272 +2061,51 @@ LRESULT CALLBACK CScintillaWnd::HandleScrollbarCustomDraw(WPARAM wParam, NMCSBCU
 
 bool CScintillaWnd::GetXmlMatchedTagsPos(XmlMatchedTagsPos& xmlTags) const
 {
-    bool       tagFound         = false;
-    auto       caret            = m_scintilla.CurrentPos();
-    auto       searchStartPoint = caret;
-    sptr_t     styleAt          = 0;
-    FindResult openFound{};
-
-    // Search back for the previous open angle bracket.
-    // Keep looking whilst the angle bracket found is inside an XML attribute
-    do
-    {
-        openFound        = FindText("<", searchStartPoint, 0, Scintilla::FindOption::None);
-        styleAt          = m_scintilla.StyleAt(openFound.start);
-        searchStartPoint = openFound.start - 1;
-    } while (openFound.success && (styleAt == SCE_H_DOUBLESTRING || styleAt == SCE_H_SINGLESTRING) && searchStartPoint > 0);
-
-    if (openFound.success && styleAt != SCE_H_CDATA)
-    {
-        // Found the "<" before the caret, now check there isn't a > between that position and the caret.
-        FindResult closeFound{};
-        searchStartPoint = openFound.start;
-        do
-        {
-            closeFound       = FindText(">", searchStartPoint, caret, Scintilla::FindOption::None);
-            styleAt          = m_scintilla.StyleAt(closeFound.start);
-            searchStartPoint = closeFound.end;
-        } while (closeFound.success && (styleAt == SCE_H_DOUBLESTRING || styleAt == SCE_H_SINGLESTRING) && searchStartPoint <= caret);
-
-        if (!closeFound.success)
-        {
-            // We're in a tag (either a start tag or an end tag)
-            auto nextChar = m_scintilla.CharAt(openFound.start + 1);
-
-            /////////////////////////////////////////////////////////////////////////
-            // CURSOR IN CLOSE TAG
-            /////////////////////////////////////////////////////////////////////////
-            if ('/' == nextChar)
-            {
-                xmlTags.tagCloseStart = openFound.start;
-                auto docLength        = m_scintilla.Length();
-                auto endCloseTag      = FindText(">", caret, docLength, Scintilla::FindOption::None);
-                if (endCloseTag.success)
-                {
-                    xmlTags.tagCloseEnd = endCloseTag.end;
-                }
-                // Now find the tagName
-                auto        position = openFound.start + 2;
-
-                // UTF-8 or ASCII tag name
-                std::string tagName;
-                nextChar = m_scintilla.CharAt(position);
-                // Checking for " or ' is actually wrong here, but it means it works better with invalid XML
-                while (position < docLength && !IsXMLWhitespace(nextChar) && nextChar != '/' && nextChar != '>' && nextChar != '\"' && nextChar != '\'')
-                {
-                    tagName.push_back(static_cast<char>(nextChar));
-                    ++position;
-                    nextChar = m_scintilla.CharAt(position);
-                }
-
-                // Now we know where the end of the tag is, and we know what the tag is called
-                if (!tagName.empty())
-                {
-                    /* Now we need to find the open tag.  The logic here is that we search for "<TAGNAME",
-                    * then check the next character - if it's one of '>', ' ', '\"' then we know we've found
-                    * a relevant tag.
-                    * We then need to check if either
-                    *    a) this tag is a self-closed tag - e.g. <TAGNAME attrib="value" />
-                    * or b) this tag has another closing tag after it and before our closing tag
-                    *       e.g.  <TAGNAME attrib="value">some text</TAGNAME></TAGNA|ME>
-                    *             (cursor represented by |)
-                    * If it's either of the above, then we continue searching, but only up to the
-                    * the point of the last find. (So in the (b) example above, we'd only search backwards
-                    * from the first "<TAGNAME...", as we know there's a close tag for the opened tag.
-
-                    * NOTE::  NEED TO CHECK THE ROTTEN CASE: ***********************************************************
-                    * <TAGNAME attrib="value"><TAGNAME>something</TAGNAME></TAGNAME></TAGNA|ME>
-                    * Maybe count all closing tags between start point and start of our end tag.???
-                    */
-                    auto       currentEndPoint   = xmlTags.tagCloseStart;
-                    auto       openTagsRemaining = 1;
-                    FindResult nextOpenTag{};
-                    do
-                    {
-                        nextOpenTag = FindOpenTag(tagName, currentEndPoint, 0);
-                        if (nextOpenTag.success)
-                        {
-                            --openTagsRemaining;
-                            // Open tag found
-                            // Now we need to check how many close tags there are between the open tag we just found,
-                            // and our close tag
-                            // eg. (Cursor == | )
-                            // <TAGNAME attrib="value"><TAGNAME>something</TAGNAME></TAGNAME></TAGNA|ME>
-                            //                         ^^^^^^^^ we've found this guy
-                            //                                           ^^^^^^^^^^ ^^^^^^^^ Now we need to count these fellas
-                            FindResult inBetweenCloseTag{};
-                            auto       currentStartPosition = nextOpenTag.end;
-                            sptr_t     closeTagsFound       = 0;
-                            bool       forwardSearch        = (currentStartPosition < currentEndPoint);
-
-                            do
-                            {
-                                inBetweenCloseTag = FindCloseTag(tagName, currentStartPosition, currentEndPoint);
-
-                                if (inBetweenCloseTag.success)
-                                {
-                                    ++closeTagsFound;
-                                    if (forwardSearch)
-                                    {
-                                        currentStartPosition = inBetweenCloseTag.end;
-                                    }
-                                    else
-                                    {
-                                        currentStartPosition = inBetweenCloseTag.start - 1;
-                                    }
-                                }
-
-                            } while (inBetweenCloseTag.success);
-
-                            // If we didn't find any close tags between the open and our close,
-                            // and there's no open tags remaining to find
-                            // then the open we found was the right one, and we can return it
-                            if (0 == closeTagsFound && 0 == openTagsRemaining)
-                            {
-                                xmlTags.tagOpenStart = nextOpenTag.start;
-                                xmlTags.tagOpenEnd   = nextOpenTag.end + 1;
-                                xmlTags.tagNameEnd   = nextOpenTag.start + static_cast<sptr_t>(tagName.size()) + 1; /* + 1 to account for '<' */
-                                tagFound             = true;
-                            }
-                            else
-                            {
-                                // Need to find the same number of opening tags, without closing tags etc.
-                                openTagsRemaining += closeTagsFound;
-                                currentEndPoint = nextOpenTag.start;
-                            }
-                        }
-                    } while (!tagFound && openTagsRemaining > 0 && nextOpenTag.success);
-                }
-            }
-            else
-            {
-                /////////////////////////////////////////////////////////////////////////
-                // CURSOR IN OPEN TAG
-                /////////////////////////////////////////////////////////////////////////
-                auto position        = openFound.start + 1;
-                auto docLength       = m_scintilla.Length();
-
-                xmlTags.tagOpenStart = openFound.start;
-
-                std::string tagName;
-                nextChar = m_scintilla.CharAt(position);
-                // Checking for " or ' is actually wrong here, but it means it works better with invalid XML
-                while (position < docLength && !IsXMLWhitespace(nextChar) && nextChar != '/' && nextChar != '>' && nextChar != '\"' && nextChar != '\'')
-                {
-                    tagName.push_back(static_cast<char>(nextChar));
-                    ++position;
-                    nextChar = m_scintilla.CharAt(position);
-                }
-
-                // Now we know where the end of the tag is, and we know what the tag is called
-                if (!tagName.empty())
-                {
-                    // First we need to check if this is a self-closing tag.
-                    // If it is, then we can just return this tag to highlight itself.
-                    xmlTags.tagNameEnd      = openFound.start + tagName.size() + 1;
-                    auto closeAnglePosition = FindCloseAngle(position, docLength);
-                    if (-1 != closeAnglePosition)
-                    {
-                        xmlTags.tagOpenEnd = closeAnglePosition + 1;
-                        // If it's a self closing tag
-                        if (m_scintilla.CharAt(closeAnglePosition - 1) == '/')
-                        {
-                            // Set it as found, and mark that there's no close tag
-                            xmlTags.tagCloseEnd   = -1;
-                            xmlTags.tagCloseStart = -1;
-                            tagFound              = true;
-                        }
-                        else
-                        {
-                            // It's a normal open tag
-
-                            /* Now we need to find the close tag.  The logic here is that we search for "</TAGNAME",
-                             * then check the next character - if it's '>' or whitespace followed by '>' then we've
-                             * found a relevant tag.
-                             * We then need to check if
-                             * our tag has another opening tag after it and before the closing tag we've found
-                             *       e.g.  <TA|GNAME><TAGNAME attrib="value">some text</TAGNAME></TAGNAME>
-                             *             (cursor represented by |)
-                             */
-                            auto       currentStartPosition = xmlTags.tagOpenEnd;
-                            auto       closeTagsRemaining   = 1;
-                            FindResult nextCloseTag{};
-                            do
-                            {
-                                nextCloseTag = FindCloseTag(tagName, currentStartPosition, docLength);
-                                if (nextCloseTag.success)
-                                {
-                                    --closeTagsRemaining;
-                                    // Open tag found
-                                    // Now we need to check how many close tags there are between the open tag we just found,
-                                    // and our close tag
-                                    // eg. (Cursor == | )
-                                    // <TAGNAM|E attrib="value"><TAGNAME>something</TAGNAME></TAGNAME></TAGNAME>
-                                    //                                            ^^^^^^^^ we've found this guy
-                                    //                         ^^^^^^^^^ Now we need to find this fella
-                                    FindResult inBetweenOpenTag{};
-                                    auto       currentEndPosition = nextCloseTag.start;
-                                    sptr_t     openTagsFound      = 0;
-
-                                    do
-                                    {
-                                        inBetweenOpenTag = FindOpenTag(tagName, currentStartPosition, currentEndPosition);
-
-                                        if (inBetweenOpenTag.success)
-                                        {
-                                            ++openTagsFound;
-                                            currentStartPosition = inBetweenOpenTag.end;
-                                        }
-
-                                    } while (inBetweenOpenTag.success);
-
-                                    // If we didn't find any open tags between our open and the close,
-                                    // and there's no close tags remaining to find
-                                    // then the close we found was the right one, and we can return it
-                                    if (0 == openTagsFound && 0 == closeTagsRemaining)
-                                    {
-                                        xmlTags.tagCloseStart = nextCloseTag.start;
-                                        xmlTags.tagCloseEnd   = nextCloseTag.end + 1;
-                                        tagFound              = true;
-                                    }
-                                    else
-                                    {
-                                        // Need to find the same number of closing tags, without opening tags etc.
-                                        closeTagsRemaining += openTagsFound;
-                                        currentStartPosition = nextCloseTag.end;
-                                    }
-                                }
-                            } while (!tagFound && closeTagsRemaining > 0 && nextCloseTag.success);
-                        } // end if (selfclosingtag)... else {
-                    }     // end if (-1 != closeAngle)  {
-
-                } // end if !tagName.empty()
-            }     // end open tag test
-        }
-    }
-    return tagFound;
-}
-
-FindResult CScintillaWnd::FindText(const char* text, sptr_t start, sptr_t end, Scintilla::FindOption flags) const
-{
-    FindResult                returnValue = {0};
+    int lexer = static_cast<int>(m_scintilla.Lexer());
+    if ((lexer != SCLEX_HTML) &&
+        (lexer != SCLEX_XML) &&
+        (lexer != SCLEX_PHPSCRIPT))
+        return false;
 
-    Scintilla::TextToFindFull search{};
-    search.lpstrText  = const_cast<char*>(text);
-    search.chrg.cpMin = start;
-    search.chrg.cpMax = end;
-    auto result       = m_scintilla.FindTextFull(flags, &search);
-    if (-1 == result)
+    // the tags are looked up in an index which is built once and then
+    // updated from the modifications (see ReflectEvents)
+    auto document  = m_scintilla.DocPointer();
+    auto docLength = m_scintilla.Length();
+    bool html      = lexer != SCLEX_XML;
+    if (!m_tagIndex.IsFor(document, html, docLength))
+        m_tagIndex.Build(std::string_view(static_cast<const char*>(m_scintilla.CharacterPointer()), docLength), document, html);
+
+    XmlTag tag;
+    XmlTag partner;
+    if (!m_tagIndex.TagAt(m_scintilla.CurrentPos(), tag))
+        return false;
+    const XmlTag* openTag = &tag;
+    if (tag.type == XmlTagType::SelfClosing)
     {
-        returnValue.success = false;
+        xmlTags.tagCloseStart = -1;
+        xmlTags.tagCloseEnd   = -1;
     }
     else
     {
-        returnValue.success = true;
-        returnValue.start   = search.chrgText.cpMin;
-        returnValue.end     = search.chrgText.cpMax;
+        if (!m_tagIndex.Partner(tag, partner))
+            return false;
+        if (tag.type == XmlTagType::Close)
+            openTag = &partner;
+        const XmlTag& closeTag = tag.type == XmlTagType::Close ? tag : partner;
+        xmlTags.tagCloseStart  = closeTag.start;
+        xmlTags.tagCloseEnd    = closeTag.End();
+    }
+    xmlTags.tagOpenStart = openTag->start;
+    xmlTags.tagNameEnd   = openTag->start + 1 + static_cast<sptr_t>(m_tagIndex.NameLength(*openTag));
+    xmlTags.tagOpenEnd   = openTag->End();
+
+    // the document was modified in another view
+    if (m_scintilla.CharAt(xmlTags.tagOpenStart) != '<' || m_scintilla.CharAt(xmlTags.tagOpenEnd - 1) != '>')
+    {
+        m_tagIndex.Clear();
+        return false;
     }
-    return returnValue;
+    return true;
 }
 
 sptr_t CScintillaWnd::FindText(const std::string& toFind, sptr_t startPos, sptr_t endPos) const
@@ -2156,175 +2117,6 @@ sptr_t CScintillaWnd::FindText(const std::string& toFind, sptr_t startPos, sptr_
     return m_scintilla.FindTextFull(Scintilla::FindOption::None, &ttf);
 }
 
-FindResult CScintillaWnd::FindOpenTag(const std::string& tagName, sptr_t start, sptr_t end) const
-{
-    std::string search("<");
-    search.append(tagName);
-    FindResult openTagFound = {0};
-    openTagFound.success    = false;
-    FindResult result{};
-    int        nextChar      = 0;
-    sptr_t     styleAt       = 0;
-    auto       searchStart   = start;
-    auto       searchEnd     = end;
-    bool       forwardSearch = (start < end);
-    do
-    {
-        result = FindText(search.c_str(), searchStart, searchEnd, Scintilla::FindOption::None);
-        if (result.success)
-        {
-            nextChar = static_cast<int>(m_scintilla.CharAt(result.end));
-            styleAt  = m_scintilla.StyleAt(result.start);
-            if (styleAt != SCE_H_CDATA && styleAt != SCE_H_DOUBLESTRING && styleAt != SCE_H_SINGLESTRING)
-            {
-                // We've got an open tag for this tag name (i.e. nextChar was space or '>')
-                // Now we need to find the end of the start tag.
-
-                // Common case, the tag is an empty tag with no whitespace. e.g. <TAGNAME>
-                if (nextChar == '>')
-                {
-                    openTagFound.end     = result.end;
-                    openTagFound.success = true;
-                }
-                else if (IsXMLWhitespace(nextChar))
-                {
-                    auto closeAnglePosition = FindCloseAngle(result.end, forwardSearch ? end : start);
-                    if (-1 != closeAnglePosition && '/' != m_scintilla.CharAt(closeAnglePosition - 1))
-                    {
-                        openTagFound.end     = closeAnglePosition;
-                        openTagFound.success = true;
-                    }
-                }
-            }
-        }
-
-        if (forwardSearch)
-        {
-            searchStart = result.end + 1;
-        }
-        else
-        {
-            searchStart = result.start - 1;
-        }
-
-        // Loop while we've found a <TAGNAME, but it's either in a CDATA section,
-        // or it's got more none whitespace characters after it. e.g. <TAGNAME2
-    } while (result.success && !openTagFound.success);
-
-    openTagFound.start = result.start;
-
-    return openTagFound;
-}
-
-sptr_t CScintillaWnd::FindCloseAngle(sptr_t startPosition, sptr_t endPosition) const
-{
-    // We'll search for the next '>', and check it's not in an attribute using the style
-    FindResult closeAngle{};
-
-    bool       isValidClose   = false;
-    sptr_t     returnPosition = -1;
-
-    // Only search forwards
-    if (startPosition > endPosition)
-    {
-        auto temp     = endPosition;
-        endPosition   = startPosition;
-        startPosition = temp;
-    }
-
-    do
-    {
-        isValidClose = false;
-
-        closeAngle   = FindText(">", startPosition, endPosition, Scintilla::FindOption::None);
-        if (closeAngle.success)
-        {
-            int style = static_cast<int>(m_scintilla.StyleAt(closeAngle.start));
-            // As long as we're not in an attribute (  <TAGNAME attrib="val>ue"> is VALID XML. )
-            if (style != SCE_H_DOUBLESTRING && style != SCE_H_SINGLESTRING)
-            {
-                returnPosition = closeAngle.start;
-                isValidClose   = true;
-            }
-            else
-            {
-                startPosition = closeAngle.end;
-            }
-        }
-
-    } while (closeAngle.success && isValidClose == false);
-
-    return returnPosition;
-}
-
-FindResult CScintillaWnd::FindCloseTag(const std::string& tagName, sptr_t start, sptr_t end) const
-{
-    std::string search("</");
-    search.append(tagName);
-    FindResult closeTagFound = {0};
-    closeTagFound.success    = false;
-    FindResult result{};
-    int        nextChar      = 0;
-    sptr_t     styleAt       = 0;
-    auto       searchStart   = start;
-    auto       searchEnd     = end;
-    bool       forwardSearch = (start < end);
-    bool       validCloseTag = false;
-    do
-    {
-        validCloseTag = false;
-        result        = FindText(search.c_str(), searchStart, searchEnd, Scintilla::FindOption::None);
-        if (result.success)
-        {
-            nextChar = static_cast<int>(m_scintilla.CharAt(result.end));
-            styleAt  = m_scintilla.StyleAt(result.start);
-
-            // Setup the parameters for the next search, if there is one.
-            if (forwardSearch)
-            {
-                searchStart = result.end + 1;
-            }
-            else
-            {
-                searchStart = result.start - 1;
-            }
-
-            if (styleAt != SCE_H_CDATA && styleAt != SCE_H_SINGLESTRING && styleAt != SCE_H_DOUBLESTRING) // If what we found was in CDATA section, it's not a valid tag.
-            {
-                // Common case - '>' follows the tag name directly
-                if (nextChar == '>')
-                {
-                    validCloseTag         = true;
-                    closeTagFound.start   = result.start;
-                    closeTagFound.end     = result.end;
-                    closeTagFound.success = true;
-                }
-                else if (IsXMLWhitespace(nextChar)) // Otherwise, if it's whitespace, then allow whitespace until a '>' - any other character is invalid.
-                {
-                    auto whitespacePoint = result.end;
-                    do
-                    {
-                        ++whitespacePoint;
-                        nextChar = static_cast<int>(m_scintilla.CharAt(whitespacePoint));
-
-                    } while (IsXMLWhitespace(nextChar));
-
-                    if (nextChar == '>')
-                    {
-                        validCloseTag         = true;
-                        closeTagFound.start   = result.start;
-                        closeTagFound.end     = whitespacePoint;
-                        closeTagFound.success = true;
-                    }
-                }
-            }
-        }
-
-    } while (result.success && !validCloseTag);
-
-    return closeTagFound;
-}
-
 std::vector<std::pair<sptr_t, sptr_t>> CScintillaWnd::GetAttributesPos(sptr_t start, sptr_t end) const
 {
     std::vector<std::pair<sptr_t, sptr_t>> attributes;
@@ -2569,7 +2361,25 @@ void CScintillaWnd::ReflectEvents(SCNotification* pScn)
         case SCN_SAVEPOINTREACHED:
             EnableChangeHistory();
             break;
-            case SCN_MODIFIED:
+        case SCN_MODIFIED:
+            // the snapshot and the counted occurrences of the selected text
+            // don't match the text anymore: count again after the edits
+            if (pScn->modificationType & (SC_MOD_INSERTTEXT | SC_MOD_DELETETEXT))
+            {
+                m_textSnapshot.reset();
+                if (!m_selTextLast.empty())
+                {
+                    StopSelTextCount();
+                    SetTimer(*this, TIM_SELTEXTCOUNT, 500, nullptr);
+                }
+            }
+            if (pScn->modificationType & (SC_MOD_INSERTTEXT | SC_MOD_DELETETEXT))
+            {
+                bool inserted = (pScn->modificationType & SC_MOD_INSERTTEXT) != 0;
+                m_tagIndex.Update(
+                    m_scintilla.DocPointer(), [this](sptr_t start, sptr_t length) { return std::string_view(static_cast<const char*>(m_scintilla.RangePointer(start, length)), length); },
+                    m_scintilla.Length(), pScn->position, inserted ? pScn->length : 0, inserted ? 0 : pScn->length);
+            }
             if (pScn->modificationType & SC_MOD_INSERTTEXT)
             {
                 if (!m_hugeLevelReached && m_scintilla.Length() > 500 * 1024 * 1024)
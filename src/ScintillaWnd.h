@@ -20,12 +20,18 @@
 #include "Document.h"
 #include "DocScroll.h"
 #include "ScrollTool.h"
+#include "TagIndex.h"
 #include "AnimationManager.h"
 #include "../ext/scintilla/include/ILexer.h"
 #include "../ext/scintilla/include/ScintillaTypes.h"
 #include "../ext/scintilla/include/ScintillaCall.h"
 
 #include <array>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
 #include <vector>
 
 class CPosData;
@@ -53,6 +59,10 @@ constexpr int        SC_MARGE_SYMBOL     = 2;
 constexpr int        SC_MARGE_FOLDER     = 4;
 
 constexpr int        MARK_BOOKMARK       = 20;
+// invisible markers for lines which were already scanned for urls
+// and checked against the annotation rules
+constexpr int        MARK_HOTSPOTSCANNED    = 19;
+constexpr int        MARK_ANNOTATIONCHECKED = 18;
 
 constexpr int        SCN_BP_MOUSEMSG     = 4000;
 
@@ -80,13 +90,6 @@ struct XmlMatchedTagsPos
     sptr_t tagCloseEnd;
 };
 
-struct FindResult
-{
-    sptr_t start;
-    sptr_t end;
-    bool   success;
-};
-
 class LexerData;
 
 class CScintillaWnd : public CWindow
@@ -102,18 +105,26 @@ public:
     Scintilla::ScintillaCall& Scintilla() const { return m_scintilla; }
 
     void                      UpdateLineNumberWidth() const;
+    /// saves the view state: the undo history stays in the document, use GetUndoData() if it's needed
     void                      SaveCurrentPos(CPosData& pos);
+    /// copies the undo history of the document, which is expensive for a long history
+    CUndoData                 GetUndoData() const;
+    /// a read-only copy of the whole text for threads, shared until the text changes
+    std::shared_ptr<const std::string> GetTextSnapshot();
     void                      RestoreCurrentPos(const CPosData& pos);
     void                      SetupLexerForLang(const std::string& lang);
     void                      MarginClick(SCNotification* pNotification);
     void                      SelectionUpdated() const;
     void                      MarkSelectedWord(bool clear, bool edit);
+    /// marks the occurrences of the selected text the background count found so far
+    void                      AddSelTextMarkers(unsigned generation);
     void                      MatchBraces(BraceMatch what);
     void                      GotoBrace() const;
     void                      MatchTags() const;
     bool                      GetSelectedCount(sptr_t& selByte, sptr_t& selLine) const;
     void                      DocScrollClear(int type) { m_docScroll.Clear(type); }
     void                      DocScrollAddLineColor(int type, sptr_t line, COLORREF clr) { m_docScroll.AddLineColor(type, line, clr); }
+    void                      DocScrollAddLineColors(int type, const std::vector<size_t>& lines, COLORREF clr) { m_docScroll.AddLineColors(type, lines, clr); }
     void                      DocScrollUpdate();
     void                      DocScrollRemoveLine(int type, sptr_t line) { m_docScroll.RemoveLine(type, line); }
     void                      MarkBookmarksInScrollbar();
@@ -147,12 +158,13 @@ protected:
     void                                   SetupFoldingColors(COLORREF fore, COLORREF back, COLORREF backSel) const;
 
     bool                                   GetXmlMatchedTagsPos(XmlMatchedTagsPos& xmlTags) const;
-    FindResult                             FindText(const char* text, sptr_t start, sptr_t end, Scintilla::FindOption flags) const;
-    FindResult                             FindOpenTag(const std::string& tagName, sptr_t start, sptr_t end) const;
-    sptr_t                                 FindCloseAngle(sptr_t startPosition, sptr_t endPosition) const;
-    FindResult                             FindCloseTag(const std::string& tagName, sptr_t start, sptr_t end) const;
     std::vector<std::pair<sptr_t, sptr_t>> GetAttributesPos(sptr_t start, sptr_t end) const;
     bool                                   AutoBraces(WPARAM wParam) const;
+    void                                   StartSelTextCount(const std::string& selText, bool wholeWord);
+    void                                   StopSelTextCount();
+    void                                   SelTextCountThread(std::shared_ptr<const std::string> snapshot, std::string selText, std::array<bool, 256> isWordChar,
+                                                              bool wholeWord, char lineEnd, unsigned generation, HWND notifyWnd);
+    void                                   ClearSelTextMarkers();
 
     void                                   BookmarkAdd(sptr_t lineNo);
     void                                   BookmarkDelete(sptr_t lineNo);
@@ -163,7 +175,20 @@ private:
     mutable Scintilla::ScintillaCall m_scintilla;
     CDocScroll                       m_docScroll;
     CScrollTool                      m_scrollTool;
+    mutable CTagIndex                m_tagIndex;
     sptr_t                           m_selTextMarkerCount;
+    // occurrences of the selected text are counted in a background thread
+    std::string                      m_selTextLast;
+    bool                             m_selTextCounting;
+    bool                             m_selTextWholeWord;
+    std::shared_ptr<const std::string> m_textSnapshot; ///< dropped when the text changes
+    Document                         m_textSnapshotDoc;
+    std::atomic<unsigned>            m_selTextGeneration;
+    std::thread                      m_selTextThread;
+    std::mutex                       m_selTextMutex;
+    std::vector<size_t>              m_selTextLines; ///< lines of the occurrences not marked yet
+    bool                             m_selTextDone;
+    bool                             m_selTextPosted;
     bool                             m_bCursorShown;
     bool                             m_bScratch;
     bool                             m_eraseBkgnd;
@@ -0,0 +1,317 @@
+﻿// This file is part of BowPad.
+//
+// Copyright (C) 2025 - Stefan Kueng
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// See <http://www.gnu.org/licenses/> for a copy of the full license text
+//
+#include "stdafx.h"
+#include "SessionFile.h"
+#include "UnicodeUtils.h"
+#include "SmartHandle.h"
+#include "OnOutOfScope.h"
+#include "BinaryData.h"
+
+#include <fstream>
+#include <memory>
+#include <string_view>
+
+namespace
+{
+constexpr uint32_t sessionMagic   = 0x53535042; // "BPSS"
+// Readers ignore data at the end of a record they don't know about, so
+// fields can be added to the end of the records without a new version.
+constexpr uint32_t sessionVersion = 1;
+constexpr USHORT   undoFormat     = COMPRESSION_FORMAT_LZNT1 | COMPRESSION_ENGINE_STANDARD;
+
+// The compression functions of ntdll are available on all supported
+// Windows versions, unlike the compression api which needs Windows 8.
+class CRtlCompression
+{
+public:
+    static const CRtlCompression& Instance()
+    {
+        static CRtlCompression instance;
+        return instance;
+    }
+
+    bool Compress(const std::string& in, std::string& out) const
+    {
+        if (!m_compress || !m_getWorkSpaceSize || in.size() > MAXLONG)
+            return false;
+        ULONG workSpaceSize = 0;
+        ULONG fragmentSize  = 0;
+        if (m_getWorkSpaceSize(undoFormat, &workSpaceSize, &fragmentSize) != 0)
+            return false;
+        auto workSpace = std::make_unique<char[]>(workSpaceSize);
+        // only worth it if the result is smaller: the call fails
+        // if the compressed data doesn't fit
+        out.resize(in.size());
+        ULONG finalSize = 0;
+        if (m_compress(undoFormat, reinterpret_cast<PUCHAR>(const_cast<char*>(in.data())), static_cast<ULONG>(in.size()),
+                       reinterpret_cast<PUCHAR>(out.data()), static_cast<ULONG>(out.size()), 4096, &finalSize, workSpace.get()) != 0 ||
+            finalSize >= in.size())
+            return false;
+        out.resize(finalSize);
+        return true;
+    }
+
+    bool Decompress(std::string_view in, size_t size, std::string& out) const
+    {
+        if (!m_decompress || size > MAXLONG || in.size() > MAXLONG)
+            return false;
+        out.resize(size);
+        ULONG finalSize = 0;
+        if (m_decompress(COMPRESSION_FORMAT_LZNT1, reinterpret_cast<PUCHAR>(out.data()), static_cast<ULONG>(out.size()),
+                         reinterpret_cast<PUCHAR>(const_cast<char*>(in.data())), static_cast<ULONG>(in.size()), &finalSize) != 0)
+            return false;
+        return finalSize == size;
+    }
+
+private:
+    CRtlCompression()
+    {
+        HMODULE hDll = GetModuleHandle(L"ntdll.dll");
+        if (hDll)
+        {
+            m_getWorkSpaceSize = reinterpret_cast<GetWorkSpaceSizeFunc>(GetProcAddress(hDll, "RtlGetCompressionWorkSpaceSize"));
+            m_compress         = reinterpret_cast<CompressFunc>(GetProcAddress(hDll, "RtlCompressBuffer"));
+            m_decompress       = reinterpret_cast<DecompressFunc>(GetProcAddress(hDll, "RtlDecompressBuffer"));
+        }
+    }
+
+    using GetWorkSpaceSizeFunc = LONG(NTAPI*)(USHORT format, PULONG workSpaceSize, PULONG fragmentWorkSpaceSize);
+    using CompressFunc         = LONG(NTAPI*)(USHORT format, PUCHAR uncompressed, ULONG uncompressedSize, PUCHAR compressed,
+                                      ULONG compressedSize, ULONG chunkSize, PULONG finalCompressedSize, PVOID workSpace);
+    using DecompressFunc       = LONG(NTAPI*)(USHORT format, PUCHAR uncompressed, ULONG uncompressedSize, PUCHAR compressed,
+                                        ULONG compressedSize, PULONG finalUncompressedSize);
+
+    GetWorkSpaceSizeFunc m_getWorkSpaceSize = nullptr;
+    CompressFunc         m_compress         = nullptr;
+    DecompressFunc       m_decompress       = nullptr;
+};
+
+void PutUndo(std::string& out, const CUndoData& undoData)
+{
+    std::string raw;
+    if (!undoData.m_actions.empty())
+    {
+        Put(raw, static_cast<int32_t>(undoData.m_currentAction));
+        Put(raw, static_cast<int32_t>(undoData.m_savePoint));
+        Put(raw, static_cast<int32_t>(undoData.m_tentative));
+        Put(raw, static_cast<uint32_t>(undoData.m_actions.size()));
+        for (const auto& action : undoData.m_actions)
+        {
+            Put(raw, static_cast<int32_t>(action.m_type));
+            Put(raw, static_cast<int64_t>(action.m_position));
+            PutString(raw, action.m_text);
+        }
+    }
+    // an undo history that doesn't fit is dropped, not the whole session
+    if (raw.size() > MAXLONG)
+        raw.clear();
+    // the stored size equals the raw size if the data isn't compressed
+    std::string compressed;
+    const auto& blob = CRtlCompression::Instance().Compress(raw, compressed) ? compressed : raw;
+    Put(out, static_cast<uint32_t>(raw.size()));
+    PutString(out, blob);
+}
+
+bool GetUndo(CReader& reader, CUndoData& undoData)
+{
+    uint32_t         rawSize = 0;
+    std::string_view blob;
+    if (!reader.Get(rawSize) || !reader.GetString(blob))
+        return false;
+    if (rawSize == 0)
+        return true;
+    std::string decompressed;
+    if (blob.size() != rawSize)
+    {
+        if (!CRtlCompression::Instance().Decompress(blob, rawSize, decompressed))
+            return false;
+        blob = decompressed;
+    }
+
+    CReader  undoReader(blob);
+    int32_t  currentAction = 0;
+    int32_t  savePoint     = 0;
+    int32_t  tentative     = 0;
+    uint32_t count         = 0;
+    if (!undoReader.Get(currentAction) || !undoReader.Get(savePoint) || !undoReader.Get(tentative) || !undoReader.Get(count))
+        return false;
+    CUndoData data;
+    data.m_currentAction = currentAction;
+    data.m_savePoint     = savePoint;
+    data.m_tentative     = tentative;
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        CUndoAction      action;
+        int32_t          type     = 0;
+        int64_t          position = 0;
+        std::string_view text;
+        if (!undoReader.Get(type) || !undoReader.Get(position) || !undoReader.GetString(text))
+            return false;
+        action.m_type     = type;
+        action.m_position = static_cast<Scintilla::Position>(position);
+        action.m_text     = text;
+        data.m_actions.push_back(std::move(action));
+    }
+    undoData = std::move(data);
+    return true;
+}
+
+void PutTab(std::string& out, const SessionTab& tab)
+{
+    const auto& pos = tab.position;
+    PutString(out, tab.path);
+    PutString(out, tab.origPath);
+    PutString(out, tab.origTitle);
+    Put(out, static_cast<uint8_t>((tab.active ? 1 : 0) | (tab.modified ? 2 : 0)));
+    Put(out, static_cast<int32_t>(tab.tabSpace));
+    Put(out, static_cast<int32_t>(tab.readDir));
+    Put(out, static_cast<int32_t>(tab.wrapMode ? static_cast<int>(*tab.wrapMode) : -1));
+    Put(out, static_cast<int32_t>(pos.m_nSelMode));
+    Put(out, static_cast<int64_t>(pos.m_nStartPos));
+    Put(out, static_cast<int64_t>(pos.m_nEndPos));
+    Put(out, static_cast<int64_t>(pos.m_nScrollWidth));
+    Put(out, static_cast<int64_t>(pos.m_xOffset));
+    Put(out, static_cast<int64_t>(pos.m_nFirstVisibleLine));
+    Put(out, static_cast<int64_t>(pos.m_nWrapLineOffset));
+    Put(out, static_cast<int64_t>(pos.m_lastStyleLine));
+    Put(out, static_cast<uint32_t>(pos.m_lineStateVector.size()));
+    for (const auto line : pos.m_lineStateVector)
+        Put(out, static_cast<int64_t>(line));
+    PutUndo(out, pos.m_undoData);
+}
+
+bool GetTab(CReader& reader, SessionTab& tab)
+{
+    auto&    pos       = tab.position;
+    uint8_t  flags     = 0;
+    int32_t  tabSpace  = 0;
+    int32_t  readDir   = 0;
+    int32_t  wrapMode  = 0;
+    int32_t  selMode   = 0;
+    int64_t  values[7] = {};
+    uint32_t numFolds  = 0;
+    if (!reader.GetString(tab.path) || !reader.GetString(tab.origPath) || !reader.GetString(tab.origTitle) ||
+        !reader.Get(flags) || !reader.Get(tabSpace) || !reader.Get(readDir) || !reader.Get(wrapMode) || !reader.Get(selMode))
+        return false;
+    for (auto& value : values)
+    {
+        if (!reader.Get(value))
+            return false;
+    }
+    if (!reader.Get(numFolds))
+        return false;
+    pos.m_lineStateVector.clear();
+    for (uint32_t i = 0; i < numFolds; ++i)
+    {
+        int64_t line = 0;
+        if (!reader.Get(line))
+            return false;
+        pos.m_lineStateVector.push_back(static_cast<sptr_t>(line));
+    }
+    tab.active              = (flags & 1) != 0;
+    tab.modified            = (flags & 2) != 0;
+    tab.tabSpace            = static_cast<TabSpace>(tabSpace);
+    tab.readDir             = static_cast<Scintilla::Bidirectional>(readDir);
+    tab.wrapMode            = wrapMode < 0 ? std::nullopt : std::optional(static_cast<Scintilla::Wrap>(wrapMode));
+    pos.m_nSelMode          = static_cast<Scintilla::SelectionMode>(selMode);
+    pos.m_nStartPos         = static_cast<sptr_t>(values[0]);
+    pos.m_nEndPos           = static_cast<sptr_t>(values[1]);
+    pos.m_nScrollWidth      = static_cast<sptr_t>(values[2]);
+    pos.m_xOffset           = static_cast<sptr_t>(values[3]);
+    pos.m_nFirstVisibleLine = static_cast<sptr_t>(values[4]);
+    pos.m_nWrapLineOffset   = static_cast<sptr_t>(values[5]);
+    pos.m_lastStyleLine     = static_cast<sptr_t>(values[6]);
+    // a damaged undo history only loses the undo history
+    if (!GetUndo(reader, pos.m_undoData))
+        pos.m_undoData = {};
+    return true;
+}
+} // namespace
+
+bool CSessionFile::Read(const std::wstring& path, std::vector<SessionTab>& tabs)
+{
+    CAutoFile hFile = CreateFile(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (!hFile.IsValid())
+        return false;
+    LARGE_INTEGER fileSize{};
+    if (!GetFileSizeEx(hFile, &fileSize) || fileSize.QuadPart == 0 || static_cast<uint64_t>(fileSize.QuadPart) > SIZE_MAX)
+        return false;
+    CAutoFile hFileMapping = CreateFileMapping(hFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!hFileMapping)
+        return false;
+    auto view = MapViewOfFile(hFileMapping, FILE_MAP_READ, 0, 0, 0);
+    if (!view)
+        return false;
+    OnOutOfScope(UnmapViewOfFile(view););
+
+    CReader  reader(std::string_view(static_cast<const char*>(view), static_cast<size_t>(fileSize.QuadPart)));
+    uint32_t magic   = 0;
+    uint32_t version = 0;
+    uint32_t count   = 0;
+    if (!reader.Get(magic) || magic != sessionMagic || !reader.Get(version) || version != sessionVersion || !reader.Get(count))
+        return false;
+    std::vector<SessionTab> sessionTabs;
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        std::string_view record;
+        if (!reader.GetString(record))
+            break;
+        // the length prefix allows to skip a damaged record
+        CReader    recordReader(record);
+        SessionTab tab;
+        if (GetTab(recordReader, tab))
+            sessionTabs.push_back(std::move(tab));
+    }
+    tabs = std::move(sessionTabs);
+    return true;
+}
+
+bool CSessionFile::Write(const std::wstring& path, const std::vector<SessionTab>& tabs)
+{
+    std::string data;
+    Put(data, sessionMagic);
+    Put(data, sessionVersion);
+    Put(data, static_cast<uint32_t>(tabs.size()));
+    std::string record;
+    for (const auto& tab : tabs)
+    {
+        record.clear();
+        PutTab(record, tab);
+        PutString(data, record);
+    }
+
+    // write a temp file first so a crash can't leave a half written session
+    const auto tempPath = path + L".tmp";
+    {
+        std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+        if (!file.good())
+            return false;
+        file.write(data.data(), static_cast<std::streamsize>(data.size()));
+        if (!file.good())
+        {
+            file.close();
+            DeleteFile(tempPath.c_str());
+            return false;
+        }
+    }
+    if (!MoveFileEx(tempPath.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING))
+    {
+        DeleteFile(tempPath.c_str());
+        return false;
+    }
+    return true;
+}
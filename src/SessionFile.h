@@ -0,0 +1,51 @@
+﻿// This file is part of BowPad.
+//
+// Copyright (C) 2025 - Stefan Kueng
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// See <http://www.gnu.org/licenses/> for a copy of the full license text
+//
+#pragma once
+#include "Document.h"
+
+#include <string>
+#include <vector>
+#include <optional>
+
+/// The state of one tab of a saved session.
+struct SessionTab
+{
+    std::wstring                   path;      ///< if relative, the file is in the backup folder
+    std::wstring                   origPath;  ///< the path of a modified file, empty for a new file
+    std::wstring                   origTitle; ///< the tab title of a modified file
+    CPosData                       position;
+    TabSpace                       tabSpace = TabSpace::Default;
+    Scintilla::Bidirectional       readDir  = Scintilla::Bidirectional::Disabled;
+    std::optional<Scintilla::Wrap> wrapMode;
+    bool                           active   = false;
+    bool                           modified = false; ///< path is a backup of the modifications
+};
+
+/**
+ * Reads and writes the tabs of a session as a binary file.
+ *
+ * The file starts with a header with the format version, followed by one
+ * length prefixed record per tab so records can be skipped without parsing
+ * them. The undo history of a tab is stored as one compressed blob.
+ * The file is memory mapped for reading.
+ */
+class CSessionFile
+{
+public:
+    static bool Read(const std::wstring& path, std::vector<SessionTab>& tabs);
+    static bool Write(const std::wstring& path, const std::vector<SessionTab>& tabs);
+};
@@ -0,0 +1,266 @@
+﻿// This file is part of BowPad.
+//
+// Copyright (C) 2025 - Stefan Kueng
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// See <http://www.gnu.org/licenses/> for a copy of the full license text
+//
+#include "stdafx.h"
+#include "SymbolCache.h"
+#include "AppUtils.h"
+#include "PathUtils.h"
+#include "StringUtils.h"
+#include "UnicodeUtils.h"
+#include "IniSettings.h"
+#include "SmartHandle.h"
+#include "OnOutOfScope.h"
+#include "BinaryData.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+
+namespace
+{
+constexpr uint32_t cacheMagic       = 0x43535042; // "BPSC"
+constexpr uint32_t cacheVersion     = 1;
+constexpr wchar_t  entryExtension[] = L".bpsym";
+
+uint64_t ToUInt64(const FILETIME& ft)
+{
+    return (static_cast<uint64_t>(ft.dwHighDateTime) << 32) | ft.dwLowDateTime;
+}
+} // namespace
+
+CSymbolCache& CSymbolCache::Instance()
+{
+    static CSymbolCache instance;
+    return instance;
+}
+
+CSymbolCache::CSymbolCache()
+    : m_folder(CPathUtils::Append(CAppUtils::GetDataPath(), L"symbolcache"))
+    , m_maxSize(static_cast<uint64_t>(max(0, CIniSettings::Instance().GetInt64(L"functions", L"symbolcachesize", 32))) * 1024 * 1024)
+    , m_maxEntries(2000)
+    , m_size(0)
+    , m_entries(0)
+    , m_trimmed(false)
+{
+}
+
+uint64_t CSymbolCache::Hash(const void* data, size_t size, uint64_t seed)
+{
+    // FNV-1a, but eight bytes at a time: good enough to notice changed
+    // content and fast enough for big files
+    constexpr uint64_t prime = 0x100000001b3ULL;
+    uint64_t           hash  = (0xcbf29ce484222325ULL ^ seed ^ size) * prime;
+    auto               p     = static_cast<const unsigned char*>(data);
+    for (; size >= sizeof(uint64_t); size -= sizeof(uint64_t), p += sizeof(uint64_t))
+    {
+        uint64_t value;
+        memcpy(&value, p, sizeof(value));
+        hash = (hash ^ value) * prime;
+        hash ^= hash >> 29;
+    }
+    for (; size; --size, ++p)
+        hash = (hash ^ *p) * prime;
+    return hash ^ (hash >> 32);
+}
+
+std::wstring CSymbolCache::GetEntryPath(const std::wstring& path) const
+{
+    auto    lowerPath = CStringUtils::to_lower(path);
+    wchar_t name[32]  = {};
+    swprintf_s(name, L"%016llx%s", Hash(lowerPath.data(), lowerPath.size() * sizeof(wchar_t)), entryExtension);
+    return CPathUtils::Append(m_folder, name);
+}
+
+bool CSymbolCache::Load(const SymbolCacheKey& key, std::vector<FunctionSymbol>& functions, std::vector<std::string>& words)
+{
+    if (m_maxSize == 0 || key.path.empty())
+        return false;
+    const auto                  entryPath = GetEntryPath(key.path);
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::string                 data;
+    {
+        std::ifstream file(entryPath, std::ios::binary);
+        if (!file.good())
+            return false;
+        data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+
+    CReader        reader(data);
+    uint32_t       magic   = 0;
+    uint32_t       version = 0;
+    std::string    path;
+    SymbolCacheKey stored;
+    if (!reader.Get(magic) || magic != cacheMagic || !reader.Get(version) || version != cacheVersion)
+        return false;
+    if (!reader.GetString(path) || !reader.Get(stored.fileSize) || !reader.Get(stored.lastWrite) ||
+        !reader.Get(stored.contentHash) || !reader.Get(stored.settingsHash))
+        return false;
+    // the entry might be for another file with the same hash of its path
+    if (_wcsicmp(CUnicodeUtils::StdGetUnicode(path).c_str(), key.path.c_str()) != 0 ||
+        stored.fileSize != key.fileSize || stored.lastWrite != key.lastWrite ||
+        stored.contentHash != key.contentHash || stored.settingsHash != key.settingsHash)
+        return false;
+
+    std::vector<FunctionSymbol> storedFunctions;
+    std::vector<std::string>    storedWords;
+    uint32_t                    count = 0;
+    if (!reader.Get(count))
+        return false;
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        FunctionSymbol function;
+        int64_t        start = 0;
+        int64_t        end   = 0;
+        if (!reader.Get(start) || !reader.Get(end) || !reader.GetString(function.name) || !reader.GetString(function.displayName))
+            return false;
+        function.start = static_cast<sptr_t>(start);
+        function.end   = static_cast<sptr_t>(end);
+        storedFunctions.push_back(std::move(function));
+    }
+    if (!reader.Get(count))
+        return false;
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        std::string word;
+        if (!reader.GetString(word))
+            return false;
+        storedWords.push_back(std::move(word));
+    }
+    functions = std::move(storedFunctions);
+    words     = std::move(storedWords);
+
+    // the file time is used to find the least recently used entries
+    CAutoFile hFile = CreateFile(entryPath.c_str(), FILE_WRITE_ATTRIBUTES, FILE_SHARE_DELETE | FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (hFile.IsValid())
+    {
+        FILETIME now;
+        GetSystemTimeAsFileTime(&now);
+        SetFileTime(hFile, nullptr, nullptr, &now);
+    }
+    return true;
+}
+
+void CSymbolCache::Store(const SymbolCacheKey& key, const std::vector<FunctionSymbol>& functions, const std::vector<std::string>& words)
+{
+    if (m_maxSize == 0 || key.path.empty())
+        return;
+    std::string data;
+    Put(data, cacheMagic);
+    Put(data, cacheVersion);
+    PutString(data, CUnicodeUtils::StdGetUTF8(key.path));
+    Put(data, key.fileSize);
+    Put(data, key.lastWrite);
+    Put(data, key.contentHash);
+    Put(data, key.settingsHash);
+    Put(data, static_cast<uint32_t>(functions.size()));
+    for (const auto& function : functions)
+    {
+        Put(data, static_cast<int64_t>(function.start));
+        Put(data, static_cast<int64_t>(function.end));
+        PutString(data, function.name);
+        PutString(data, function.displayName);
+    }
+    Put(data, static_cast<uint32_t>(words.size()));
+    for (const auto& word : words)
+        PutString(data, word);
+    // a single file must not push everything else out of the cache
+    if (data.size() > m_maxSize / 4)
+        return;
+
+    const auto                  entryPath = GetEntryPath(key.path);
+    std::lock_guard<std::mutex> lock(m_mutex);
+    CreateDirectory(m_folder.c_str(), nullptr);
+    WIN32_FILE_ATTRIBUTE_DATA oldData{};
+    const bool                existed = GetFileAttributesEx(entryPath.c_str(), GetFileExInfoStandard, &oldData) != FALSE;
+    // write a temp file first so a crash can't leave a half written entry
+    const auto                tempPath = entryPath + L".tmp";
+    {
+        std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+        if (!file.good())
+            return;
+        file.write(data.data(), static_cast<std::streamsize>(data.size()));
+        if (!file.good())
+        {
+            file.close();
+            DeleteFile(tempPath.c_str());
+            return;
+        }
+    }
+    if (!MoveFileEx(tempPath.c_str(), entryPath.c_str(), MOVEFILE_REPLACE_EXISTING))
+    {
+        DeleteFile(tempPath.c_str());
+        return;
+    }
+    if (m_trimmed)
+    {
+        m_size += data.size();
+        if (existed)
+            m_size -= min(m_size, (static_cast<uint64_t>(oldData.nFileSizeHigh) << 32) | oldData.nFileSizeLow);
+        else
+            ++m_entries;
+    }
+    if (!m_trimmed || m_size > m_maxSize || m_entries > m_maxEntries)
+        Trim();
+}
+
+// Must be called with m_mutex locked.
+void CSymbolCache::Trim()
+{
+    struct Entry
+    {
+        std::wstring path;
+        uint64_t     size;
+        uint64_t     lastUsed;
+    };
+    std::vector<Entry> entries;
+    WIN32_FIND_DATA    findData{};
+    HANDLE             hFind = FindFirstFile(CPathUtils::Append(m_folder, std::wstring(L"*") + entryExtension).c_str(), &findData);
+    if (hFind != INVALID_HANDLE_VALUE)
+    {
+        OnOutOfScope(
+            FindClose(hFind););
+        do
+        {
+            if ((findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) == 0)
+            {
+                entries.push_back({CPathUtils::Append(m_folder, findData.cFileName),
+                                   (static_cast<uint64_t>(findData.nFileSizeHigh) << 32) | findData.nFileSizeLow,
+                                   ToUInt64(findData.ftLastWriteTime)});
+            }
+        } while (FindNextFile(hFind, &findData));
+    }
+    m_size = 0;
+    for (const auto& entry : entries)
+        m_size += entry.size;
+    m_entries = entries.size();
+    m_trimmed = true;
+    if (m_size <= m_maxSize && m_entries <= m_maxEntries)
+        return;
+
+    // remove the least recently used entries until there's some room
+    // left, so this doesn't have to be done again right away
+    std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) { return a.lastUsed < b.lastUsed; });
+    for (const auto& entry : entries)
+    {
+        if (m_size <= m_maxSize / 4 * 3 && m_entries <= m_maxEntries / 4 * 3)
+            break;
+        if (DeleteFile(entry.path.c_str()))
+        {
+            m_size -= entry.size;
+            --m_entries;
+        }
+    }
+}
@@ -0,0 +1,76 @@
+﻿// This file is part of BowPad.
+//
+// Copyright (C) 2025 - Stefan Kueng
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// See <http://www.gnu.org/licenses/> for a copy of the full license text
+//
+#pragma once
+#include "Scintilla.h"
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <cstdint>
+
+struct FunctionSymbol
+{
+    sptr_t      start = 0;
+    sptr_t      end   = 0;
+    std::string name;
+    std::string displayName;
+};
+
+/// Identifies the content a cache entry was created from.
+struct SymbolCacheKey
+{
+    std::wstring path;
+    uint64_t     fileSize     = 0;
+    uint64_t     lastWrite    = 0;
+    uint64_t     contentHash  = 0; ///< CSymbolCache::Hash() of the UTF-8 content
+    uint64_t     settingsHash = 0; ///< CSymbolCache::Hash() of the language and its regexes
+};
+
+/**
+ * Cache of the functions and autocomplete words found in files, so they
+ * don't have to be parsed again every time a file is opened.
+ *
+ * Every file gets its own small binary file in the data folder. Entries are
+ * only used if the whole key matches. The least recently used entries are
+ * removed once the cache gets bigger than the configured size.
+ */
+class CSymbolCache
+{
+public:
+    static CSymbolCache& Instance();
+
+    /// Returns true and fills functions and words if there's an entry for key.
+    bool                 Load(const SymbolCacheKey& key, std::vector<FunctionSymbol>& functions, std::vector<std::string>& words);
+    void                 Store(const SymbolCacheKey& key, const std::vector<FunctionSymbol>& functions, const std::vector<std::string>& words);
+
+    static uint64_t      Hash(const void* data, size_t size, uint64_t seed = 0);
+
+private:
+    CSymbolCache();
+    ~CSymbolCache() = default;
+
+    std::wstring GetEntryPath(const std::wstring& path) const;
+    void         Trim();
+
+    std::mutex   m_mutex;
+    std::wstring m_folder;
+    uint64_t     m_maxSize;
+    size_t       m_maxEntries;
+    uint64_t     m_size;    ///< size of all entries, valid once m_trimmed is set
+    size_t       m_entries; ///< number of entries, valid once m_trimmed is set
+    bool         m_trimmed;
+};
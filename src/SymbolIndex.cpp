@@ -0,0 +1,487 @@
+﻿// This file is part of BowPad.
+//
+// Copyright (C) 2025 - Stefan Kueng
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// See <http://www.gnu.org/licenses/> for a copy of the full license text
+//
+#include "stdafx.h"
+#include "SymbolIndex.h"
+#include "SymbolCache.h"
+#include "PathWatcher.h"
+#include "PathUtils.h"
+#include "StringUtils.h"
+#include "UnicodeUtils.h"
+#include "DirFileEnum.h"
+#include "LexStyles.h"
+#include "DocumentManager.h"
+#include "OnOutOfScope.h"
+
+#include <algorithm>
+#include <atomic>
+#include <set>
+#include <string_view>
+#include <thread>
+
+extern void FindFunctionsInText(const std::string& lang, const std::string& functionRegex, const std::vector<std::string>& trimTokens,
+                                const std::string& text, std::vector<FunctionSymbol>& functions);
+
+namespace
+{
+constexpr int    SCORE_EXACT          = 400;
+constexpr int    SCORE_EXACT_NOCASE   = 300;
+constexpr int    SCORE_PREFIX         = 200;
+constexpr int    SCORE_CONTAINS       = 100;
+// symbols in files of the same language as the current one rank higher
+constexpr int    BONUS_SAME_LANGUAGE  = 50;
+
+// more changes than that at once and the index is rebuilt instead of updated
+constexpr size_t MAX_CHANGES_TO_APPLY = 500;
+// indexes kept at once, each one has a folder watcher running
+constexpr size_t MAX_INDEXED_ROOTS    = 4;
+
+struct SymbolLanguage
+{
+    std::string              lang;
+    std::string              functionRegex;
+    std::vector<std::string> trimTokens;
+};
+using ExtensionLanguages = std::map<std::wstring, std::shared_ptr<const SymbolLanguage>>;
+
+struct IndexedSymbol
+{
+    std::string name;
+    std::string lowerName;
+    std::string displayName;
+    size_t      line = 0;
+};
+
+struct IndexedFile
+{
+    std::wstring                          path;
+    std::shared_ptr<const SymbolLanguage> language;
+    std::vector<IndexedSymbol>            symbols;
+};
+
+std::wstring NormalizeRoot(const std::wstring& root)
+{
+    auto path = CStringUtils::to_lower(root);
+    std::replace(path.begin(), path.end(), L'/', L'\\');
+    while (!path.empty() && path.back() == L'\\')
+        path.pop_back();
+    return path;
+}
+// Returns true for drive roots like "c:" and share roots like "\\server\share".
+// Returns true for drive roots like "c:" and share roots like "\\\\server\\share".
+bool IsVolumeRoot(const std::wstring& normalizedRoot)
+{
+    if (normalizedRoot.size() <= 2)
+        return true;
+    if (!normalizedRoot.starts_with(L"\\\\"))
+        return false;
+    return std::count(normalizedRoot.begin() + 2, normalizedRoot.end(), L'\\') <= 1;
+}
+
+std::string ToLower(std::string s)
+{
+    std::transform(s.begin(), s.end(), s.begin(), [](char c) { return static_cast<char>(::tolower(static_cast<unsigned char>(c))); });
+    return s;
+}
+
+// Returns the languages with a function regex, by the file extensions they're used for.
+// Must be called from the UI thread.
+ExtensionLanguages GetIndexedLanguages()
+{
+    auto&                                                        lexStyles = CLexStyles::Instance();
+    std::map<std::string, std::shared_ptr<const SymbolLanguage>> byLang;
+    ExtensionLanguages                                           languages;
+    for (const auto& [ext, lang] : lexStyles.GetLanguagesForExtensions())
+    {
+        const auto& functionRegex = lexStyles.GetFunctionRegexForLang(lang);
+        if (functionRegex.empty())
+            continue;
+        auto& language = byLang[lang];
+        if (!language)
+            language = std::make_shared<const SymbolLanguage>(SymbolLanguage{lang, functionRegex, lexStyles.GetFunctionRegexTrimForLang(lang)});
+        languages[CUnicodeUtils::StdGetUnicode(ext)] = language;
+    }
+    return languages;
+}
+
+// Reads a text file as UTF-8, decoded like the editor does it so the function
+// positions are the same as in the editor. Returns false for files that are
+// too big or binary.
+bool ReadTextFile(const std::wstring& path, uint64_t maxSize, std::string& text)
+{
+    if (!CDocumentManager::ReadFileAsUtf8(path, maxSize, text))
+        return false;
+    return text.find('\0') == std::string::npos;
+}
+
+std::vector<IndexedSymbol> ParseFile(const std::wstring& path, const SymbolLanguage& language, uint64_t maxSize)
+{
+    std::vector<IndexedSymbol> symbols;
+    std::string                text;
+    if (!ReadTextFile(path, maxSize, text))
+        return symbols;
+    std::vector<FunctionSymbol> functions;
+    FindFunctionsInText(language.lang, language.functionRegex, language.trimTokens, text, functions);
+    // the functions are sorted by their position, so the lines can be counted along the way
+    size_t line = 0;
+    sptr_t pos  = 0;
+    symbols.reserve(functions.size());
+    for (auto& function : functions)
+    {
+        if (function.start < pos || function.start > static_cast<sptr_t>(text.size()))
+            continue;
+        line += std::count(text.begin() + pos, text.begin() + function.start, '\n');
+        pos = function.start;
+        IndexedSymbol symbol;
+        symbol.lowerName   = ToLower(function.name);
+        symbol.name        = std::move(function.name);
+        symbol.displayName = std::move(function.displayName);
+        symbol.line        = line;
+        symbols.push_back(std::move(symbol));
+    }
+    return symbols;
+}
+} // namespace
+
+class CSymbolIndex::CRoot
+{
+public:
+    CRoot(const std::wstring& path, ExtensionLanguages&& languages, uint64_t maxFileSize)
+        : path(path)
+        , languages(std::move(languages))
+        , maxFileSize(maxFileSize)
+    {
+        watcher.AddPath(path, true);
+    }
+
+    // the threads parse files with the function regexes, which must not
+    // outlive the statics they use: stop them and wait for them
+    ~CRoot()
+    {
+        stop = true;
+        if (buildThread.joinable())
+            buildThread.join();
+        if (updateThread.joinable())
+            updateThread.join();
+        watcher.Stop();
+    }
+
+    void StartBuild()
+    {
+        if (building.exchange(true))
+            return;
+        // a finished build thread still has to be joined
+        if (buildThread.joinable())
+            buildThread.join();
+        buildThread = std::thread([this]() {
+            // the encoding detection uses IMultiLanguage
+            CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+            OnOutOfScope(CoUninitialize());
+            ProfileTimer                        profileTimer(L"building symbol index");
+            std::map<std::wstring, IndexedFile> newFiles;
+            Scan(path, newFiles);
+            std::lock_guard lock(mutex);
+            if (!stop)
+            {
+                files = std::move(newFiles);
+                ready = true;
+                ++generation;
+            }
+            building = false;
+        });
+    }
+
+    // must be called with the mutex locked
+    void Update()
+    {
+        // changes that happen during a build are picked up once it's done
+        if (!ready || building)
+            return;
+        auto changes = watcher.GetChangedPaths();
+        if (changes.empty())
+            return;
+        if (changes.size() > MAX_CHANGES_TO_APPLY)
+        {
+            // keep using the old index until the new one is ready
+            StartBuild();
+            return;
+        }
+        for (const auto& [action, changedPath] : changes)
+        {
+            if (!IsExcludedPath(changedPath))
+                pendingPaths.insert(changedPath);
+        }
+        if (!pendingPaths.empty() && !updating.exchange(true))
+        {
+            if (updateThread.joinable())
+                updateThread.join();
+            updateThread = std::thread([this]() {
+                CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+                OnOutOfScope(CoUninitialize());
+                ApplyPendingPaths();
+            });
+        }
+    }
+
+    // Returns all symbols sorted by their lower case name.
+    // Must be called with the mutex locked.
+    const std::vector<std::pair<const IndexedFile*, const IndexedSymbol*>>& GetSortedSymbols()
+    {
+        if (sortedGeneration == generation && !sortedSymbols.empty())
+            return sortedSymbols;
+        sortedSymbols.clear();
+        for (const auto& [key, file] : files)
+        {
+            for (const auto& symbol : file.symbols)
+                sortedSymbols.emplace_back(&file, &symbol);
+        }
+        std::sort(sortedSymbols.begin(), sortedSymbols.end(), [](const auto& lhs, const auto& rhs) {
+            return lhs.second->lowerName < rhs.second->lowerName;
+        });
+        sortedGeneration = generation;
+        return sortedSymbols;
+    }
+
+    const std::wstring                  path;
+    const ExtensionLanguages            languages;
+    const uint64_t                      maxFileSize;
+    std::mutex                          mutex;
+    std::map<std::wstring, IndexedFile> files; ///< by lower case path
+    bool                                ready      = false; ///< false until the first build finished
+    std::atomic_bool                    building   = false;
+    unsigned                            generation = 0;
+    CPathWatcher                        watcher;
+    uint64_t                            lastUsed = 0; ///< guarded by the mutex of CSymbolIndex
+
+private:
+    std::shared_ptr<const SymbolLanguage> GetLanguage(const std::wstring& filePath) const
+    {
+        auto found = languages.find(CStringUtils::to_lower(CPathUtils::GetFileExtension(filePath)));
+        return found != languages.end() ? found->second : nullptr;
+    }
+
+    static bool IsExcludedFolder(std::wstring_view name)
+    {
+        return name.size() == 4 && (_wcsnicmp(name.data(), L".svn", 4) == 0 || _wcsnicmp(name.data(), L".git", 4) == 0);
+    }
+
+    // true for paths inside excluded folders: the changes there can be frequent,
+    // but they never contain sources
+    bool IsExcludedPath(const std::wstring& changedPath) const
+    {
+        if (changedPath.size() <= path.size() + 1 || _wcsnicmp(changedPath.c_str(), path.c_str(), path.size()) != 0 || changedPath[path.size()] != L'\\')
+            return true;
+        std::wstring_view rest(changedPath.c_str() + path.size() + 1);
+        while (!rest.empty())
+        {
+            auto pos = rest.find(L'\\');
+            if (IsExcludedFolder(rest.substr(0, pos)))
+                return true;
+            if (pos == std::wstring_view::npos)
+                break;
+            rest.remove_prefix(pos + 1);
+        }
+        return false;
+    }
+
+    void AddFile(const std::wstring& filePath, std::map<std::wstring, IndexedFile>& result) const
+    {
+        auto language = GetLanguage(filePath);
+        if (!language)
+            return;
+        result[CStringUtils::to_lower(filePath)] = IndexedFile{filePath, language, ParseFile(filePath, *language, maxFileSize)};
+    }
+
+    void Scan(const std::wstring& folder, std::map<std::wstring, IndexedFile>& result) const
+    {
+        CDirFileEnum enumerator(folder);
+        bool         bIsDir  = false;
+        bool         recurse = true;
+        std::wstring filePath;
+        while (!stop && enumerator.NextFile(filePath, &bIsDir, recurse))
+        {
+            recurse = true;
+            if (bIsDir)
+                recurse = !IsExcludedFolder(CPathUtils::GetFileName(filePath));
+            else
+                AddFile(filePath, result);
+        }
+    }
+
+    // parses the changed files again, without holding the lock while doing so
+    void ApplyPendingPaths()
+    {
+        for (;;)
+        {
+            std::set<std::wstring> changedPaths;
+            {
+                std::lock_guard lock(mutex);
+                if (pendingPaths.empty() || stop)
+                {
+                    updating = false;
+                    return;
+                }
+                changedPaths.swap(pendingPaths);
+            }
+            std::map<std::wstring, IndexedFile> parsed;
+            std::vector<std::wstring>           removed;
+            for (const auto& changedPath : changedPaths)
+            {
+                if (stop)
+                    break;
+                // what matters is the current state, not what the change was:
+                // there might have been more changes to the same path since
+                auto attributes = GetFileAttributes(changedPath.c_str());
+                if (attributes == INVALID_FILE_ATTRIBUTES)
+                    removed.push_back(CStringUtils::to_lower(changedPath));
+                else if (attributes & FILE_ATTRIBUTE_DIRECTORY)
+                {
+                    // folders that are moved in come with content
+                    Scan(changedPath, parsed);
+                }
+                else
+                    AddFile(changedPath, parsed);
+            }
+            std::lock_guard lock(mutex);
+            for (const auto& removedPath : removed)
+            {
+                // the path might have been a folder
+                auto prefix = removedPath + L"\\";
+                files.erase(removedPath);
+                for (auto it = files.lower_bound(prefix); it != files.end() && it->first.starts_with(prefix);)
+                    it = files.erase(it);
+            }
+            for (auto& [key, file] : parsed)
+                files[key] = std::move(file);
+            ++generation;
+        }
+    }
+
+    std::set<std::wstring>                                           pendingPaths;
+    std::atomic_bool                                                 updating         = false;
+    std::atomic_bool                                                 stop             = false;
+    std::thread                                                      buildThread;
+    std::thread                                                      updateThread;
+    std::vector<std::pair<const IndexedFile*, const IndexedSymbol*>> sortedSymbols;
+    unsigned                                                         sortedGeneration = 0;
+};
+
+CSymbolIndex& CSymbolIndex::Instance()
+{
+    static CSymbolIndex instance;
+    return instance;
+}
+
+std::shared_ptr<CSymbolIndex::CRoot> CSymbolIndex::GetRoot(const std::wstring& root, bool create)
+{
+    auto            key = NormalizeRoot(root);
+    std::lock_guard lock(m_mutex);
+    if (auto found = m_roots.find(key); found != m_roots.end())
+    {
+        found->second->lastUsed = ++m_useCount;
+        return found->second;
+    }
+    if (!create || IsVolumeRoot(key))
+        return nullptr;
+    if (m_roots.size() >= MAX_INDEXED_ROOTS)
+    {
+        // the root stops its threads and its watcher once it's not used anymore
+        auto oldest = std::ranges::min_element(m_roots, {}, [](const auto& entry) { return entry.second->lastUsed; });
+        m_roots.erase(oldest);
+    }
+    auto path = root;
+    while (!path.empty() && (path.back() == L'\\' || path.back() == L'/'))
+        path.pop_back();
+    auto maxFileSize = static_cast<uint64_t>(CIniSettings::Instance().GetInt64(L"symbolindex", L"maxfilesize", 1024)) * 1024;
+    auto pRoot       = std::make_shared<CRoot>(path, GetIndexedLanguages(), maxFileSize);
+    pRoot->lastUsed  = ++m_useCount;
+    pRoot->StartBuild();
+    m_roots[key] = pRoot;
+    return pRoot;
+}
+
+void CSymbolIndex::Shutdown()
+{
+    std::map<std::wstring, std::shared_ptr<CRoot>> roots;
+    {
+        std::lock_guard lock(m_mutex);
+        roots.swap(m_roots);
+    }
+    // destroying the roots waits for their threads
+    roots.clear();
+}
+
+bool CSymbolIndex::Prepare(const std::wstring& root)
+{
+    auto pRoot = GetRoot(root, true);
+    if (!pRoot)
+        return false;
+    std::lock_guard lock(pRoot->mutex);
+    pRoot->Update();
+    return pRoot->ready;
+}
+
+std::vector<SymbolIndexMatch> CSymbolIndex::Query(const std::wstring& root, const std::string& name, const std::string& lang, size_t maxResults)
+{
+    std::vector<SymbolIndexMatch> results;
+    auto                          pRoot = GetRoot(root, false);
+    if (!pRoot || name.empty() || maxResults == 0)
+        return results;
+    std::lock_guard lock(pRoot->mutex);
+    pRoot->Update();
+    if (!pRoot->ready)
+        return results;
+    const auto& symbols   = pRoot->GetSortedSymbols();
+    const auto  lowerName = ToLower(name);
+    auto        add       = [&](const IndexedFile& file, const IndexedSymbol& symbol, int score) {
+        if (file.language->lang == lang)
+            score += BONUS_SAME_LANGUAGE;
+        results.push_back(SymbolIndexMatch{file.path, symbol.line, symbol.name, symbol.displayName, score});
+    };
+    // the symbols starting with the name follow each other, the exact matches first
+    auto first = std::partition_point(symbols.begin(), symbols.end(), [&](const auto& entry) {
+        return entry.second->lowerName < lowerName;
+    });
+    for (auto it = first; it != symbols.end() && it->second->lowerName.starts_with(lowerName); ++it)
+    {
+        const auto& [file, symbol] = *it;
+        if (symbol->lowerName.size() != lowerName.size())
+            add(*file, *symbol, SCORE_PREFIX - static_cast<int>(min(symbol->lowerName.size() - lowerName.size(), size_t(50))));
+        else
+            add(*file, *symbol, symbol->name == name ? SCORE_EXACT : SCORE_EXACT_NOCASE);
+    }
+    // only look further if there aren't enough matches already
+    if (results.size() < maxResults)
+    {
+        for (const auto& [file, symbol] : symbols)
+        {
+            auto pos = symbol->lowerName.find(lowerName);
+            if (pos != std::string::npos && pos > 0)
+                add(*file, *symbol, SCORE_CONTAINS - static_cast<int>(min(symbol->lowerName.size() - lowerName.size(), size_t(50))));
+        }
+    }
+    auto better = [](const SymbolIndexMatch& lhs, const SymbolIndexMatch& rhs) {
+        if (lhs.score != rhs.score)
+            return lhs.score > rhs.score;
+        if (lhs.path != rhs.path)
+            return lhs.path < rhs.path;
+        return lhs.line < rhs.line;
+    };
+    const auto resultCount = min(maxResults, results.size());
+    std::partial_sort(results.begin(), results.begin() + resultCount, results.end(), better);
+    results.resize(resultCount);
+    return results;
+}
@@ -0,0 +1,79 @@
+﻿// This file is part of BowPad.
+//
+// Copyright (C) 2025 - Stefan Kueng
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// See <http://www.gnu.org/licenses/> for a copy of the full license text
+//
+#pragma once
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <mutex>
+
+struct SymbolIndexMatch
+{
+    std::wstring path;
+    size_t       line = 0; ///< zero based
+    std::string  name;
+    std::string  displayName;
+    int          score = 0;
+};
+
+/**
+ * In-memory index of the functions defined in all files below a root folder,
+ * so that symbols can be resolved across a project without searching the
+ * whole folder every time.
+ *
+ * Files are parsed with the function regex of their language. The index of a
+ * root is built in a background thread the first time the root is used and
+ * kept up to date with a CPathWatcher afterwards: changed files are parsed
+ * again in the background while the old symbols are still used.
+ * Drive and share roots aren't indexed, and only a few roots are kept: the
+ * least recently used one is dropped when another root is indexed.
+ */
+class CSymbolIndex
+{
+public:
+    static CSymbolIndex& Instance();
+
+    /**
+     * Starts indexing the root folder if that's not done already.
+     * Returns true if the index for the root is ready to be queried.
+     * Must be called from the UI thread since it reads the language settings.
+     */
+    bool                          Prepare(const std::wstring& root);
+
+    /**
+     * Returns the symbols below root matching name, best matches first:
+     * exact matches, then symbols starting with name, then symbols containing it.
+     * Symbols from files of the language lang rank higher.
+     * Returns an empty list if the index isn't ready yet.
+     */
+    std::vector<SymbolIndexMatch> Query(const std::wstring& root, const std::string& name, const std::string& lang, size_t maxResults);
+
+    /// Drops all indexes and waits for their threads to finish. Must be called
+    /// before exiting, while the statics the threads use still exist.
+    void                          Shutdown();
+
+private:
+    CSymbolIndex()  = default;
+    ~CSymbolIndex() = default;
+
+    class CRoot;
+    std::shared_ptr<CRoot> GetRoot(const std::wstring& root, bool create);
+
+    std::mutex                                     m_mutex;
+    std::map<std::wstring, std::shared_ptr<CRoot>> m_roots;
+    uint64_t                                       m_useCount = 0;
+};
@@ -0,0 +1,410 @@
+﻿// This file is part of BowPad.
+//
+// Copyright (C) 2025 - Stefan Kueng
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// See <http://www.gnu.org/licenses/> for a copy of the full license text
+//
+#include "stdafx.h"
+#include "TagIndex.h"
+
+#include <algorithm>
+
+// tags longer than this are not tags but an unterminated attribute value
+constexpr size_t MAX_TAG_LENGTH = 64 * 1024;
+// the first text parsed after an edit reaches this far beyond the edit
+constexpr sptr_t UPDATE_WINDOW  = 4096;
+
+static bool IsXmlWhitespace(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+static bool IsNameStart(char c)
+{
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_' || c == ':' || (c & 0x80);
+}
+
+static bool IsNameEnd(char c)
+{
+    // checking for " or ' is actually wrong here, but it means it works better with invalid XML
+    return IsXmlWhitespace(c) || c == '/' || c == '>' || c == '<' || c == '\"' || c == '\'';
+}
+
+static bool EqualsNoCase(std::string_view text, std::string_view lowerName)
+{
+    if (text.size() != lowerName.size())
+        return false;
+    for (size_t i = 0; i < text.size(); ++i)
+    {
+        char c = text[i];
+        if (c >= 'A' && c <= 'Z')
+            c = static_cast<char>(c - 'A' + 'a');
+        if (c != lowerName[i])
+            return false;
+    }
+    return true;
+}
+
+static bool SameTag(const XmlTag& a, const XmlTag& b)
+{
+    return a.name == b.name && a.type == b.type;
+}
+
+bool CTagIndex::IsFor(const void* document, bool html, sptr_t docLength) const
+{
+    return m_valid && m_document == document && m_html == html && m_length == docLength;
+}
+
+void CTagIndex::Build(std::string_view text, const void* document, bool html)
+{
+    Clear();
+    m_document = document;
+    m_html     = html;
+    m_length   = static_cast<sptr_t>(text.size());
+    m_tags.reserve(std::count(text.begin(), text.end(), '<'));
+    Parse(text, 0, true, [this](const XmlTag& tag) {
+        m_tags.push_back(tag);
+        return true;
+    });
+    m_valid = true;
+}
+
+void CTagIndex::Clear()
+{
+    m_tags.clear();
+    m_tags.shrink_to_fit();
+    m_names.clear();
+    m_nameIds.clear();
+    m_nameCache.fill(0);
+    m_document   = nullptr;
+    m_length     = 0;
+    m_shiftIndex = 0;
+    m_shiftDelta = 0;
+    m_valid      = false;
+    m_paired     = false;
+    m_updateWork = 0;
+}
+
+void CTagIndex::Update(const void* document, const GetTextFunc& getText, sptr_t docLength, sptr_t pos, sptr_t inserted, sptr_t deleted)
+{
+    if (!m_valid || document != m_document)
+        return;
+    if (m_length + inserted - deleted != docLength)
+    {
+        // a modification was missed
+        Clear();
+        return;
+    }
+    m_length = docLength;
+
+    // tags ending before the edit are not affected. Parsing starts right
+    // after the last of them, but not within the content of a script or
+    // style element.
+    size_t first = 0;
+    for (size_t last = m_tags.size(); first < last;)
+    {
+        auto mid = first + (last - first) / 2;
+        if (Start(mid) + m_tags[mid].length <= pos)
+            first = mid + 1;
+        else
+            last = mid;
+    }
+    while (first > 0 && IsRawOpen(m_tags[first - 1]))
+        --first;
+    sptr_t              parseStart = first > 0 ? Start(first - 1) + m_tags[first - 1].length : 0;
+    sptr_t              delta      = inserted - deleted;
+    sptr_t              newEditEnd = pos + inserted;
+
+    // parse until a tag after the edit is found which was already in the
+    // index at the same place: from there on the old tags are still valid.
+    // If a tag or comment doesn't end within the parsed text, parse again
+    // with twice as much text.
+    std::vector<XmlTag> newTags;
+    size_t              old        = first;
+    for (sptr_t windowLength = newEditEnd - parseStart + UPDATE_WINDOW;; windowLength *= 2)
+    {
+        windowLength = min(windowLength, docLength - parseStart);
+        bool atEnd   = parseStart + windowLength >= docLength;
+        newTags.clear();
+        old         = first;
+        auto result = Parse(getText(parseStart, windowLength), parseStart, atEnd, [&](const XmlTag& tag) {
+            if (tag.start >= newEditEnd)
+            {
+                while (old < m_tags.size() && Start(old) + delta < tag.start)
+                    ++old;
+                if (old < m_tags.size() && Start(old) + delta == tag.start && m_tags[old].length == tag.length && SameTag(m_tags[old], tag))
+                    return false;
+            }
+            newTags.push_back(tag);
+            return true;
+        });
+        if (result == ParseEnd::End)
+            old = m_tags.size();
+        if (result != ParseEnd::Truncated)
+            break;
+    }
+
+    // the tags after the edit are not moved right away: all tags from
+    // m_shiftIndex on are m_shiftDelta off. Only the tags between that
+    // index and the edit are adjusted, so typing at one place doesn't
+    // touch the rest of the index.
+    size_t work = 0;
+    if (m_shiftDelta == 0)
+        m_shiftIndex = first;
+    for (; m_shiftIndex < first; ++m_shiftIndex, ++work)
+        m_tags[m_shiftIndex].start += m_shiftDelta;
+    for (; m_shiftIndex > old; ++work)
+        m_tags[--m_shiftIndex].start -= m_shiftDelta;
+
+    // the pairs stay the same if the edit didn't change the sequence of tags
+    bool sameTags = (old - first) == newTags.size();
+    for (size_t i = 0; sameTags && i < newTags.size(); ++i)
+    {
+        sameTags           = SameTag(m_tags[first + i], newTags[i]);
+        newTags[i].partner = m_tags[first + i].partner;
+    }
+    if (sameTags)
+        std::copy(newTags.begin(), newTags.end(), m_tags.begin() + first);
+    else
+    {
+        m_tags.erase(m_tags.begin() + first, m_tags.begin() + old);
+        m_tags.insert(m_tags.begin() + first, newTags.begin(), newTags.end());
+        m_paired = false;
+        work += m_tags.size() - first;
+    }
+    m_shiftIndex = first + newTags.size();
+    m_shiftDelta += delta;
+
+    // many edits without a lookup in between, e.g. from a replace all:
+    // building the index again when it's needed is faster than updating it
+    m_updateWork += work;
+    if (m_updateWork > 4 * m_tags.size() + UPDATE_WINDOW)
+        Clear();
+}
+
+bool CTagIndex::TagAt(sptr_t pos, XmlTag& tag)
+{
+    if (!m_valid)
+        return false;
+    m_updateWork = 0;
+    if (!m_paired)
+        Pair();
+    // the last tag starting before pos
+    size_t index = 0;
+    for (size_t last = m_tags.size(); index < last;)
+    {
+        auto mid = index + (last - index) / 2;
+        if (Start(mid) < pos)
+            index = mid + 1;
+        else
+            last = mid;
+    }
+    if (index == 0 || pos >= Start(index - 1) + m_tags[index - 1].length)
+        return false;
+    tag       = m_tags[index - 1];
+    tag.start = Start(index - 1);
+    return true;
+}
+
+bool CTagIndex::Partner(const XmlTag& tag, XmlTag& partner) const
+{
+    if (tag.partner < 0)
+        return false;
+    partner       = m_tags[tag.partner];
+    partner.start = Start(tag.partner);
+    return true;
+}
+
+CTagIndex::ParseEnd CTagIndex::Parse(std::string_view text, sptr_t offset, bool atEnd, const std::function<bool(const XmlTag&)>& onTag)
+{
+    constexpr auto npos      = std::string_view::npos;
+    auto           endOfText = [atEnd]() { return atEnd ? ParseEnd::End : ParseEnd::Truncated; };
+    // within the content of a script or style element only its close tag counts
+    uint32_t       rawName   = 0;
+    bool           inRaw     = false;
+    size_t         pos       = 0;
+    while (pos < text.size())
+    {
+        if (inRaw)
+        {
+            const auto& name = m_names[rawName];
+            for (pos = text.find("</", pos); pos != npos; pos = text.find("</", pos + 2))
+            {
+                if (pos + 3 + name.size() > text.size())
+                {
+                    pos = npos;
+                    break;
+                }
+                if (EqualsNoCase(text.substr(pos + 2, name.size()), name) && IsNameEnd(text[pos + 2 + name.size()]))
+                    break;
+            }
+            if (pos == npos)
+                return endOfText();
+            inRaw = false;
+        }
+        else
+        {
+            pos = text.find('<', pos);
+            if (pos == npos)
+                return endOfText();
+        }
+
+        auto rest = text.substr(pos);
+        // "<![CDATA[" is the longest start sequence
+        if (!atEnd && rest.size() < 9)
+            return ParseEnd::Truncated;
+
+        std::string_view endSequence;
+        if (rest.starts_with("<!--"))
+            endSequence = "-->";
+        else if (rest.starts_with("<![CDATA["))
+            endSequence = "]]>";
+        else if (rest.starts_with("<?"))
+            endSequence = "?>";
+        else if (rest.starts_with("<!"))
+            endSequence = ">";
+        if (!endSequence.empty())
+        {
+            auto endPos = text.find(endSequence, pos + 2);
+            if (endPos == npos)
+                return endOfText();
+            pos = endPos + endSequence.size();
+            continue;
+        }
+
+        XmlTag tag;
+        tag.start        = offset + static_cast<sptr_t>(pos);
+        bool   isClose   = rest.size() > 1 && rest[1] == '/';
+        size_t nameStart = isClose ? 2 : 1;
+        size_t nameEnd   = nameStart;
+        while (nameEnd < rest.size() && !IsNameEnd(rest[nameEnd]))
+            ++nameEnd;
+        if (nameEnd == rest.size() && !atEnd)
+            return ParseEnd::Truncated;
+        if (nameEnd == nameStart || (!isClose && (!IsNameStart(rest[nameStart]) || (nameEnd < rest.size() && (rest[nameEnd] == '\"' || rest[nameEnd] == '\'')))))
+        {
+            ++pos;
+            continue;
+        }
+
+        // a close tag allows only whitespace before the '>', an open tag
+        // attributes whose values may contain a '>'
+        size_t gt    = npos;
+        size_t limit = min(rest.size(), MAX_TAG_LENGTH);
+        char   quote = 0;
+        size_t i     = nameEnd;
+        for (; i < limit; ++i)
+        {
+            char c = rest[i];
+            // a '<' is not allowed in attribute values either: that way whether
+            // there's a tag doesn't depend on the text after the next '<'
+            if (c == '<')
+                break;
+            if (quote)
+            {
+                if (c == quote)
+                    quote = 0;
+            }
+            else if (c == '>')
+            {
+                gt = i;
+                break;
+            }
+            else if (isClose && !IsXmlWhitespace(c))
+                break;
+            else if (c == '\"' || c == '\'')
+                quote = c;
+        }
+        if (gt == npos)
+        {
+            if (i == rest.size() && !atEnd)
+                return ParseEnd::Truncated;
+            ++pos;
+            continue;
+        }
+
+        tag.length = static_cast<uint32_t>(gt + 1);
+        tag.name   = Intern(rest.substr(nameStart, nameEnd - nameStart));
+        if (isClose)
+            tag.type = XmlTagType::Close;
+        else if (rest[gt - 1] == '/')
+            tag.type = XmlTagType::SelfClosing;
+        else
+            tag.type = XmlTagType::Open;
+        if (!onTag(tag))
+            return ParseEnd::Stopped;
+        if (IsRawOpen(tag))
+        {
+            inRaw   = true;
+            rawName = tag.name;
+        }
+        pos += gt + 1;
+    }
+    return endOfText();
+}
+
+uint32_t CTagIndex::Intern(std::string_view name)
+{
+    // documents use few tag names, so most of them are found in the cache
+    // without creating a string and hashing it
+    auto& cached = m_nameCache[(name.size() * 31 + (name.front() | 0x20) + (name.back() | 0x20)) % m_nameCache.size()];
+    if (cached < m_names.size() && EqualsNoCase(name, m_names[cached]))
+        return cached;
+
+    std::string lowerName(name);
+    for (auto& c : lowerName)
+    {
+        if (c >= 'A' && c <= 'Z')
+            c = static_cast<char>(c - 'A' + 'a');
+    }
+    auto it = m_nameIds.find(lowerName);
+    if (it != m_nameIds.end())
+        cached = it->second;
+    else
+    {
+        cached = static_cast<uint32_t>(m_names.size());
+        m_names.push_back(lowerName);
+        m_nameIds[std::move(lowerName)] = cached;
+    }
+    return cached;
+}
+
+bool CTagIndex::IsRawOpen(const XmlTag& tag) const
+{
+    if (!m_html || tag.type != XmlTagType::Open)
+        return false;
+    const auto& name = m_names[tag.name];
+    return name == "script" || name == "style";
+}
+
+void CTagIndex::Pair()
+{
+    // an open tag is matched by the next close tag with the same name that
+    // isn't matched by another open tag with that name in between
+    std::vector<std::vector<int32_t>> openTags(m_names.size());
+    for (size_t i = 0; i < m_tags.size(); ++i)
+    {
+        auto& tag   = m_tags[i];
+        auto& open  = openTags[tag.name];
+        tag.partner = -1;
+        if (tag.type == XmlTagType::Open)
+            open.push_back(static_cast<int32_t>(i));
+        else if (tag.type == XmlTagType::Close && !open.empty())
+        {
+            tag.partner                 = open.back();
+            m_tags[open.back()].partner = static_cast<int32_t>(i);
+            open.pop_back();
+        }
+    }
+    m_paired = true;
+}
@@ -0,0 +1,102 @@
+﻿// This file is part of BowPad.
+//
+// Copyright (C) 2025 - Stefan Kueng
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// See <http://www.gnu.org/licenses/> for a copy of the full license text
+//
+#pragma once
+#include "Scintilla.h"
+
+#include <array>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <unordered_map>
+#include <functional>
+#include <cstdint>
+
+enum class XmlTagType : uint8_t
+{
+    Open,
+    Close,
+    SelfClosing,
+};
+
+struct XmlTag
+{
+    sptr_t     start   = 0;  ///< position of the '<'
+    uint32_t   length  = 0;  ///< up to and including the '>'
+    uint32_t   name    = 0;  ///< interned lower case tag name
+    int32_t    partner = -1; ///< index of the matching open or close tag
+    XmlTagType type    = XmlTagType::Open;
+
+    sptr_t     End() const { return start + length; }
+};
+
+/**
+ * Index of the xml/html tags of a document, used to find matching tags
+ * without searching the document text.
+ *
+ * The index is built once for the whole document and then kept up to date
+ * from the modifications: only the text around an edit is parsed again, and
+ * open and close tags are only paired again if an edit added, removed or
+ * renamed a tag. Tags inside comments, CDATA sections and processing
+ * instructions are ignored, and for html the content of script and style
+ * elements as well.
+ */
+class CTagIndex
+{
+public:
+    using GetTextFunc = std::function<std::string_view(sptr_t start, sptr_t length)>;
+
+    bool          IsFor(const void* document, bool html, sptr_t docLength) const;
+    void          Build(std::string_view text, const void* document, bool html);
+    void          Clear();
+
+    /// updates the index after text was inserted or deleted at pos.
+    /// getText returns the text of the modified document.
+    void          Update(const void* document, const GetTextFunc& getText, sptr_t docLength, sptr_t pos, sptr_t inserted, sptr_t deleted);
+
+    /// gets the tag with pos after its '<' and before or at its '>'
+    bool          TagAt(sptr_t pos, XmlTag& tag);
+    /// gets the open tag of a close tag and vice versa
+    bool          Partner(const XmlTag& tag, XmlTag& partner) const;
+    size_t        NameLength(const XmlTag& tag) const { return m_names[tag.name].size(); }
+
+private:
+    enum class ParseEnd
+    {
+        End,      ///< the end of the document was reached
+        Stopped,  ///< the callback returned false
+        Truncated ///< more text is needed, the text isn't the end of the document
+    };
+
+    ParseEnd Parse(std::string_view text, sptr_t offset, bool atEnd, const std::function<bool(const XmlTag&)>& onTag);
+    uint32_t Intern(std::string_view name);
+    bool     IsRawOpen(const XmlTag& tag) const;
+    void     Pair();
+    sptr_t   Start(size_t index) const { return m_tags[index].start + (index >= m_shiftIndex ? m_shiftDelta : 0); }
+
+    std::vector<XmlTag>                       m_tags; ///< sorted by position
+    std::vector<std::string>                  m_names;
+    std::unordered_map<std::string, uint32_t> m_nameIds;
+    std::array<uint32_t, 64>                  m_nameCache{}; ///< recently used name ids
+    const void*                               m_document   = nullptr;
+    sptr_t                                    m_length     = 0;
+    size_t                                    m_shiftIndex = 0; ///< the tags from here on are not moved yet
+    sptr_t                                    m_shiftDelta = 0; ///< by this much
+    bool                                      m_html       = false;
+    bool                                      m_valid      = false;
+    bool                                      m_paired     = false;
+    size_t                                    m_updateWork = 0; ///< tags touched by updates since the last lookup
+};
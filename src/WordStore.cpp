@@ -0,0 +1,159 @@
+﻿// This file is part of BowPad.
+//
+// Copyright (C) 2025 - Stefan Kueng
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// See <http://www.gnu.org/licenses/> for a copy of the full license text
+//
+#include "stdafx.h"
+#include "WordStore.h"
+
+#include <algorithm>
+
+// up to that many changes are merged into the sorted array in place,
+// more than that and the array is rebuilt
+constexpr size_t maxChangesInPlace = 64;
+
+int CWordStore::Compare(std::string_view lhs, std::string_view rhs)
+{
+    auto result = _strnicmp(lhs.data(), rhs.data(), min(lhs.size(), rhs.size()));
+    if (result != 0)
+        return result;
+    return lhs.size() < rhs.size() ? -1 : (lhs.size() > rhs.size() ? 1 : 0);
+}
+
+std::vector<CWordStore::Entry>::const_iterator CWordStore::LowerBound(std::string_view word) const
+{
+    return std::partition_point(m_entries.begin(), m_entries.end(), [&](const Entry& entry) {
+        return Compare(GetWord(entry), word) < 0;
+    });
+}
+
+void CWordStore::Add(std::string_view word, AutoCompleteType type, int count)
+{
+    if (!word.empty() && count > 0)
+        m_pending.push_back(Change{std::string(word), type, count});
+}
+
+void CWordStore::Remove(std::string_view word, int count)
+{
+    if (!word.empty() && count > 0)
+        m_pending.push_back(Change{std::string(word), AutoCompleteType::None, -count});
+}
+
+void CWordStore::Clear()
+{
+    m_text.clear();
+    m_entries.clear();
+    m_pending.clear();
+    m_unusedText = 0;
+}
+
+bool CWordStore::Contains(std::string_view word)
+{
+    Merge();
+    auto it = LowerBound(word);
+    return it != m_entries.end() && Compare(GetWord(*it), word) == 0;
+}
+
+void CWordStore::Merge()
+{
+    if (m_pending.empty())
+        return;
+    // stable, so the first spelling of a word stays first
+    std::stable_sort(m_pending.begin(), m_pending.end(), [](const Change& lhs, const Change& rhs) {
+        return Compare(lhs.word, rhs.word) < 0;
+    });
+    // one change per word
+    size_t last = 0;
+    for (size_t i = 1; i < m_pending.size(); ++i)
+    {
+        auto& merged = m_pending[last];
+        if (Compare(merged.word, m_pending[i].word) == 0)
+        {
+            if (merged.type == AutoCompleteType::None)
+                merged.type = m_pending[i].type;
+            merged.delta += m_pending[i].delta;
+        }
+        else if (++last != i)
+            m_pending[last] = std::move(m_pending[i]);
+    }
+    m_pending.resize(last + 1);
+
+    if (m_pending.size() > maxChangesInPlace)
+    {
+        Rebuild();
+        return;
+    }
+    for (const auto& change : m_pending)
+    {
+        const auto index = static_cast<size_t>(LowerBound(change.word) - m_entries.begin());
+        if (index < m_entries.size() && Compare(GetWord(m_entries[index]), change.word) == 0)
+        {
+            auto& entry = m_entries[index];
+            if (static_cast<int64_t>(entry.refs) + change.delta > 0)
+                entry.refs = static_cast<uint32_t>(entry.refs + change.delta);
+            else
+            {
+                m_unusedText += entry.length;
+                m_entries.erase(m_entries.begin() + index);
+            }
+        }
+        else if (change.delta > 0)
+        {
+            m_entries.insert(m_entries.begin() + index, Entry{static_cast<uint32_t>(m_text.size()), static_cast<uint32_t>(change.word.size()), static_cast<uint32_t>(change.delta), change.type});
+            m_text.append(change.word);
+        }
+    }
+    m_pending.clear();
+    // the text of removed words is only dropped once there's a lot of it
+    if (m_unusedText > m_text.size() / 2)
+        Rebuild();
+}
+
+void CWordStore::Rebuild()
+{
+    // the merged words go into new buffers, which also drops the text of removed words
+    std::string        text;
+    std::vector<Entry> entries;
+    text.reserve(m_text.size() - m_unusedText);
+    entries.reserve(m_entries.size() + m_pending.size());
+    auto append = [&](std::string_view word, uint32_t refs, AutoCompleteType type) {
+        entries.push_back(Entry{static_cast<uint32_t>(text.size()), static_cast<uint32_t>(word.size()), refs, type});
+        text.append(word);
+    };
+    auto it = m_entries.cbegin();
+    for (const auto& change : m_pending)
+    {
+        for (; it != m_entries.cend() && Compare(GetWord(*it), change.word) < 0; ++it)
+            append(GetWord(*it), it->refs, it->type);
+        int64_t refs = change.delta;
+        auto    type = change.type;
+        if (it != m_entries.cend() && Compare(GetWord(*it), change.word) == 0)
+        {
+            refs += it->refs;
+            type  = it->type;
+            if (refs > 0)
+                append(GetWord(*it), static_cast<uint32_t>(refs), type);
+            ++it;
+        }
+        else if (refs > 0)
+            append(change.word, static_cast<uint32_t>(refs), type);
+    }
+    for (; it != m_entries.cend(); ++it)
+        append(GetWord(*it), it->refs, it->type);
+    m_text.swap(text);
+    m_entries.swap(entries);
+    m_unusedText = 0;
+    m_pending.clear();
+    m_pending.shrink_to_fit();
+}
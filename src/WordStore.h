@@ -0,0 +1,95 @@
+﻿// This file is part of BowPad.
+//
+// Copyright (C) 2025 - Stefan Kueng
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// See <http://www.gnu.org/licenses/> for a copy of the full license text
+//
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+
+enum class AutoCompleteType : int
+{
+    None = -1,
+    Code = 0,
+    Path,
+    Snippet,
+    Word,
+};
+
+/**
+ * The words used for autocompletion, e.g. of one language or one document.
+ *
+ * All words are stored in one buffer and indexed by an array sorted case
+ * insensitively, so the words starting with a prefix are found with a binary
+ * search. Words are unique regardless of case, the first spelling added wins.
+ *
+ * Every word is reference counted: it's only gone once it has been removed
+ * as often as it was added. That way the words of a document can be kept
+ * up to date by adding and removing the words of every edit.
+ *
+ * Changes are collected first and merged into the sorted array the next time
+ * it's queried: adding a whole document's words doesn't move the array around
+ * for every single word.
+ */
+class CWordStore
+{
+public:
+    void   Add(std::string_view word, AutoCompleteType type, int count = 1);
+    void   Remove(std::string_view word, int count = 1);
+    void   Clear();
+    bool   empty() const { return m_entries.empty() && m_pending.empty(); }
+    bool   Contains(std::string_view word);
+
+    /// Calls callback(word, type) for every word starting with prefix, ignoring case.
+    template <typename Callback>
+    void   ForEachWithPrefix(std::string_view prefix, Callback&& callback)
+    {
+        Merge();
+        for (auto it = LowerBound(prefix); it != m_entries.end(); ++it)
+        {
+            auto word = GetWord(*it);
+            if (word.size() < prefix.size() || Compare(word.substr(0, prefix.size()), prefix) != 0)
+                break;
+            callback(word, it->type);
+        }
+    }
+
+private:
+    struct Entry
+    {
+        uint32_t         offset; ///< into m_text
+        uint32_t         length;
+        uint32_t         refs;
+        AutoCompleteType type;
+    };
+    struct Change
+    {
+        std::string      word;
+        AutoCompleteType type;
+        int              delta;
+    };
+
+    static int                         Compare(std::string_view lhs, std::string_view rhs);
+    std::string_view                   GetWord(const Entry& entry) const { return std::string_view(m_text).substr(entry.offset, entry.length); }
+    std::vector<Entry>::const_iterator LowerBound(std::string_view word) const;
+    void                               Merge();
+    void                               Rebuild();
+
+    std::string                        m_text;
+    std::vector<Entry>                 m_entries;
+    size_t                             m_unusedText = 0; ///< bytes in m_text of words which are gone
+    std::vector<Change>                m_pending;
+};
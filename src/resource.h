@@ -389,6 +389,7 @@
 #define IDC_REGEXHELP                   1135
 #define IDC_BUTTON1                     1136
 #define IDC_RESETSTYLE                  1136
+#define IDC_INCREMENTALSEARCH           1137
 #define IDC_STATIC                      -1
 
 // Next default values for new objects
@@ -398,7 +399,7 @@
 #define _APS_NO_MFC                     1
 #define _APS_NEXT_RESOURCE_VALUE        259
 #define _APS_NEXT_COMMAND_VALUE         32773
-#define _APS_NEXT_CONTROL_VALUE         1137
+#define _APS_NEXT_CONTROL_VALUE         1138
 #define _APS_NEXT_SYMED_VALUE           110
 #endif
 #endif
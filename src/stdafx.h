@@ -78,3 +78,6 @@
 #define WM_MOVETODESKTOP     (WM_APP + 15)
 #define WM_MOVETODESKTOP2    (WM_APP + 16)
 #define WM_SCICHAR           (WM_APP + 17)
+#define WM_INCSEARCHREADY    (WM_APP + 18)
+#define WM_PATHLISTREADY     (WM_APP + 19)
+#define WM_SELTEXTMARKERS    (WM_APP + 20)